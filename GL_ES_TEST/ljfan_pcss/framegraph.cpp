@@ -0,0 +1,362 @@
+/*
+ * framegraph.cpp
+ * Render passes declare the attachments they write and the textures they
+ * read; the graph owns the GL objects behind them.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "framegraph.h"
+
+void fgInit(FrameGraph* graph, int width, int height)
+{
+	memset(graph, 0, sizeof(*graph));
+	fgCreateResource(graph, "backbuffer", width, height, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+	fgCreateResource(graph, "backbuffer depth", width, height, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT);
+	graph->resources[FG_BACKBUFFER].imported = true;
+	graph->resources[FG_BACKBUFFER_DEPTH].imported = true;
+}
+
+void fgDestroy(FrameGraph* graph)
+{
+	for(int i=0; i<graph->numPasses; i++) {
+		if(graph->passes[i].fbo) {
+			glDeleteFramebuffers(1, &graph->passes[i].fbo);
+		}
+	}
+	for(int i=0; i<graph->numPhysical; i++) {
+		if(graph->physical[i].target == GL_TEXTURE_2D) {
+			glDeleteTextures(1, &graph->physical[i].name);
+		} else {
+			glDeleteRenderbuffers(1, &graph->physical[i].name);
+		}
+	}
+	memset(graph, 0, sizeof(*graph));
+}
+
+int fgCreateResource(FrameGraph* graph, const char* name, int width, int height,
+		GLenum internalFormat, GLenum format, GLenum type)
+{
+	if(graph->numResources == FG_MAX_RESOURCES) {
+		return -1;
+	}
+	FgResource* res = &graph->resources[graph->numResources];
+	memset(res, 0, sizeof(*res));
+	res->name = name;
+	res->width = width;
+	res->height = height;
+	res->internalFormat = internalFormat;
+	res->format = format;
+	res->type = type;
+	res->firstPass = -1;
+	res->lastPass = -1;
+	res->physical = -1;
+	graph->compiled = false;
+	return graph->numResources++;
+}
+
+int fgAddPass(FrameGraph* graph, const char* name, FgPassFunc func)
+{
+	if(graph->numPasses == FG_MAX_PASSES) {
+		return -1;
+	}
+	FgPass* pass = &graph->passes[graph->numPasses];
+	memset(pass, 0, sizeof(*pass));
+	pass->name = name;
+	pass->func = func;
+	pass->clearDepth = 1.0f;
+	graph->compiled = false;
+	return graph->numPasses++;
+}
+
+void fgWrite(FrameGraph* graph, int pass, int resource, GLenum attachment, FgLoadOp load)
+{
+	FgPass* p = &graph->passes[pass];
+	if(p->numWrites == FG_MAX_ATTACHMENTS) {
+		return;
+	}
+	p->writes[p->numWrites].resource = resource;
+	p->writes[p->numWrites].attachment = attachment;
+	p->writes[p->numWrites].load = load;
+	p->numWrites++;
+	graph->compiled = false;
+}
+
+void fgRead(FrameGraph* graph, int pass, int resource)
+{
+	FgPass* p = &graph->passes[pass];
+	if(p->numReads == FG_MAX_RESOURCES) {
+		return;
+	}
+	p->reads[p->numReads++] = resource;
+	graph->compiled = false;
+}
+
+void fgClearValues(FrameGraph* graph, int pass, float r, float g, float b, float a, float depth)
+{
+	FgPass* p = &graph->passes[pass];
+	p->clearColor[0] = r;
+	p->clearColor[1] = g;
+	p->clearColor[2] = b;
+	p->clearColor[3] = a;
+	p->clearDepth = depth;
+}
+
+static void touch(FgResource* res, int pass)
+{
+	if(res->firstPass < 0) {
+		res->firstPass = pass;
+	}
+	res->lastPass = pass;
+}
+
+/* Renderbuffers only take sized formats. */
+static GLenum sizedFormat(GLenum internalFormat)
+{
+	switch(internalFormat) {
+	case GL_RGBA:			return GL_RGBA8;
+	case GL_RGB:			return GL_RGB8;
+	case GL_DEPTH_COMPONENT:	return GL_DEPTH_COMPONENT24;
+	case GL_DEPTH_STENCIL:		return GL_DEPTH24_STENCIL8;
+	default:			return internalFormat;
+	}
+}
+
+static int allocPhysical(FrameGraph* graph, FgResource* res)
+{
+	GLenum target = res->sampled ? GL_TEXTURE_2D : GL_RENDERBUFFER;
+
+	/* Alias anything of the same shape whose last user is already done. */
+	for(int i=0; i<graph->numPhysical; i++) {
+		FgPhysical* phys = &graph->physical[i];
+		if(phys->target == target && phys->internalFormat == res->internalFormat &&
+				phys->width == res->width && phys->height == res->height &&
+				phys->busyUntil < res->firstPass) {
+			phys->busyUntil = res->lastPass;
+			return i;
+		}
+	}
+
+	FgPhysical* phys = &graph->physical[graph->numPhysical];
+	phys->target = target;
+	phys->internalFormat = res->internalFormat;
+	phys->width = res->width;
+	phys->height = res->height;
+	phys->busyUntil = res->lastPass;
+	if(target == GL_TEXTURE_2D) {
+		glGenTextures(1, &phys->name);
+		glBindTexture(GL_TEXTURE_2D, phys->name);
+		glTexImage2D(GL_TEXTURE_2D, 0, res->internalFormat, res->width, res->height, 0, res->format, res->type, NULL);
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	} else {
+		glGenRenderbuffers(1, &phys->name);
+		glBindRenderbuffer(GL_RENDERBUFFER, phys->name);
+		glRenderbufferStorage(GL_RENDERBUFFER, sizedFormat(res->internalFormat), res->width, res->height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	}
+	return graph->numPhysical++;
+}
+
+/* The default framebuffer names its attachments differently. */
+static GLenum defaultAttachment(GLenum attachment)
+{
+	return attachment == GL_DEPTH_ATTACHMENT ? GL_DEPTH :
+			attachment == GL_STENCIL_ATTACHMENT ? GL_STENCIL : GL_COLOR;
+}
+
+bool fgCompile(FrameGraph* graph)
+{
+	for(int i=0; i<graph->numPasses; i++) {
+		if(graph->passes[i].fbo) {
+			glDeleteFramebuffers(1, &graph->passes[i].fbo);
+			graph->passes[i].fbo = 0;
+		}
+	}
+	for(int i=0; i<graph->numPhysical; i++) {
+		if(graph->physical[i].target == GL_TEXTURE_2D) {
+			glDeleteTextures(1, &graph->physical[i].name);
+		} else {
+			glDeleteRenderbuffers(1, &graph->physical[i].name);
+		}
+	}
+	graph->numPhysical = 0;
+
+	/* lifetimes */
+	for(int r=0; r<graph->numResources; r++) {
+		graph->resources[r].firstPass = -1;
+		graph->resources[r].lastPass = -1;
+		graph->resources[r].sampled = false;
+		graph->resources[r].physical = -1;
+	}
+	for(int p=0; p<graph->numPasses; p++) {
+		FgPass* pass = &graph->passes[p];
+		for(int w=0; w<pass->numWrites; w++) {
+			touch(&graph->resources[pass->writes[w].resource], p);
+		}
+		for(int r=0; r<pass->numReads; r++) {
+			FgResource* res = &graph->resources[pass->reads[r]];
+			if(res->firstPass < 0 && !res->imported) {
+				printf("frame graph: pass %s reads %s before anything writes it\n", pass->name, res->name);
+				return false;
+			}
+			touch(res, p);
+			res->sampled = true;
+		}
+	}
+
+	/* attachments, in order of first use so the aliasing sees them in time order */
+	for(int p=0; p<graph->numPasses; p++) {
+		for(int r=0; r<graph->numResources; r++) {
+			FgResource* res = &graph->resources[r];
+			if(res->firstPass == p && !res->imported) {
+				res->physical = allocPhysical(graph, res);
+			}
+		}
+	}
+
+	/* FBOs and load / store actions */
+	for(int p=0; p<graph->numPasses; p++) {
+		FgPass* pass = &graph->passes[p];
+		bool onscreen = false;
+		bool offscreen = false;
+		GLenum drawBuffers[FG_MAX_ATTACHMENTS];
+		int numDrawBuffers = 0;
+
+		pass->clearMask = 0;
+		pass->numInvalidateBefore = 0;
+		pass->numInvalidateAfter = 0;
+		for(int w=0; w<pass->numWrites; w++) {
+			FgResource* res = &graph->resources[pass->writes[w].resource];
+			if(res->imported) {
+				onscreen = true;
+			} else {
+				offscreen = true;
+			}
+			pass->width = res->width;
+			pass->height = res->height;
+		}
+		if(onscreen && offscreen) {
+			printf("frame graph: pass %s mixes the window surface with its own attachments\n", pass->name);
+			return false;
+		}
+
+		if(offscreen) {
+			glGenFramebuffers(1, &pass->fbo);
+			glBindFramebuffer(GL_FRAMEBUFFER, pass->fbo);
+		}
+		for(int w=0; w<pass->numWrites; w++) {
+			FgAttachment* att = &pass->writes[w];
+			FgResource* res = &graph->resources[att->resource];
+			GLenum name = onscreen ? defaultAttachment(att->attachment) : att->attachment;
+			bool color = att->attachment != GL_DEPTH_ATTACHMENT && att->attachment != GL_STENCIL_ATTACHMENT &&
+					att->attachment != GL_DEPTH_STENCIL_ATTACHMENT;
+
+			if(offscreen) {
+				FgPhysical* phys = &graph->physical[res->physical];
+				if(phys->target == GL_TEXTURE_2D) {
+					glFramebufferTexture2D(GL_FRAMEBUFFER, att->attachment, GL_TEXTURE_2D, phys->name, 0);
+				} else {
+					glFramebufferRenderbuffer(GL_FRAMEBUFFER, att->attachment, GL_RENDERBUFFER, phys->name);
+				}
+				if(color) {
+					drawBuffers[numDrawBuffers++] = att->attachment;
+				}
+			}
+
+			if(att->load == FG_LOAD_CLEAR) {
+				pass->clearMask |= color ? GL_COLOR_BUFFER_BIT : GL_DEPTH_BUFFER_BIT;
+			} else if(att->load == FG_LOAD_DONT_CARE) {
+				pass->invalidateBefore[pass->numInvalidateBefore++] = name;
+			}
+			/* Nothing reads it after this pass and it is not presented: don't store it. */
+			if(res->lastPass == p && att->resource != FG_BACKBUFFER) {
+				pass->invalidateAfter[pass->numInvalidateAfter++] = name;
+			}
+		}
+		if(offscreen) {
+			if(numDrawBuffers > 0) {
+				glDrawBuffers(numDrawBuffers, drawBuffers);
+			} else {
+				GLenum none = GL_NONE;
+				glDrawBuffers(1, &none);
+			}
+			GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+			if(status != GL_FRAMEBUFFER_COMPLETE) {
+				printf("frame graph: pass %s framebuffer incomplete (0x%x)\n", pass->name, status);
+				glBindFramebuffer(GL_FRAMEBUFFER, 0);
+				return false;
+			}
+		}
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	printf("frame graph: %d passes, %d resources in %d attachments\n",
+			graph->numPasses, graph->numResources - 2, graph->numPhysical);
+	for(int r=0; r<graph->numResources; r++) {
+		FgResource* res = &graph->resources[r];
+		if(res->imported || res->physical < 0) {
+			continue;
+		}
+		printf("  %s: %dx%d %s #%d, passes %d-%d\n", res->name, res->width, res->height,
+				graph->physical[res->physical].target == GL_TEXTURE_2D ? "texture" : "renderbuffer",
+				res->physical, res->firstPass, res->lastPass);
+	}
+
+	graph->boundFbo = (GLuint)-1;
+	graph->compiled = true;
+	return true;
+}
+
+void fgExecute(FrameGraph* graph, void* frameData)
+{
+	if(!graph->compiled) {
+		return;
+	}
+	graph->binds = 0;
+	graph->invalidates = 0;
+	for(int p=0; p<graph->numPasses; p++) {
+		FgPass* pass = &graph->passes[p];
+		if(pass->numWrites > 0) {
+			if(graph->boundFbo != pass->fbo) {
+				glBindFramebuffer(GL_FRAMEBUFFER, pass->fbo);
+				graph->boundFbo = pass->fbo;
+				graph->binds++;
+			}
+			if(graph->viewport[2] != pass->width || graph->viewport[3] != pass->height) {
+				glViewport(0, 0, pass->width, pass->height);
+				graph->viewport[2] = pass->width;
+				graph->viewport[3] = pass->height;
+			}
+			if(pass->numInvalidateBefore > 0) {
+				glInvalidateFramebuffer(GL_FRAMEBUFFER, pass->numInvalidateBefore, pass->invalidateBefore);
+				graph->invalidates += pass->numInvalidateBefore;
+			}
+			if(pass->clearMask) {
+				glClearColor(pass->clearColor[0], pass->clearColor[1], pass->clearColor[2], pass->clearColor[3]);
+				glClearDepthf(pass->clearDepth);
+				glClear(pass->clearMask);
+			}
+		}
+
+		pass->func(frameData);
+
+		if(pass->numInvalidateAfter > 0) {
+			glInvalidateFramebuffer(GL_FRAMEBUFFER, pass->numInvalidateAfter, pass->invalidateAfter);
+			graph->invalidates += pass->numInvalidateAfter;
+		}
+	}
+}
+
+GLuint fgTexture(const FrameGraph* graph, int resource)
+{
+	const FgResource* res = &graph->resources[resource];
+	if(res->physical < 0 || graph->physical[res->physical].target != GL_TEXTURE_2D) {
+		return 0;
+	}
+	return graph->physical[res->physical].name;
+}
@@ -0,0 +1,127 @@
+/*
+ * framegraph.h
+ * Render passes declare the attachments they write and the textures they
+ * read; the graph owns the GL objects behind them.
+ */
+
+#ifndef FRAMEGRAPH_H
+#define FRAMEGRAPH_H
+
+#include <GLES3/gl32.h>
+
+#define FG_MAX_RESOURCES	8
+#define FG_MAX_PASSES		8
+#define FG_MAX_ATTACHMENTS	3
+
+/* The window surface, always present, created by fgInit(). */
+#define FG_BACKBUFFER		0
+#define FG_BACKBUFFER_DEPTH	1
+
+/* What a pass wants in an attachment when it starts. */
+typedef enum {
+	FG_LOAD_DONT_CARE,	/* fully overwritten, previous contents are invalidated */
+	FG_LOAD_CLEAR,
+	FG_LOAD_KEEP,
+} FgLoadOp;
+
+typedef void (*FgPassFunc)(void* frameData);
+
+typedef struct {
+	const char* name;
+	int width;
+	int height;
+	GLenum internalFormat;
+	GLenum format;
+	GLenum type;
+	bool imported;		/* owned by EGL, not by the graph */
+	/* filled by fgCompile() */
+	int firstPass;
+	int lastPass;
+	bool sampled;		/* read by a later pass, so it needs a texture */
+	int physical;
+} FgResource;
+
+/* A texture or renderbuffer, shared by resources whose lifetimes do not overlap. */
+typedef struct {
+	GLenum target;		/* GL_TEXTURE_2D or GL_RENDERBUFFER */
+	GLuint name;
+	GLenum internalFormat;
+	int width;
+	int height;
+	int busyUntil;		/* last pass of the resource currently using it */
+} FgPhysical;
+
+typedef struct {
+	int resource;
+	GLenum attachment;
+	FgLoadOp load;
+} FgAttachment;
+
+typedef struct {
+	const char* name;
+	FgPassFunc func;
+	FgAttachment writes[FG_MAX_ATTACHMENTS];
+	int numWrites;
+	int reads[FG_MAX_RESOURCES];
+	int numReads;
+	float clearColor[4];
+	float clearDepth;
+	/* filled by fgCompile() */
+	GLuint fbo;
+	int width;
+	int height;
+	GLbitfield clearMask;
+	GLenum invalidateBefore[FG_MAX_ATTACHMENTS];
+	int numInvalidateBefore;
+	GLenum invalidateAfter[FG_MAX_ATTACHMENTS];
+	int numInvalidateAfter;
+} FgPass;
+
+typedef struct {
+	FgResource resources[FG_MAX_RESOURCES];
+	int numResources;
+	FgPass passes[FG_MAX_PASSES];
+	int numPasses;
+	FgPhysical physical[FG_MAX_RESOURCES];
+	int numPhysical;
+	bool compiled;
+	/* GL state as last set by fgExecute() */
+	GLuint boundFbo;
+	int viewport[4];
+	/* per frame counters */
+	int binds;
+	int invalidates;
+} FrameGraph;
+
+void fgInit(FrameGraph* graph, int width, int height);
+void fgDestroy(FrameGraph* graph);
+
+/* Declares a 2D attachment; format and type are only used if it ends up a texture. */
+int fgCreateResource(FrameGraph* graph, const char* name, int width, int height,
+		GLenum internalFormat, GLenum format, GLenum type);
+
+int fgAddPass(FrameGraph* graph, const char* name, FgPassFunc func);
+void fgWrite(FrameGraph* graph, int pass, int resource, GLenum attachment, FgLoadOp load);
+void fgRead(FrameGraph* graph, int pass, int resource);
+void fgClearValues(FrameGraph* graph, int pass, float r, float g, float b, float a, float depth);
+
+/*
+ * Works out resource lifetimes, allocates and aliases the attachments,
+ * builds one FBO per off-screen pass and the invalidate lists. Passes run
+ * in the order they were added. Returns false on an unusable graph.
+ */
+bool fgCompile(FrameGraph* graph);
+
+/*
+ * Runs every pass: binds its FBO and viewport only when they change,
+ * invalidates / clears per the load ops, calls the pass and then
+ * invalidates the attachments nothing reads afterwards. Clears use the
+ * current write masks; passes must leave the framebuffer binding and the
+ * viewport alone.
+ */
+void fgExecute(FrameGraph* graph, void* frameData);
+
+/* The texture behind a sampled resource, 0 for anything else. */
+GLuint fgTexture(const FrameGraph* graph, int resource);
+
+#endif
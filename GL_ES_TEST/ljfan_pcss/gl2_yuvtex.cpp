@@ -16,6 +16,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 #include <sched.h>
 #include <sys/resource.h>
@@ -34,6 +35,16 @@
 #include <EGLUtils.h>
 #include "KnightModel.h"
 #include "matrix.h"
+#include "mesh.h"
+#include "scene.h"
+#include "framepipeline.h"
+#include "framegraph.h"
+
+/* Draw the knight through its LOD chain, clustered and culled on the CPU. */
+#define MESHLET_CULLING 1
+
+/* Build the next frames on a worker thread, 0 builds them inline on the GL thread. */
+#define FRAME_THREAD 1
 
 using namespace android;
 
@@ -180,6 +191,8 @@ GLuint createProgram_ori(const char* pVertexSource, const char* pFragmentSource)
 GLuint gProgram_depth;
 GLuint gProgram_shadow;
 GLuint gProgram_show_depth;
+GLuint gProgram_depth_instanced;
+GLuint gProgram_shadow_instanced;
 GLint gvPositionHandle;
 GLint gYuvTexSamplerHandle;
 
@@ -224,6 +237,34 @@ static const char gFragmentShader_shadow[] =
   "     color = vec4(vsNormal, 1.0) * test + vec4(0.0, 0.0, 0.0, 1.0);\n"
   "}\n";
 
+/* Scene mode: one draw per LOD, the model matrix comes from the instance. */
+static const char gVertexShader_shadow_instanced[] =
+	"#version 320 es\n"
+	"\n"
+	"layout(location = 0) in vec3 vPosition;\n"
+	"layout(location = 1) in vec3 vNormal;\n"
+	"layout(location = 2) in mat4 instanceModel;\n"
+	"uniform mat4 viewProj;\n"
+	"uniform mat4 lightViewProj;\n"
+	"out vec4 worldPos;\n"
+	"out vec3 vsNormal;\n"
+  "void main() {\n"
+  "  vec4 world = instanceModel*vec4(vPosition, 1.0);\n"
+  "  gl_Position = viewProj*world;\n"
+  "  worldPos = lightViewProj*world;\n"
+  "  vsNormal  = vNormal;\n"
+  "}\n";
+
+static const char gVertexShader_depth_instanced[] =
+  "#version 320 es\n"
+  "\n"
+	"layout(location = 0) in vec3 vPosition;\n"
+	"layout(location = 2) in mat4 instanceModel;\n"
+	"uniform mat4 viewProj;\n"
+  "void main() {\n"
+  "  gl_Position = viewProj*instanceModel*vec4(vPosition, 1.0);\n"
+  "}\n";
+
 static const char gVertexShader_depth[] =
   "#version 320 es\n"
   "\n"
@@ -297,20 +338,317 @@ float LightV[16];
 float LightP[16];
 float lightMvp[16];
 #define PI 3.1415926
-GLuint depthTex = 0;
-GLuint colorTex = 0;
-GLuint depthFBO = 0;
+/* Shadow map pass, camera pass and depth overlay; the graph owns their attachments. */
+FrameGraph frameGraph;
+int shadowDepth = -1;
+int shadowColor = -1;
 float Light_X =  -5;
 float Light_Y =  5;
 float Light_Z = 2;
+float Eye_X = 0;
+float Eye_Y = 3;
+float Eye_Z = 5;
+float sceneScale = 1;
 float maxY = 0.0;
 float minY = 0.0;
 float maxZ = 0.0;
 float minZ = 0.0;
-float rotate = 0;
 
 EGLint screen_w, screen_h;
 
+/* Largest projected error, in pixels / shadow map texels, a LOD may introduce. */
+#define CAMERA_LOD_PIXEL_ERROR	1.0f
+#define SHADOW_LOD_PIXEL_ERROR	4.0f
+#define SHADOW_MAP_SIZE		1024
+
+MeshLod knightLods[MAX_LODS];
+int numKnightLods = 0;
+GLuint knightVAO = 0;
+GLuint knightVBO = 0;
+GLuint knightIBO = 0;
+GLuint indirectBuffer = 0;
+PFNGLMULTIDRAWELEMENTSINDIRECTEXTPROC multiDrawElementsIndirect = NULL;
+int frameCount = 0;
+int visibleCamera = 0;
+int visibleShadow = 0;
+
+void setupMeshlets() {
+		unsigned int* indices = (unsigned int*)malloc(sizeof(unsigned int)*knight_numIndices);
+		for(int i=0; i<knight_numIndices; i++) {
+			indices[i] = knight_indices[i];
+		}
+		nsecs_t start = systemTime();
+		numKnightLods = buildLodChain(knightLods, MAX_LODS, knight_vertices[0].position,
+				sizeof(ModelVertex)/sizeof(float), knight_numVertices, indices, knight_numIndices);
+		free(indices);
+		printf("knight: %d LODs built in %lld ms\n", numKnightLods, (long long)ns2ms(systemTime() - start));
+
+		/* All levels share one index buffer, level 0 has the most meshlets. */
+		int totalIndices = 0;
+		for(int i=0; i<numKnightLods; i++) {
+			knightLods[i].firstIndex = totalIndices;
+			totalIndices += knightLods[i].meshlets.numIndices;
+			printf("  LOD%d: %d triangles, %d meshlets, error %f\n", i,
+					knightLods[i].meshlets.numIndices/3, knightLods[i].meshlets.numMeshlets, knightLods[i].error);
+		}
+
+		/* Indirect draws need every enabled attribute sourced from a buffer. */
+		glGenVertexArrays(1, &knightVAO);
+		glBindVertexArray(knightVAO);
+		glGenBuffers(1, &knightVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, knightVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(knight_vertices), knight_vertices, GL_STATIC_DRAW);
+		glGenBuffers(1, &knightIBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, knightIBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int)*totalIndices, NULL, GL_STATIC_DRAW);
+		for(int i=0; i<numKnightLods; i++) {
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int)*knightLods[i].firstIndex,
+					sizeof(unsigned int)*knightLods[i].meshlets.numIndices, knightLods[i].meshlets.indices);
+		}
+		glEnableVertexAttribArray(0);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 48, (void*)0);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 48, (void*)12);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		glGenBuffers(1, &indirectBuffer);
+
+		const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+		if(extensions && strstr(extensions, "GL_EXT_multi_draw_indirect")) {
+			multiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTEXTPROC)
+					eglGetProcAddress("glMultiDrawElementsIndirectEXT");
+		}
+		printf("multi draw indirect: %s\n", multiDrawElementsIndirect ? "yes" : "no");
+		checkGlError("setupMeshlets");
+}
+
+/*
+ * Picks the knight's LOD for a viewer at (x, y, z). The knight stands at
+ * (0, -minY, 0); projScale is the target height / (2 * tan(fovy / 2)).
+ */
+int knightLod(float x, float y, float z, float projScale, float maxPixelError) {
+		float dy = y + minY;
+		float distance = sqrtf(x*x + dy*dy + z*z);
+		return selectLod(knightLods, numKnightLods, distance, projScale, maxPixelError);
+}
+
+/*
+ * Culls the meshlets of one knight LOD against the frustum of mvp (and
+ * against eye, given in object space, when not NULL). The commands written
+ * to cmds already point into the shared index buffer.
+ */
+int cullKnightMeshlets(DrawElementsIndirectCommand* cmds, float* mvp, const float* eye, int lod) {
+		float planes[24];
+		frustumPlanes(mvp, planes);
+		int numCmds = cullMeshlets(&knightLods[lod].meshlets, planes, eye, cmds);
+		for(int i=0; i<numCmds; i++) {
+			cmds[i].firstIndex += knightLods[lod].firstIndex;
+		}
+		return numCmds;
+}
+
+/* Draws the output of cullKnightMeshlets(), returns the number of triangles. */
+int drawKnightMeshlets(const DrawElementsIndirectCommand* cmds, int numCmds) {
+		if(numCmds == 0) {
+			return 0;
+		}
+		glBindVertexArray(knightVAO);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand)*numCmds, cmds, GL_STREAM_DRAW);
+		if(multiDrawElementsIndirect) {
+			multiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, numCmds, 0);
+		} else {
+			for(int i=0; i<numCmds; i++) {
+				glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+						(void*)(sizeof(DrawElementsIndirectCommand)*i));
+			}
+		}
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		glBindVertexArray(0);
+		checkGlError("drawKnightMeshlets");
+
+		int numTriangles = 0;
+		for(int i=0; i<numCmds; i++) {
+			numTriangles += cmds[i].count/3;
+		}
+		return numTriangles;
+}
+
+/* Number of knights in scene mode, 0 draws the single knight of the demo. */
+int numInstances = 0;
+InstanceScene scene;
+GLuint instanceBuffer = 0;
+GLuint knightInstVAO = 0;
+GpuTimer depthTimer;
+GpuTimer senceTimer;
+nsecs_t cpuTime = 0;
+
+void setupScene() {
+		setupInstanceGrid(&scene, numInstances, 1.5f, 170, -minY,
+				knight_vertices[0].position, sizeof(ModelVertex)/sizeof(float), knight_numVertices);
+
+		/* Pull the camera and the light back until the whole grid is in view. */
+		sceneScale = scene.extent/1.5f;
+		if(sceneScale < 1) {
+			sceneScale = 1;
+		}
+		Eye_X *= sceneScale; Eye_Y *= sceneScale; Eye_Z *= sceneScale;
+		Light_X *= sceneScale; Light_Y *= sceneScale; Light_Z *= sceneScale;
+		printf("scene: %d knights, grid extent %f, scale %f\n", numInstances, scene.extent, sceneScale);
+
+		/* camera pass instances first, shadow pass instances after them */
+		glGenBuffers(1, &instanceBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(float)*16*numInstances*2, NULL, GL_STREAM_DRAW);
+
+		glGenVertexArrays(1, &knightInstVAO);
+		glBindVertexArray(knightInstVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, knightVBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, knightIBO);
+		glEnableVertexAttribArray(0);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 48, (void*)0);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 48, (void*)12);
+		bindInstanceAttribs(instanceBuffer, 0);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		gpuTimerInit(&depthTimer);
+		gpuTimerInit(&senceTimer);
+		checkGlError("setupScene");
+}
+
+/*
+ * Everything the GL thread needs to submit one frame. buildFrame() fills it
+ * on the frame pipeline's worker while the GL thread submits older frames,
+ * so nothing in here may be shared with the GL thread's own state.
+ */
+typedef struct {
+		float rotate;
+		float viewProj[16];
+		float lightViewProj[16];
+		float knightMvp[16];
+		float knightLightMvp[16];
+		float floorMvp[16];
+		float floorLightMvp[16];
+		int lodCamera;
+		int lodShadow;
+		DrawElementsIndirectCommand* cameraCmds;
+		int numCameraCmds;
+		DrawElementsIndirectCommand* shadowCmds;
+		int numShadowCmds;
+		InstanceBuckets cameraBuckets;
+		InstanceBuckets shadowBuckets;
+		float* models;		/* camera pass instances, then shadow pass instances */
+} FramePacket;
+
+FramePacket framePackets[FRAME_PACKETS];
+FramePipeline framePipeline;
+
+/*
+ * Worker side of a frame: simulation, matrices, per-meshlet culling and
+ * per-instance culling / LOD bucketing. Only reads state that is fixed once
+ * setupGraphics() returns.
+ */
+void buildFrame(void* packet, int /*frame*/) {
+		FramePacket* f = (FramePacket*)packet;
+		float v[16], p[16], lightV[16], lightP[16];
+		float r[16], s[16], t[16], m[16];
+
+		f->rotate = 170;
+
+		setLookAt(v, Eye_X, Eye_Y, Eye_Z, 0, 0, 0, 0, 1, 0);
+		perspective_matrix(PI/6, 1, 0.9, 100.0*sceneScale, p);
+		multiply_matrix(p, v, f->viewProj);
+		setLookAt(lightV, Light_X, Light_Y, Light_Z, 0, 0, 0, 1, 0, 0);
+		perspective_matrix(PI/6, 1, 0.9, 100.0*sceneScale, lightP);
+		multiply_matrix(lightP, lightV, f->lightViewProj);
+
+		rotate_matrix(f->rotate, 0, 1, 0, r);
+		setTranslate(t, 0, minY*-1, 0);
+		multiply_matrix(t, r, m);
+		multiply_matrix(f->viewProj, m, f->knightMvp);
+		multiply_matrix(f->lightViewProj, m, f->knightLightMvp);
+
+		setScaling(s, 10*sceneScale, 10*sceneScale, 10*sceneScale);
+		multiply_matrix(f->viewProj, s, f->floorMvp);
+		multiply_matrix(f->lightViewProj, s, f->floorLightMvp);
+
+#if MESHLET_CULLING
+		if(numInstances > 0) {
+			float eye[3] = { Eye_X, Eye_Y, Eye_Z };
+			float light[3] = { Light_X, Light_Y, Light_Z };
+			bucketInstances(&f->cameraBuckets, f->models, &scene, f->viewProj, eye,
+					knightLods, numKnightLods, screen_h/(2*tan(PI/12)), CAMERA_LOD_PIXEL_ERROR);
+			/* casters outside the light frustum cannot reach the shadow map */
+			bucketInstances(&f->shadowBuckets, f->models + 16*numInstances, &scene, f->lightViewProj, light,
+					knightLods, numKnightLods, SHADOW_MAP_SIZE/(2*tan(PI/12)), SHADOW_LOD_PIXEL_ERROR);
+		} else {
+			float mInv[16];
+			float eye[3];
+			invert4(mInv, m);
+			/* camera position brought into object space */
+			for(int i=0; i<3; i++) {
+				eye[i] = mInv[i]*Eye_X + mInv[4+i]*Eye_Y + mInv[8+i]*Eye_Z + mInv[12+i];
+			}
+			f->lodCamera = knightLod(Eye_X, Eye_Y, Eye_Z, screen_h/(2*tan(PI/12)), CAMERA_LOD_PIXEL_ERROR);
+			f->numCameraCmds = cullKnightMeshlets(f->cameraCmds, f->knightMvp, eye, f->lodCamera);
+			f->lodShadow = knightLod(Light_X, Light_Y, Light_Z, SHADOW_MAP_SIZE/(2*tan(PI/12)), SHADOW_LOD_PIXEL_ERROR);
+			f->numShadowCmds = cullKnightMeshlets(f->shadowCmds, f->knightLightMvp, NULL, f->lodShadow);
+		}
+#endif
+}
+
+void setupFramePipeline() {
+		void* packets[FRAME_PACKETS];
+		for(int i=0; i<FRAME_PACKETS; i++) {
+			FramePacket* f = &framePackets[i];
+			memset(f, 0, sizeof(*f));
+#if MESHLET_CULLING
+			f->cameraCmds = (DrawElementsIndirectCommand*)malloc(sizeof(DrawElementsIndirectCommand)*knightLods[0].meshlets.numMeshlets);
+			f->shadowCmds = (DrawElementsIndirectCommand*)malloc(sizeof(DrawElementsIndirectCommand)*knightLods[0].meshlets.numMeshlets);
+			if(numInstances > 0) {
+				f->models = (float*)malloc(sizeof(float)*16*numInstances*2);
+			}
+#endif
+			packets[i] = f;
+		}
+		framePipelineStart(&framePipeline, packets, FRAME_PACKETS, buildFrame, FRAME_THREAD);
+		printf("frame pipeline: %d packets, built %s\n", FRAME_PACKETS,
+				framePipeline.threaded ? "on a worker thread" : "on the GL thread");
+}
+
+/* Uploads the packet's visible instances, camera pass first and shadow pass after them. */
+void uploadInstances(const FramePacket* f) {
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(float)*16*numInstances*2, NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float)*16*f->cameraBuckets.numVisible, f->models);
+		glBufferSubData(GL_ARRAY_BUFFER, sizeof(float)*16*numInstances, sizeof(float)*16*f->shadowBuckets.numVisible,
+				f->models + 16*numInstances);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/* One glDrawElementsInstanced per LOD; base is the buckets' first instance in instanceBuffer. */
+int drawKnightInstances(const InstanceBuckets* buckets, int base) {
+		int numTriangles = 0;
+		glBindVertexArray(knightInstVAO);
+		for(int lod=0; lod<numKnightLods; lod++) {
+			if(buckets->count[lod] == 0) {
+				continue;
+			}
+			bindInstanceAttribs(instanceBuffer, base + buckets->first[lod]);
+			glDrawElementsInstanced(GL_TRIANGLES, knightLods[lod].meshlets.numIndices, GL_UNSIGNED_INT,
+					(void*)(sizeof(unsigned int)*knightLods[lod].firstIndex), buckets->count[lod]);
+			numTriangles += knightLods[lod].meshlets.numIndices/3*buckets->count[lod];
+		}
+		glBindVertexArray(0);
+		checkGlError("drawKnightInstances");
+		return numTriangles;
+}
+
+bool setupFrameGraph(int w, int h);
+
 bool setupGraphics(int w, int h) {
     gProgram_depth = createProgram_ori(gVertexShader_depth, gFragmentShader_depth);
     if (!gProgram_depth) {
@@ -326,45 +664,24 @@ bool setupGraphics(int w, int h) {
     if (!gProgram_show_depth) {
         return false;
     }
+
+    gProgram_depth_instanced = createProgram_ori(gVertexShader_depth_instanced, gFragmentShader_depth);
+    if (!gProgram_depth_instanced) {
+        return false;
+    }
+
+    gProgram_shadow_instanced = createProgram_ori(gVertexShader_shadow_instanced, gFragmentShader_shadow);
+    if (!gProgram_shadow_instanced) {
+        return false;
+    }
     
     glViewport(0, 0, w, h);
     checkGlError("glViewport");
     checkGlError("e");
     
-    glGenFramebuffers(1, &depthFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, depthFBO);
-
-		glGenTextures(1, &depthTex);
-		glBindTexture(GL_TEXTURE_2D, depthTex);
-		checkGlError("d");
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, 1024, 1024, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
-		checkGlError("a");
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		checkGlError("b");
-
-		glGenTextures(1, &colorTex);
-		glBindTexture(GL_TEXTURE_2D, colorTex);
-		checkGlError("d");
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1024, 1024, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-		checkGlError("a");
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTex, 0);
-		checkGlError("c");
-		printf("colorTex=%d depthTex=%d depthFBO=%d\n", colorTex, depthTex, depthFBO);
-
-		int status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-		checkGlError("11");
-		if(status != GL_FRAMEBUFFER_COMPLETE) {
-			printf("Fuck!\n");
-			exit(1);
-		}
+    if(!setupFrameGraph(w, h)) {
+        return false;
+    }
 
 		for(int i=0; i<knight_numVertices; i++) {
 				if(minY > knight_vertices[i].position[1]){
@@ -388,58 +705,48 @@ bool setupGraphics(int w, int h) {
 		
 		printf("maxY=%f minY=%f\n", maxZ, minZ);
 
+#if MESHLET_CULLING
+		setupMeshlets();
+		if(numInstances > 0) {
+			setupScene();
+		}
+#endif
+		setupFramePipeline();
 
     return true;
 }
 
 
-void drawDepth() {
-		setLookAt(LightV, Light_X, Light_Y, Light_Z, 0, 0, 0, 1, 0, 0);
-		perspective_matrix(PI/6, 1, 0.9, 100.0, LightP);
-
-		rotate_matrix(rotate, 0, 1, 0, r);
-		setScaling(s, 1, 1, 1);
-		setTranslate(t, 0, minY*-1, 0);
-		multiply_matrix(s, r, temp);
-		multiply_matrix(t, temp, m);
-		multiply_matrix(LightV, m, mv);
-		multiply_matrix(LightP, mv, lightMvp);
-
-		glBindFramebuffer(GL_FRAMEBUFFER, depthFBO);
-		glBindTexture(GL_TEXTURE_2D, depthTex);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTex, 0);
-		glBindTexture(GL_TEXTURE_2D, colorTex);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTex, 0);
-		
-		
-		glViewport(0, 0, 1024, 1024);
-
-		glClearDepthf(1.0f);
-		glClearColor(1.0, 0.0, 0.0, 1.0);
-		glClear( GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT );
-
+void drawDepth(const FramePacket* f) {
+#if MESHLET_CULLING
+		if(numInstances > 0) {
+			glUseProgram(gProgram_depth_instanced);
+			glUniformMatrix4fv( glGetUniformLocation (gProgram_depth_instanced, "viewProj"), 1, GL_FALSE, f->lightViewProj);
+			visibleShadow = drawKnightInstances(&f->shadowBuckets, numInstances);
+			checkGlError("drawDepth");
+			return;
+		}
+#endif
 
 		glUseProgram(gProgram_depth);
-		glUniformMatrix4fv( glGetUniformLocation (gProgram_depth, "mvp"), 1, GL_FALSE, lightMvp);
+		glUniformMatrix4fv( glGetUniformLocation (gProgram_depth, "mvp"), 1, GL_FALSE, f->knightLightMvp);
+#if MESHLET_CULLING
+		visibleShadow = drawKnightMeshlets(f->shadowCmds, f->numShadowCmds);
+#else
 		glEnableVertexAttribArray(0);
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 48, knight_vertices);
 		glDrawElements(GL_TRIANGLES, knight_numIndices, GL_UNSIGNED_INT, knight_indices);
+#endif
 
-
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glClearColor(0.0, 0.0, 0.0, 1.0);
 		checkGlError("drawDepth");
 }
 
 void drawShowDepth() {
-	  glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	  glViewport(0, 0, screen_w, screen_h);
-	  	  
 		glUseProgram(gProgram_show_depth);
 	  
 		checkGlError("3");
 	  glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, depthTex);
+		glBindTexture(GL_TEXTURE_2D, fgTexture(&frameGraph, shadowDepth));
 		
 		glUniform1i(glGetUniformLocation (gProgram_show_depth, "depthTex"), 0);
 		
@@ -448,51 +755,40 @@ void drawShowDepth() {
 		glDrawArrays(GL_TRIANGLES, 0, 6);
 }
 
-void drawSence() {
+void drawSence(const FramePacket* f) {
 		glUseProgram(gProgram_shadow);
 
-		setLookAt(v, 0, 3, 5, 0, 0, 0, 0, 1, 0);
-		perspective_matrix(PI/6, 1, 0.9, 100.0, p);
-
-		rotate_matrix(rotate, 0, 1, 0, r);
-		setScaling(s, 1, 1, 1);
-		setTranslate(t, 0, minY*-1, 0);
-		multiply_matrix(s, r, temp);
-		multiply_matrix(t, temp, m);
-		multiply_matrix(v, m, mv);
-		multiply_matrix(p, mv, mvp);
-		multiply_matrix(LightV, m, mv);
-		multiply_matrix(LightP, mv, lightMvp);
-
-	  glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	  glViewport(0, 0, screen_w, screen_h);
 		checkGlError("3");
 	  glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, depthTex);
+		glBindTexture(GL_TEXTURE_2D, fgTexture(&frameGraph, shadowDepth));
 		checkGlError("33");
 		glUniform1i(glGetUniformLocation (gProgram_shadow, "depthTex"), 0);
 		
 		
-		glUniformMatrix4fv( glGetUniformLocation (gProgram_shadow, "LightMvp"), 1, GL_FALSE, lightMvp);
+		glUniformMatrix4fv( glGetUniformLocation (gProgram_shadow, "LightMvp"), 1, GL_FALSE, f->knightLightMvp);
 		
-		glUniformMatrix4fv( glGetUniformLocation (gProgram_shadow, "mvp"), 1, GL_FALSE, mvp);
+		glUniformMatrix4fv( glGetUniformLocation (gProgram_shadow, "mvp"), 1, GL_FALSE, f->knightMvp);
+#if MESHLET_CULLING
+		if(numInstances > 0) {
+			glUseProgram(gProgram_shadow_instanced);
+			glUniform1i(glGetUniformLocation (gProgram_shadow_instanced, "depthTex"), 0);
+			glUniformMatrix4fv( glGetUniformLocation (gProgram_shadow_instanced, "viewProj"), 1, GL_FALSE, f->viewProj);
+			glUniformMatrix4fv( glGetUniformLocation (gProgram_shadow_instanced, "lightViewProj"), 1, GL_FALSE, f->lightViewProj);
+			visibleCamera = drawKnightInstances(&f->cameraBuckets, 0);
+			glUseProgram(gProgram_shadow);
+		} else {
+			visibleCamera = drawKnightMeshlets(f->cameraCmds, f->numCameraCmds);
+		}
+#else
 		glEnableVertexAttribArray(0);
 		glEnableVertexAttribArray(1);
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 48, knight_vertices);
 		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 48, (void*)((char*)knight_vertices+12));
 		glDrawElements(GL_TRIANGLES, knight_numIndices, GL_UNSIGNED_INT, knight_indices);
+#endif
 
-		setScaling(s, 10, 10, 10);
-		setIdentity(t);
-		multiply_matrix(t, s, m);
-		multiply_matrix(v, m, mv);
-		multiply_matrix(p, mv, mvp);
-		
-		multiply_matrix(LightV, m, mv);
-		multiply_matrix(LightP, mv, lightMvp);
-		
-		glUniformMatrix4fv( glGetUniformLocation (gProgram_shadow, "LightMvp"), 1, GL_FALSE, lightMvp);
-		glUniformMatrix4fv( glGetUniformLocation (gProgram_shadow, "mvp"), 1, GL_FALSE, mvp);
+		glUniformMatrix4fv( glGetUniformLocation (gProgram_shadow, "LightMvp"), 1, GL_FALSE, f->floorLightMvp);
+		glUniformMatrix4fv( glGetUniformLocation (gProgram_shadow, "mvp"), 1, GL_FALSE, f->floorMvp);
 		glEnableVertexAttribArray(0);
 		glEnableVertexAttribArray(1);
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 24, gTriangleVertices);
@@ -502,29 +798,109 @@ void drawSence() {
 }
 
 
+void depthPass(void* frameData) {
+		gpuTimerBegin(&depthTimer);
+		drawDepth((const FramePacket*)frameData);
+		gpuTimerEnd(&depthTimer);
+		checkGlError("1");
+}
+
+void sencePass(void* frameData) {
+		gpuTimerBegin(&senceTimer);
+		drawSence((const FramePacket*)frameData);
+		gpuTimerEnd(&senceTimer);
+}
+
+void showDepthPass(void* /*frameData*/) {
+		drawShowDepth();
+		checkGlError("2");
+}
+
+/*
+ * The shadow map's color target is never sampled, so it becomes a
+ * renderbuffer that is invalidated instead of stored, and the window's depth
+ * is dropped after the overlay instead of being written back.
+ */
+bool setupFrameGraph(int w, int h) {
+		fgInit(&frameGraph, w, h);
+		shadowDepth = fgCreateResource(&frameGraph, "shadow depth", SHADOW_MAP_SIZE, SHADOW_MAP_SIZE,
+				GL_DEPTH_COMPONENT, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT);
+		shadowColor = fgCreateResource(&frameGraph, "shadow color", SHADOW_MAP_SIZE, SHADOW_MAP_SIZE,
+				GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE);
+
+		int depth = fgAddPass(&frameGraph, "depth", depthPass);
+		fgWrite(&frameGraph, depth, shadowDepth, GL_DEPTH_ATTACHMENT, FG_LOAD_CLEAR);
+		fgWrite(&frameGraph, depth, shadowColor, GL_COLOR_ATTACHMENT0, FG_LOAD_CLEAR);
+		fgClearValues(&frameGraph, depth, 1.0, 0.0, 0.0, 1.0, 1.0);
+
+		int sence = fgAddPass(&frameGraph, "sence", sencePass);
+		fgRead(&frameGraph, sence, shadowDepth);
+		fgWrite(&frameGraph, sence, FG_BACKBUFFER, GL_COLOR_ATTACHMENT0, FG_LOAD_CLEAR);
+		fgWrite(&frameGraph, sence, FG_BACKBUFFER_DEPTH, GL_DEPTH_ATTACHMENT, FG_LOAD_CLEAR);
+		fgClearValues(&frameGraph, sence, 0.0, 0.0, 0.0, 1.0, 1.0);
+
+		int showDepth = fgAddPass(&frameGraph, "show depth", showDepthPass);
+		fgRead(&frameGraph, showDepth, shadowDepth);
+		fgWrite(&frameGraph, showDepth, FG_BACKBUFFER, GL_COLOR_ATTACHMENT0, FG_LOAD_KEEP);
+		fgWrite(&frameGraph, showDepth, FG_BACKBUFFER_DEPTH, GL_DEPTH_ATTACHMENT, FG_LOAD_KEEP);
+
+		bool ok = fgCompile(&frameGraph);
+		checkGlError("setupFrameGraph");
+		return ok;
+}
+
+/*
+ * GL side of a frame: takes the packet the worker built, uploads it and
+ * submits. The worker is already building the next frames meanwhile.
+ */
 void renderFrame() {
 		{
 			(void)m;
 			(void)mv;
 		}
-		
-		rotate = 170;
-		
-		//printf("rotate=%f\n", rotate);
 
 		glEnable(GL_DEPTH_TEST);
 
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear( GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT );
-
-		drawDepth();
-		checkGlError("1");
-		drawSence();
-		drawShowDepth();
-		checkGlError("2");
+		FramePacket* f = (FramePacket*)framePipelineAcquire(&framePipeline);
+		nsecs_t start = systemTime();
+#if MESHLET_CULLING
+		if(numInstances > 0) {
+			uploadInstances(f);
+		}
+#endif
+
+		fgExecute(&frameGraph, f);
+		cpuTime += systemTime() - start;
+
+		if((++frameCount % 100) == 0) {
+			double buildMs, waitMs;
+			framePipelineStats(&framePipeline, &buildMs, &waitMs);
+			printf("frame: build %.3f ms, submit %.3f ms, waited %.3f ms for the worker, "
+					"%d fbo binds %d invalidates\n",
+					buildMs, cpuTime/100/1000000.0, waitMs, frameGraph.binds, frameGraph.invalidates);
+#if MESHLET_CULLING
+			if(numInstances > 0) {
+				printf("%d knights: visible camera %d shadow %d, triangles camera %d shadow %d, "
+						"gpu depth %.3f ms sence %.3f ms\n",
+						numInstances, f->cameraBuckets.numVisible, f->shadowBuckets.numVisible, visibleCamera, visibleShadow,
+						gpuTimerAverage(&depthTimer), gpuTimerAverage(&senceTimer));
+			} else {
+				printf("triangles drawn: camera %d/%d (LOD%d) shadow %d/%d (LOD%d)\n",
+						visibleCamera, knight_numIndices/3, f->lodCamera, visibleShadow, knight_numIndices/3, f->lodShadow);
+			}
+#endif
+			cpuTime = 0;
+		}
+		framePipelineRelease(&framePipeline);
 }
 
-int main(int /*argc*/, char** /*argv*/) {
+/*
+ * usage: test-pcss [instances]
+ * With an instance count the knight is replaced by a grid of that many
+ * knights, drawn instanced in both passes, and the CPU / GPU cost per frame
+ * is printed every 100 frames.
+ */
+int main(int argc, char** argv) {
     EGLBoolean returnValue;
     EGLConfig myConfig = {0};
 
@@ -541,6 +917,10 @@ int main(int /*argc*/, char** /*argv*/) {
 
     EGLDisplay dpy;
 
+    if (argc > 1) {
+        numInstances = atoi(argv[1]);
+    }
+
     checkEglError("<init>");
     dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
     checkEglError("eglGetDisplay");
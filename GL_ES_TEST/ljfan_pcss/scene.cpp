@@ -0,0 +1,201 @@
+/*
+ * scene.cpp
+ * Instanced scene mode and GPU timing helpers.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <EGL/egl.h>
+
+#include "scene.h"
+#include "matrix.h"
+
+void setupInstanceGrid(InstanceScene* scene, int numInstances, float spacing, float angle, float yOffset,
+		const float* positions, int stride, int numVertices)
+{
+	float mn[3] = { 1e30f, 1e30f, 1e30f };
+	float mx[3] = { -1e30f, -1e30f, -1e30f };
+	for(int i=0; i<numVertices; i++) {
+		const float* p = positions + i*stride;
+		for(int k=0; k<3; k++) {
+			if(p[k] < mn[k]) mn[k] = p[k];
+			if(p[k] > mx[k]) mx[k] = p[k];
+		}
+	}
+	float r2 = 0.0f;
+	for(int k=0; k<3; k++) {
+		scene->center[k] = (mn[k] + mx[k])*0.5f;
+	}
+	for(int i=0; i<numVertices; i++) {
+		const float* p = positions + i*stride;
+		float dx = p[0] - scene->center[0];
+		float dy = p[1] - scene->center[1];
+		float dz = p[2] - scene->center[2];
+		if(dx*dx + dy*dy + dz*dz > r2) r2 = dx*dx + dy*dy + dz*dz;
+	}
+	scene->radius = sqrtf(r2);
+
+	int side = (int)ceil(sqrt((double)numInstances));
+	scene->numInstances = numInstances;
+	scene->models = (float*)malloc(sizeof(float)*16*numInstances);
+	scene->extent = side*spacing*0.5f;
+
+	float r[16];
+	rotate_matrix(angle, 0, 1, 0, r);
+	for(int i=0; i<numInstances; i++) {
+		float* m = scene->models + i*16;
+		memcpy(m, r, sizeof(r));
+		m[12] = ((i % side) + 0.5f)*spacing - scene->extent;
+		m[13] = yOffset;
+		m[14] = ((i / side) + 0.5f)*spacing - scene->extent;
+	}
+}
+
+void freeInstanceGrid(InstanceScene* scene)
+{
+	free(scene->models);
+	scene->models = NULL;
+	scene->numInstances = 0;
+}
+
+void bucketInstances(InstanceBuckets* buckets, float* outModels, const InstanceScene* scene,
+		const float* viewProj, const float* eye,
+		const MeshLod* lods, int numLods, float projScale, float maxPixelError)
+{
+	float planes[24];
+	if(viewProj) {
+		frustumPlanes(viewProj, planes);
+	}
+
+	/* Two passes: count per LOD, then scatter into contiguous ranges. */
+	unsigned char* lodOf = (unsigned char*)malloc(scene->numInstances);
+	memset(buckets, 0, sizeof(*buckets));
+	for(int i=0; i<scene->numInstances; i++) {
+		const float* m = scene->models + i*16;
+		float c[3];
+		for(int k=0; k<3; k++) {
+			c[k] = m[k]*scene->center[0] + m[4+k]*scene->center[1] + m[8+k]*scene->center[2] + m[12+k];
+		}
+
+		bool visible = true;
+		for(int p=0; viewProj && p<6 && visible; p++) {
+			const float* pl = planes + p*4;
+			if(pl[0]*c[0] + pl[1]*c[1] + pl[2]*c[2] + pl[3] < -scene->radius) {
+				visible = false;
+			}
+		}
+		if(!visible) {
+			lodOf[i] = 0xff;
+			continue;
+		}
+
+		float dx = c[0] - eye[0];
+		float dy = c[1] - eye[1];
+		float dz = c[2] - eye[2];
+		int lod = selectLod(lods, numLods, sqrtf(dx*dx + dy*dy + dz*dz), projScale, maxPixelError);
+		lodOf[i] = lod;
+		buckets->count[lod]++;
+	}
+
+	int fill[MAX_LODS];
+	for(int l=0; l<MAX_LODS; l++) {
+		buckets->first[l] = buckets->numVisible;
+		fill[l] = buckets->numVisible;
+		buckets->numVisible += buckets->count[l];
+	}
+	for(int i=0; i<scene->numInstances; i++) {
+		if(lodOf[i] != 0xff) {
+			memcpy(outModels + 16*fill[lodOf[i]]++, scene->models + i*16, sizeof(float)*16);
+		}
+	}
+	free(lodOf);
+}
+
+void bindInstanceAttribs(GLuint buffer, int firstInstance)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	for(int c=0; c<4; c++) {
+		glEnableVertexAttribArray(INSTANCE_ATTRIB + c);
+		glVertexAttribPointer(INSTANCE_ATTRIB + c, 4, GL_FLOAT, GL_FALSE, sizeof(float)*16,
+				(void*)(sizeof(float)*(16*firstInstance + 4*c)));
+		glVertexAttribDivisor(INSTANCE_ATTRIB + c, 1);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+static PFNGLGENQUERIESEXTPROC genQueries = NULL;
+static PFNGLBEGINQUERYEXTPROC beginQuery = NULL;
+static PFNGLENDQUERYEXTPROC endQuery = NULL;
+static PFNGLGETQUERYOBJECTUIVEXTPROC getQueryObjectuiv = NULL;
+static PFNGLGETQUERYOBJECTUI64VEXTPROC getQueryObjectui64v = NULL;
+
+bool gpuTimerSupported()
+{
+	static int supported = -1;
+	if(supported < 0) {
+		const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+		supported = extensions && strstr(extensions, "GL_EXT_disjoint_timer_query");
+		if(supported) {
+			genQueries = (PFNGLGENQUERIESEXTPROC)eglGetProcAddress("glGenQueriesEXT");
+			beginQuery = (PFNGLBEGINQUERYEXTPROC)eglGetProcAddress("glBeginQueryEXT");
+			endQuery = (PFNGLENDQUERYEXTPROC)eglGetProcAddress("glEndQueryEXT");
+			getQueryObjectuiv = (PFNGLGETQUERYOBJECTUIVEXTPROC)eglGetProcAddress("glGetQueryObjectuivEXT");
+			getQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VEXTPROC)eglGetProcAddress("glGetQueryObjectui64vEXT");
+			supported = genQueries && beginQuery && endQuery && getQueryObjectuiv && getQueryObjectui64v;
+		}
+	}
+	return supported;
+}
+
+void gpuTimerInit(GpuTimer* timer)
+{
+	memset(timer, 0, sizeof(*timer));
+	if(gpuTimerSupported()) {
+		genQueries(GPU_TIMER_LATENCY, timer->queries);
+	}
+}
+
+void gpuTimerBegin(GpuTimer* timer)
+{
+	if(!gpuTimerSupported()) {
+		return;
+	}
+
+	/* Collect the result of the query issued GPU_TIMER_LATENCY frames ago. */
+	GLuint query = timer->queries[timer->frame % GPU_TIMER_LATENCY];
+	if(timer->frame >= GPU_TIMER_LATENCY) {
+		GLuint available = 0;
+		GLint disjoint = 0;
+		getQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+		glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+		if(available && !disjoint) {
+			GLuint64 ns = 0;
+			getQueryObjectui64v(query, GL_QUERY_RESULT_EXT, &ns);
+			timer->totalMs += ns/1000000.0;
+			timer->samples++;
+		}
+	}
+	beginQuery(GL_TIME_ELAPSED_EXT, query);
+}
+
+void gpuTimerEnd(GpuTimer* timer)
+{
+	if(!gpuTimerSupported()) {
+		return;
+	}
+	endQuery(GL_TIME_ELAPSED_EXT);
+	timer->frame++;
+}
+
+double gpuTimerAverage(GpuTimer* timer)
+{
+	if(timer->samples == 0) {
+		return -1.0;
+	}
+	double avg = timer->totalMs/timer->samples;
+	timer->totalMs = 0.0;
+	timer->samples = 0;
+	return avg;
+}
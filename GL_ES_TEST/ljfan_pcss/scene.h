@@ -0,0 +1,76 @@
+/*
+ * scene.h
+ * Instanced scene mode and GPU timing helpers used to measure how the
+ * shadow passes scale with the number of casters.
+ */
+
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <GLES3/gl32.h>
+#include <GLES2/gl2ext.h>
+
+#include "mesh.h"
+
+/* Per-instance model matrices, fed to the shaders at locations 2..5. */
+#define INSTANCE_ATTRIB		2
+
+typedef struct {
+	int numInstances;
+	float* models;			/* 16 floats per instance, column major */
+	float center[3];		/* bounding sphere of the mesh, object space */
+	float radius;
+	float extent;			/* half size of the grid, world units */
+} InstanceScene;
+
+/* Visible instances of one pass, grouped by the LOD they are drawn with. */
+typedef struct {
+	int first[MAX_LODS];
+	int count[MAX_LODS];
+	int numVisible;
+} InstanceBuckets;
+
+/*
+ * Lays numInstances copies of a mesh out on a square grid centred on the
+ * origin, spacing world units apart, each rotated by angle degrees around
+ * Y and lifted by yOffset.
+ */
+void setupInstanceGrid(InstanceScene* scene, int numInstances, float spacing, float angle, float yOffset,
+		const float* positions, int stride, int numVertices);
+void freeInstanceGrid(InstanceScene* scene);
+
+/*
+ * Culls instances against the frustum of viewProj (NULL keeps all of them),
+ * picks a LOD for each from its distance to eye and writes the model
+ * matrices of the survivors into outModels grouped by LOD.
+ */
+void bucketInstances(InstanceBuckets* buckets, float* outModels, const InstanceScene* scene,
+		const float* viewProj, const float* eye,
+		const MeshLod* lods, int numLods, float projScale, float maxPixelError);
+
+/* Enables the mat4 attribute at INSTANCE_ATTRIB on the bound VAO, reading
+ * from buffer starting at the given instance. */
+void bindInstanceAttribs(GLuint buffer, int firstInstance);
+
+/*
+ * GL_TIME_ELAPSED_EXT queries kept in flight over a few frames so reading
+ * them back never stalls the pipeline. Without GL_EXT_disjoint_timer_query
+ * every call is a no-op and gpuTimerAverage() returns -1.
+ */
+#define GPU_TIMER_LATENCY	4
+
+typedef struct {
+	GLuint queries[GPU_TIMER_LATENCY];
+	int frame;
+	double totalMs;
+	int samples;
+} GpuTimer;
+
+bool gpuTimerSupported();
+void gpuTimerInit(GpuTimer* timer);
+void gpuTimerBegin(GpuTimer* timer);
+void gpuTimerEnd(GpuTimer* timer);
+/* Average over the samples gathered since the last call, then resets. */
+double gpuTimerAverage(GpuTimer* timer);
+
+#endif
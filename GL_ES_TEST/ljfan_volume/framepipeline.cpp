@@ -0,0 +1,117 @@
+/*
+ * framepipeline.cpp
+ * Builds frame packets on a worker thread ahead of the GL thread.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "framepipeline.h"
+
+static void* framePipelineWorker(void* data)
+{
+	FramePipeline* pipe = (FramePipeline*)data;
+	for(;;) {
+		pthread_mutex_lock(&pipe->lock);
+		while(!pipe->quit && pipe->built - pipe->consumed >= pipe->numPackets) {
+			pthread_cond_wait(&pipe->cond, &pipe->lock);
+		}
+		if(pipe->quit) {
+			pthread_mutex_unlock(&pipe->lock);
+			break;
+		}
+		int frame = pipe->built;
+		pthread_mutex_unlock(&pipe->lock);
+
+		/* The slot is owned by the worker until built is bumped. */
+		nsecs_t start = systemTime();
+		pipe->build(pipe->packets[frame % pipe->numPackets], frame);
+		nsecs_t elapsed = systemTime() - start;
+
+		pthread_mutex_lock(&pipe->lock);
+		pipe->buildTime += elapsed;
+		pipe->built++;
+		pthread_cond_broadcast(&pipe->cond);
+		pthread_mutex_unlock(&pipe->lock);
+	}
+	return NULL;
+}
+
+bool framePipelineStart(FramePipeline* pipe, void** packets, int numPackets, BuildFrameFunc build, bool threaded)
+{
+	memset(pipe, 0, sizeof(*pipe));
+	if(numPackets < 1 || numPackets > FRAME_PACKETS) {
+		return false;
+	}
+	for(int i=0; i<numPackets; i++) {
+		pipe->packets[i] = packets[i];
+	}
+	pipe->numPackets = numPackets;
+	pipe->build = build;
+	pipe->threaded = threaded;
+	pthread_mutex_init(&pipe->lock, NULL);
+	pthread_cond_init(&pipe->cond, NULL);
+
+	if(threaded && pthread_create(&pipe->thread, NULL, framePipelineWorker, pipe) != 0) {
+		printf("framePipelineStart: pthread_create failed, building on the GL thread\n");
+		pipe->threaded = false;
+	}
+	return true;
+}
+
+void framePipelineStop(FramePipeline* pipe)
+{
+	if(pipe->threaded) {
+		pthread_mutex_lock(&pipe->lock);
+		pipe->quit = true;
+		pthread_cond_broadcast(&pipe->cond);
+		pthread_mutex_unlock(&pipe->lock);
+		pthread_join(pipe->thread, NULL);
+		pipe->threaded = false;
+	}
+	pthread_cond_destroy(&pipe->cond);
+	pthread_mutex_destroy(&pipe->lock);
+}
+
+void* framePipelineAcquire(FramePipeline* pipe)
+{
+	void* packet = pipe->packets[pipe->consumed % pipe->numPackets];
+	if(!pipe->threaded) {
+		nsecs_t start = systemTime();
+		pipe->build(packet, pipe->consumed);
+		pipe->buildTime += systemTime() - start;
+		pipe->built++;
+		pipe->frames++;
+		return packet;
+	}
+
+	nsecs_t start = systemTime();
+	pthread_mutex_lock(&pipe->lock);
+	while(pipe->built == pipe->consumed) {
+		pthread_cond_wait(&pipe->cond, &pipe->lock);
+	}
+	pipe->waitTime += systemTime() - start;
+	pipe->frames++;
+	pthread_mutex_unlock(&pipe->lock);
+	return packet;
+}
+
+void framePipelineRelease(FramePipeline* pipe)
+{
+	pthread_mutex_lock(&pipe->lock);
+	pipe->consumed++;
+	pthread_cond_broadcast(&pipe->cond);
+	pthread_mutex_unlock(&pipe->lock);
+}
+
+void framePipelineStats(FramePipeline* pipe, double* buildMs, double* waitMs)
+{
+	pthread_mutex_lock(&pipe->lock);
+	int frames = pipe->frames > 0 ? pipe->frames : 1;
+	*buildMs = pipe->buildTime/frames/1000000.0;
+	*waitMs = pipe->waitTime/frames/1000000.0;
+	pipe->buildTime = 0;
+	pipe->waitTime = 0;
+	pipe->frames = 0;
+	pthread_mutex_unlock(&pipe->lock);
+}
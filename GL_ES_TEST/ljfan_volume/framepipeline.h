@@ -0,0 +1,57 @@
+/*
+ * framepipeline.h
+ * Builds frame packets on a worker thread ahead of the GL thread.
+ */
+
+#ifndef FRAMEPIPELINE_H
+#define FRAMEPIPELINE_H
+
+#include <pthread.h>
+
+#include <utils/Timers.h>
+
+/*
+ * Packets in flight. With 3 the worker can prepare frame N+1 and N+2 while
+ * the GL thread submits frame N; 2 is plain double buffering.
+ */
+#define FRAME_PACKETS		3
+
+/* Fills packet with everything the GL thread needs to submit frame. */
+typedef void (*BuildFrameFunc)(void* packet, int frame);
+
+typedef struct {
+	void* packets[FRAME_PACKETS];
+	int numPackets;
+	BuildFrameFunc build;
+	bool threaded;
+
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int built;			/* packets finished by the worker */
+	int consumed;			/* packets released by the GL thread */
+	bool quit;
+
+	/* accumulated since the last framePipelineStats() */
+	nsecs_t buildTime;		/* worker time spent in build */
+	nsecs_t waitTime;		/* GL thread time spent waiting for a packet */
+	int frames;
+} FramePipeline;
+
+/*
+ * Starts the pipeline over numPackets caller owned packets. Without threaded
+ * no worker is created and framePipelineAcquire() builds the packet in place,
+ * which gives the serial baseline to compare against.
+ */
+bool framePipelineStart(FramePipeline* pipe, void** packets, int numPackets, BuildFrameFunc build, bool threaded);
+void framePipelineStop(FramePipeline* pipe);
+
+/* GL thread: blocks until the next frame's packet is ready. */
+void* framePipelineAcquire(FramePipeline* pipe);
+/* GL thread: hands the packet back to the worker once it is submitted. */
+void framePipelineRelease(FramePipeline* pipe);
+
+/* Average build and wait time per frame in ms since the last call, then resets. */
+void framePipelineStats(FramePipeline* pipe, double* buildMs, double* waitMs);
+
+#endif
@@ -16,6 +16,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 #include <sched.h>
 #include <sys/resource.h>
@@ -41,6 +42,15 @@
 //#include "test_ori.h"
 //#include "Index_ad.h"
 #include "matrix.h"
+#include "mesh.h"
+#include "scene.h"
+#include "framepipeline.h"
+
+/* Draw the object through its LOD chain, clustered and culled on the CPU. */
+#define MESHLET_CULLING 1
+
+/* Build the next frames on a worker thread, 0 builds them inline on the GL thread. */
+#define FRAME_THREAD 1
 
 using namespace android;
 
@@ -186,6 +196,8 @@ GLuint createProgram_ori(const char* pVertexSource, const char* pFragmentSource)
 
 GLuint gProgram;
 GLuint gProgram1;
+GLuint gProgram_instanced;
+GLuint gProgram1_instanced;
 GLint gvPositionHandle;
 GLint gYuvTexSamplerHandle;
 float * data_adjacency;
@@ -503,7 +515,185 @@ static const char gFragmentShader_ori[] =
     "  gl_FragColor = color;\n"
     "}\n";
 
+/* Scene mode: one draw per LOD, the model matrix comes from the instance. */
+static const char gVertexShader_instanced[] = 
+	"#version 320 es\n"
+	"\n"
+	"layout(location = 1) in vec4 vPosition;\n"
+	"layout(location = 2) in mat4 instanceModel;\n"
+	"out vec4 PosL;\n"
+    "void main() {\n"
+    "  PosL = instanceModel*vPosition;\n"
+    "}\n";
+
+static const char gVertexShader_ori_instanced[] = 
+	"#version 320 es\n"
+	"\n"
+	"layout(location = 0) in vec4 vPosition;\n"
+	"layout(location = 2) in mat4 instanceModel;\n"
+	"uniform mat4 mvp;\n"
+    "void main() {\n"
+    "  gl_Position = mvp*instanceModel*vPosition;\n"
+    "}\n";
+
+static const char gFragmentShader_ori_instanced[] = 
+	"#version 320 es\n"
+	"\n"
+    "precision highp float;\n"
+    "uniform vec4 color;\n"
+    "out vec4 color_out;\n"
+    "void main() {\n"
+    "  color_out = color;\n"
+    "}\n";
+
+
+/*
+ * Largest projected error, in pixels, a LOD may introduce. Shadow volumes
+ * only need the silhouette, so they get a coarser level than the object.
+ */
+#define CAMERA_LOD_PIXEL_ERROR	1.0f
+#define SHADOW_LOD_PIXEL_ERROR	4.0f
+
+MeshLod objLods[MAX_LODS];
+int numObjLods = 0;
+unsigned int adjFirstIndex[MAX_LODS];
+float* objPositions = NULL;
+GLuint objVAO = 0;
+GLuint objVBO = 0;
+GLuint objIBO = 0;
+GLuint stencilVAO = 0;
+GLuint adjIBO = 0;
+GLuint indirectBuffer = 0;
+PFNGLMULTIDRAWELEMENTSINDIRECTEXTPROC multiDrawElementsIndirect = NULL;
+int frameCount = 0;
+int visibleCamera = 0;
+float projScale = 1.0f;
+float Eye_X = 0;
+float Eye_Y = 20;
+float Eye_Z = 30;
+float sceneScale = 1;
+
+void setupMeshlets(GLuint program) {
+		unsigned int* indices = NULL;
+		int numUnique = weldPositions(ori, ver_num, &objPositions, &indices);
+		nsecs_t start = systemTime();
+		numObjLods = buildLodChain(objLods, MAX_LODS, objPositions, 3, numUnique, indices, ver_num);
+		free(indices);
+		printf("object: %d unique vertices, %d LODs built in %lld ms\n",
+				numUnique, numObjLods, (long long)ns2ms(systemTime() - start));
+
+		/* All levels share one index buffer, level 0 has the most meshlets. */
+		int totalIndices = 0;
+		for(int i=0; i<numObjLods; i++) {
+			objLods[i].firstIndex = totalIndices;
+			adjFirstIndex[i] = totalIndices*2;
+			totalIndices += objLods[i].meshlets.numIndices;
+			printf("  LOD%d: %d triangles, %d meshlets, error %f\n", i,
+					objLods[i].meshlets.numIndices/3, objLods[i].meshlets.numMeshlets, objLods[i].error);
+		}
+
+		/* Indirect draws need every enabled attribute sourced from a buffer. */
+		GLint loc = glGetAttribLocation(program, "vPosition");
+		glGenVertexArrays(1, &objVAO);
+		glBindVertexArray(objVAO);
+		glGenBuffers(1, &objVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, objVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(float)*3*numUnique, objPositions, GL_STATIC_DRAW);
+		glGenBuffers(1, &objIBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, objIBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int)*totalIndices, NULL, GL_STATIC_DRAW);
+		for(int i=0; i<numObjLods; i++) {
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int)*objLods[i].firstIndex,
+					sizeof(unsigned int)*objLods[i].meshlets.numIndices, objLods[i].meshlets.indices);
+		}
+		glEnableVertexAttribArray(loc);
+		glVertexAttribPointer(loc, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+		/* The stencil pass reads the same positions through adjacency lists. */
+		glGenVertexArrays(1, &stencilVAO);
+		glBindVertexArray(stencilVAO);
+		glGenBuffers(1, &adjIBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, adjIBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int)*totalIndices*2, NULL, GL_STATIC_DRAW);
+		for(int i=0; i<numObjLods; i++) {
+			unsigned int* adjacency = (unsigned int*)malloc(sizeof(unsigned int)*objLods[i].meshlets.numIndices*2);
+			buildAdjacency(adjacency, objLods[i].meshlets.indices, objLods[i].meshlets.numIndices);
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int)*adjFirstIndex[i],
+					sizeof(unsigned int)*objLods[i].meshlets.numIndices*2, adjacency);
+			free(adjacency);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, objVBO);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		glGenBuffers(1, &indirectBuffer);
 
+		const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+		if(extensions && strstr(extensions, "GL_EXT_multi_draw_indirect")) {
+			multiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTEXTPROC)
+					eglGetProcAddress("glMultiDrawElementsIndirectEXT");
+		}
+		printf("multi draw indirect: %s\n", multiDrawElementsIndirect ? "yes" : "no");
+		checkGlError("setupMeshlets");
+}
+
+/*
+ * Culls the meshlets of one object LOD against the camera frustum and
+ * against the camera position brought into object space. The stencil pass
+ * keeps drawing the whole object: a shadow volume reaches far beyond its
+ * caster, so the caster's clusters say nothing about whether their volume
+ * is on screen.
+ */
+int cullObjectMeshlets(DrawElementsIndirectCommand* cmds, float* mvp, float* model, int lod) {
+		float planes[24];
+		float mInv[16];
+		float eye[3];
+		frustumPlanes(mvp, planes);
+		invert4(mInv, model);
+		for(int i=0; i<3; i++) {
+			eye[i] = mInv[i]*Eye_X + mInv[4+i]*Eye_Y + mInv[8+i]*Eye_Z + mInv[12+i];
+		}
+		int numCmds = cullMeshlets(&objLods[lod].meshlets, planes, eye, cmds);
+		for(int i=0; i<numCmds; i++) {
+			cmds[i].firstIndex += objLods[lod].firstIndex;
+		}
+		return numCmds;
+}
+
+/* Draws the output of cullObjectMeshlets(), returns the number of triangles. */
+int drawObjectMeshlets(const DrawElementsIndirectCommand* cmds, int numCmds) {
+		if(numCmds == 0) {
+			return 0;
+		}
+
+		glBindVertexArray(objVAO);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand)*numCmds, cmds, GL_STREAM_DRAW);
+		if(multiDrawElementsIndirect) {
+			multiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, numCmds, 0);
+		} else {
+			for(int i=0; i<numCmds; i++) {
+				glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+						(void*)(sizeof(DrawElementsIndirectCommand)*i));
+			}
+		}
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		glBindVertexArray(0);
+		checkGlError("drawObjectMeshlets");
+
+		int numTriangles = 0;
+		for(int i=0; i<numCmds; i++) {
+			numTriangles += cmds[i].count/3;
+		}
+		return numTriangles;
+}
+
+void setupScene();
+void setupFramePipeline();
+/* Number of objects in scene mode, 0 draws the single object of the demo. */
+int numInstances = 0;
 
 bool setupGraphics(int w, int h) {
     gProgram = createProgram(gVertexShader, gGeoShader, gFragmentShader);
@@ -515,6 +705,16 @@ bool setupGraphics(int w, int h) {
     if (!gProgram1) {
         return false;
     }
+
+    gProgram_instanced = createProgram(gVertexShader_instanced, gGeoShader, gFragmentShader);
+    if (!gProgram_instanced) {
+        return false;
+    }
+
+    gProgram1_instanced = createProgram_ori(gVertexShader_ori_instanced, gFragmentShader_ori_instanced);
+    if (!gProgram1_instanced) {
+        return false;
+    }
     
     glViewport(0, 0, w, h);
     checkGlError("glViewport");
@@ -608,6 +808,15 @@ bool setupGraphics(int w, int h) {
     	}
     	printf("find_num=%d\n", find_num);
     }
+
+#if MESHLET_CULLING
+    projScale = h/(2*tan(3.1415926/12));
+    setupMeshlets(gProgram1);
+    if(numInstances > 0) {
+        setupScene();
+    }
+#endif
+    setupFramePipeline();
     return true;
 }
 
@@ -637,12 +846,175 @@ float mvp[16];
 #define PI 3.1415926
 static float rotate = 100;
 
-void drawSence() {
-		glUseProgram(gProgram1);
+/* Scene mode state, only used when numInstances > 0. */
+InstanceScene scene;
+GLuint instanceBuffer = 0;
+GLuint objInstVAO = 0;
+GLuint stencilInstVAO = 0;
+GpuTimer senceTimer;
+GpuTimer stencilTimer;
+GpuTimer senceShadowTimer;
+nsecs_t cpuTime = 0;
+int visibleStencil = 0;
+
+void setupScene() {
+		setupInstanceGrid(&scene, numInstances, 3.0f, rotate, 0, ori, 3, ver_num);
+
+		/* Pull the camera back until the whole grid is in view. */
+		sceneScale = scene.extent/8.0f;
+		if(sceneScale < 1) {
+			sceneScale = 1;
+		}
+		Eye_X *= sceneScale; Eye_Y *= sceneScale; Eye_Z *= sceneScale;
+		printf("scene: %d objects, grid extent %f, scale %f\n", numInstances, scene.extent, sceneScale);
+
+		/* camera pass instances first, stencil pass instances after them */
+		glGenBuffers(1, &instanceBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(float)*16*numInstances*2, NULL, GL_STREAM_DRAW);
+
+		glGenVertexArrays(1, &objInstVAO);
+		glBindVertexArray(objInstVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, objVBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, objIBO);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+		bindInstanceAttribs(instanceBuffer, 0);
+
+		glGenVertexArrays(1, &stencilInstVAO);
+		glBindVertexArray(stencilInstVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, objVBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, adjIBO);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+		bindInstanceAttribs(instanceBuffer, 0);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		gpuTimerInit(&senceTimer);
+		gpuTimerInit(&stencilTimer);
+		gpuTimerInit(&senceShadowTimer);
+		checkGlError("setupScene");
+}
+
+/*
+ * Everything the GL thread needs to submit one frame. buildFrame() fills it
+ * on the frame pipeline's worker while the GL thread submits older frames,
+ * so nothing in here may be shared with the GL thread's own state.
+ */
+typedef struct {
+		float rotate;
+		float viewProj[16];
+		float floorMvp[16];
+		float objectMvp[16];
+		int lodCamera;
+		int lodShadow;
+		DrawElementsIndirectCommand* cameraCmds;
+		int numCameraCmds;
+		InstanceBuckets cameraBuckets;
+		InstanceBuckets shadowBuckets;
+		float* models;		/* camera pass instances, then stencil pass instances */
+} FramePacket;
+
+FramePacket framePackets[FRAME_PACKETS];
+FramePipeline framePipeline;
+
+/*
+ * Worker side of a frame: simulation, matrices, LOD selection, per-meshlet
+ * culling and per-instance culling / LOD bucketing. Shadow volumes are not
+ * frustum culled, a volume can cross the view with its caster outside, so
+ * the stencil pass only gets the coarser LOD policy. Only reads state that
+ * is fixed once setupGraphics() returns.
+ */
+void buildFrame(void* packet, int /*frame*/) {
+		FramePacket* f = (FramePacket*)packet;
+		float v[16], p[16], r[16], s[16], t[16], m[16];
 
+		//rotate +=0.1;
+		f->rotate = rotate;
+
+		setLookAt(v, Eye_X, Eye_Y, Eye_Z, 0, 0, 0, 0, 1, 0);
+		perspective_matrix(PI/6, 1, 0.9, 100000.0, p);
+		multiply_matrix(p, v, f->viewProj);
+
+		setTranslate(t, 0, -3, 0);
+		setScaling(s, 20.0*sceneScale, 20.0*sceneScale, 20.0*sceneScale);
 		multiply_matrix(t, s, m);
-		multiply_matrix(v, m, mv);
-		multiply_matrix(p, mv, mvp);
+		multiply_matrix(f->viewProj, m, f->floorMvp);
+
+		rotate_matrix(f->rotate, 0, 1, 0, r);
+		multiply_matrix(f->viewProj, r, f->objectMvp);
+
+#if MESHLET_CULLING
+		float eye[3] = { Eye_X, Eye_Y, Eye_Z };
+		if(numInstances > 0) {
+			bucketInstances(&f->cameraBuckets, f->models, &scene, f->viewProj, eye,
+					objLods, numObjLods, projScale, CAMERA_LOD_PIXEL_ERROR);
+			bucketInstances(&f->shadowBuckets, f->models + 16*numInstances, &scene, NULL, eye,
+					objLods, numObjLods, projScale, SHADOW_LOD_PIXEL_ERROR);
+		} else {
+			/* the object sits at the origin */
+			float eyeDistance = sqrtf(Eye_X*Eye_X + Eye_Y*Eye_Y + Eye_Z*Eye_Z);
+			f->lodCamera = selectLod(objLods, numObjLods, eyeDistance, projScale, CAMERA_LOD_PIXEL_ERROR);
+			f->lodShadow = selectLod(objLods, numObjLods, eyeDistance, projScale, SHADOW_LOD_PIXEL_ERROR);
+			f->numCameraCmds = cullObjectMeshlets(f->cameraCmds, f->objectMvp, r, f->lodCamera);
+		}
+#endif
+}
+
+void setupFramePipeline() {
+		void* packets[FRAME_PACKETS];
+		for(int i=0; i<FRAME_PACKETS; i++) {
+			FramePacket* f = &framePackets[i];
+			memset(f, 0, sizeof(*f));
+#if MESHLET_CULLING
+			f->cameraCmds = (DrawElementsIndirectCommand*)malloc(sizeof(DrawElementsIndirectCommand)*objLods[0].meshlets.numMeshlets);
+			if(numInstances > 0) {
+				f->models = (float*)malloc(sizeof(float)*16*numInstances*2);
+			}
+#endif
+			packets[i] = f;
+		}
+		framePipelineStart(&framePipeline, packets, FRAME_PACKETS, buildFrame, FRAME_THREAD);
+		printf("frame pipeline: %d packets, built %s\n", FRAME_PACKETS,
+				framePipeline.threaded ? "on a worker thread" : "on the GL thread");
+}
+
+/* Uploads the packet's visible instances, camera pass first and stencil pass after them. */
+void uploadInstances(const FramePacket* f) {
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(float)*16*numInstances*2, NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float)*16*f->cameraBuckets.numVisible, f->models);
+		glBufferSubData(GL_ARRAY_BUFFER, sizeof(float)*16*numInstances, sizeof(float)*16*f->shadowBuckets.numVisible,
+				f->models + 16*numInstances);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/* One instanced draw per LOD; base is the buckets' first instance in instanceBuffer. */
+int drawObjectInstances(const InstanceBuckets* buckets, int base, bool adjacency) {
+		int numTriangles = 0;
+		glBindVertexArray(adjacency ? stencilInstVAO : objInstVAO);
+		for(int lod=0; lod<numObjLods; lod++) {
+			if(buckets->count[lod] == 0) {
+				continue;
+			}
+			bindInstanceAttribs(instanceBuffer, base + buckets->first[lod]);
+			if(adjacency) {
+				glDrawElementsInstanced(GL_TRIANGLES_ADJACENCY, objLods[lod].meshlets.numIndices*2, GL_UNSIGNED_INT,
+						(void*)(sizeof(unsigned int)*adjFirstIndex[lod]), buckets->count[lod]);
+			} else {
+				glDrawElementsInstanced(GL_TRIANGLES, objLods[lod].meshlets.numIndices, GL_UNSIGNED_INT,
+						(void*)(sizeof(unsigned int)*objLods[lod].firstIndex), buckets->count[lod]);
+			}
+			numTriangles += objLods[lod].meshlets.numIndices/3*buckets->count[lod];
+		}
+		glBindVertexArray(0);
+		checkGlError("drawObjectInstances");
+		return numTriangles;
+}
+
+void drawSence(const FramePacket* f) {
+		glUseProgram(gProgram1);
 
 		checkGlError("glUseProgram");
 
@@ -652,38 +1024,46 @@ void drawSence() {
 		checkGlError("glEnableVertexAttribArray");
 
 		glUniform4f( glGetUniformLocation (gProgram1, "color"), 0.5, 0.5, 0.5, 1.0);
-		glUniformMatrix4fv( glGetUniformLocation (gProgram1, "mvp"), 1, GL_FALSE, mvp);
+		glUniformMatrix4fv( glGetUniformLocation (gProgram1, "mvp"), 1, GL_FALSE, f->floorMvp);
 
 		//Draw the floor
 		glDrawArrays(GL_TRIANGLES, 0, 6);
 		checkGlError("glDrawArrays1");		
 
 
-		rotate_matrix(rotate, 0, 1, 0, m);
-		multiply_matrix(v, m, mv);
-		multiply_matrix(p, mv, mvp);
+#if MESHLET_CULLING
+		if(numInstances > 0) {
+			glUseProgram(gProgram1_instanced);
+			glUniform4f( glGetUniformLocation (gProgram1_instanced, "color"), 1.0, 0.5, 0.5, 1.0);
+			glUniformMatrix4fv( glGetUniformLocation (gProgram1_instanced, "mvp"), 1, GL_FALSE, f->viewProj);
+			visibleCamera = drawObjectInstances(&f->cameraBuckets, 0, false);
+		} else {
+			glUniform4f( glGetUniformLocation (gProgram1, "color"), 1.0, 0.5, 0.5, 1.0);
+			glUniformMatrix4fv( glGetUniformLocation (gProgram1, "mvp"), 1, GL_FALSE, f->objectMvp);
+
+			//Draw the object
+			visibleCamera = drawObjectMeshlets(f->cameraCmds, f->numCameraCmds);
+		}
+#else
 		glVertexAttribPointer(glGetAttribLocation (gProgram1, "vPosition"), 3, GL_FLOAT, GL_FALSE, 0, ori);
 		glEnableVertexAttribArray(glGetAttribLocation (gProgram1, "vPosition"));
 		checkGlError("glEnableVertexAttribArray");
 		
 		glUniform4f( glGetUniformLocation (gProgram1, "color"), 1.0, 0.5, 0.5, 1.0);
 				
-		glUniformMatrix4fv( glGetUniformLocation (gProgram1, "mvp"), 1, GL_FALSE, mvp);
+		glUniformMatrix4fv( glGetUniformLocation (gProgram1, "mvp"), 1, GL_FALSE, f->objectMvp);
 
 		//Draw the object
 		glDrawArrays(GL_TRIANGLES, 0, ver_num);
+#endif
 		checkGlError("glDrawArrays0");
 }
 
 
-void drawSenceShadow() {
+void drawSenceShadow(const FramePacket* f) {
 		glUseProgram(gProgram1);
 
 #if 1
-		multiply_matrix(t, s, m);
-		multiply_matrix(v, m, mv);
-		multiply_matrix(p, mv, mvp);
-
 		checkGlError("glUseProgram");
 
 		glVertexAttribPointer(glGetAttribLocation (gProgram1, "vPosition"), 3, GL_FLOAT, GL_FALSE, 0, gTriangleVertices);
@@ -692,7 +1072,7 @@ void drawSenceShadow() {
 		checkGlError("glEnableVertexAttribArray");
 
 		glUniform4f( glGetUniformLocation (gProgram1, "color"), 0.25, 0.25, 0.25, 1.0);
-		glUniformMatrix4fv( glGetUniformLocation (gProgram1, "mvp"), 1, GL_FALSE, mvp);
+		glUniformMatrix4fv( glGetUniformLocation (gProgram1, "mvp"), 1, GL_FALSE, f->floorMvp);
 
 		//Draw the floor
 
@@ -700,9 +1080,20 @@ void drawSenceShadow() {
 		checkGlError("glDrawArrays1");		
 
 
-		rotate_matrix(rotate, 0, 1, 0, m);
-		multiply_matrix(v, m, mv);
-		multiply_matrix(p, mv, mvp);
+#if MESHLET_CULLING
+		if(numInstances > 0) {
+			glUseProgram(gProgram1_instanced);
+			glUniform4f( glGetUniformLocation (gProgram1_instanced, "color"), 0.5, 0.25, 0.25, 1.0);
+			glUniformMatrix4fv( glGetUniformLocation (gProgram1_instanced, "mvp"), 1, GL_FALSE, f->viewProj);
+			visibleCamera = drawObjectInstances(&f->cameraBuckets, 0, false);
+		} else {
+			glUniform4f( glGetUniformLocation (gProgram1, "color"), 0.5, 0.25, 0.25, 1.0);
+			glUniformMatrix4fv( glGetUniformLocation (gProgram1, "mvp"), 1, GL_FALSE, f->objectMvp);
+
+			//Draw the object
+			visibleCamera = drawObjectMeshlets(f->cameraCmds, f->numCameraCmds);
+		}
+#else
 		glVertexAttribPointer(glGetAttribLocation (gProgram1, "vPosition"), 3, GL_FLOAT, GL_FALSE, 0, ori);
 		glEnableVertexAttribArray(glGetAttribLocation (gProgram1, "vPosition"));
 		checkGlError("glEnableVertexAttribArray");
@@ -710,10 +1101,11 @@ void drawSenceShadow() {
 		glUniform4f( glGetUniformLocation (gProgram1, "color"), 0.5, 0.25, 0.25, 1.0);
 
 				
-		glUniformMatrix4fv( glGetUniformLocation (gProgram1, "mvp"), 1, GL_FALSE, mvp);
+		glUniformMatrix4fv( glGetUniformLocation (gProgram1, "mvp"), 1, GL_FALSE, f->objectMvp);
 
 		//Draw the object
 		glDrawArrays(GL_TRIANGLES, 0, ver_num);
+#endif
 		checkGlError("glDrawArrays0");
 #else
 		{
@@ -758,17 +1150,15 @@ void drawStencil() {
     glDrawElements(GL_TRIANGLES_ADJACENCY, index_num, GL_UNSIGNED_INT, index_data);
     checkGlError("glDrawArrays2");  	
 }*/
-void drawStencil() {
+void drawStencil(const FramePacket* f) {
 		//Update the stencil buffer
-		rotate_matrix(rotate, 0, 1, 0, m);
-		multiply_matrix(v, m, mv);
-		multiply_matrix(p, mv, mvp);
-
 		glUseProgram(gProgram);
-		glUniformMatrix4fv( glGetUniformLocation (gProgram, "mvp"), 1, GL_FALSE, mvp);
+		glUniformMatrix4fv( glGetUniformLocation (gProgram, "mvp"), 1, GL_FALSE, f->objectMvp);
 		glUniform3f( glGetUniformLocation (gProgram, "light"), 0.0, -1.0, 0.0);
+#if !MESHLET_CULLING
 		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, data_adjacency);
 		glEnableVertexAttribArray(1);
+#endif
 
 		glDepthMask(GL_FALSE);
 		glEnable(GL_STENCIL_TEST);
@@ -785,20 +1175,31 @@ void drawStencil() {
 		glEnable(GL_POLYGON_OFFSET_FILL);
 		glPolygonOffset(0.0f, -1.0f);
 
+#if MESHLET_CULLING
+		if(numInstances > 0) {
+			glUseProgram(gProgram_instanced);
+			glUniformMatrix4fv( glGetUniformLocation (gProgram_instanced, "mvp"), 1, GL_FALSE, f->viewProj);
+			glUniform3f( glGetUniformLocation (gProgram_instanced, "light"), 0.0, -1.0, 0.0);
+			visibleStencil = drawObjectInstances(&f->shadowBuckets, numInstances, true);
+		} else {
+			glBindVertexArray(stencilVAO);
+			glDrawElements(GL_TRIANGLES_ADJACENCY, objLods[f->lodShadow].meshlets.numIndices*2, GL_UNSIGNED_INT,
+					(void*)(sizeof(unsigned int)*adjFirstIndex[f->lodShadow]));
+			glBindVertexArray(0);
+		}
+#else
 		glDrawArrays(GL_TRIANGLES_ADJACENCY, 0, ver_num*2);
+#endif
 		glDisable(GL_POLYGON_OFFSET_FILL);
 		checkGlError("glDrawArrays2");  	
 }
 
 
+/*
+ * GL side of a frame: takes the packet the worker built, uploads it and
+ * submits. The worker is already building the next frames meanwhile.
+ */
 void renderFrame() {
-		//rotate +=0.1;
-		rotate_matrix(rotate, 0, 1, 0, r);
-		setTranslate(t, 0, -3, 0);
-		setScaling(s, 20.0, 20.0, 20.0);
-		setLookAt(v, 0, 20, 30, 0, 0, 0, 0, 1, 0);
-		perspective_matrix(PI/6, 1, 0.9, 100000.0, p);
-
 		{
 			(void)gTriangleVertices;
 			(void)m;
@@ -811,6 +1212,14 @@ void renderFrame() {
 		glDisable(GL_STENCIL_TEST);
 		glDepthMask(GL_TRUE);
 
+		FramePacket* f = (FramePacket*)framePipelineAcquire(&framePipeline);
+		nsecs_t start = systemTime();
+#if MESHLET_CULLING
+		if(numInstances > 0) {
+			uploadInstances(f);
+		}
+#endif
+
 		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 		glClearStencil(0);
 		glClearDepthf(1.0);
@@ -818,12 +1227,16 @@ void renderFrame() {
 
 		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 		//glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);//FAKE
-		drawSence();
+		gpuTimerBegin(&senceTimer);
+		drawSence(f);
+		gpuTimerEnd(&senceTimer);
 
 		
 		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
 		//glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);//FAKE
-		drawStencil();
+		gpuTimerBegin(&stencilTimer);
+		drawStencil(f);
+		gpuTimerEnd(&stencilTimer);
 
 		//Draw the shadow
 		glDepthMask(GL_FALSE);
@@ -837,10 +1250,40 @@ void renderFrame() {
 
 		glEnable(GL_STENCIL_TEST);
 		glStencilFunc(GL_NOTEQUAL, 0x0, 0xFF);
-		drawSenceShadow();
+		gpuTimerBegin(&senceShadowTimer);
+		drawSenceShadow(f);
+		gpuTimerEnd(&senceShadowTimer);
+		cpuTime += systemTime() - start;
+
+		if((++frameCount % 100) == 0) {
+			double buildMs, waitMs;
+			framePipelineStats(&framePipeline, &buildMs, &waitMs);
+			printf("frame: build %.3f ms, submit %.3f ms, waited %.3f ms for the worker\n",
+					buildMs, cpuTime/100/1000000.0, waitMs);
+#if MESHLET_CULLING
+			if(numInstances > 0) {
+				printf("%d objects: visible %d, triangles camera %d stencil %d, "
+						"gpu sence %.3f ms stencil %.3f ms sence shadow %.3f ms\n",
+						numInstances, f->cameraBuckets.numVisible, visibleCamera, visibleStencil,
+						gpuTimerAverage(&senceTimer), gpuTimerAverage(&stencilTimer),
+						gpuTimerAverage(&senceShadowTimer));
+			} else {
+				printf("triangles drawn: camera %d/%d (LOD%d) shadow volume %d (LOD%d)\n",
+						visibleCamera, ver_num/3, f->lodCamera, objLods[f->lodShadow].meshlets.numIndices/3, f->lodShadow);
+			}
+#endif
+			cpuTime = 0;
+		}
+		framePipelineRelease(&framePipeline);
 }
 
-int main(int /*argc*/, char** /*argv*/) {
+/*
+ * usage: test-volume [instances]
+ * With an instance count the object is replaced by a grid of that many
+ * copies, drawn instanced in the camera and stencil volume passes, and the
+ * CPU / GPU cost per frame is printed every 100 frames.
+ */
+int main(int argc, char** argv) {
     EGLBoolean returnValue;
     EGLConfig myConfig = {0};
 
@@ -859,6 +1302,10 @@ int main(int /*argc*/, char** /*argv*/) {
 
     EGLDisplay dpy;
 
+    if (argc > 1) {
+        numInstances = atoi(argv[1]);
+    }
+
     checkEglError("<init>");
     dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
     checkEglError("eglGetDisplay");
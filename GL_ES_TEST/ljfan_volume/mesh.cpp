@@ -0,0 +1,367 @@
+/*
+ * mesh.cpp
+ * Mesh preprocessing and CPU-side culling helpers.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <map>
+
+#include "mesh.h"
+
+struct PositionKey {
+	float p[3];
+	bool operator<(const PositionKey& o) const {
+		return memcmp(p, o.p, sizeof(p)) < 0;
+	}
+};
+
+int weldPositions(const float* positions, int numVertices, float** outPositions, unsigned int** outIndices)
+{
+	std::map<PositionKey, unsigned int> unique;
+	float* welded = (float*)malloc(sizeof(float)*3*numVertices);
+	unsigned int* indices = (unsigned int*)malloc(sizeof(unsigned int)*numVertices);
+	int numUnique = 0;
+
+	for(int i=0; i<numVertices; i++) {
+		PositionKey key;
+		memcpy(key.p, positions+i*3, sizeof(key.p));
+		std::map<PositionKey, unsigned int>::iterator it = unique.find(key);
+		if(it == unique.end()) {
+			memcpy(welded+numUnique*3, key.p, sizeof(key.p));
+			unique[key] = numUnique;
+			indices[i] = numUnique++;
+		} else {
+			indices[i] = it->second;
+		}
+	}
+
+	*outPositions = welded;
+	*outIndices = indices;
+	return numUnique;
+}
+
+static void faceNormal(const float* positions, int stride, const unsigned int* tri, float* n)
+{
+	const float* a = positions + tri[0]*stride;
+	const float* b = positions + tri[1]*stride;
+	const float* c = positions + tri[2]*stride;
+	float e1[3] = { b[0]-a[0], b[1]-a[1], b[2]-a[2] };
+	float e2[3] = { c[0]-a[0], c[1]-a[1], c[2]-a[2] };
+	n[0] = e1[1]*e2[2] - e1[2]*e2[1];
+	n[1] = e1[2]*e2[0] - e1[0]*e2[2];
+	n[2] = e1[0]*e2[1] - e1[1]*e2[0];
+	float len = sqrtf(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+	if(len > 0.0f) {
+		n[0] /= len; n[1] /= len; n[2] /= len;
+	}
+}
+
+static void computeBounds(Meshlet* ml, const float* positions, int stride, const unsigned int* indices)
+{
+	float mn[3] = { 1e30f, 1e30f, 1e30f };
+	float mx[3] = { -1e30f, -1e30f, -1e30f };
+	float axis[3] = { 0.0f, 0.0f, 0.0f };
+	int numTriangles = ml->indexCount/3;
+	float* normals = (float*)malloc(sizeof(float)*3*numTriangles);
+	float* centroids = (float*)malloc(sizeof(float)*3*numTriangles);
+
+	for(unsigned int i=0; i<ml->indexCount; i++) {
+		const float* p = positions + indices[i]*stride;
+		for(int k=0; k<3; k++) {
+			if(p[k] < mn[k]) mn[k] = p[k];
+			if(p[k] > mx[k]) mx[k] = p[k];
+		}
+	}
+
+	float r2 = 0.0f;
+	for(int k=0; k<3; k++) {
+		ml->center[k] = (mn[k] + mx[k])*0.5f;
+	}
+	for(unsigned int i=0; i<ml->indexCount; i++) {
+		const float* p = positions + indices[i]*stride;
+		float dx = p[0] - ml->center[0];
+		float dy = p[1] - ml->center[1];
+		float dz = p[2] - ml->center[2];
+		float d2 = dx*dx + dy*dy + dz*dz;
+		if(d2 > r2) r2 = d2;
+	}
+	ml->radius = sqrtf(r2);
+
+	/* Face normals; degenerate triangles do not contribute to the cone. */
+	for(int t=0; t<numTriangles; t++) {
+		const float* a = positions + indices[t*3+0]*stride;
+		const float* b = positions + indices[t*3+1]*stride;
+		const float* c = positions + indices[t*3+2]*stride;
+		float* n = normals + t*3;
+		faceNormal(positions, stride, indices + t*3, n);
+		for(int k=0; k<3; k++) {
+			centroids[t*3+k] = (a[k] + b[k] + c[k])/3.0f;
+			axis[k] += n[k];
+		}
+	}
+
+	float axisLen = sqrtf(axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2]);
+	ml->coneCutoff = 2.0f;
+	memcpy(ml->coneApex, ml->center, sizeof(ml->coneApex));
+	ml->coneAxis[0] = 0.0f; ml->coneAxis[1] = 0.0f; ml->coneAxis[2] = 1.0f;
+
+	if(axisLen > 0.0f) {
+		for(int k=0; k<3; k++) {
+			axis[k] /= axisLen;
+		}
+
+		float minDot = 1.0f;
+		for(int t=0; t<numTriangles; t++) {
+			const float* n = normals + t*3;
+			if(n[0] == 0.0f && n[1] == 0.0f && n[2] == 0.0f) {
+				continue;
+			}
+			float d = n[0]*axis[0] + n[1]*axis[1] + n[2]*axis[2];
+			if(d < minDot) minDot = d;
+		}
+
+		/* Cones wider than ~84 degrees are not worth testing. */
+		if(minDot > 0.1f) {
+			float maxT = 0.0f;
+			for(int t=0; t<numTriangles; t++) {
+				const float* n = normals + t*3;
+				const float* c = centroids + t*3;
+				float dn = n[0]*axis[0] + n[1]*axis[1] + n[2]*axis[2];
+				if(dn <= 0.0f) {
+					continue;
+				}
+				float dc = (ml->center[0]-c[0])*n[0] + (ml->center[1]-c[1])*n[1] + (ml->center[2]-c[2])*n[2];
+				float d = dc/dn;
+				if(d > maxT) maxT = d;
+			}
+			for(int k=0; k<3; k++) {
+				ml->coneAxis[k] = axis[k];
+				ml->coneApex[k] = ml->center[k] - axis[k]*maxT;
+			}
+			ml->coneCutoff = sqrtf(1.0f - minDot*minDot);
+		}
+	}
+
+	free(normals);
+	free(centroids);
+}
+
+/*
+ * Greedy clustering: a meshlet grows through triangles that share vertices
+ * with it, preferring the candidate that adds the fewest new vertices and
+ * then the one closest to the meshlet's average normal, so the clusters
+ * stay compact and their normal cones narrow enough to be useful.
+ */
+int buildMeshlets(MeshletMesh* mesh, const float* positions, int stride,
+		const unsigned int* indices, int numIndices)
+{
+	int numTriangles = numIndices/3;
+	unsigned int numVertices = 0;
+	for(int i=0; i<numTriangles*3; i++) {
+		if(indices[i] + 1 > numVertices) numVertices = indices[i] + 1;
+	}
+
+	/* vertex -> triangle adjacency in CSR form */
+	int* adjOffset = (int*)calloc(numVertices+1, sizeof(int));
+	int* adjTris = (int*)malloc(sizeof(int)*numTriangles*3);
+	for(int i=0; i<numTriangles*3; i++) {
+		adjOffset[indices[i]+1]++;
+	}
+	for(unsigned int v=0; v<numVertices; v++) {
+		adjOffset[v+1] += adjOffset[v];
+	}
+	int* fill = (int*)malloc(sizeof(int)*numVertices);
+	memcpy(fill, adjOffset, sizeof(int)*numVertices);
+	for(int i=0; i<numTriangles*3; i++) {
+		adjTris[fill[indices[i]]++] = i/3;
+	}
+	free(fill);
+
+	float* normals = (float*)malloc(sizeof(float)*3*numTriangles);
+	for(int t=0; t<numTriangles; t++) {
+		faceNormal(positions, stride, indices + t*3, normals + t*3);
+	}
+
+	/* Per-vertex slot in the meshlet being filled, -1 when not yet used. */
+	int* slot = (int*)malloc(sizeof(int)*numVertices);
+	memset(slot, 0xff, sizeof(int)*numVertices);
+	bool* emitted = (bool*)calloc(numTriangles, sizeof(bool));
+	unsigned int used[MESHLET_MAX_VERTICES];
+	int numUsed = 0;
+
+	mesh->meshlets = (Meshlet*)malloc(sizeof(Meshlet)*(numTriangles > 0 ? numTriangles : 1));
+	mesh->indices = (unsigned int*)malloc(sizeof(unsigned int)*(numTriangles > 0 ? numTriangles*3 : 1));
+	mesh->numIndices = 0;
+	mesh->numMeshlets = 0;
+
+	Meshlet* cur = NULL;
+	float axis[3] = { 0.0f, 0.0f, 0.0f };
+	int seed = 0;
+	for(int emittedCount = 0; emittedCount < numTriangles; emittedCount++) {
+		int best = -1;
+		int bestExtra = 4;
+		float bestDot = -2.0f;
+
+		if(cur) {
+			for(int u=0; u<numUsed; u++) {
+				unsigned int v = used[u];
+				for(int a=adjOffset[v]; a<adjOffset[v+1]; a++) {
+					int t = adjTris[a];
+					if(emitted[t]) {
+						continue;
+					}
+					const unsigned int* tri = indices + t*3;
+					int extra = (slot[tri[0]] < 0) + (slot[tri[1]] < 0 && tri[1] != tri[0]) +
+							(slot[tri[2]] < 0 && tri[2] != tri[0] && tri[2] != tri[1]);
+					float d = normals[t*3]*axis[0] + normals[t*3+1]*axis[1] + normals[t*3+2]*axis[2];
+					if(extra < bestExtra || (extra == bestExtra && d > bestDot)) {
+						best = t;
+						bestExtra = extra;
+						bestDot = d;
+					}
+				}
+			}
+			if(best >= 0 && (numUsed + bestExtra > MESHLET_MAX_VERTICES ||
+					cur->indexCount/3 + 1 > MESHLET_MAX_TRIANGLES)) {
+				best = -1;
+			}
+		}
+
+		if(best < 0) {
+			/* Start a new meshlet from the next triangle not yet emitted. */
+			while(emitted[seed]) {
+				seed++;
+			}
+			best = seed;
+			for(int i=0; i<numUsed; i++) {
+				slot[used[i]] = -1;
+			}
+			numUsed = 0;
+			axis[0] = axis[1] = axis[2] = 0.0f;
+			cur = &mesh->meshlets[mesh->numMeshlets++];
+			cur->firstIndex = mesh->numIndices;
+			cur->indexCount = 0;
+		}
+
+		const unsigned int* tri = indices + best*3;
+		for(int k=0; k<3; k++) {
+			if(slot[tri[k]] < 0) {
+				slot[tri[k]] = numUsed;
+				used[numUsed++] = tri[k];
+			}
+			mesh->indices[mesh->numIndices++] = tri[k];
+			axis[k] += normals[best*3+k];
+		}
+		cur->indexCount += 3;
+		emitted[best] = true;
+	}
+
+	for(int i=0; i<mesh->numMeshlets; i++) {
+		Meshlet* ml = &mesh->meshlets[i];
+		computeBounds(ml, positions, stride, mesh->indices + ml->firstIndex);
+	}
+
+	free(adjOffset);
+	free(adjTris);
+	free(normals);
+	free(slot);
+	free(emitted);
+	return mesh->numMeshlets;
+}
+
+void freeMeshlets(MeshletMesh* mesh)
+{
+	free(mesh->meshlets);
+	free(mesh->indices);
+	mesh->meshlets = NULL;
+	mesh->indices = NULL;
+	mesh->numMeshlets = 0;
+	mesh->numIndices = 0;
+}
+
+void buildAdjacency(unsigned int* outIndices, const unsigned int* indices, int numIndices)
+{
+	/* directed edge (a, b) -> vertex opposite to it */
+	std::map<std::pair<unsigned int, unsigned int>, unsigned int> opposite;
+	for(int i=0; i+2<numIndices; i+=3) {
+		for(int k=0; k<3; k++) {
+			opposite[std::make_pair(indices[i+k], indices[i+(k+1)%3])] = indices[i+(k+2)%3];
+		}
+	}
+
+	for(int i=0; i+2<numIndices; i+=3) {
+		for(int k=0; k<3; k++) {
+			unsigned int a = indices[i+k];
+			unsigned int b = indices[i+(k+1)%3];
+			std::map<std::pair<unsigned int, unsigned int>, unsigned int>::iterator it =
+					opposite.find(std::make_pair(b, a));
+			outIndices[i*2+k*2+0] = a;
+			outIndices[i*2+k*2+1] = it != opposite.end() ? it->second : indices[i+(k+2)%3];
+		}
+	}
+}
+
+void frustumPlanes(const float* mvp, float* planes)
+{
+	for(int i=0; i<3; i++) {
+		for(int k=0; k<4; k++) {
+			planes[(i*2+0)*4+k] = mvp[k*4+3] + mvp[k*4+i];
+			planes[(i*2+1)*4+k] = mvp[k*4+3] - mvp[k*4+i];
+		}
+	}
+	for(int i=0; i<6; i++) {
+		float* pl = planes + i*4;
+		float len = sqrtf(pl[0]*pl[0] + pl[1]*pl[1] + pl[2]*pl[2]);
+		if(len > 0.0f) {
+			pl[0] /= len; pl[1] /= len; pl[2] /= len; pl[3] /= len;
+		}
+	}
+}
+
+int cullMeshlets(const MeshletMesh* mesh, const float* planes, const float* eye,
+		DrawElementsIndirectCommand* cmds)
+{
+	int numVisible = 0;
+	for(int i=0; i<mesh->numMeshlets; i++) {
+		const Meshlet* ml = &mesh->meshlets[i];
+		bool visible = true;
+
+		for(int p=0; p<6 && visible; p++) {
+			const float* pl = planes + p*4;
+			float d = pl[0]*ml->center[0] + pl[1]*ml->center[1] + pl[2]*ml->center[2] + pl[3];
+			if(d < -ml->radius) {
+				visible = false;
+			}
+		}
+
+		if(visible && eye && ml->coneCutoff <= 1.0f) {
+			float dir[3] = { ml->coneApex[0]-eye[0], ml->coneApex[1]-eye[1], ml->coneApex[2]-eye[2] };
+			float len = sqrtf(dir[0]*dir[0] + dir[1]*dir[1] + dir[2]*dir[2]);
+			if(len > 0.0f &&
+					dir[0]*ml->coneAxis[0] + dir[1]*ml->coneAxis[1] + dir[2]*ml->coneAxis[2] >= ml->coneCutoff*len) {
+				visible = false;
+			}
+		}
+
+		if(!visible) {
+			continue;
+		}
+
+		/* Merge with the previous command when the index ranges touch. */
+		if(numVisible > 0 &&
+				cmds[numVisible-1].firstIndex + cmds[numVisible-1].count == ml->firstIndex) {
+			cmds[numVisible-1].count += ml->indexCount;
+			continue;
+		}
+
+		DrawElementsIndirectCommand* cmd = &cmds[numVisible++];
+		cmd->count = ml->indexCount;
+		cmd->instanceCount = 1;
+		cmd->firstIndex = ml->firstIndex;
+		cmd->baseVertex = 0;
+		cmd->reservedMustBeZero = 0;
+	}
+	return numVisible;
+}
@@ -0,0 +1,106 @@
+/*
+ * mesh.h
+ * Mesh preprocessing and CPU-side culling helpers.
+ */
+
+#ifndef MESH_H
+#define MESH_H
+
+/* Cluster limits, sized so that a meshlet fits a 64-wide GPU wave. */
+#define MESHLET_MAX_VERTICES	64
+#define MESHLET_MAX_TRIANGLES	124
+
+/* Layout mandated by glDrawElementsIndirect / glMultiDrawElementsIndirectEXT. */
+typedef struct {
+	unsigned int count;
+	unsigned int instanceCount;
+	unsigned int firstIndex;
+	int baseVertex;
+	unsigned int reservedMustBeZero;
+} DrawElementsIndirectCommand;
+
+typedef struct {
+	unsigned int firstIndex;	/* offset into MeshletMesh::indices */
+	unsigned int indexCount;
+	float center[3];		/* bounding sphere, object space */
+	float radius;
+	float coneApex[3];		/* normal cone, object space */
+	float coneAxis[3];
+	float coneCutoff;		/* > 1.0 when the cone can never be back-facing */
+} Meshlet;
+
+typedef struct {
+	Meshlet* meshlets;
+	int numMeshlets;
+	unsigned int* indices;		/* triangles reordered so every meshlet is contiguous */
+	int numIndices;
+} MeshletMesh;
+
+/*
+ * Merges vertices with bit-identical positions of a flat triangle list
+ * (3 floats per vertex). Returns the number of unique vertices; the caller
+ * frees *outPositions and *outIndices.
+ */
+int weldPositions(const float* positions, int numVertices, float** outPositions, unsigned int** outIndices);
+
+/*
+ * Splits an indexed triangle list into clusters of at most
+ * MESHLET_MAX_VERTICES vertices / MESHLET_MAX_TRIANGLES triangles.
+ * stride is the distance between two positions in floats.
+ */
+int buildMeshlets(MeshletMesh* mesh, const float* positions, int stride,
+		const unsigned int* indices, int numIndices);
+void freeMeshlets(MeshletMesh* mesh);
+
+/*
+ * Expands a triangle list into GL_TRIANGLES_ADJACENCY order (6 indices per
+ * triangle). An edge without a neighbour gets the triangle's own third
+ * vertex, so the silhouette test sees it as a crease.
+ */
+void buildAdjacency(unsigned int* outIndices, const unsigned int* indices, int numIndices);
+
+/* LOD chain limits. */
+#define MAX_LODS		6
+#define LOD_MIN_TRIANGLES	64
+
+typedef struct {
+	MeshletMesh meshlets;		/* the level's triangles, clustered */
+	unsigned int firstIndex;	/* where the level starts in the shared index buffer */
+	float error;			/* object space deviation from level 0 */
+} MeshLod;
+
+/*
+ * Simplifies an indexed triangle list down to about targetIndices indices.
+ * outIndices must hold numIndices entries and keeps indexing positions.
+ * Vertices are told apart by all stride floats, so hard edges and uv
+ * seams stay where they are.
+ * Returns the number of indices written, *outError gets the largest
+ * object space deviation introduced.
+ */
+int simplifyMesh(unsigned int* outIndices, float* outError,
+		const float* positions, int stride, int numVertices,
+		const unsigned int* indices, int numIndices, int targetIndices);
+
+/* Level 0 is the input mesh, every further level halves the triangle count. */
+int buildLodChain(MeshLod* lods, int maxLods, const float* positions, int stride, int numVertices,
+		const unsigned int* indices, int numIndices);
+void freeLodChain(MeshLod* lods, int numLods);
+
+/*
+ * Picks the coarsest level whose error, projected at distance, stays under
+ * maxPixelError. projScale is the viewport height / (2 * tan(fovy / 2)).
+ */
+int selectLod(const MeshLod* lods, int numLods, float distance, float projScale, float maxPixelError);
+
+/* Extracts the 6 normalised clip planes (a, b, c, d) of a column major mvp. */
+void frustumPlanes(const float* mvp, float* planes);
+
+/*
+ * Writes one indirect command per surviving meshlet into cmds and returns
+ * the number written. planes come from frustumPlanes() of the object's mvp,
+ * eye is the viewer in object space, or NULL to skip back-face cone culling.
+ */
+int cullMeshlets(const MeshletMesh* mesh, const float* planes, const float* eye,
+		DrawElementsIndirectCommand* cmds);
+
+#endif
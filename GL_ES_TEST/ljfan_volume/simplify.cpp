@@ -0,0 +1,339 @@
+/*
+ * simplify.cpp
+ * Quadric error metric mesh simplification and LOD selection.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <map>
+#include <vector>
+#include <algorithm>
+
+#include "mesh.h"
+
+/* Symmetric 4x4 quadric stored as its upper triangle. */
+struct Quadric {
+	double a[10];
+};
+
+static void quadricAddPlane(Quadric* q, double nx, double ny, double nz, double d)
+{
+	q->a[0] += nx*nx; q->a[1] += nx*ny; q->a[2] += nx*nz; q->a[3] += nx*d;
+	q->a[4] += ny*ny; q->a[5] += ny*nz; q->a[6] += ny*d;
+	q->a[7] += nz*nz; q->a[8] += nz*d;
+	q->a[9] += d*d;
+}
+
+static void quadricAdd(Quadric* q, const Quadric* o)
+{
+	for(int i=0; i<10; i++) {
+		q->a[i] += o->a[i];
+	}
+}
+
+static double quadricError(const Quadric* q, const float* p)
+{
+	double x = p[0], y = p[1], z = p[2];
+	double e = q->a[0]*x*x + 2*q->a[1]*x*y + 2*q->a[2]*x*z + 2*q->a[3]*x
+			+ q->a[4]*y*y + 2*q->a[5]*y*z + 2*q->a[6]*y
+			+ q->a[7]*z*z + 2*q->a[8]*z
+			+ q->a[9];
+	return e > 0.0 ? e : 0.0;
+}
+
+static void triangleNormal(const float* a, const float* b, const float* c, double* n)
+{
+	double e1[3] = { b[0]-a[0], b[1]-a[1], b[2]-a[2] };
+	double e2[3] = { c[0]-a[0], c[1]-a[1], c[2]-a[2] };
+	n[0] = e1[1]*e2[2] - e1[2]*e2[1];
+	n[1] = e1[2]*e2[0] - e1[0]*e2[2];
+	n[2] = e1[0]*e2[1] - e1[1]*e2[0];
+	double len = sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+	if(len > 0.0) {
+		n[0] /= len; n[1] /= len; n[2] /= len;
+	}
+}
+
+struct Collapse {
+	unsigned int from;
+	unsigned int to;
+	double cost;
+	bool operator<(const Collapse& o) const {
+		return cost < o.cost;
+	}
+};
+
+/* Orders vertex indices by every float of the vertex, not just the position. */
+struct VertexLess {
+	const float* vertices;
+	int stride;
+	bool operator()(unsigned int a, unsigned int b) const {
+		return memcmp(vertices + a*stride, vertices + b*stride, sizeof(float)*stride) < 0;
+	}
+};
+
+/*
+ * Edge-collapse simplification driven by per-vertex plane quadrics.
+ * Vertices equal in all stride floats are merged first; ones that only
+ * share a position, at a hard edge or a uv seam, stay apart, so their
+ * normals and uvs are not averaged away. Each collapse moves a vertex onto
+ * one of its neighbours, so the output keeps indexing the original vertex
+ * buffer. Border vertices are locked to keep closed meshes closed, which
+ * the stencil shadow volume relies on; seams count as borders, each side
+ * sees only its own triangles, so they are locked too and do not crack. Collapses run in passes of independent edges, cheapest first,
+ * until the triangle budget is met or nothing else can be collapsed.
+ */
+int simplifyMesh(unsigned int* outIndices, float* outError,
+		const float* positions, int stride, int numVertices,
+		const unsigned int* indices, int numIndices, int targetIndices)
+{
+	std::vector<unsigned int> canonical(numVertices);
+	{
+		VertexLess less = { positions, stride };
+		std::map<unsigned int, unsigned int, VertexLess> unique(less);
+		for(int v=0; v<numVertices; v++) {
+			/* the first of equal vertices stays, the rest map to it */
+			canonical[v] = unique.insert(std::make_pair((unsigned int)v, (unsigned int)v)).first->second;
+		}
+	}
+
+	std::vector<unsigned int> tris;
+	tris.reserve(numIndices);
+	for(int i=0; i+2<numIndices; i+=3) {
+		unsigned int a = canonical[indices[i]];
+		unsigned int b = canonical[indices[i+1]];
+		unsigned int c = canonical[indices[i+2]];
+		if(a != b && b != c && c != a) {
+			tris.push_back(a); tris.push_back(b); tris.push_back(c);
+		}
+	}
+
+	std::vector<Quadric> quadrics(numVertices);
+	memset(&quadrics[0], 0, sizeof(Quadric)*numVertices);
+	for(size_t i=0; i<tris.size(); i+=3) {
+		const float* a = positions + tris[i]*stride;
+		const float* b = positions + tris[i+1]*stride;
+		const float* c = positions + tris[i+2]*stride;
+		double n[3];
+		triangleNormal(a, b, c, n);
+		double d = -(n[0]*a[0] + n[1]*a[1] + n[2]*a[2]);
+		for(int k=0; k<3; k++) {
+			quadricAddPlane(&quadrics[tris[i+k]], n[0], n[1], n[2], d);
+		}
+	}
+
+	std::vector<unsigned char> locked(numVertices, 0);
+	{
+		std::map<std::pair<unsigned int, unsigned int>, int> edgeCount;
+		for(size_t i=0; i<tris.size(); i+=3) {
+			for(int k=0; k<3; k++) {
+				unsigned int u = tris[i+k], w = tris[i+(k+1)%3];
+				edgeCount[std::make_pair(std::min(u, w), std::max(u, w))]++;
+			}
+		}
+		for(std::map<std::pair<unsigned int, unsigned int>, int>::iterator it = edgeCount.begin();
+				it != edgeCount.end(); ++it) {
+			if(it->second == 1) {
+				locked[it->first.first] = 1;
+				locked[it->first.second] = 1;
+			}
+		}
+	}
+
+	double maxError = 0.0;
+	std::vector<unsigned int> collapseTo(numVertices);
+	std::vector<unsigned char> touched(numVertices);
+	std::vector<int> adjOffset(numVertices+1);
+	std::vector<int> adjTris;
+	std::vector<Collapse> collapses;
+
+	while((int)tris.size() > targetIndices) {
+		int numTris = tris.size()/3;
+
+		/* vertex -> triangle adjacency for the flip test */
+		std::fill(adjOffset.begin(), adjOffset.end(), 0);
+		for(size_t i=0; i<tris.size(); i++) {
+			adjOffset[tris[i]+1]++;
+		}
+		for(int v=0; v<numVertices; v++) {
+			adjOffset[v+1] += adjOffset[v];
+		}
+		adjTris.resize(tris.size());
+		{
+			std::vector<int> fill(adjOffset.begin(), adjOffset.end()-1);
+			for(size_t i=0; i<tris.size(); i++) {
+				adjTris[fill[tris[i]]++] = i/3;
+			}
+		}
+
+		collapses.clear();
+		for(size_t i=0; i<tris.size(); i+=3) {
+			for(int k=0; k<3; k++) {
+				unsigned int u = tris[i+k], w = tris[i+(k+1)%3];
+				/* every interior edge is seen twice, keep one direction */
+				if(u > w && !locked[u] && !locked[w]) {
+					continue;
+				}
+				Quadric q = quadrics[u];
+				quadricAdd(&q, &quadrics[w]);
+				Collapse c;
+				double costUW = locked[u] ? -1.0 : quadricError(&q, positions + w*stride);
+				double costWU = locked[w] ? -1.0 : quadricError(&q, positions + u*stride);
+				if(costUW < 0.0 && costWU < 0.0) {
+					continue;
+				}
+				if(costWU < 0.0 || (costUW >= 0.0 && costUW <= costWU)) {
+					c.from = u; c.to = w; c.cost = costUW;
+				} else {
+					c.from = w; c.to = u; c.cost = costWU;
+				}
+				collapses.push_back(c);
+			}
+		}
+		if(collapses.empty()) {
+			break;
+		}
+		std::sort(collapses.begin(), collapses.end());
+
+		for(int v=0; v<numVertices; v++) {
+			collapseTo[v] = v;
+		}
+		std::fill(touched.begin(), touched.end(), 0);
+
+		int removed = 0;
+		int budget = numTris - targetIndices/3;
+		int accepted = 0;
+		for(size_t ci=0; ci<collapses.size() && removed < budget; ci++) {
+			const Collapse& c = collapses[ci];
+			if(touched[c.from] || touched[c.to]) {
+				continue;
+			}
+
+			/* Reject the collapse if it flips any triangle around c.from. */
+			const float* target = positions + c.to*stride;
+			bool flips = false;
+			int lost = 0;
+			for(int a=adjOffset[c.from]; a<adjOffset[c.from+1] && !flips; a++) {
+				const unsigned int* tri = &tris[adjTris[a]*3];
+				if(tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) {
+					lost++;
+					continue;
+				}
+				const float* p[3];
+				const float* q[3];
+				for(int k=0; k<3; k++) {
+					p[k] = positions + tri[k]*stride;
+					q[k] = tri[k] == c.from ? target : p[k];
+				}
+				double n0[3], n1[3];
+				triangleNormal(p[0], p[1], p[2], n0);
+				triangleNormal(q[0], q[1], q[2], n1);
+				if(n0[0]*n1[0] + n0[1]*n1[1] + n0[2]*n1[2] < 0.25) {
+					flips = true;
+				}
+			}
+			if(flips) {
+				continue;
+			}
+
+			collapseTo[c.from] = c.to;
+			quadricAdd(&quadrics[c.to], &quadrics[c.from]);
+			if(c.cost > maxError) {
+				maxError = c.cost;
+			}
+			for(int a=adjOffset[c.from]; a<adjOffset[c.from+1]; a++) {
+				const unsigned int* tri = &tris[adjTris[a]*3];
+				touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+			}
+			for(int a=adjOffset[c.to]; a<adjOffset[c.to+1]; a++) {
+				const unsigned int* tri = &tris[adjTris[a]*3];
+				touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+			}
+			removed += lost;
+			accepted++;
+		}
+		if(accepted == 0) {
+			break;
+		}
+
+		size_t out = 0;
+		for(size_t i=0; i<tris.size(); i+=3) {
+			unsigned int a = collapseTo[tris[i]];
+			unsigned int b = collapseTo[tris[i+1]];
+			unsigned int c = collapseTo[tris[i+2]];
+			if(a != b && b != c && c != a) {
+				tris[out++] = a; tris[out++] = b; tris[out++] = c;
+			}
+		}
+		tris.resize(out);
+	}
+
+	if(!tris.empty()) {
+		memcpy(outIndices, &tris[0], sizeof(unsigned int)*tris.size());
+	}
+	if(outError) {
+		*outError = (float)sqrt(maxError);
+	}
+	return tris.size();
+}
+
+int buildLodChain(MeshLod* lods, int maxLods, const float* positions, int stride, int numVertices,
+		const unsigned int* indices, int numIndices)
+{
+	int numLods = 0;
+	float error = 0.0f;
+	unsigned int* cur = (unsigned int*)malloc(sizeof(unsigned int)*numIndices);
+	memcpy(cur, indices, sizeof(unsigned int)*numIndices);
+	int curCount = numIndices;
+
+	while(numLods < maxLods) {
+		MeshLod* lod = &lods[numLods++];
+		lod->error = error;
+		lod->firstIndex = 0;
+		buildMeshlets(&lod->meshlets, positions, stride, cur, curCount);
+
+		if(numLods == maxLods || curCount/3 <= LOD_MIN_TRIANGLES) {
+			break;
+		}
+
+		/* Each level simplifies the previous one, the errors accumulate. */
+		unsigned int* next = (unsigned int*)malloc(sizeof(unsigned int)*curCount);
+		float levelError = 0.0f;
+		int nextCount = simplifyMesh(next, &levelError, positions, stride, numVertices,
+				cur, curCount, (curCount/3/2)*3);
+		if(nextCount == 0 || nextCount > curCount*9/10) {
+			free(next);
+			break;
+		}
+		free(cur);
+		cur = next;
+		curCount = nextCount;
+		error += levelError;
+	}
+
+	free(cur);
+	return numLods;
+}
+
+void freeLodChain(MeshLod* lods, int numLods)
+{
+	for(int i=0; i<numLods; i++) {
+		freeMeshlets(&lods[i].meshlets);
+	}
+}
+
+int selectLod(const MeshLod* lods, int numLods, float distance, float projScale, float maxPixelError)
+{
+	if(distance <= 0.0f) {
+		return 0;
+	}
+	int level = 0;
+	for(int i=1; i<numLods; i++) {
+		if(lods[i].error*projScale/distance > maxPixelError) {
+			break;
+		}
+		level = i;
+	}
+	return level;
+}
@@ -2,7 +2,12 @@ LOCAL_PATH:= $(call my-dir)
 include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES:= \
-		    test.cpp
+		    test.cpp \
+		    fill.cpp \
+		    fillpool.cpp \
+		    damage.cpp \
+		    producer.cpp \
+		    framestats.cpp
 		    
 LOCAL_C_INCLUDES := \
 	external/skia/include/core
@@ -15,9 +20,146 @@ LOCAL_SHARED_LIBRARIES := \
 			libbinder
             
 
+LOCAL_ARM_NEON := true
+
 LOCAL_MODULE:= red_layer
 
 LOCAL_MODULE_TAGS := tests
 
 include $(BUILD_EXECUTABLE)
 
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+		    fill.cpp \
+		    fillpool.cpp \
+		    fill_bench.cpp
+
+LOCAL_ARM_NEON := true
+
+LOCAL_MODULE:= fill_bench
+
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+		    fill.cpp \
+		    fillpool.cpp \
+		    fill_bench.cpp
+
+LOCAL_LDLIBS := -lpthread
+
+LOCAL_MODULE:= fill_bench_host
+
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+		    test.cpp \
+		    fill.cpp \
+		    fillpool.cpp \
+		    damage.cpp \
+		    producer.cpp \
+		    framestats.cpp
+
+LOCAL_STATIC_LIBRARIES := \
+		    libhostwindow
+
+LOCAL_LDLIBS := -lpthread
+
+LOCAL_MODULE:= red_layer_host
+
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+		    scene_test.cpp \
+		    scene.cpp \
+		    fill.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+		    libcutils \
+		    libutils \
+		    libui \
+		    libgui \
+			libbinder
+
+LOCAL_ARM_NEON := true
+
+LOCAL_MODULE:= layer_scene
+
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+		    scene_test.cpp \
+		    scene.cpp \
+		    fill.cpp
+
+LOCAL_STATIC_LIBRARIES := \
+		    libhostwindow
+
+LOCAL_LDLIBS := -lpthread
+
+LOCAL_MODULE:= layer_scene_host
+
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+		    tree_test.cpp \
+		    tree.cpp \
+		    scene.cpp \
+		    fill.cpp \
+		    framestats.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+		    libcutils \
+		    libutils \
+		    libui \
+		    libgui \
+			libbinder
+
+LOCAL_ARM_NEON := true
+
+LOCAL_MODULE:= layer_tree
+
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+		    tree_test.cpp \
+		    tree.cpp \
+		    scene.cpp \
+		    fill.cpp \
+		    framestats.cpp
+
+LOCAL_STATIC_LIBRARIES := \
+		    libhostwindow
+
+LOCAL_LDLIBS := -lpthread
+
+LOCAL_MODULE:= layer_tree_host
+
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_HOST_EXECUTABLE)
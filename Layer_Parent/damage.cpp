@@ -0,0 +1,131 @@
+/*
+ * damage.cpp
+ * Per-frame damage history for partial buffer updates.
+ */
+
+#include <string.h>
+
+#include "damage.h"
+
+static inline int imin(int a, int b) { return a < b ? a : b; }
+static inline int imax(int a, int b) { return a > b ? a : b; }
+
+static bool isEmpty(const DamageRect* r)
+{
+	return r->right <= r->left || r->bottom <= r->top;
+}
+
+static bool intersects(const DamageRect* a, const DamageRect* b)
+{
+	return a->left < b->right && b->left < a->right && a->top < b->bottom && b->top < a->bottom;
+}
+
+static DamageRect bounds(const DamageRect* a, const DamageRect* b)
+{
+	DamageRect r = { imin(a->left, b->left), imin(a->top, b->top), imax(a->right, b->right), imax(a->bottom, b->bottom) };
+	return r;
+}
+
+static long area(const DamageRect* r)
+{
+	return isEmpty(r) ? 0 : (long)(r->right - r->left)*(r->bottom - r->top);
+}
+
+void damageClear(DamageRegion* region)
+{
+	region->numRects = 0;
+}
+
+void damageAdd(DamageRegion* region, const DamageRect* rect)
+{
+	if(isEmpty(rect)) {
+		return;
+	}
+	DamageRect r = *rect;
+
+	/* Swallow everything r touches; growing r can make it touch more. */
+	bool merged = true;
+	while(merged) {
+		merged = false;
+		for(int i=0; i<region->numRects; i++) {
+			if(intersects(&r, &region->rects[i])) {
+				r = bounds(&r, &region->rects[i]);
+				region->rects[i] = region->rects[--region->numRects];
+				merged = true;
+				break;
+			}
+		}
+	}
+
+	if(region->numRects == DAMAGE_MAX_RECTS) {
+		/* merge with the rect that adds the least extra area */
+		int best = 0;
+		long bestCost = -1;
+		for(int i=0; i<region->numRects; i++) {
+			DamageRect b = bounds(&r, &region->rects[i]);
+			long cost = area(&b) - area(&r) - area(&region->rects[i]);
+			if(bestCost < 0 || cost < bestCost) {
+				best = i;
+				bestCost = cost;
+			}
+		}
+		DamageRect b = bounds(&r, &region->rects[best]);
+		region->rects[best] = region->rects[--region->numRects];
+		damageAdd(region, &b);
+		return;
+	}
+	region->rects[region->numRects++] = r;
+}
+
+void damageUnion(DamageRegion* region, const DamageRegion* other)
+{
+	for(int i=0; i<other->numRects; i++) {
+		damageAdd(region, &other->rects[i]);
+	}
+}
+
+long damageArea(const DamageRegion* region)
+{
+	long total = 0;
+	for(int i=0; i<region->numRects; i++) {
+		total += area(&region->rects[i]);
+	}
+	return total;
+}
+
+DamageRect damageBounds(const DamageRegion* region)
+{
+	DamageRect r = { 0, 0, 0, 0 };
+	for(int i=0; i<region->numRects; i++) {
+		r = i == 0 ? region->rects[0] : bounds(&r, &region->rects[i]);
+	}
+	return r;
+}
+
+void damageTrackerInit(DamageTracker* tracker, int width, int height)
+{
+	memset(tracker, 0, sizeof(*tracker));
+	tracker->width = width;
+	tracker->height = height;
+}
+
+void damageRepaint(const DamageTracker* tracker, int age, const DamageRegion* current, DamageRegion* out)
+{
+	damageClear(out);
+	if(age <= 0 || age > DAMAGE_HISTORY || age > tracker->frames) {
+		DamageRect all = { 0, 0, tracker->width, tracker->height };
+		damageAdd(out, &all);
+		return;
+	}
+	/* a buffer of age n holds frame frames - n, it missed the ones after it */
+	for(int f=tracker->frames - age + 1; f<tracker->frames; f++) {
+		damageUnion(out, &tracker->history[f % DAMAGE_HISTORY]);
+	}
+	damageUnion(out, current);
+}
+
+void damagePush(DamageTracker* tracker, const DamageRegion* current)
+{
+	tracker->history[tracker->frames % DAMAGE_HISTORY] = *current;
+	tracker->frames++;
+}
@@ -0,0 +1,56 @@
+/*
+ * damage.h
+ * Per-frame damage history, so a producer only rewrites what changed since
+ * the dequeued buffer was last drawn.
+ */
+
+#ifndef DAMAGE_H
+#define DAMAGE_H
+
+/* Rects per region; beyond that the closest ones are merged. */
+#define DAMAGE_MAX_RECTS	8
+/* Frames remembered, buffers older than this are redrawn whole. */
+#define DAMAGE_HISTORY		8
+
+/* Top-left origin, right and bottom exclusive. */
+typedef struct {
+	int left;
+	int top;
+	int right;
+	int bottom;
+} DamageRect;
+
+typedef struct {
+	DamageRect rects[DAMAGE_MAX_RECTS];
+	int numRects;
+} DamageRegion;
+
+typedef struct {
+	int width;
+	int height;
+	DamageRegion history[DAMAGE_HISTORY];	/* by frame number */
+	int frames;
+} DamageTracker;
+
+void damageClear(DamageRegion* region);
+/* Adds rect, clipped to nothing if empty; overlapping rects are merged. */
+void damageAdd(DamageRegion* region, const DamageRect* rect);
+void damageUnion(DamageRegion* region, const DamageRegion* other);
+/* Pixels covered, counting overlaps once per rect. */
+long damageArea(const DamageRegion* region);
+DamageRect damageBounds(const DamageRegion* region);
+
+void damageTrackerInit(DamageTracker* tracker, int width, int height);
+
+/*
+ * What has to be written into a buffer of the given age (as reported by
+ * NATIVE_WINDOW_BUFFER_AGE) to bring it to the frame whose own damage is
+ * current: the damage of the age - 1 frames it missed plus current. Age 0
+ * means unknown contents, which is the whole buffer.
+ */
+void damageRepaint(const DamageTracker* tracker, int age, const DamageRegion* current, DamageRegion* out);
+
+/* Records current as the damage of the frame just queued. */
+void damagePush(DamageTracker* tracker, const DamageRegion* current);
+
+#endif
@@ -0,0 +1,1142 @@
+/*
+ * fill.cpp
+ * CPU fill / blit engine for the surfaces red_layer writes before every
+ * queueBuffer. Everything honours the buffer's stride.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FILL_NEON 1
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FILL_X86 1
+#endif
+
+#include "fill.h"
+
+#define ALIGN(x, a)	(((x) + (a) - 1) & ~((a) - 1))
+
+/* ---- scalar ---- */
+
+static void fillRow32Scalar(uint32_t* dst, uint32_t value, int count)
+{
+	for(int i=0; i<count; i++) {
+		dst[i] = value;
+	}
+}
+
+static void fillRow16Scalar(uint16_t* dst, uint16_t value, int count)
+{
+	for(int i=0; i<count; i++) {
+		dst[i] = value;
+	}
+}
+
+static void gradientRow32Scalar(uint32_t* dst, const int32_t* start, const int32_t* step, int count)
+{
+	int32_t acc[4] = { start[0], start[1], start[2], start[3] };
+	for(int i=0; i<count; i++) {
+		dst[i] = FILL_RGBA(acc[0] >> 16, acc[1] >> 16, acc[2] >> 16, acc[3] >> 16);
+		for(int c=0; c<4; c++) {
+			acc[c] += step[c];
+		}
+	}
+}
+
+static void rgbxRowScalar(uint32_t* dst, const uint32_t* src, int count)
+{
+	for(int i=0; i<count; i++) {
+		dst[i] = src[i] | 0xff000000;
+	}
+}
+
+static inline uint16_t to565(uint32_t p)
+{
+	return ((p & 0xf8) << 8) | ((p >> 5) & 0x07e0) | ((p >> 19) & 0x1f);
+}
+
+static void rgb565RowScalar(uint16_t* dst, const uint32_t* src, int count)
+{
+	for(int i=0; i<count; i++) {
+		dst[i] = to565(src[i]);
+	}
+}
+
+static inline uint8_t toLuma(uint32_t p)
+{
+	int r = p & 0xff;
+	int g = (p >> 8) & 0xff;
+	int b = (p >> 16) & 0xff;
+	return ((66*r + 129*g + 25*b + 128) >> 8) + 16;
+}
+
+static void lumaRowScalar(uint8_t* dst, const uint32_t* src, int count)
+{
+	for(int i=0; i<count; i++) {
+		dst[i] = toLuma(src[i]);
+	}
+}
+
+static inline uint8_t clamp8(int v)
+{
+	return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+/* Chroma of an averaged r, g, b. */
+static inline void toChroma(int r, int g, int b, uint8_t* u, uint8_t* v)
+{
+	*u = clamp8(((-38*r - 74*g + 112*b + 128) >> 8) + 128);
+	*v = clamp8(((112*r - 94*g - 18*b + 128) >> 8) + 128);
+}
+
+static void chromaRowScalar(uint8_t* u, uint8_t* v, int step, const uint32_t* row0, const uint32_t* row1, int width)
+{
+	int x = 0;
+	for(; 2*x+1<width; x++) {
+		uint32_t p0 = row0[2*x], p1 = row0[2*x+1], p2 = row1[2*x], p3 = row1[2*x+1];
+		/* r and b summed side by side in one word, g on its own */
+		uint32_t rb = (p0 & 0xff00ff) + (p1 & 0xff00ff) + (p2 & 0xff00ff) + (p3 & 0xff00ff);
+		uint32_t g = ((p0 >> 8) & 0xff) + ((p1 >> 8) & 0xff) + ((p2 >> 8) & 0xff) + ((p3 >> 8) & 0xff);
+		toChroma(((rb & 0xffff) + 2) >> 2, (g + 2) >> 2, ((rb >> 16) + 2) >> 2, &u[x*step], &v[x*step]);
+	}
+	if(2*x < width) {
+		/* odd width: the last column only has two pixels */
+		uint32_t p0 = row0[2*x], p2 = row1[2*x];
+		toChroma(((p0 & 0xff) + (p2 & 0xff) + 1) >> 1, (((p0 >> 8) & 0xff) + ((p2 >> 8) & 0xff) + 1) >> 1,
+				(((p0 >> 16) & 0xff) + ((p2 >> 16) & 0xff) + 1) >> 1, &u[x*step], &v[x*step]);
+	}
+}
+
+static void copyRow32Scalar(uint32_t* dst, const uint32_t* src, int count)
+{
+	memcpy(dst, src, sizeof(uint32_t)*count);
+}
+
+static const FillKernels scalarKernels = {
+	"scalar",
+	fillRow32Scalar,
+	fillRow16Scalar,
+	gradientRow32Scalar,
+	rgbxRowScalar,
+	rgb565RowScalar,
+	lumaRowScalar,
+	chromaRowScalar,
+	copyRow32Scalar,
+	NULL,
+};
+
+/* ---- SSE2 / AVX2 ---- */
+
+#if FILL_X86
+static void fillRow32Sse2(uint32_t* dst, uint32_t value, int count)
+{
+	__m128i v = _mm_set1_epi32(value);
+	int i = 0;
+	for(; i+16<=count; i+=16) {
+		_mm_storeu_si128((__m128i*)(dst + i), v);
+		_mm_storeu_si128((__m128i*)(dst + i + 4), v);
+		_mm_storeu_si128((__m128i*)(dst + i + 8), v);
+		_mm_storeu_si128((__m128i*)(dst + i + 12), v);
+	}
+	for(; i+4<=count; i+=4) {
+		_mm_storeu_si128((__m128i*)(dst + i), v);
+	}
+	fillRow32Scalar(dst + i, value, count - i);
+}
+
+static void fillRow16Sse2(uint16_t* dst, uint16_t value, int count)
+{
+	__m128i v = _mm_set1_epi16(value);
+	int i = 0;
+	for(; i+32<=count; i+=32) {
+		_mm_storeu_si128((__m128i*)(dst + i), v);
+		_mm_storeu_si128((__m128i*)(dst + i + 8), v);
+		_mm_storeu_si128((__m128i*)(dst + i + 16), v);
+		_mm_storeu_si128((__m128i*)(dst + i + 24), v);
+	}
+	for(; i+8<=count; i+=8) {
+		_mm_storeu_si128((__m128i*)(dst + i), v);
+	}
+	fillRow16Scalar(dst + i, value, count - i);
+}
+
+/* One pixel per register, four registers packed down to four RGBA pixels. */
+static void gradientRow32Sse2(uint32_t* dst, const int32_t* start, const int32_t* step, int count)
+{
+	__m128i st = _mm_setr_epi32(step[0], step[1], step[2], step[3]);
+	__m128i st4 = _mm_slli_epi32(st, 2);
+	__m128i acc0 = _mm_setr_epi32(start[0], start[1], start[2], start[3]);
+	__m128i acc1 = _mm_add_epi32(acc0, st);
+	__m128i acc2 = _mm_add_epi32(acc1, st);
+	__m128i acc3 = _mm_add_epi32(acc2, st);
+	int i = 0;
+	for(; i+4<=count; i+=4) {
+		__m128i p01 = _mm_packs_epi32(_mm_srli_epi32(acc0, 16), _mm_srli_epi32(acc1, 16));
+		__m128i p23 = _mm_packs_epi32(_mm_srli_epi32(acc2, 16), _mm_srli_epi32(acc3, 16));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(p01, p23));
+		acc0 = _mm_add_epi32(acc0, st4);
+		acc1 = _mm_add_epi32(acc1, st4);
+		acc2 = _mm_add_epi32(acc2, st4);
+		acc3 = _mm_add_epi32(acc3, st4);
+	}
+	int32_t rest[4];
+	_mm_storeu_si128((__m128i*)rest, acc0);
+	gradientRow32Scalar(dst + i, rest, step, count - i);
+}
+
+static void rgbxRowSse2(uint32_t* dst, const uint32_t* src, int count)
+{
+	__m128i alpha = _mm_set1_epi32(0xff000000);
+	int i = 0;
+	for(; i+4<=count; i+=4) {
+		__m128i p = _mm_loadu_si128((const __m128i*)(src + i));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(p, alpha));
+	}
+	rgbxRowScalar(dst + i, src + i, count - i);
+}
+
+static inline __m128i pack565Sse2(__m128i p)
+{
+	__m128i r = _mm_slli_epi32(_mm_and_si128(p, _mm_set1_epi32(0xf8)), 8);
+	__m128i g = _mm_and_si128(_mm_srli_epi32(p, 5), _mm_set1_epi32(0x07e0));
+	__m128i b = _mm_and_si128(_mm_srli_epi32(p, 19), _mm_set1_epi32(0x1f));
+	__m128i v = _mm_or_si128(_mm_or_si128(r, g), b);
+	/* sign extend so the signed pack keeps all 16 bits (no packus_epi32 before SSE4.1) */
+	return _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+}
+
+static void rgb565RowSse2(uint16_t* dst, const uint32_t* src, int count)
+{
+	int i = 0;
+	for(; i+8<=count; i+=8) {
+		__m128i a = pack565Sse2(_mm_loadu_si128((const __m128i*)(src + i)));
+		__m128i b = pack565Sse2(_mm_loadu_si128((const __m128i*)(src + i + 4)));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(a, b));
+	}
+	rgb565RowScalar(dst + i, src + i, count - i);
+}
+
+/* Luma of four pixels as 32-bit lanes. */
+static inline __m128i luma4Sse2(__m128i p)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i coef = _mm_setr_epi16(66, 129, 25, 0, 66, 129, 25, 0);
+	__m128i s = _mm_madd_epi16(_mm_unpacklo_epi8(p, zero), coef);
+	__m128i t = _mm_madd_epi16(_mm_unpackhi_epi8(p, zero), coef);
+	__m128i rg = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(s), _mm_castsi128_ps(t), _MM_SHUFFLE(2, 0, 2, 0)));
+	__m128i b = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(s), _mm_castsi128_ps(t), _MM_SHUFFLE(3, 1, 3, 1)));
+	__m128i y = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(rg, b), _mm_set1_epi32(128)), 8);
+	return _mm_add_epi32(y, _mm_set1_epi32(16));
+}
+
+static void lumaRowSse2(uint8_t* dst, const uint32_t* src, int count)
+{
+	int i = 0;
+	for(; i+16<=count; i+=16) {
+		__m128i y0 = luma4Sse2(_mm_loadu_si128((const __m128i*)(src + i)));
+		__m128i y1 = luma4Sse2(_mm_loadu_si128((const __m128i*)(src + i + 4)));
+		__m128i y2 = luma4Sse2(_mm_loadu_si128((const __m128i*)(src + i + 8)));
+		__m128i y3 = luma4Sse2(_mm_loadu_si128((const __m128i*)(src + i + 12)));
+		__m128i y = _mm_packus_epi16(_mm_packs_epi32(y0, y1), _mm_packs_epi32(y2, y3));
+		_mm_storeu_si128((__m128i*)(dst + i), y);
+	}
+	lumaRowScalar(dst + i, src + i, count - i);
+}
+
+/* 2x2 block sums of four pixel pairs, averaged: r, g, b, a of two blocks per register. */
+static inline __m128i blockAverageSse2(__m128i a, __m128i b)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+	__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+	__m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+	return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+}
+
+/* One chroma component of four blocks as 32-bit lanes. */
+static inline __m128i chroma4Sse2(__m128i avg01, __m128i avg23, __m128i coef)
+{
+	__m128i s = _mm_madd_epi16(avg01, coef);
+	__m128i t = _mm_madd_epi16(avg23, coef);
+	__m128i rg = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(s), _mm_castsi128_ps(t), _MM_SHUFFLE(2, 0, 2, 0)));
+	__m128i b = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(s), _mm_castsi128_ps(t), _MM_SHUFFLE(3, 1, 3, 1)));
+	__m128i c = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(rg, b), _mm_set1_epi32(128)), 8);
+	return _mm_add_epi32(c, _mm_set1_epi32(128));
+}
+
+static void chromaRowSse2(uint8_t* u, uint8_t* v, int step, const uint32_t* row0, const uint32_t* row1, int width)
+{
+	const __m128i coefU = _mm_setr_epi16(-38, -74, 112, 0, -38, -74, 112, 0);
+	const __m128i coefV = _mm_setr_epi16(112, -94, -18, 0, 112, -94, -18, 0);
+	int i = 0;
+	for(; i+8<=width; i+=8) {
+		__m128i avg01 = blockAverageSse2(_mm_loadu_si128((const __m128i*)(row0 + i)),
+				_mm_loadu_si128((const __m128i*)(row1 + i)));
+		__m128i avg23 = blockAverageSse2(_mm_loadu_si128((const __m128i*)(row0 + i + 4)),
+				_mm_loadu_si128((const __m128i*)(row1 + i + 4)));
+		__m128i uv16 = _mm_packs_epi32(chroma4Sse2(avg01, avg23, coefU), chroma4Sse2(avg01, avg23, coefV));
+		__m128i uv = _mm_packus_epi16(uv16, uv16);	/* u0..u3 v0..v3 */
+		int x = i/2;
+		if(step == 2) {
+			_mm_storel_epi64((__m128i*)(u + 2*x), _mm_unpacklo_epi8(uv, _mm_srli_si128(uv, 4)));
+		} else {
+			int32_t us = _mm_cvtsi128_si32(uv);
+			int32_t vs = _mm_cvtsi128_si32(_mm_srli_si128(uv, 4));
+			memcpy(u + x, &us, 4);
+			memcpy(v + x, &vs, 4);
+		}
+	}
+	chromaRowScalar(u + (i/2)*step, v + (i/2)*step, step, row0 + i, row1 + i, width - i);
+}
+
+static const FillKernels sse2Kernels = {
+	"sse2",
+	fillRow32Sse2,
+	fillRow16Sse2,
+	gradientRow32Sse2,
+	rgbxRowSse2,
+	rgb565RowSse2,
+	lumaRowSse2,
+	chromaRowSse2,
+	copyRow32Scalar,
+	NULL,
+};
+
+/* AVX2 is not part of the x86 ABI baseline, these are only used after a CPU check. */
+__attribute__((target("avx2")))
+static void fillRow32Avx2(uint32_t* dst, uint32_t value, int count)
+{
+	__m256i v = _mm256_set1_epi32(value);
+	int i = 0;
+	for(; i+32<=count; i+=32) {
+		_mm256_storeu_si256((__m256i*)(dst + i), v);
+		_mm256_storeu_si256((__m256i*)(dst + i + 8), v);
+		_mm256_storeu_si256((__m256i*)(dst + i + 16), v);
+		_mm256_storeu_si256((__m256i*)(dst + i + 24), v);
+	}
+	for(; i+8<=count; i+=8) {
+		_mm256_storeu_si256((__m256i*)(dst + i), v);
+	}
+	fillRow32Scalar(dst + i, value, count - i);
+}
+
+__attribute__((target("avx2")))
+static void fillRow16Avx2(uint16_t* dst, uint16_t value, int count)
+{
+	__m256i v = _mm256_set1_epi16(value);
+	int i = 0;
+	for(; i+64<=count; i+=64) {
+		_mm256_storeu_si256((__m256i*)(dst + i), v);
+		_mm256_storeu_si256((__m256i*)(dst + i + 16), v);
+		_mm256_storeu_si256((__m256i*)(dst + i + 32), v);
+		_mm256_storeu_si256((__m256i*)(dst + i + 48), v);
+	}
+	for(; i+16<=count; i+=16) {
+		_mm256_storeu_si256((__m256i*)(dst + i), v);
+	}
+	fillRow16Scalar(dst + i, value, count - i);
+}
+
+__attribute__((target("avx2")))
+static void rgbxRowAvx2(uint32_t* dst, const uint32_t* src, int count)
+{
+	__m256i alpha = _mm256_set1_epi32(0xff000000);
+	int i = 0;
+	for(; i+8<=count; i+=8) {
+		__m256i p = _mm256_loadu_si256((const __m256i*)(src + i));
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm256_or_si256(p, alpha));
+	}
+	rgbxRowScalar(dst + i, src + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i pack565Avx2(__m256i p)
+{
+	__m256i r = _mm256_slli_epi32(_mm256_and_si256(p, _mm256_set1_epi32(0xf8)), 8);
+	__m256i g = _mm256_and_si256(_mm256_srli_epi32(p, 5), _mm256_set1_epi32(0x07e0));
+	__m256i b = _mm256_and_si256(_mm256_srli_epi32(p, 19), _mm256_set1_epi32(0x1f));
+	return _mm256_or_si256(_mm256_or_si256(r, g), b);
+}
+
+__attribute__((target("avx2")))
+static void rgb565RowAvx2(uint16_t* dst, const uint32_t* src, int count)
+{
+	int i = 0;
+	for(; i+16<=count; i+=16) {
+		__m256i a = pack565Avx2(_mm256_loadu_si256((const __m256i*)(src + i)));
+		__m256i b = pack565Avx2(_mm256_loadu_si256((const __m256i*)(src + i + 8)));
+		/* the pack works per 128-bit lane, put the quarters back in order */
+		__m256i v = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256((__m256i*)(dst + i), v);
+	}
+	rgb565RowScalar(dst + i, src + i, count - i);
+}
+
+static const FillKernels avx2Kernels = {
+	"avx2",
+	fillRow32Avx2,
+	fillRow16Avx2,
+	gradientRow32Sse2,
+	rgbxRowAvx2,
+	rgb565RowAvx2,
+	lumaRowSse2,
+	chromaRowSse2,
+	copyRow32Scalar,
+	NULL,
+};
+
+/*
+ * Streaming (non-temporal) stores: the written lines bypass the cache, so a
+ * frame that is only written, never read back, does not evict everything
+ * else and needs no read-for-ownership. The scalar heads align dst.
+ */
+static void fillRow32Sse2Stream(uint32_t* dst, uint32_t value, int count)
+{
+	int head = (int)((16 - ((uintptr_t)dst & 15)) & 15)/4;
+	head = head < count ? head : count;
+	fillRow32Scalar(dst, value, head);
+	__m128i v = _mm_set1_epi32(value);
+	int i = head;
+	for(; i+16<=count; i+=16) {
+		_mm_stream_si128((__m128i*)(dst + i), v);
+		_mm_stream_si128((__m128i*)(dst + i + 4), v);
+		_mm_stream_si128((__m128i*)(dst + i + 8), v);
+		_mm_stream_si128((__m128i*)(dst + i + 12), v);
+	}
+	for(; i+4<=count; i+=4) {
+		_mm_stream_si128((__m128i*)(dst + i), v);
+	}
+	fillRow32Scalar(dst + i, value, count - i);
+}
+
+static void fillRow16Sse2Stream(uint16_t* dst, uint16_t value, int count)
+{
+	if((uintptr_t)dst & 1) {
+		fillRow16Sse2(dst, value, count);
+		return;
+	}
+	int head = (int)((16 - ((uintptr_t)dst & 15)) & 15)/2;
+	head = head < count ? head : count;
+	fillRow16Scalar(dst, value, head);
+	__m128i v = _mm_set1_epi16(value);
+	int i = head;
+	for(; i+32<=count; i+=32) {
+		_mm_stream_si128((__m128i*)(dst + i), v);
+		_mm_stream_si128((__m128i*)(dst + i + 8), v);
+		_mm_stream_si128((__m128i*)(dst + i + 16), v);
+		_mm_stream_si128((__m128i*)(dst + i + 24), v);
+	}
+	for(; i+8<=count; i+=8) {
+		_mm_stream_si128((__m128i*)(dst + i), v);
+	}
+	fillRow16Scalar(dst + i, value, count - i);
+}
+
+static void rgbxRowSse2Stream(uint32_t* dst, const uint32_t* src, int count)
+{
+	int head = (int)((16 - ((uintptr_t)dst & 15)) & 15)/4;
+	head = head < count ? head : count;
+	rgbxRowScalar(dst, src, head);
+	__m128i alpha = _mm_set1_epi32(0xff000000);
+	int i = head;
+	for(; i+4<=count; i+=4) {
+		__m128i p = _mm_loadu_si128((const __m128i*)(src + i));
+		_mm_stream_si128((__m128i*)(dst + i), _mm_or_si128(p, alpha));
+	}
+	rgbxRowScalar(dst + i, src + i, count - i);
+}
+
+static void copyRow32Sse2Stream(uint32_t* dst, const uint32_t* src, int count)
+{
+	int head = (int)((16 - ((uintptr_t)dst & 15)) & 15)/4;
+	head = head < count ? head : count;
+	copyRow32Scalar(dst, src, head);
+	int i = head;
+	for(; i+8<=count; i+=8) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(src + i + 4));
+		_mm_stream_si128((__m128i*)(dst + i), a);
+		_mm_stream_si128((__m128i*)(dst + i + 4), b);
+	}
+	copyRow32Scalar(dst + i, src + i, count - i);
+}
+
+/* Streaming stores are weakly ordered, fence them before anyone else looks. */
+static void flushSse2()
+{
+	_mm_sfence();
+}
+
+static const FillKernels sse2StreamKernels = {
+	"sse2-nt",
+	fillRow32Sse2Stream,
+	fillRow16Sse2Stream,
+	gradientRow32Sse2,
+	rgbxRowSse2Stream,
+	rgb565RowSse2,
+	lumaRowSse2,
+	chromaRowSse2,
+	copyRow32Sse2Stream,
+	flushSse2,
+};
+
+__attribute__((target("avx2")))
+static void fillRow32Avx2Stream(uint32_t* dst, uint32_t value, int count)
+{
+	int head = (int)((32 - ((uintptr_t)dst & 31)) & 31)/4;
+	head = head < count ? head : count;
+	fillRow32Scalar(dst, value, head);
+	__m256i v = _mm256_set1_epi32(value);
+	int i = head;
+	for(; i+32<=count; i+=32) {
+		_mm256_stream_si256((__m256i*)(dst + i), v);
+		_mm256_stream_si256((__m256i*)(dst + i + 8), v);
+		_mm256_stream_si256((__m256i*)(dst + i + 16), v);
+		_mm256_stream_si256((__m256i*)(dst + i + 24), v);
+	}
+	for(; i+8<=count; i+=8) {
+		_mm256_stream_si256((__m256i*)(dst + i), v);
+	}
+	fillRow32Scalar(dst + i, value, count - i);
+}
+
+__attribute__((target("avx2")))
+static void copyRow32Avx2Stream(uint32_t* dst, const uint32_t* src, int count)
+{
+	int head = (int)((32 - ((uintptr_t)dst & 31)) & 31)/4;
+	head = head < count ? head : count;
+	copyRow32Scalar(dst, src, head);
+	int i = head;
+	for(; i+16<=count; i+=16) {
+		__m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(src + i + 8));
+		_mm256_stream_si256((__m256i*)(dst + i), a);
+		_mm256_stream_si256((__m256i*)(dst + i + 8), b);
+	}
+	copyRow32Scalar(dst + i, src + i, count - i);
+}
+
+static const FillKernels avx2StreamKernels = {
+	"avx2-nt",
+	fillRow32Avx2Stream,
+	fillRow16Sse2Stream,
+	gradientRow32Sse2,
+	rgbxRowSse2Stream,
+	rgb565RowAvx2,
+	lumaRowSse2,
+	chromaRowSse2,
+	copyRow32Avx2Stream,
+	flushSse2,
+};
+#endif
+
+/* ---- NEON ---- */
+
+#if FILL_NEON
+static void fillRow32Neon(uint32_t* dst, uint32_t value, int count)
+{
+	uint32x4_t v = vdupq_n_u32(value);
+	int i = 0;
+	for(; i+16<=count; i+=16) {
+		vst1q_u32(dst + i, v);
+		vst1q_u32(dst + i + 4, v);
+		vst1q_u32(dst + i + 8, v);
+		vst1q_u32(dst + i + 12, v);
+	}
+	for(; i+4<=count; i+=4) {
+		vst1q_u32(dst + i, v);
+	}
+	fillRow32Scalar(dst + i, value, count - i);
+}
+
+static void fillRow16Neon(uint16_t* dst, uint16_t value, int count)
+{
+	uint16x8_t v = vdupq_n_u16(value);
+	int i = 0;
+	for(; i+32<=count; i+=32) {
+		vst1q_u16(dst + i, v);
+		vst1q_u16(dst + i + 8, v);
+		vst1q_u16(dst + i + 16, v);
+		vst1q_u16(dst + i + 24, v);
+	}
+	for(; i+8<=count; i+=8) {
+		vst1q_u16(dst + i, v);
+	}
+	fillRow16Scalar(dst + i, value, count - i);
+}
+
+static void gradientRow32Neon(uint32_t* dst, const int32_t* start, const int32_t* step, int count)
+{
+	int32x4_t st = vld1q_s32(step);
+	int32x4_t st4 = vshlq_n_s32(st, 2);
+	int32x4_t acc0 = vld1q_s32(start);
+	int32x4_t acc1 = vaddq_s32(acc0, st);
+	int32x4_t acc2 = vaddq_s32(acc1, st);
+	int32x4_t acc3 = vaddq_s32(acc2, st);
+	int i = 0;
+	for(; i+4<=count; i+=4) {
+		int16x8_t p01 = vcombine_s16(vshrn_n_s32(acc0, 16), vshrn_n_s32(acc1, 16));
+		int16x8_t p23 = vcombine_s16(vshrn_n_s32(acc2, 16), vshrn_n_s32(acc3, 16));
+		vst1q_u8((uint8_t*)(dst + i), vcombine_u8(vqmovun_s16(p01), vqmovun_s16(p23)));
+		acc0 = vaddq_s32(acc0, st4);
+		acc1 = vaddq_s32(acc1, st4);
+		acc2 = vaddq_s32(acc2, st4);
+		acc3 = vaddq_s32(acc3, st4);
+	}
+	int32_t rest[4];
+	vst1q_s32(rest, acc0);
+	gradientRow32Scalar(dst + i, rest, step, count - i);
+}
+
+static void rgbxRowNeon(uint32_t* dst, const uint32_t* src, int count)
+{
+	uint32x4_t alpha = vdupq_n_u32(0xff000000);
+	int i = 0;
+	for(; i+4<=count; i+=4) {
+		vst1q_u32(dst + i, vorrq_u32(vld1q_u32(src + i), alpha));
+	}
+	rgbxRowScalar(dst + i, src + i, count - i);
+}
+
+static void rgb565RowNeon(uint16_t* dst, const uint32_t* src, int count)
+{
+	int i = 0;
+	for(; i+8<=count; i+=8) {
+		uint8x8x4_t p = vld4_u8((const uint8_t*)(src + i));
+		uint16x8_t v = vshll_n_u8(p.val[0], 8);
+		v = vsriq_n_u16(v, vshll_n_u8(p.val[1], 8), 5);
+		v = vsriq_n_u16(v, vshll_n_u8(p.val[2], 8), 11);
+		vst1q_u16(dst + i, v);
+	}
+	rgb565RowScalar(dst + i, src + i, count - i);
+}
+
+static void lumaRowNeon(uint8_t* dst, const uint32_t* src, int count)
+{
+	int i = 0;
+	for(; i+8<=count; i+=8) {
+		uint8x8x4_t p = vld4_u8((const uint8_t*)(src + i));
+		uint16x8_t y = vmull_u8(p.val[0], vdup_n_u8(66));
+		y = vmlal_u8(y, p.val[1], vdup_n_u8(129));
+		y = vmlal_u8(y, p.val[2], vdup_n_u8(25));
+		y = vaddq_u16(y, vdupq_n_u16(128));
+		vst1_u8(dst + i, vadd_u8(vshrn_n_u16(y, 8), vdup_n_u8(16)));
+	}
+	lumaRowScalar(dst + i, src + i, count - i);
+}
+
+static void chromaRowNeon(uint8_t* u, uint8_t* v, int step, const uint32_t* row0, const uint32_t* row1, int width)
+{
+	int i = 0;
+	for(; i+8<=width; i+=8) {
+		uint8x8x4_t p0 = vld4_u8((const uint8_t*)(row0 + i));
+		uint8x8x4_t p1 = vld4_u8((const uint8_t*)(row1 + i));
+		/* pairwise add within a row, then add the other row: 2x2 sums of four blocks */
+		int16x4_t r = vreinterpret_s16_u16(vrshr_n_u16(vpadal_u8(vpaddl_u8(p0.val[0]), p1.val[0]), 2));
+		int16x4_t g = vreinterpret_s16_u16(vrshr_n_u16(vpadal_u8(vpaddl_u8(p0.val[1]), p1.val[1]), 2));
+		int16x4_t b = vreinterpret_s16_u16(vrshr_n_u16(vpadal_u8(vpaddl_u8(p0.val[2]), p1.val[2]), 2));
+		int16x4_t cu = vmla_n_s16(vmla_n_s16(vmul_n_s16(r, -38), g, -74), b, 112);
+		int16x4_t cv = vmla_n_s16(vmla_n_s16(vmul_n_s16(r, 112), g, -94), b, -18);
+		int16x8_t c = vcombine_s16(cu, cv);
+		c = vaddq_s16(vshrq_n_s16(vaddq_s16(c, vdupq_n_s16(128)), 8), vdupq_n_s16(128));
+		uint8x8_t uv = vqmovun_s16(c);		/* u0..u3 v0..v3 */
+		int x = i/2;
+		if(step == 2) {
+			vst1_u8(u + 2*x, vzip_u8(uv, vext_u8(uv, uv, 4)).val[0]);
+		} else {
+			uint8_t tmp[8];
+			vst1_u8(tmp, uv);
+			memcpy(u + x, tmp, 4);
+			memcpy(v + x, tmp + 4, 4);
+		}
+	}
+	chromaRowScalar(u + (i/2)*step, v + (i/2)*step, step, row0 + i, row1 + i, width - i);
+}
+
+static const FillKernels neonKernels = {
+	"neon",
+	fillRow32Neon,
+	fillRow16Neon,
+	gradientRow32Neon,
+	rgbxRowNeon,
+	rgb565RowNeon,
+	lumaRowNeon,
+	chromaRowNeon,
+	copyRow32Scalar,
+	NULL,
+};
+
+/*
+ * AArch64 has STNP as a non-temporal hint; only clang exposes it, through
+ * __builtin_nontemporal_store on vectors.
+ */
+#if defined(__aarch64__) && defined(__clang__)
+#define FILL_NEON_STREAM 1
+
+static void fillRow32NeonStream(uint32_t* dst, uint32_t value, int count)
+{
+	int head = (int)((16 - ((uintptr_t)dst & 15)) & 15)/4;
+	head = head < count ? head : count;
+	fillRow32Scalar(dst, value, head);
+	uint32x4_t v = vdupq_n_u32(value);
+	int i = head;
+	for(; i+8<=count; i+=8) {
+		__builtin_nontemporal_store(v, (uint32x4_t*)(dst + i));
+		__builtin_nontemporal_store(v, (uint32x4_t*)(dst + i + 4));
+	}
+	fillRow32Scalar(dst + i, value, count - i);
+}
+
+static void copyRow32NeonStream(uint32_t* dst, const uint32_t* src, int count)
+{
+	int head = (int)((16 - ((uintptr_t)dst & 15)) & 15)/4;
+	head = head < count ? head : count;
+	copyRow32Scalar(dst, src, head);
+	int i = head;
+	for(; i+8<=count; i+=8) {
+		uint32x4_t a = vld1q_u32(src + i);
+		uint32x4_t b = vld1q_u32(src + i + 4);
+		__builtin_nontemporal_store(a, (uint32x4_t*)(dst + i));
+		__builtin_nontemporal_store(b, (uint32x4_t*)(dst + i + 4));
+	}
+	copyRow32Scalar(dst + i, src + i, count - i);
+}
+
+static const FillKernels neonStreamKernels = {
+	"neon-nt",
+	fillRow32NeonStream,
+	fillRow16Neon,
+	gradientRow32Neon,
+	rgbxRowNeon,
+	rgb565RowNeon,
+	lumaRowNeon,
+	chromaRowNeon,
+	copyRow32NeonStream,
+	NULL,
+};
+#endif
+#endif
+
+int fillKernelList(const FillKernels** list, int max)
+{
+	int n = 0;
+	if(n < max) list[n++] = &scalarKernels;
+#if FILL_X86
+	if(n < max) list[n++] = &sse2Kernels;
+	if(n < max && __builtin_cpu_supports("avx2")) list[n++] = &avx2Kernels;
+#endif
+#if FILL_NEON
+	if(n < max) list[n++] = &neonKernels;
+#endif
+	return n;
+}
+
+int fillStreamingKernelList(const FillKernels** list, int max)
+{
+	int n = 0;
+#if FILL_X86
+	if(n < max) list[n++] = &sse2StreamKernels;
+	if(n < max && __builtin_cpu_supports("avx2")) list[n++] = &avx2StreamKernels;
+#endif
+#if FILL_NEON_STREAM
+	if(n < max) list[n++] = &neonStreamKernels;
+#endif
+	return n;
+}
+
+static const FillKernels* current = NULL;
+
+const FillKernels* fillGetKernels()
+{
+	if(!current) {
+		const FillKernels* list[4];
+		current = list[fillKernelList(list, 4) - 1];
+	}
+	return current;
+}
+
+void fillSetKernels(const FillKernels* kernels)
+{
+	current = kernels;
+}
+
+/* ---- surfaces ---- */
+
+typedef struct {
+	uint8_t* y;
+	uint8_t* u;
+	uint8_t* v;
+	int yStride;
+	int cStride;
+	int cStep;		/* 2 when Cb and Cr are interleaved */
+} YuvPlanes;
+
+static void yuvPlanes(const FillSurface* s, YuvPlanes* p)
+{
+	p->y = (uint8_t*)s->bits;
+	p->yStride = s->stride;
+	if(s->format == FILL_NV12) {
+		p->cStride = s->stride;
+		p->u = p->y + s->stride*s->height;
+		p->v = p->u + 1;
+		p->cStep = 2;
+	} else {
+		p->cStride = ALIGN(s->stride/2, 16);
+		p->v = p->y + s->stride*s->height;
+		p->u = p->v + p->cStride*((s->height + 1)/2);
+		p->cStep = 1;
+	}
+}
+
+size_t fillSurfaceSize(const FillSurface* s)
+{
+	switch(s->format) {
+	case FILL_RGBA8888:
+	case FILL_RGBX8888:
+		return (size_t)s->stride*s->height*4;
+	case FILL_RGB565:
+		return (size_t)s->stride*s->height*2;
+	case FILL_NV12:
+		return (size_t)s->stride*s->height + (size_t)s->stride*((s->height + 1)/2);
+	case FILL_YV12:
+		return (size_t)s->stride*s->height + (size_t)ALIGN(s->stride/2, 16)*((s->height + 1)/2)*2;
+	}
+	return 0;
+}
+
+const char* fillFormatName(FillFormat format)
+{
+	switch(format) {
+	case FILL_RGBA8888:	return "RGBA8888";
+	case FILL_RGBX8888:	return "RGBX8888";
+	case FILL_RGB565:	return "RGB565";
+	case FILL_NV12:		return "NV12";
+	case FILL_YV12:		return "YV12";
+	}
+	return "?";
+}
+
+/*
+ * Row buffers kept per thread and only ever grown, so a fill does not go
+ * to malloc: pool workers and the calling thread each reuse their own.
+ * ROW_SOURCE holds the rows a fill builds, ROW_SCRATCH is what
+ * convertRows() hands to the row source. Freed when the thread exits.
+ */
+enum { ROW_SOURCE, ROW_SCRATCH, ROW_BUFFERS };
+
+struct RowBuffers {
+	uint32_t* rows[ROW_BUFFERS];
+	int size[ROW_BUFFERS];
+	~RowBuffers() { for(int i=0; i<ROW_BUFFERS; i++) free(rows[i]); }
+};
+static thread_local RowBuffers rowBuffers;
+
+static uint32_t* rowBuffer(int which, int pixels)
+{
+	RowBuffers* b = &rowBuffers;
+	if(b->size[which] < pixels) {
+		free(b->rows[which]);
+		b->rows[which] = (uint32_t*)malloc(sizeof(uint32_t)*pixels);
+		b->size[which] = pixels;
+	}
+	return b->rows[which];
+}
+
+/* Hands out the RGBA row for y, scratch is width pixels the callee may use. */
+typedef const uint32_t* (*RowSource)(int y, uint32_t* scratch, void* user);
+
+/*
+ * Writes columns [x0, x1) of rows [y0, y1) of dst from RGBA rows, converting
+ * to dst's format. Sources hand out whole rows starting at x = 0.
+ */
+static void convertRows(const FillSurface* dst, int x0, int x1, int y0, int y1, int height,
+		RowSource source, void* user, bool opaque)
+{
+	const FillKernels* k = fillGetKernels();
+	int width = x1 - x0;
+	uint32_t* scratch = rowBuffer(ROW_SCRATCH, x1*2);
+	uint8_t* bits = (uint8_t*)dst->bits;
+	YuvPlanes planes;
+	if(dst->format == FILL_NV12 || dst->format == FILL_YV12) {
+		yuvPlanes(dst, &planes);
+	}
+
+	for(int y=y0; y<y1; y++) {
+		const uint32_t* src = source(y, scratch, user) + x0;
+		switch(dst->format) {
+		case FILL_RGBA8888:
+			if(opaque) {
+				k->rgbxRow((uint32_t*)(bits + (size_t)y*dst->stride*4) + x0, src, width);
+			} else {
+				k->copyRow32((uint32_t*)(bits + (size_t)y*dst->stride*4) + x0, src, width);
+			}
+			break;
+		case FILL_RGBX8888:
+			k->rgbxRow((uint32_t*)(bits + (size_t)y*dst->stride*4) + x0, src, width);
+			break;
+		case FILL_RGB565:
+			k->rgb565Row((uint16_t*)(bits + (size_t)y*dst->stride*2) + x0, src, width);
+			break;
+		case FILL_NV12:
+		case FILL_YV12:
+			k->lumaRow(planes.y + (size_t)y*planes.yStride + x0, src, width);
+			if((y & 1) == 0) {
+				const uint32_t* next = y + 1 < height ? source(y + 1, scratch + x1, user) + x0 : src;
+				size_t offset = (size_t)(y/2)*planes.cStride + (x0/2)*planes.cStep;
+				k->chromaRow(planes.u + offset, planes.v + offset, planes.cStep, src, next, width);
+			}
+			break;
+		}
+	}
+}
+
+/* Columns [x0, x0 + width) of chroma row cy set to one Cb, Cr pair. */
+static void chromaFill(const YuvPlanes* planes, int cy, int x0, int width, uint8_t u, uint8_t v)
+{
+	size_t offset = (size_t)cy*planes->cStride + (x0/2)*planes->cStep;
+	if(planes->cStep == 2) {
+		/* Cb in the low byte: the plane is little endian Cb, Cr pairs */
+		fillGetKernels()->fillRow16((uint16_t*)(planes->u + offset), u | (v << 8), (width + 1)/2);
+	} else {
+		memset(planes->u + offset, u, (width + 1)/2);
+		memset(planes->v + offset, v, (width + 1)/2);
+	}
+}
+
+static void solidRows(const FillSurface* dst, uint32_t rgba, int x0, int x1, int y0, int y1)
+{
+	int width = x1 - x0;
+	const FillKernels* k = fillGetKernels();
+	uint8_t* bits = (uint8_t*)dst->bits;
+
+	switch(dst->format) {
+	case FILL_RGBA8888:
+	case FILL_RGBX8888: {
+		uint32_t value = dst->format == FILL_RGBX8888 ? rgba | 0xff000000 : rgba;
+		for(int y=y0; y<y1; y++) {
+			k->fillRow32((uint32_t*)(bits + (size_t)y*dst->stride*4) + x0, value, width);
+		}
+		break;
+	}
+	case FILL_RGB565:
+		for(int y=y0; y<y1; y++) {
+			k->fillRow16((uint16_t*)(bits + (size_t)y*dst->stride*2) + x0, to565(rgba), width);
+		}
+		break;
+	case FILL_NV12:
+	case FILL_YV12: {
+		YuvPlanes planes;
+		uint8_t u, v;
+		yuvPlanes(dst, &planes);
+		toChroma(rgba & 0xff, (rgba >> 8) & 0xff, (rgba >> 16) & 0xff, &u, &v);
+		for(int y=y0; y<y1; y++) {
+			memset(planes.y + (size_t)y*planes.yStride + x0, toLuma(rgba), width);
+		}
+		for(int y=y0/2; y<(y1 + 1)/2; y++) {
+			chromaFill(&planes, y, x0, width, u, v);
+		}
+		break;
+	}
+	}
+}
+
+static uint32_t lerpColor(uint32_t from, uint32_t to, int i, int n)
+{
+	uint32_t out = 0;
+	for(int c=0; c<32; c+=8) {
+		int a = (from >> c) & 0xff;
+		int b = (to >> c) & 0xff;
+		out |= (uint32_t)(n > 0 ? a + (b - a)*i/n : a) << c;
+	}
+	return out;
+}
+
+typedef struct {
+	const uint32_t* row;
+	const uint32_t* rows[2];
+	int cell;
+} RowParams;
+
+static const uint32_t* sameRow(int /*y*/, uint32_t* /*scratch*/, void* user)
+{
+	return ((RowParams*)user)->row;
+}
+
+static void gradientRows(const FillSurface* dst, uint32_t from, uint32_t to, bool vertical,
+		int x0, int x1, int y0, int y1)
+{
+	const FillKernels* k = fillGetKernels();
+	RowParams params;
+
+	if(vertical && (dst->format == FILL_NV12 || dst->format == FILL_YV12)) {
+		/*
+		 * One colour per row: a luma value per row and a chroma pair per
+		 * two, each worked out once, then only memsets. The pair is what
+		 * chromaRow() makes of the two rows, without converting a pixel.
+		 */
+		YuvPlanes planes;
+		yuvPlanes(dst, &planes);
+		for(int y=y0; y<y1; y++) {
+			uint32_t color = lerpColor(from, to, y, dst->height - 1);
+			memset(planes.y + (size_t)y*planes.yStride + x0, toLuma(color), x1 - x0);
+			if((y & 1) == 0) {
+				uint32_t next = y + 1 < dst->height ? lerpColor(from, to, y + 1, dst->height - 1) : color;
+				uint8_t u, v;
+				toChroma(((color & 0xff) + (next & 0xff) + 1) >> 1,
+						(((color >> 8) & 0xff) + ((next >> 8) & 0xff) + 1) >> 1,
+						(((color >> 16) & 0xff) + ((next >> 16) & 0xff) + 1) >> 1, &u, &v);
+				chromaFill(&planes, y/2, x0, x1 - x0, u, v);
+			}
+		}
+		return;
+	}
+	if(vertical) {
+		/* a solid row each, written straight into the surface */
+		uint8_t* bits = (uint8_t*)dst->bits;
+		for(int y=y0; y<y1; y++) {
+			uint32_t color = lerpColor(from, to, y, dst->height - 1);
+			if(dst->format == FILL_RGB565) {
+				k->fillRow16((uint16_t*)(bits + (size_t)y*dst->stride*2) + x0, to565(color), x1 - x0);
+			} else {
+				k->fillRow32((uint32_t*)(bits + (size_t)y*dst->stride*4) + x0,
+						dst->format == FILL_RGBX8888 ? color | 0xff000000 : color, x1 - x0);
+			}
+		}
+		return;
+	}
+
+	/* Every row is the same: build it once, then convert it per row. */
+	int32_t start[4], step[4];
+	for(int c=0; c<4; c++) {
+		int a = (from >> (c*8)) & 0xff;
+		int b = (to >> (c*8)) & 0xff;
+		start[c] = a << 16;
+		step[c] = dst->width > 1 ? (b - a)*65536/(dst->width - 1) : 0;
+	}
+	uint32_t* row = rowBuffer(ROW_SOURCE, x1);
+	k->gradientRow32(row, start, step, x1);
+	params.row = row;
+	convertRows(dst, x0, x1, y0, y1, dst->height, sameRow, &params, false);
+}
+
+static const uint32_t* checkerRow(int y, uint32_t* /*scratch*/, void* user)
+{
+	RowParams* p = (RowParams*)user;
+	return p->rows[(y/p->cell) & 1];
+}
+
+static void checkerRows(const FillSurface* dst, uint32_t a, uint32_t b, int cell, int x0, int x1, int y0, int y1)
+{
+	const FillKernels* k = fillGetKernels();
+	RowParams params;
+	if(cell < 1) {
+		cell = 1;
+	}
+	params.cell = cell;
+
+	/* the two row phases, built from runs of the solid kernel */
+	uint32_t* rows = rowBuffer(ROW_SOURCE, x1*2);
+	for(int phase=0; phase<2; phase++) {
+		uint32_t* row = rows + phase*x1;
+		for(int x=0; x<x1; x+=cell) {
+			int n = x + cell <= x1 ? cell : x1 - x;
+			k->fillRow32(row + x, ((x/cell + phase) & 1) ? b : a, n);
+		}
+		params.rows[phase] = row;
+	}
+	convertRows(dst, x0, x1, y0, y1, dst->height, checkerRow, &params, false);
+}
+
+typedef struct {
+	const uint8_t* bits;
+	int stride;
+} BlitSource;
+
+static const uint32_t* blitRow(int y, uint32_t* /*scratch*/, void* user)
+{
+	BlitSource* src = (BlitSource*)user;
+	return (const uint32_t*)(src->bits + (size_t)y*src->stride*4);
+}
+
+static void blitRows(const FillSurface* dst, const FillSurface* src, int x0, int x1, int y0, int y1)
+{
+	if(src->format != FILL_RGBA8888 && src->format != FILL_RGBX8888) {
+		return;
+	}
+	BlitSource source;
+	source.bits = (const uint8_t*)src->bits;
+	source.stride = src->stride;
+	int width = dst->width < src->width ? dst->width : src->width;
+	int height = dst->height < src->height ? dst->height : src->height;
+	if(x1 > width) {
+		x1 = width;
+	}
+	if(y1 > height) {
+		y1 = height;
+	}
+	if(x0 < x1 && y0 < y1) {
+		convertRows(dst, x0, x1, y0, y1, height, blitRow, &source, src->format == FILL_RGBX8888);
+	}
+}
+
+void fillRect(const FillSurface* dst, const FillOp* op, int x0, int y0, int x1, int y1)
+{
+	if(dst->format == FILL_NV12 || dst->format == FILL_YV12) {
+		/* whole 2x2 chroma blocks */
+		x0 &= ~1;
+		y0 &= ~1;
+		x1 = ALIGN(x1, 2);
+		y1 = ALIGN(y1, 2);
+	}
+	x0 = x0 < 0 ? 0 : x0;
+	y0 = y0 < 0 ? 0 : y0;
+	x1 = x1 > dst->width ? dst->width : x1;
+	y1 = y1 > dst->height ? dst->height : y1;
+	if(x0 >= x1 || y0 >= y1) {
+		return;
+	}
+	switch(op->type) {
+	case FILL_OP_SOLID:		solidRows(dst, op->color, x0, x1, y0, y1); break;
+	case FILL_OP_HGRADIENT:		gradientRows(dst, op->color, op->color2, false, x0, x1, y0, y1); break;
+	case FILL_OP_VGRADIENT:		gradientRows(dst, op->color, op->color2, true, x0, x1, y0, y1); break;
+	case FILL_OP_CHECKER:		checkerRows(dst, op->color, op->color2, op->cell, x0, x1, y0, y1); break;
+	case FILL_OP_BLIT:		blitRows(dst, op->src, x0, x1, y0, y1); break;
+	}
+	const FillKernels* k = fillGetKernels();
+	if(k->flush) {
+		k->flush();
+	}
+}
+
+void fillRows(const FillSurface* dst, const FillOp* op, int y0, int y1)
+{
+	fillRect(dst, op, 0, y0, dst->width, y1);
+}
+
+void fillSolid(const FillSurface* dst, uint32_t rgba)
+{
+	FillOp op = { FILL_OP_SOLID, rgba, 0, 0, NULL };
+	fillRect(dst, &op, 0, 0, dst->width, dst->height);
+}
+
+void fillGradient(const FillSurface* dst, uint32_t from, uint32_t to, bool vertical)
+{
+	FillOp op = { vertical ? FILL_OP_VGRADIENT : FILL_OP_HGRADIENT, from, to, 0, NULL };
+	fillRect(dst, &op, 0, 0, dst->width, dst->height);
+}
+
+void fillChecker(const FillSurface* dst, uint32_t a, uint32_t b, int cell)
+{
+	FillOp op = { FILL_OP_CHECKER, a, b, cell, NULL };
+	fillRect(dst, &op, 0, 0, dst->width, dst->height);
+}
+
+void fillBlit(const FillSurface* dst, const FillSurface* src)
+{
+	FillOp op = { FILL_OP_BLIT, 0, 0, 0, src };
+	fillRect(dst, &op, 0, 0, dst->width, dst->height);
+}
@@ -0,0 +1,102 @@
+/*
+ * fill.h
+ * CPU fill / blit engine for the surfaces red_layer writes before every
+ * queueBuffer. Everything honours the buffer's stride.
+ */
+
+#ifndef FILL_H
+#define FILL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum {
+	FILL_RGBA8888,
+	FILL_RGBX8888,
+	FILL_RGB565,
+	FILL_NV12,		/* Y plane, then interleaved CbCr, both stride bytes wide */
+	FILL_YV12,		/* Y plane, then Cr and Cb planes of ALIGN(stride / 2, 16) bytes */
+} FillFormat;
+
+typedef struct {
+	void* bits;
+	int width;
+	int height;
+	int stride;		/* in pixels, as in ANativeWindowBuffer */
+	FillFormat format;
+} FillSurface;
+
+/* Colours are RGBA8888 as laid out in memory: r in the low byte. */
+#define FILL_RGBA(r, g, b, a)	((uint32_t)(r) | ((uint32_t)(g) << 8) | ((uint32_t)(b) << 16) | ((uint32_t)(a) << 24))
+
+/*
+ * Row kernels behind the surface operations. Every instruction set fills
+ * in the whole table, falling back to the scalar kernel where it has
+ * nothing better.
+ */
+typedef struct {
+	const char* name;
+	void (*fillRow32)(uint32_t* dst, uint32_t value, int count);
+	void (*fillRow16)(uint16_t* dst, uint16_t value, int count);
+	/* start / step are r, g, b, a in 16.16 fixed point */
+	void (*gradientRow32)(uint32_t* dst, const int32_t* start, const int32_t* step, int count);
+	void (*rgbxRow)(uint32_t* dst, const uint32_t* src, int count);
+	void (*rgb565Row)(uint16_t* dst, const uint32_t* src, int count);
+	/* BT.601 limited range luma, and chroma of the 2x2 blocks of two rows */
+	void (*lumaRow)(uint8_t* dst, const uint32_t* src, int count);
+	void (*chromaRow)(uint8_t* u, uint8_t* v, int step, const uint32_t* row0, const uint32_t* row1, int width);
+	void (*copyRow32)(uint32_t* dst, const uint32_t* src, int count);
+	/* orders the stores of a finished operation, NULL when not needed */
+	void (*flush)();
+} FillKernels;
+
+/* Kernel sets this build and CPU can run, scalar first, best last. */
+int fillKernelList(const FillKernels** list, int max);
+/*
+ * Sets that write RGB rows with non-temporal stores, for buffers the CPU
+ * never reads back; may be none. fillGetKernels() never picks these itself.
+ */
+int fillStreamingKernelList(const FillKernels** list, int max);
+const FillKernels* fillGetKernels();
+/* Overrides the automatic choice, NULL restores it. */
+void fillSetKernels(const FillKernels* kernels);
+
+size_t fillSurfaceSize(const FillSurface* surface);
+const char* fillFormatName(FillFormat format);
+
+void fillSolid(const FillSurface* dst, uint32_t rgba);
+void fillGradient(const FillSurface* dst, uint32_t from, uint32_t to, bool vertical);
+/* Checkerboard of cell x cell squares. */
+void fillChecker(const FillSurface* dst, uint32_t a, uint32_t b, int cell);
+/* Copies an RGBA8888 / RGBX8888 surface into dst, converting to dst's format. */
+void fillBlit(const FillSurface* dst, const FillSurface* src);
+
+/*
+ * The operations above as data, so a frame can be split into row bands and
+ * filled from several threads. Bands of YUV surfaces must start on an even row.
+ */
+typedef enum {
+	FILL_OP_SOLID,
+	FILL_OP_HGRADIENT,
+	FILL_OP_VGRADIENT,
+	FILL_OP_CHECKER,
+	FILL_OP_BLIT,
+} FillOpType;
+
+typedef struct {
+	FillOpType type;
+	uint32_t color;
+	uint32_t color2;	/* gradient end, second checker colour */
+	int cell;
+	const FillSurface* src;	/* FILL_OP_BLIT */
+} FillOp;
+
+/* Rows [y0, y1) of op applied to the whole of dst. */
+void fillRows(const FillSurface* dst, const FillOp* op, int y0, int y1);
+/*
+ * Only [x0, x1) x [y0, y1) of op applied to the whole of dst, clipped to
+ * dst. YUV rects are widened to whole 2x2 chroma blocks.
+ */
+void fillRect(const FillSurface* dst, const FillOp* op, int x0, int y0, int x1, int y1);
+
+#endif
@@ -0,0 +1,230 @@
+/*
+ * fill_bench.cpp
+ * Checks every fill kernel set, the streaming ones included, against the
+ * scalar one, then reports the throughput of each operation per format.
+ *
+ * usage: fill_bench [width height stride iterations]
+ *        fill_bench -t [maxThreads frames]
+ * The second form fills 1080p, 4K and 8K RGBA frames on a fill pool of
+ * 1..maxThreads pinned threads and reports frames per second and latency.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fill.h"
+#include "fillpool.h"
+
+#define NUM_OPS		5
+
+static const char* opNames[NUM_OPS] = { "solid", "hgradient", "vgradient", "checker", "blit" };
+
+static FillSurface source;
+
+static void runOp(int op, const FillSurface* dst)
+{
+	switch(op) {
+	case 0: fillSolid(dst, FILL_RGBA(255, 0, 0, 255)); break;
+	case 1: fillGradient(dst, FILL_RGBA(255, 0, 0, 255), FILL_RGBA(0, 64, 255, 128), false); break;
+	case 2: fillGradient(dst, FILL_RGBA(0, 255, 0, 255), FILL_RGBA(200, 0, 50, 0), true); break;
+	case 3: fillChecker(dst, FILL_RGBA(255, 255, 255, 255), FILL_RGBA(30, 60, 90, 255), 32); break;
+	case 4: fillBlit(dst, &source); break;
+	}
+}
+
+/* The byte-per-channel loop red_layer used to run, for reference. */
+static void legacyFill(const FillSurface* dst)
+{
+	char* vaddr = (char*)dst->bits;
+	for(int i=0; i<dst->height; i++) {
+		for(int j=0; j<dst->width; j++) {
+			vaddr[i*dst->stride*4 + j*4 + 0] = 255;
+			vaddr[i*dst->stride*4 + j*4 + 1] = 0;
+			vaddr[i*dst->stride*4 + j*4 + 2] = 0;
+			vaddr[i*dst->stride*4 + j*4 + 3] = 255;
+		}
+	}
+}
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+/* Bytes an operation writes: the visible pixels, not the stride padding. */
+static double bytesWritten(const FillSurface* s)
+{
+	switch(s->format) {
+	case FILL_RGBA8888:
+	case FILL_RGBX8888:	return 4.0*s->width*s->height;
+	case FILL_RGB565:	return 2.0*s->width*s->height;
+	default:		return 1.5*s->width*s->height;
+	}
+}
+
+static void* allocSurface(FillSurface* s, int width, int height, int stride, FillFormat format)
+{
+	s->width = width;
+	s->height = height;
+	s->stride = stride;
+	s->format = format;
+	void* bits = NULL;
+	if(posix_memalign(&bits, 64, fillSurfaceSize(s)) != 0) {
+		return NULL;
+	}
+	s->bits = bits;
+	return bits;
+}
+
+/* Odd sizes and padded strides so the tails and the padding get checked too. */
+static bool verify(const FillKernels* scalar, const FillKernels* kernels)
+{
+	static const int sizes[][3] = { { 333, 101, 352 }, { 64, 64, 64 }, { 7, 3, 16 }, { 1, 1, 16 } };
+	bool ok = true;
+	for(unsigned sz=0; sz<sizeof(sizes)/sizeof(sizes[0]); sz++) {
+		FillSurface src;
+		allocSurface(&src, sizes[sz][0], sizes[sz][1], sizes[sz][2], FILL_RGBA8888);
+		uint32_t seed = 12345;
+		for(size_t i=0; i<fillSurfaceSize(&src)/4; i++) {
+			seed = seed*1103515245 + 12345;
+			((uint32_t*)src.bits)[i] = seed;
+		}
+		source = src;
+
+		for(int f=FILL_RGBA8888; f<=FILL_YV12; f++) {
+			FillSurface ref, out;
+			allocSurface(&ref, sizes[sz][0], sizes[sz][1], sizes[sz][2], (FillFormat)f);
+			allocSurface(&out, sizes[sz][0], sizes[sz][1], sizes[sz][2], (FillFormat)f);
+			for(int op=0; op<NUM_OPS; op++) {
+				memset(ref.bits, 0xcd, fillSurfaceSize(&ref));
+				memset(out.bits, 0xcd, fillSurfaceSize(&out));
+				fillSetKernels(scalar);
+				runOp(op, &ref);
+				fillSetKernels(kernels);
+				runOp(op, &out);
+				if(memcmp(ref.bits, out.bits, fillSurfaceSize(&ref)) != 0) {
+					printf("MISMATCH %s %s %s %dx%d stride %d\n", kernels->name, opNames[op],
+							fillFormatName((FillFormat)f), ref.width, ref.height, ref.stride);
+					ok = false;
+				}
+			}
+			free(ref.bits);
+			free(out.bits);
+		}
+		free(src.bits);
+	}
+	fillSetKernels(NULL);
+	return ok;
+}
+
+static int threadSweep(int maxThreads, int frames)
+{
+	static const int sizes[][2] = { { 1920, 1080 }, { 3840, 2160 }, { 7680, 4320 } };
+	static const FillOpType ops[] = { FILL_OP_SOLID, FILL_OP_HGRADIENT };
+	if(maxThreads > FILL_POOL_MAX_THREADS) {
+		maxThreads = FILL_POOL_MAX_THREADS;
+	}
+
+	printf("%-10s %-10s %7s %8s %8s %8s\n", "size", "op", "threads", "fps", "avg ms", "max ms");
+	for(unsigned sz=0; sz<sizeof(sizes)/sizeof(sizes[0]); sz++) {
+		FillSurface dst;
+		if(!allocSurface(&dst, sizes[sz][0], sizes[sz][1], sizes[sz][0], FILL_RGBA8888)) {
+			printf("cannot allocate %dx%d\n", sizes[sz][0], sizes[sz][1]);
+			return 1;
+		}
+		for(int threads=1; threads<=maxThreads; threads*=2) {
+			FillPool pool;
+			fillPoolStart(&pool, threads, true);
+			for(unsigned o=0; o<sizeof(ops)/sizeof(ops[0]); o++) {
+				FillOp op = { ops[o], FILL_RGBA(255, 0, 0, 255), FILL_RGBA(0, 0, 255, 255), 0, NULL };
+				fillPoolRun(&pool, &dst, &op);
+				double worst = 0;
+				double start = now();
+				for(int i=0; i<frames; i++) {
+					double t = now();
+					fillPoolRun(&pool, &dst, &op);
+					t = now() - t;
+					worst = t > worst ? t : worst;
+				}
+				double elapsed = now() - start;
+				char size[16];
+				snprintf(size, sizeof(size), "%dx%d", dst.width, dst.height);
+				printf("%-10s %-10s %7d %8.1f %8.3f %8.3f\n", size, opNames[ops[o]], pool.numThreads,
+						frames/elapsed, elapsed*1000/frames, worst*1000);
+			}
+			fillPoolStop(&pool);
+		}
+		free(dst.bits);
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if(argc > 1 && strcmp(argv[1], "-t") == 0) {
+		return threadSweep(argc > 2 ? atoi(argv[2]) : 8, argc > 3 ? atoi(argv[3]) : 60);
+	}
+
+	int width = argc > 1 ? atoi(argv[1]) : 1920;
+	int height = argc > 2 ? atoi(argv[2]) : 1080;
+	int stride = argc > 3 ? atoi(argv[3]) : 1920;
+	int iterations = argc > 4 ? atoi(argv[4]) : 100;
+	if(stride < width) {
+		stride = width;
+	}
+
+	const FillKernels* list[8];
+	int numKernels = fillKernelList(list, 8);
+	numKernels += fillStreamingKernelList(list + numKernels, 8 - numKernels);
+	bool ok = true;
+	for(int k=1; k<numKernels; k++) {
+		ok = verify(list[0], list[k]) && ok;
+	}
+	if(!ok) {
+		return 1;
+	}
+	printf("%d kernel sets verified against scalar\n", numKernels);
+
+	allocSurface(&source, width, height, stride, FILL_RGBA8888);
+	memset(source.bits, 0x5a, fillSurfaceSize(&source));
+
+	printf("%dx%d stride %d, %d iterations\n", width, height, stride, iterations);
+	printf("%-8s %-10s %-9s %8s %8s\n", "kernels", "op", "format", "GB/s", "ms");
+
+	FillSurface dst;
+	allocSurface(&dst, width, height, stride, FILL_RGBA8888);
+	legacyFill(&dst);
+	double start = now();
+	for(int i=0; i<iterations; i++) {
+		legacyFill(&dst);
+	}
+	double elapsed = now() - start;
+	printf("%-8s %-10s %-9s %8.2f %8.3f\n", "bytewise", "solid", "RGBA8888",
+			bytesWritten(&dst)*iterations/elapsed/1e9, elapsed*1000/iterations);
+	free(dst.bits);
+
+	for(int k=0; k<numKernels; k++) {
+		fillSetKernels(list[k]);
+		for(int f=FILL_RGBA8888; f<=FILL_YV12; f++) {
+			allocSurface(&dst, width, height, stride, (FillFormat)f);
+			for(int op=0; op<NUM_OPS; op++) {
+				runOp(op, &dst);
+				start = now();
+				for(int i=0; i<iterations; i++) {
+					runOp(op, &dst);
+				}
+				elapsed = now() - start;
+				printf("%-8s %-10s %-9s %8.2f %8.3f\n", list[k]->name, opNames[op], fillFormatName((FillFormat)f),
+						bytesWritten(&dst)*iterations/elapsed/1e9, elapsed*1000/iterations);
+			}
+			free(dst.bits);
+		}
+	}
+	fillSetKernels(NULL);
+	free(source.bits);
+	return 0;
+}
@@ -0,0 +1,253 @@
+/*
+ * fillpool.cpp
+ * Persistent worker threads that fill one surface in row bands.
+ */
+
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "fillpool.h"
+
+#define ALIGN(x, a)	(((x) + (a) - 1) & ~((a) - 1))
+
+/* Bands per thread, so faster cores can take more of the frame. */
+#define BANDS_PER_THREAD	4
+#define MIN_BAND_ROWS		16
+
+/* Relative speed of a CPU, 0 when sysfs does not say. */
+static long cpuSpeed(int cpu)
+{
+	static const char* files[] = {
+		"/sys/devices/system/cpu/cpu%d/cpu_capacity",
+		"/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq",
+	};
+	for(unsigned i=0; i<sizeof(files)/sizeof(files[0]); i++) {
+		char path[128];
+		snprintf(path, sizeof(path), files[i], cpu);
+		FILE* fp = fopen(path, "r");
+		if(!fp) {
+			continue;
+		}
+		long value = 0;
+		int n = fscanf(fp, "%ld", &value);
+		fclose(fp);
+		if(n == 1) {
+			return value;
+		}
+	}
+	return 0;
+}
+
+/* Fastest CPUs first, ties in CPU order. */
+static int fastestCpus(int* cpus, int max)
+{
+	long speeds[CPU_SETSIZE];
+	int order[CPU_SETSIZE];
+	int numCpus = sysconf(_SC_NPROCESSORS_CONF);
+	if(numCpus > CPU_SETSIZE) {
+		numCpus = CPU_SETSIZE;
+	}
+	for(int i=0; i<numCpus; i++) {
+		speeds[i] = cpuSpeed(i);
+		order[i] = i;
+	}
+	for(int i=1; i<numCpus; i++) {
+		for(int j=i; j>0 && speeds[order[j]] > speeds[order[j - 1]]; j--) {
+			int t = order[j];
+			order[j] = order[j - 1];
+			order[j - 1] = t;
+		}
+	}
+	int n = numCpus < max ? numCpus : max;
+	for(int i=0; i<n; i++) {
+		cpus[i] = order[i];
+	}
+	return n;
+}
+
+static void pinToCpu(int cpu)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if(sched_setaffinity(0, sizeof(set), &set) != 0) {
+		printf("fillPool: cannot pin to cpu %d\n", cpu);
+	}
+}
+
+/* Rows [y0, y1) of every rect, in order. */
+static void fillBand(const FillSurface* dst, const FillPoolRect* rects, int numRects, int y0, int y1)
+{
+	for(int i=0; i<numRects; i++) {
+		const FillPoolRect* r = &rects[i];
+		int top = r->y0 > y0 ? r->y0 : y0;
+		int bottom = r->y1 < y1 ? r->y1 : y1;
+		if(top < bottom) {
+			fillRect(dst, r->op, r->x0, top, r->x1, bottom);
+		}
+	}
+}
+
+static void runBands(FillPool* pool)
+{
+	for(;;) {
+		int band = __atomic_fetch_add(&pool->nextBand, 1, __ATOMIC_RELAXED);
+		if(band >= pool->numBands) {
+			break;
+		}
+		int y0 = pool->y0 + band*pool->bandRows;
+		int y1 = y0 + pool->bandRows < pool->y1 ? y0 + pool->bandRows : pool->y1;
+		fillBand(pool->dst, pool->rects, pool->numRects, y0, y1);
+	}
+}
+
+static void* fillPoolThread(void* data)
+{
+	FillPoolWorker* args = (FillPoolWorker*)data;
+	FillPool* pool = args->pool;
+	if(pool->cpus[args->index] >= 0) {
+		pinToCpu(pool->cpus[args->index]);
+	}
+
+	int seen = 0;
+	for(;;) {
+		pthread_mutex_lock(&pool->lock);
+		while(!pool->quit && pool->generation == seen) {
+			pthread_cond_wait(&pool->startCond, &pool->lock);
+		}
+		if(pool->quit) {
+			pthread_mutex_unlock(&pool->lock);
+			break;
+		}
+		seen = pool->generation;
+		pthread_mutex_unlock(&pool->lock);
+
+		runBands(pool);
+
+		pthread_mutex_lock(&pool->lock);
+		if(--pool->running == 0) {
+			pthread_cond_signal(&pool->doneCond);
+		}
+		pthread_mutex_unlock(&pool->lock);
+	}
+	return NULL;
+}
+
+bool fillPoolStart(FillPool* pool, int numThreads, bool pin)
+{
+	memset(pool, 0, sizeof(*pool));
+	if(numThreads < 1 || numThreads > FILL_POOL_MAX_THREADS) {
+		return false;
+	}
+	for(int i=0; i<FILL_POOL_MAX_THREADS; i++) {
+		pool->cpus[i] = -1;
+	}
+	if(pin) {
+		int cpus[FILL_POOL_MAX_THREADS];
+		int n = fastestCpus(cpus, numThreads);
+		for(int i=0; i<numThreads && n > 0; i++) {
+			pool->cpus[i] = cpus[i % n];
+		}
+	}
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->startCond, NULL);
+	pthread_cond_init(&pool->doneCond, NULL);
+
+	/* the caller is thread 0 */
+	pool->numThreads = 1;
+	if(pool->cpus[0] >= 0) {
+		pinToCpu(pool->cpus[0]);
+	}
+	for(int i=1; i<numThreads; i++) {
+		pool->workers[i].pool = pool;
+		pool->workers[i].index = i;
+		if(pthread_create(&pool->threads[i], NULL, fillPoolThread, &pool->workers[i]) != 0) {
+			printf("fillPoolStart: pthread_create failed, running with %d threads\n", i);
+			break;
+		}
+		pool->numThreads++;
+	}
+	return true;
+}
+
+void fillPoolStop(FillPool* pool)
+{
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = true;
+	pthread_cond_broadcast(&pool->startCond);
+	pthread_mutex_unlock(&pool->lock);
+	for(int i=1; i<pool->numThreads; i++) {
+		pthread_join(pool->threads[i], NULL);
+	}
+	pthread_cond_destroy(&pool->doneCond);
+	pthread_cond_destroy(&pool->startCond);
+	pthread_mutex_destroy(&pool->lock);
+	pool->numThreads = 0;
+}
+
+void fillPoolRun(FillPool* pool, const FillSurface* dst, const FillOp* op)
+{
+	fillPoolRunRect(pool, dst, op, 0, 0, dst->width, dst->height);
+}
+
+void fillPoolRunRect(FillPool* pool, const FillSurface* dst, const FillOp* op, int x0, int y0, int x1, int y1)
+{
+	FillPoolRect rect = { op, x0, y0, x1, y1 };
+	fillPoolRunRects(pool, dst, &rect, 1);
+}
+
+void fillPoolRunRects(FillPool* pool, const FillSurface* dst, const FillPoolRect* rects, int numRects)
+{
+	int y0 = dst->height;
+	int y1 = 0;
+	for(int i=0; i<numRects; i++) {
+		if(rects[i].x0 < rects[i].x1 && rects[i].y0 < rects[i].y1) {
+			y0 = rects[i].y0 < y0 ? rects[i].y0 : y0;
+			y1 = rects[i].y1 > y1 ? rects[i].y1 : y1;
+		}
+	}
+	/*
+	 * Bands start on even rows so YUV chroma pairs stay inside one band;
+	 * fillBand() clips to each rect, so nothing above a rect is written.
+	 */
+	y0 = y0 < 0 ? 0 : y0 & ~1;
+	y1 = y1 < dst->height ? y1 : dst->height;
+	if(y0 >= y1) {
+		return;
+	}
+	int bands = pool->numThreads*BANDS_PER_THREAD;
+	int rows = ALIGN((y1 - y0 + bands - 1)/bands, 2);
+	if(rows < MIN_BAND_ROWS) {
+		rows = MIN_BAND_ROWS;
+	}
+
+	if(pool->numThreads == 1 || rows >= y1 - y0) {
+		fillBand(dst, rects, numRects, y0, y1);
+		return;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->dst = dst;
+	pool->rects = rects;
+	pool->numRects = numRects;
+	pool->y0 = y0;
+	pool->y1 = y1;
+	pool->bandRows = rows;
+	pool->numBands = (y1 - y0 + rows - 1)/rows;
+	pool->nextBand = 0;
+	pool->running = pool->numThreads - 1;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->startCond);
+	pthread_mutex_unlock(&pool->lock);
+
+	runBands(pool);
+
+	/* the one synchronisation point of the frame */
+	pthread_mutex_lock(&pool->lock);
+	while(pool->running > 0) {
+		pthread_cond_wait(&pool->doneCond, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,75 @@
+/*
+ * fillpool.h
+ * Persistent worker threads that fill one surface in row bands, so 4K and
+ * 8K buffers can be produced at display rate.
+ */
+
+#ifndef FILLPOOL_H
+#define FILLPOOL_H
+
+#include <pthread.h>
+
+#include "fill.h"
+
+#define FILL_POOL_MAX_THREADS	16
+
+typedef struct FillPool FillPool;
+
+/* One op over [x0, x1) x [y0, y1) of the surface, as fillRect(). */
+typedef struct {
+	const FillOp* op;
+	int x0, y0, x1, y1;
+} FillPoolRect;
+
+typedef struct {
+	FillPool* pool;
+	int index;
+} FillPoolWorker;
+
+struct FillPool {
+	int numThreads;			/* including the caller of fillPoolRun() */
+	pthread_t threads[FILL_POOL_MAX_THREADS];
+	int cpus[FILL_POOL_MAX_THREADS];	/* -1 when not pinned */
+	FillPoolWorker workers[FILL_POOL_MAX_THREADS];
+
+	pthread_mutex_t lock;
+	pthread_cond_t startCond;
+	pthread_cond_t doneCond;
+	int generation;			/* bumped for every frame */
+	int running;			/* workers still busy on the current frame */
+	bool quit;
+
+	/* the current frame */
+	const FillSurface* dst;
+	const FillPoolRect* rects;
+	int numRects;
+	int y0, y1;			/* rows the bands cover */
+	int bandRows;
+	int numBands;
+	int nextBand;			/* claimed with atomics */
+};
+
+/*
+ * Starts numThreads - 1 workers; the caller of fillPoolRun() is the last
+ * thread. With pin every thread, the caller included, is bound to one of
+ * the fastest CPUs by cpu_capacity or max frequency, so on big.LITTLE the
+ * work lands on the big cores first.
+ */
+bool fillPoolStart(FillPool* pool, int numThreads, bool pin);
+void fillPoolStop(FillPool* pool);
+
+/*
+ * Fills the whole of dst with op. Bands are handed out dynamically, so a
+ * slow core takes fewer of them; returns once every band is written.
+ */
+void fillPoolRun(FillPool* pool, const FillSurface* dst, const FillOp* op);
+/* The same for [x0, x1) x [y0, y1) of dst only, as fillRect(). */
+void fillPoolRunRect(FillPool* pool, const FillSurface* dst, const FillOp* op, int x0, int y0, int x1, int y1);
+/*
+ * Every rect of a frame in one job, so the frame has one synchronisation
+ * point however many rects it has. Rects are applied in order within each
+ * band, so a later rect draws over an earlier one where they overlap.
+ */
+void fillPoolRunRects(FillPool* pool, const FillSurface* dst, const FillPoolRect* rects, int numRects);
+
+#endif
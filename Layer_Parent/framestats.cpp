@@ -0,0 +1,128 @@
+/*
+ * framestats.cpp
+ * Per-frame producer timestamps and a dequeue-to-present latency histogram.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "framestats.h"
+
+/* Polls before a pending frame is given up on. */
+#define MAX_POLLS	64
+
+void frameStatsInit(FrameStats* stats, int64_t now)
+{
+	memset(stats, 0, sizeof(*stats));
+	stats->start = now;
+}
+
+static void addLatency(FrameStats* stats, const FrameTimes* t, int64_t present)
+{
+	int bucket = (int)((present - t->dequeueStart)/1000000);
+	bucket = bucket < 0 ? 0 : bucket;
+	bucket = bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+	stats->histogram[bucket]++;
+	stats->queueToPresent += present - t->queued;
+	stats->presented++;
+	if(stats->period > 0 && stats->lastPresent > 0) {
+		/* a gap of n periods means n - 1 refreshes showed the previous frame again */
+		int64_t gap = (present - stats->lastPresent + stats->period/2)/stats->period;
+		stats->dropped += gap > 1 ? (int)(gap - 1) : 0;
+	}
+	stats->lastPresent = present > stats->lastPresent ? present : stats->lastPresent;
+}
+
+void frameStatsAdd(FrameStats* stats, const FrameTimes* times)
+{
+	stats->dequeueWait += times->dequeued - times->dequeueStart;
+	stats->fenceWait += times->locked - times->dequeued;
+	stats->fill += times->filled - times->locked;
+	stats->queue += times->queued - times->filled;
+	stats->frames++;
+
+	if(stats->numPending == FRAME_STATS_PENDING) {
+		/* the consumer is not reporting, drop the oldest */
+		memmove(&stats->pending[0], &stats->pending[1], sizeof(FrameTimes)*(FRAME_STATS_PENDING - 1));
+		stats->numPending--;
+		stats->lost++;
+	}
+	stats->pending[stats->numPending] = *times;
+	stats->pending[stats->numPending].polls = 0;
+	stats->numPending++;
+}
+
+void frameStatsCollect(FrameStats* stats, PresentTimeFunc presentTime, void* user)
+{
+	int kept = 0;
+	for(int i=0; i<stats->numPending; i++) {
+		FrameTimes* t = &stats->pending[i];
+		int64_t present = 0;
+		int status = presentTime(user, t->id, &present);
+		if(status > 0) {
+			addLatency(stats, t, present);
+		} else if(status < 0 || ++t->polls >= MAX_POLLS) {
+			stats->lost++;
+		} else {
+			stats->pending[kept++] = *t;
+		}
+	}
+	stats->numPending = kept;
+}
+
+int frameStatsPercentile(const FrameStats* stats, double fraction)
+{
+	int target = (int)(stats->presented*fraction);
+	int seen = 0;
+	for(int i=0; i<LATENCY_BUCKETS; i++) {
+		seen += stats->histogram[i];
+		if(seen > target) {
+			return i + 1;
+		}
+	}
+	return LATENCY_BUCKETS;
+}
+
+void frameStatsPrint(FrameStats* stats, int64_t now)
+{
+	int frames = stats->frames > 0 ? stats->frames : 1;
+	printf("%d frames, %.1f fps: dequeue %.3f ms, fence %.3f ms, fill %.3f ms, queue %.3f ms\n",
+			stats->frames, stats->frames*1e9/(now - stats->start), stats->dequeueWait/frames/1e6,
+			stats->fenceWait/frames/1e6, stats->fill/frames/1e6, stats->queue/frames/1e6);
+
+	if(stats->presented > 0) {
+		printf("dequeue to present: p50 < %d ms, p90 < %d ms, p99 < %d ms; queue to present %.3f ms avg; %d without present time\n",
+				frameStatsPercentile(stats, 0.5), frameStatsPercentile(stats, 0.9), frameStatsPercentile(stats, 0.99),
+				stats->queueToPresent/stats->presented/1e6, stats->lost);
+		if(stats->period > 0) {
+			printf("%d refreshes dropped at %.1f fps\n", stats->dropped, 1e9/stats->period);
+		}
+		int peak = 1;
+		for(int i=0; i<LATENCY_BUCKETS; i++) {
+			peak = stats->histogram[i] > peak ? stats->histogram[i] : peak;
+		}
+		for(int i=0; i<LATENCY_BUCKETS; i++) {
+			if(stats->histogram[i] == 0) {
+				continue;
+			}
+			char bar[41];
+			int n = stats->histogram[i]*40/peak;
+			memset(bar, '#', n);
+			bar[n] = '\0';
+			printf("  %s%2d ms %5d %s\n", i == LATENCY_BUCKETS - 1 ? ">=" : "  ", i, stats->histogram[i], bar);
+		}
+	} else {
+		printf("no present times yet, %d lost\n", stats->lost);
+	}
+
+	int numPending = stats->numPending;
+	FrameTimes pending[FRAME_STATS_PENDING];
+	memcpy(pending, stats->pending, sizeof(FrameTimes)*numPending);
+	int64_t period = stats->period;
+	int64_t lastPresent = stats->lastPresent;
+	frameStatsInit(stats, now);
+	memcpy(stats->pending, pending, sizeof(FrameTimes)*numPending);
+	stats->numPending = numPending;
+	stats->period = period;
+	stats->lastPresent = lastPresent;
+}
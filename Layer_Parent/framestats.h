@@ -0,0 +1,64 @@
+/*
+ * framestats.h
+ * Per-frame producer timestamps and a dequeue-to-present latency histogram.
+ */
+
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+#include <stdint.h>
+
+/* Frames waiting for their present time. */
+#define FRAME_STATS_PENDING	32
+/* 1 ms buckets; the last one also counts everything slower. */
+#define LATENCY_BUCKETS		100
+
+/* All in systemTime() nanoseconds. */
+typedef struct {
+	uint64_t id;			/* native_window_get_next_frame_id() */
+	int64_t dequeueStart;
+	int64_t dequeued;		/* dequeueBuffer returned */
+	int64_t locked;			/* acquire fence signalled, buffer mapped */
+	int64_t filled;
+	int64_t queued;			/* queueBuffer returned */
+	int polls;
+} FrameTimes;
+
+/*
+ * Asks the consumer when frame id reached the display. Returns 1 with
+ * *present set, 0 while not known yet, -1 if it never will be.
+ */
+typedef int (*PresentTimeFunc)(void* user, uint64_t id, int64_t* present);
+
+typedef struct {
+	FrameTimes pending[FRAME_STATS_PENDING];
+	int numPending;
+
+	/* since the last frameStatsPrint() */
+	int histogram[LATENCY_BUCKETS];
+	int presented;
+	int lost;			/* no present time, or evicted while pending */
+	int frames;
+	int64_t dequeueWait;
+	int64_t fenceWait;
+	int64_t fill;
+	int64_t queue;
+	int64_t queueToPresent;
+	int64_t start;
+
+	/* kept across frameStatsPrint() */
+	int64_t period;			/* target frame interval, 0 when not paced */
+	int64_t lastPresent;
+	int dropped;			/* refreshes skipped between consecutive presents */
+} FrameStats;
+
+void frameStatsInit(FrameStats* stats, int64_t now);
+void frameStatsAdd(FrameStats* stats, const FrameTimes* times);
+/* Moves every frame whose present time is now known into the histogram. */
+void frameStatsCollect(FrameStats* stats, PresentTimeFunc presentTime, void* user);
+/* Prints the phase averages, latency percentiles and histogram, then resets. */
+void frameStatsPrint(FrameStats* stats, int64_t now);
+/* Dequeue to present latency in ms below which fraction of the presented frames fall. */
+int frameStatsPercentile(const FrameStats* stats, double fraction);
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ * producer.cpp
+ * What red_layer draws into each buffer.
+ */
+
+#include <string.h>
+
+#include "producer.h"
+
+bool producerInit(Producer* producer, FillPool* pool, const char* mode, int width, int height)
+{
+	memset(producer, 0, sizeof(*producer));
+	producer->pool = pool;
+	producer->width = width;
+	producer->height = height;
+	damageTrackerInit(&producer->damage, width, height);
+
+	FillOp background = { FILL_OP_SOLID, FILL_RGBA(255, 0, 0, 255), FILL_RGBA(0, 0, 255, 255), 64, NULL };
+	FillOp box = { FILL_OP_SOLID, FILL_RGBA(255, 255, 255, 255), 0, 0, NULL };
+	producer->boxOp = box;
+	if(strcmp(mode, "gradient") == 0) {
+		background.type = FILL_OP_HGRADIENT;
+	} else if(strcmp(mode, "checker") == 0) {
+		background.type = FILL_OP_CHECKER;
+		background.color2 = FILL_RGBA(255, 255, 255, 255);
+	} else if(strcmp(mode, "box") == 0 || strcmp(mode, "boxfull") == 0) {
+		background.type = FILL_OP_HGRADIENT;
+		producer->box = true;
+		producer->fullRedraw = strcmp(mode, "boxfull") == 0;
+	} else if(strcmp(mode, "solid") != 0) {
+		return false;
+	}
+	producer->background = background;
+	return true;
+}
+
+/* Bounces back and forth along the diagonal. */
+static DamageRect boxRect(const Producer* producer, int frame)
+{
+	int rangeX = producer->width > BOX_SIZE ? producer->width - BOX_SIZE : 1;
+	int rangeY = producer->height > BOX_SIZE ? producer->height - BOX_SIZE : 1;
+	int x = (frame*BOX_SPEED) % (2*rangeX);
+	int y = (frame*BOX_SPEED) % (2*rangeY);
+	x = x < rangeX ? x : 2*rangeX - x;
+	y = y < rangeY ? y : 2*rangeY - y;
+	DamageRect r = { x, y, x + BOX_SIZE, y + BOX_SIZE };
+	return r;
+}
+
+void producerBeginFrame(Producer* producer, int age, DamageRegion* repaint, DamageRegion* surfaceDamage)
+{
+	damageClear(&producer->current);
+	if(producer->box && producer->frame > 0) {
+		DamageRect before = boxRect(producer, producer->frame - 1);
+		DamageRect now = boxRect(producer, producer->frame);
+		damageAdd(&producer->current, &before);
+		damageAdd(&producer->current, &now);
+	} else {
+		/* the first frame, or content that changes everywhere */
+		DamageRect all = { 0, 0, producer->width, producer->height };
+		damageAdd(&producer->current, &all);
+	}
+	damageRepaint(&producer->damage, producer->fullRedraw ? 0 : age, &producer->current, repaint);
+	*surfaceDamage = producer->current;
+}
+
+void producerDraw(Producer* producer, const FillSurface* dst, const DamageRegion* repaint)
+{
+	/* every background rect, then the box over them, in one pool job */
+	FillPoolRect rects[2*DAMAGE_MAX_RECTS];
+	int numRects = 0;
+	for(int i=0; i<repaint->numRects; i++) {
+		const DamageRect* r = &repaint->rects[i];
+		FillPoolRect background = { &producer->background, r->left, r->top, r->right, r->bottom };
+		rects[numRects++] = background;
+	}
+	DamageRect box = boxRect(producer, producer->frame);
+	for(int i=0; producer->box && i<repaint->numRects; i++) {
+		const DamageRect* r = &repaint->rects[i];
+		int left = r->left > box.left ? r->left : box.left;
+		int top = r->top > box.top ? r->top : box.top;
+		int right = r->right < box.right ? r->right : box.right;
+		int bottom = r->bottom < box.bottom ? r->bottom : box.bottom;
+		if(left < right && top < bottom) {
+			FillPoolRect part = { &producer->boxOp, left, top, right, bottom };
+			rects[numRects++] = part;
+		}
+	}
+	fillPoolRunRects(producer->pool, dst, rects, numRects);
+}
+
+void producerEndFrame(Producer* producer)
+{
+	damagePush(&producer->damage, &producer->current);
+	producer->frame++;
+}
@@ -0,0 +1,46 @@
+/*
+ * producer.h
+ * What red_layer draws into each buffer, kept apart from the window code so
+ * it only depends on the fill engine.
+ */
+
+#ifndef PRODUCER_H
+#define PRODUCER_H
+
+#include "damage.h"
+#include "fill.h"
+#include "fillpool.h"
+
+#define BOX_SIZE	128
+#define BOX_SPEED	8	/* pixels per frame */
+
+typedef struct {
+	FillPool* pool;
+	FillOp background;
+	/* a box bouncing over a static background, the mostly static layer case */
+	bool box;
+	FillOp boxOp;
+	/* ignore buffer age and redraw everything, the baseline for box */
+	bool fullRedraw;
+
+	int width;
+	int height;
+	DamageTracker damage;
+	DamageRegion current;		/* what changed in this frame */
+	int frame;
+} Producer;
+
+/* mode: solid, gradient, checker, box or boxfull. Returns false for anything else. */
+bool producerInit(Producer* producer, FillPool* pool, const char* mode, int width, int height);
+
+/*
+ * Starts the next frame for a buffer of the given age: fills repaint with
+ * what must be written into it and surfaceDamage with what changed on
+ * screen since the previous frame.
+ */
+void producerBeginFrame(Producer* producer, int age, DamageRegion* repaint, DamageRegion* surfaceDamage);
+void producerDraw(Producer* producer, const FillSurface* dst, const DamageRegion* repaint);
+/* Call once the buffer is queued. */
+void producerEndFrame(Producer* producer);
+
+#endif
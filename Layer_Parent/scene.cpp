@@ -0,0 +1,140 @@
+/*
+ * scene.cpp
+ * A grid of layers whose position, size and matrix are animated together.
+ */
+
+#include <math.h>
+#include <stdio.h>
+
+#include <ui/GraphicBufferMapper.h>
+
+#include "fill.h"
+#include "scene.h"
+
+using namespace android;
+
+static const uint32_t sceneColors[] = {
+	FILL_RGBA(255, 0, 0, 255),
+	FILL_RGBA(0, 255, 0, 255),
+	FILL_RGBA(0, 0, 255, 255),
+	FILL_RGBA(255, 255, 0, 255),
+	FILL_RGBA(0, 255, 255, 255),
+	FILL_RGBA(255, 0, 255, 255),
+};
+
+bool sceneQueueSolid(ANativeWindow* window, uint32_t color)
+{
+	ANativeWindowBuffer* buffer;
+	int fenceFd = -1;
+	if(native_window_api_connect(window, NATIVE_WINDOW_API_CPU) != 0) {
+		return false;
+	}
+	if(window->dequeueBuffer(window, &buffer, &fenceFd) != 0) {
+		return false;
+	}
+	char* vaddr = NULL;
+	/* lockAsync takes the fence whether or not it succeeds */
+	if(GraphicBufferMapper::get().lockAsync(buffer->handle, 0x00000030,
+			Rect(0, 0, buffer->width, buffer->height), (void**)&vaddr, fenceFd) != NO_ERROR || !vaddr) {
+		window->cancelBuffer(window, buffer, -1);
+		return false;
+	}
+	FillSurface dst = { vaddr, buffer->width, buffer->height, buffer->stride, FILL_RGBA8888 };
+	fillSolid(&dst, color);
+	int releaseFd = -1;
+	GraphicBufferMapper::get().unlockAsync(buffer->handle, &releaseFd);
+	return window->queueBuffer(window, buffer, releaseFd) == 0;
+}
+
+bool sceneCreate(Scene* scene, const sp<SurfaceComposerClient>& client, int n, int width, int height)
+{
+	if(n < 1 || n > SCENE_MAX_LAYERS) {
+		return false;
+	}
+	int columns = (int)ceil(sqrt((double)n));
+	int rows = (n + columns - 1)/columns;
+	int cellWidth = width/columns;
+	int cellHeight = height/rows;
+
+	SurfaceComposerClient::Transaction t;
+	scene->numLayers = 0;
+	scene->frame = 0;
+	for(int i=0; i<n; i++) {
+		SceneLayer* layer = &scene->layers[i];
+		char name[32];
+		snprintf(name, sizeof(name), "scene_%d", i);
+		/* half a cell, so a layer can grow into its cell without covering the next one */
+		layer->width = cellWidth/2;
+		layer->height = cellHeight/2;
+		layer->x = (i % columns)*cellWidth;
+		layer->y = (i/columns)*cellHeight;
+		layer->sc = client->createSurface(String8(name), layer->width, layer->height, HAL_PIXEL_FORMAT_RGBA_8888, 0);
+		if(layer->sc == NULL || !layer->sc->isValid()) {
+			printf("cannot create layer %d\n", i);
+			sceneDestroy(scene);
+			return false;
+		}
+		scene->numLayers++;
+		layer->surface = layer->sc->getSurface();
+		if(!sceneQueueSolid(layer->surface.get(), sceneColors[i % (sizeof(sceneColors)/sizeof(sceneColors[0]))])) {
+			printf("cannot draw layer %d\n", i);
+		}
+		t.setLayer(layer->sc, SCENE_BASE_Z + i)
+			.setPosition(layer->sc, layer->x, layer->y)
+			.setSize(layer->sc, layer->width, layer->height)
+			.show(layer->sc);
+	}
+	t.apply();
+	return true;
+}
+
+void sceneDestroy(Scene* scene)
+{
+	SurfaceComposerClient::Transaction t;
+	for(int i=0; i<scene->numLayers; i++) {
+		t.hide(scene->layers[i].sc);
+	}
+	t.apply();
+	for(int i=0; i<scene->numLayers; i++) {
+		native_window_api_disconnect(scene->layers[i].surface.get(), NATIVE_WINDOW_API_CPU);
+		scene->layers[i].surface = NULL;
+		scene->layers[i].sc = NULL;
+	}
+	scene->numLayers = 0;
+}
+
+/* 0 -> 1 -> 0 over two swings, each layer a little behind the previous one. */
+static float sceneProgress(const Scene* scene, int layer)
+{
+	int f = (scene->frame + layer*4) % (2*SCENE_ANIMATION_COUNT);
+	return f < SCENE_ANIMATION_COUNT ? (float)f/SCENE_ANIMATION_COUNT : (float)(2*SCENE_ANIMATION_COUNT - f)/SCENE_ANIMATION_COUNT;
+}
+
+void sceneFrame(Scene* scene, SurfaceComposerClient::Transaction& t)
+{
+	for(int i=0; i<scene->numLayers; i++) {
+		SceneLayer* layer = &scene->layers[i];
+		float p = sceneProgress(scene, i);
+		float ratio = 1.0f + p;
+		t.setPosition(layer->sc, layer->x + p*layer->width/2, layer->y + p*layer->height/2)
+			.setSize(layer->sc, layer->width + (int)(p*layer->width/2), layer->height + (int)(p*layer->height/2))
+			.setMatrix(layer->sc, ratio, 0.0f, 0.0f, ratio);
+	}
+	scene->frame++;
+}
+
+int sceneFrameUnbatched(Scene* scene)
+{
+	for(int i=0; i<scene->numLayers; i++) {
+		SceneLayer* layer = &scene->layers[i];
+		float p = sceneProgress(scene, i);
+		float ratio = 1.0f + p;
+		SurfaceComposerClient::Transaction().setPosition(layer->sc, layer->x + p*layer->width/2,
+				layer->y + p*layer->height/2).apply();
+		SurfaceComposerClient::Transaction().setSize(layer->sc, layer->width + (int)(p*layer->width/2),
+				layer->height + (int)(p*layer->height/2)).apply();
+		SurfaceComposerClient::Transaction().setMatrix(layer->sc, ratio, 0.0f, 0.0f, ratio).apply();
+	}
+	scene->frame++;
+	return 3*scene->numLayers;
+}
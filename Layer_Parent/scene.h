@@ -0,0 +1,50 @@
+/*
+ * scene.h
+ * A grid of layers whose position, size and matrix are animated together,
+ * every change of a frame batched into one transaction.
+ */
+
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <gui/Surface.h>
+#include <gui/SurfaceComposerClient.h>
+
+#define SCENE_MAX_LAYERS	64
+/* The first layer's z, above the launcher like red_layer's. */
+#define SCENE_BASE_Z		31100
+/* Frames of one zoom in / out swing, as in the sideband animation. */
+#define SCENE_ANIMATION_COUNT	60
+
+typedef struct {
+	android::sp<android::SurfaceControl> sc;
+	android::sp<android::Surface> surface;
+	/* home cell and size */
+	float x;
+	float y;
+	int width;
+	int height;
+} SceneLayer;
+
+typedef struct {
+	SceneLayer layers[SCENE_MAX_LAYERS];
+	int numLayers;
+	int frame;
+} Scene;
+
+/* Connects as a CPU producer and queues one buffer of color, enough for a layer that only moves. */
+bool sceneQueueSolid(ANativeWindow* window, uint32_t color);
+
+/*
+ * Creates n layers tiled over width x height, each with one solid buffer
+ * queued, and shows them all with a single transaction.
+ */
+bool sceneCreate(Scene* scene, const android::sp<android::SurfaceComposerClient>& client, int n, int width, int height);
+void sceneDestroy(Scene* scene);
+
+/* Adds the position, size and matrix of every layer for the next frame to t. */
+void sceneFrame(Scene* scene, android::SurfaceComposerClient::Transaction& t);
+/* The same changes, one transaction per call as the old tools did; returns the count. */
+int sceneFrameUnbatched(Scene* scene);
+
+#endif
@@ -0,0 +1,129 @@
+/*
+ * scene_test.cpp
+ * Animates 1..maxLayers layers and reports how long applying a frame's
+ * layer changes takes, batched into one transaction per vsync against one
+ * transaction per change.
+ *
+ * usage: layer_scene [maxLayers] [frames] [refreshHz]
+ * Frames are paced on an absolute refreshHz timer standing in for vsync;
+ * a frame whose apply runs past the next tick is counted as late.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <binder/IPCThreadState.h>
+#include <binder/ProcessState.h>
+#include <utils/Timers.h>
+
+#include "scene.h"
+
+using namespace android;
+
+#define MAX_FRAMES	10000
+
+static int compareTimes(const void* a, const void* b)
+{
+	nsecs_t x = *(const nsecs_t*)a;
+	nsecs_t y = *(const nsecs_t*)b;
+	return x < y ? -1 : x > y;
+}
+
+static void sleepUntil(nsecs_t when)
+{
+	struct timespec ts;
+	ts.tv_sec = when/1000000000;
+	ts.tv_nsec = when % 1000000000;
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+	}
+}
+
+/* applies[] is sorted in place. */
+static void printRun(int layers, const char* mode, int frames, int transactions, int changes,
+		nsecs_t* applies, int late)
+{
+	nsecs_t total = 0;
+	for(int i=0; i<frames; i++) {
+		total += applies[i];
+	}
+	qsort(applies, frames, sizeof(nsecs_t), compareTimes);
+	printf("%6d %-9s %6.1f %8.3f %8.3f %8.3f %8.3f %10.0f %5d\n", layers, mode, (double)transactions/frames,
+			total/frames/1e6, applies[frames/2]/1e6, applies[frames*99/100]/1e6, applies[frames - 1]/1e6,
+			total > 0 ? changes*1e9/total : 0.0, late);
+}
+
+static void runScene(const sp<SurfaceComposerClient>& client, int layers, int frames, nsecs_t period,
+		nsecs_t* applies)
+{
+	Scene scene;
+	if(!sceneCreate(&scene, client, layers, 1920, 1080)) {
+		return;
+	}
+	for(int batched=1; batched>=0; batched--) {
+		int transactions = 0;
+		int changes = 0;
+		int late = 0;
+		nsecs_t vsync = systemTime() + period;
+		for(int f=0; f<frames; f++) {
+			sleepUntil(vsync);
+			nsecs_t start = systemTime();
+			if(batched) {
+				SurfaceComposerClient::Transaction t;
+				sceneFrame(&scene, t);
+				t.apply();
+				transactions++;
+				changes += 3*layers;
+			} else {
+				int n = sceneFrameUnbatched(&scene);
+				transactions += n;
+				changes += n;
+			}
+			nsecs_t end = systemTime();
+			applies[f] = end - start;
+			vsync += period;
+			if(end > vsync) {
+				late++;
+				/* skip the ticks that were missed, as a vsync callback would */
+				while(vsync < end) {
+					vsync += period;
+				}
+			}
+		}
+		printRun(layers, batched ? "batched" : "unbatched", frames, transactions, changes, applies, late);
+	}
+	sceneDestroy(&scene);
+}
+
+int main(int argc, char** argv)
+{
+	int maxLayers = argc > 1 ? atoi(argv[1]) : SCENE_MAX_LAYERS;
+	int frames = argc > 2 ? atoi(argv[2]) : 2*SCENE_ANIMATION_COUNT;
+	int refreshHz = argc > 3 ? atoi(argv[3]) : 60;
+	if(maxLayers < 1 || maxLayers > SCENE_MAX_LAYERS || frames < 1 || frames > MAX_FRAMES || refreshHz < 1) {
+		printf("usage: %s [maxLayers 1..%d] [frames 1..%d] [refreshHz]\n", argv[0], SCENE_MAX_LAYERS, MAX_FRAMES);
+		return 1;
+	}
+
+	sp<ProcessState> proc(ProcessState::self());
+	ProcessState::self()->startThreadPool();
+	sp<SurfaceComposerClient> client = new SurfaceComposerClient();
+	if(client->initCheck() != NO_ERROR) {
+		printf("cannot connect to SurfaceFlinger\n");
+		return 1;
+	}
+
+	static nsecs_t applies[MAX_FRAMES];
+	printf("%d frames at %d Hz, apply times in ms\n", frames, refreshHz);
+	printf("%6s %-9s %6s %8s %8s %8s %8s %10s %5s\n", "layers", "mode", "tx/f", "avg", "p50", "p99", "max",
+			"changes/s", "late");
+	for(int layers=1; layers<=maxLayers; layers*=2) {
+		runScene(client, layers, frames, 1000000000LL/refreshHz, applies);
+		if(layers < maxLayers && layers*2 > maxLayers) {
+			runScene(client, maxLayers, frames, 1000000000LL/refreshHz, applies);
+		}
+	}
+	return 0;
+}
@@ -1,5 +1,6 @@
 #include <cutils/memory.h>
 #include <utils/Log.h>
+#include <utils/Timers.h>
 
 #include <binder/IPCThreadState.h>
 #include <binder/ProcessState.h>
@@ -7,16 +8,585 @@
 
 #include <gui/Surface.h>
 #include <gui/SurfaceComposerClient.h>
+#include <hardware/gralloc.h>
 #include <ui/GraphicBufferMapper.h>
 #include<sys/mman.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fill.h"
+#include "fillpool.h"
+#include "framestats.h"
+#include "producer.h"
 //#include </home/flj/O-Android/Android/frameworks/native/libs/nativewindow/include/android/native_window.h>
 
 using namespace android;
 
+/* NV12 has no common HAL constant; vendors that use it map their own value here. */
+static bool toFillFormat(int halFormat, FillFormat* format)
+{
+	switch(halFormat) {
+	case HAL_PIXEL_FORMAT_RGBA_8888:	*format = FILL_RGBA8888; return true;
+	case HAL_PIXEL_FORMAT_RGBX_8888:	*format = FILL_RGBX8888; return true;
+	case HAL_PIXEL_FORMAT_RGB_565:		*format = FILL_RGB565; return true;
+	case HAL_PIXEL_FORMAT_YV12:		*format = FILL_YV12; return true;
+	default:				return false;
+	}
+}
+
+/* Fill statistics are printed every this many frames. */
+#define STATS_FRAMES	120
+
+/*
+ * Surface damage is given with a bottom-left origin; Surface flips it back
+ * against the buffer height in queueBuffer.
+ */
+static void setSurfaceDamage(ANativeWindow* window, const DamageRegion* damage, int height)
+{
+	android_native_rect_t rects[DAMAGE_MAX_RECTS];
+	for(int i=0; i<damage->numRects; i++) {
+		rects[i].left = damage->rects[i].left;
+		rects[i].right = damage->rects[i].right;
+		rects[i].top = height - damage->rects[i].top;
+		rects[i].bottom = height - damage->rects[i].bottom;
+	}
+	native_window_set_surface_damage(window, rects, damage->numRects);
+}
+
+/* The original loop: blocking deprecated dequeue / queue, one buffer at a time. */
+static void runSerial(ANativeWindow* window, Producer* producer, int maxFrames)
+{
+	ANativeWindowBuffer* outBuffer;
+	nsecs_t periodStart = systemTime();
+	nsecs_t fillTotal = 0;
+	nsecs_t fillMax = 0;
+	long pixels = 0;
+	int frames = 0;
+
+	for(int frame=0; maxFrames == 0 || frame < maxFrames; frame++) {
+		char* vaddr;
+		int status = window->dequeueBuffer_DEPRECATED(window, &outBuffer);
+
+		int age = 0;
+		window->query(window, NATIVE_WINDOW_BUFFER_AGE, &age);
+		DamageRegion repaint, surfaceDamage;
+		producerBeginFrame(producer, age, &repaint, &surfaceDamage);
+		DamageRect lockRect = damageBounds(&repaint);
+		GraphicBufferMapper::get().lock(outBuffer->handle, 0x00000030,
+				Rect(lockRect.left, lockRect.top, lockRect.right, lockRect.bottom), (void**)&vaddr);
+
+		FillSurface dst = { vaddr, outBuffer->width, outBuffer->height, outBuffer->stride, FILL_RGBA8888 };
+		if(!toFillFormat(outBuffer->format, &dst.format)) {
+			printf("unsupported buffer format %d\n", outBuffer->format);
+		} else {
+			nsecs_t start = systemTime();
+			producerDraw(producer, &dst, &repaint);
+			nsecs_t elapsed = systemTime() - start;
+			fillTotal += elapsed;
+			fillMax = elapsed > fillMax ? elapsed : fillMax;
+			pixels += damageArea(&repaint);
+		}
+		GraphicBufferMapper::get().unlock(outBuffer->handle);
+		setSurfaceDamage(window, &surfaceDamage, outBuffer->height);
+		status = window->queueBuffer_DEPRECATED(window, outBuffer);
+		producerEndFrame(producer);
+
+		if(++frames == STATS_FRAMES) {
+			nsecs_t now = systemTime();
+			printf("%dx%d %d threads: %.1f fps, fill %.3f ms avg %.3f ms max, %ld kpixels written per frame\n",
+					dst.width, dst.height, producer->pool->numThreads, frames*1e9/(now - periodStart),
+					fillTotal/frames/1e6, fillMax/1e6, pixels/frames/1000);
+			periodStart = now;
+			fillTotal = 0;
+			fillMax = 0;
+			pixels = 0;
+			frames = 0;
+		}
+	}
+}
+
+static int presentTime(void* user, uint64_t id, int64_t* present)
+{
+	ANativeWindow* window = (ANativeWindow*)user;
+	if(native_window_get_frame_timestamps(window, id, NULL, NULL, NULL, NULL, NULL, NULL, present, NULL, NULL) != 0) {
+		return -1;
+	}
+	if(*present == NATIVE_WINDOW_TIMESTAMP_PENDING) {
+		return 0;
+	}
+	return *present == NATIVE_WINDOW_TIMESTAMP_INVALID ? -1 : 1;
+}
+
+/*
+ * Fence based loop over a fixed number of buffers: dequeue returns as soon
+ * as a slot is free, the release fence is only waited on by lockAsync, and
+ * queueBuffer does not wait for the consumer, so buffer N+1 is filled while
+ * N is still on screen.
+ */
+static void runPipelined(ANativeWindow* window, Producer* producer, int buffers, int maxFrames)
+{
+	if(native_window_set_buffer_count(window, buffers) != 0) {
+		printf("cannot set %d buffers\n", buffers);
+	}
+	bool timestamps = native_window_enable_frame_timestamps(window, true) == 0;
+	if(!timestamps) {
+		printf("frame timestamps not supported, no present latency\n");
+	}
+
+	FrameStats stats;
+	frameStatsInit(&stats, systemTime());
+	for(int frame=0; maxFrames == 0 || frame < maxFrames; frame++) {
+		ANativeWindowBuffer* buffer;
+		FrameTimes t;
+		memset(&t, 0, sizeof(t));
+		int fenceFd = -1;
+
+		t.dequeueStart = systemTime();
+		if(window->dequeueBuffer(window, &buffer, &fenceFd) != 0) {
+			printf("dequeueBuffer failed\n");
+			break;
+		}
+		t.dequeued = systemTime();
+
+		int age = 0;
+		window->query(window, NATIVE_WINDOW_BUFFER_AGE, &age);
+		DamageRegion repaint, surfaceDamage;
+		producerBeginFrame(producer, age, &repaint, &surfaceDamage);
+		DamageRect lockRect = damageBounds(&repaint);
+		char* vaddr = NULL;
+		/* takes the fence, even on failure: waits for the consumer to release the buffer, then closes it */
+		if(GraphicBufferMapper::get().lockAsync(buffer->handle, 0x00000030,
+				Rect(lockRect.left, lockRect.top, lockRect.right, lockRect.bottom), (void**)&vaddr, fenceFd) != NO_ERROR || !vaddr) {
+			window->cancelBuffer(window, buffer, -1);
+			stats.lost++;
+			continue;
+		}
+		t.locked = systemTime();
+
+		FillSurface dst = { vaddr, buffer->width, buffer->height, buffer->stride, FILL_RGBA8888 };
+		if(toFillFormat(buffer->format, &dst.format)) {
+			producerDraw(producer, &dst, &repaint);
+		}
+		int releaseFd = -1;
+		GraphicBufferMapper::get().unlockAsync(buffer->handle, &releaseFd);
+		t.filled = systemTime();
+
+		setSurfaceDamage(window, &surfaceDamage, buffer->height);
+		if(timestamps) {
+			native_window_get_next_frame_id(window, &t.id);
+		}
+		window->queueBuffer(window, buffer, releaseFd);
+		t.queued = systemTime();
+		producerEndFrame(producer);
+
+		frameStatsAdd(&stats, &t);
+		if(timestamps) {
+			frameStatsCollect(&stats, presentTime, window);
+		}
+		if(stats.frames == STATS_FRAMES) {
+			printf("%dx%d, %d buffers, %d threads\n", dst.width, dst.height, buffers, producer->pool->numThreads);
+			frameStatsPrint(&stats, systemTime());
+		}
+	}
+}
+
+/*
+ * Allocation usage the producer negotiates and the usage each lock asks for.
+ * The producer never reads its buffers back, so SW_WRITE_OFTEN alone lets
+ * gralloc hand out write-combined / uncached memory that read bits would
+ * force to be cached.
+ */
+typedef struct {
+	const char* name;
+	uint64_t allocUsage;
+	uint32_t lockUsage;
+} UsageCase;
+
+static const UsageCase usageCases[] = {
+	{ "rw-often",	GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_SW_WRITE_OFTEN,
+			GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_SW_WRITE_OFTEN },
+	{ "rw/w-lock",	GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_SW_WRITE_OFTEN, GRALLOC_USAGE_SW_WRITE_OFTEN },
+	{ "w-often",	GRALLOC_USAGE_SW_WRITE_OFTEN, GRALLOC_USAGE_SW_WRITE_OFTEN },
+	{ "w-rarely",	GRALLOC_USAGE_SW_WRITE_RARELY, GRALLOC_USAGE_SW_WRITE_RARELY },
+};
+
+/* Frames after a usage change that reallocate the buffers, not timed. */
+#define USAGE_WARMUP_FRAMES	4
+
+/*
+ * Lock, full-frame fill and unlock cost for every usage case, once with the
+ * regular kernels and once with the streaming ones when the CPU has them.
+ */
+static void runUsageSweep(ANativeWindow* window, int frames)
+{
+	const FillKernels* streaming[4];
+	int numStreaming = fillStreamingKernelList(streaming, 4);
+	const FillKernels* kernels[2] = { NULL, numStreaming > 0 ? streaming[numStreaming - 1] : NULL };
+	if(frames <= 0) {
+		frames = STATS_FRAMES;
+	}
+
+	printf("%-10s %-8s %-8s %9s %9s %9s %8s\n", "usage", "kernels", "lock", "lock ms", "fill ms", "unlock ms", "GB/s");
+	for(unsigned u=0; u<sizeof(usageCases)/sizeof(usageCases[0]); u++) {
+		const UsageCase* c = &usageCases[u];
+		if(native_window_set_usage(window, c->allocUsage) != 0) {
+			printf("%s: cannot set usage 0x%llx\n", c->name, (unsigned long long)c->allocUsage);
+			continue;
+		}
+		for(int k=0; k<2; k++) {
+			if(k == 1 && kernels[k] == NULL) {
+				break;
+			}
+			fillSetKernels(kernels[k]);
+			nsecs_t lockTotal = 0, fillTotal = 0, unlockTotal = 0;
+			double bytes = 0;
+			bool supported = true;
+			for(int frame=0; frame<frames + USAGE_WARMUP_FRAMES; frame++) {
+				ANativeWindowBuffer* buffer;
+				int fenceFd = -1;
+				if(window->dequeueBuffer(window, &buffer, &fenceFd) != 0) {
+					printf("dequeueBuffer failed\n");
+					fillSetKernels(NULL);
+					return;
+				}
+				char* vaddr = NULL;
+				nsecs_t t0 = systemTime();
+				/* gralloc may refuse a lock usage the allocation does not cover */
+				if(GraphicBufferMapper::get().lockAsync(buffer->handle, c->lockUsage,
+						Rect(0, 0, buffer->width, buffer->height), (void**)&vaddr, fenceFd) != NO_ERROR || !vaddr) {
+					window->cancelBuffer(window, buffer, -1);
+					supported = false;
+					break;
+				}
+				nsecs_t t1 = systemTime();
+				FillSurface dst = { vaddr, buffer->width, buffer->height, buffer->stride, FILL_RGBA8888 };
+				bool known = toFillFormat(buffer->format, &dst.format);
+				if(known) {
+					fillSolid(&dst, frame & 1 ? FILL_RGBA(255, 0, 0, 255) : FILL_RGBA(0, 0, 255, 255));
+				}
+				nsecs_t t2 = systemTime();
+				int releaseFd = -1;
+				GraphicBufferMapper::get().unlockAsync(buffer->handle, &releaseFd);
+				nsecs_t t3 = systemTime();
+				window->queueBuffer(window, buffer, releaseFd);
+				if(frame >= USAGE_WARMUP_FRAMES && known) {
+					lockTotal += t1 - t0;
+					fillTotal += t2 - t1;
+					unlockTotal += t3 - t2;
+					bytes += (double)fillSurfaceSize(&dst);
+				}
+			}
+			char lock[16];
+			snprintf(lock, sizeof(lock), "0x%02x", c->lockUsage);
+			if(!supported) {
+				/* the lock fails whatever the kernels, skip the streaming row */
+				printf("%-10s %-8s %-8s %9s\n", c->name, fillGetKernels()->name, lock, "unsupported");
+				break;
+			}
+			printf("%-10s %-8s %-8s %9.3f %9.3f %9.3f %8.2f\n", c->name, fillGetKernels()->name, lock,
+					lockTotal/frames/1e6, fillTotal/frames/1e6, unlockTotal/frames/1e6,
+					fillTotal > 0 ? bytes/fillTotal : 0.0);
+		}
+	}
+	fillSetKernels(NULL);
+}
+
+/* Layers the stress mode can drive, and what the display is assumed to be. */
+#define STRESS_MAX_LAYERS	32
+#define STRESS_DISPLAY_WIDTH	1920
+#define STRESS_DISPLAY_HEIGHT	1080
+
+typedef struct {
+	int layers;
+	int width;
+	int height;
+	int format;		/* HAL_PIXEL_FORMAT_* */
+	float alpha;
+	int overlap;		/* percent of a layer covered by the next one */
+	int fps;
+	int frames;
+	int z;			/* the bottom layer's z, the others go up by one */
+	int buffers;
+} StressConfig;
+
+typedef struct {
+	sp<SurfaceControl> sc;
+	sp<Surface> surface;
+	ANativeWindow* window;
+	Producer producer;
+	FrameStats stats;
+	bool timestamps;
+} StressLayer;
+
+static bool parseFormat(const char* name, int* format)
+{
+	if(strcmp(name, "rgba") == 0) {
+		*format = HAL_PIXEL_FORMAT_RGBA_8888;
+	} else if(strcmp(name, "rgbx") == 0) {
+		*format = HAL_PIXEL_FORMAT_RGBX_8888;
+	} else if(strcmp(name, "565") == 0) {
+		*format = HAL_PIXEL_FORMAT_RGB_565;
+	} else if(strcmp(name, "yv12") == 0) {
+		*format = HAL_PIXEL_FORMAT_YV12;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Cascades the layers left to right, then down, each one shifted by the
+ * part of a layer it does not overlap. overlap 100 stacks them exactly.
+ */
+static void stressPosition(const StressConfig* config, int i, float* x, float* y)
+{
+	int stepX = config->width*(100 - config->overlap)/100;
+	int stepY = config->height*(100 - config->overlap)/100;
+	int perRow = stepX > 0 ? (STRESS_DISPLAY_WIDTH - config->width)/stepX + 1 : config->layers;
+	perRow = perRow > 0 ? perRow : 1;
+	int row = i/perRow;
+	int rows = stepY > 0 ? (STRESS_DISPLAY_HEIGHT - config->height)/stepY + 1 : 1;
+	*x = (i % perRow)*stepX;
+	*y = (rows > 0 ? row % rows : 0)*stepY;
+}
+
+/* One frame of one layer, the pipelined loop's body without the printing. */
+static void stressFrame(StressLayer* layer)
+{
+	ANativeWindow* window = layer->window;
+	ANativeWindowBuffer* buffer;
+	FrameTimes t;
+	memset(&t, 0, sizeof(t));
+	int fenceFd = -1;
+
+	t.dequeueStart = systemTime();
+	if(window->dequeueBuffer(window, &buffer, &fenceFd) != 0) {
+		layer->stats.lost++;
+		return;
+	}
+	t.dequeued = systemTime();
+	int age = 0;
+	window->query(window, NATIVE_WINDOW_BUFFER_AGE, &age);
+	DamageRegion repaint, surfaceDamage;
+	producerBeginFrame(&layer->producer, age, &repaint, &surfaceDamage);
+	DamageRect lockRect = damageBounds(&repaint);
+	char* vaddr = NULL;
+	if(GraphicBufferMapper::get().lockAsync(buffer->handle, 0x00000030,
+			Rect(lockRect.left, lockRect.top, lockRect.right, lockRect.bottom), (void**)&vaddr, fenceFd) != NO_ERROR || !vaddr) {
+		window->cancelBuffer(window, buffer, -1);
+		layer->stats.lost++;
+		return;
+	}
+	t.locked = systemTime();
+	FillSurface dst = { vaddr, buffer->width, buffer->height, buffer->stride, FILL_RGBA8888 };
+	if(toFillFormat(buffer->format, &dst.format)) {
+		producerDraw(&layer->producer, &dst, &repaint);
+	}
+	int releaseFd = -1;
+	GraphicBufferMapper::get().unlockAsync(buffer->handle, &releaseFd);
+	t.filled = systemTime();
+	setSurfaceDamage(window, &surfaceDamage, buffer->height);
+	if(layer->timestamps) {
+		native_window_get_next_frame_id(window, &t.id);
+	}
+	window->queueBuffer(window, buffer, releaseFd);
+	t.queued = systemTime();
+	producerEndFrame(&layer->producer);
+	frameStatsAdd(&layer->stats, &t);
+}
+
+static void stressSleepUntil(nsecs_t when)
+{
+	struct timespec ts;
+	ts.tv_sec = when/1000000000;
+	ts.tv_nsec = when % 1000000000;
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+	}
+}
+
+/*
+ * K layers of the given size, format and alpha, stacked from z upwards
+ * with the given overlap, all redrawn every tick of a fps timer. At the
+ * end every layer reports its present latency and the refreshes it
+ * dropped, followed by the ticks the producer itself missed.
+ */
+static int runStress(const StressConfig* config, FillPool* pool)
+{
+	static StressLayer layers[STRESS_MAX_LAYERS];
+	sp<SurfaceComposerClient> client = new SurfaceComposerClient();
+	nsecs_t period = 1000000000LL/config->fps;
+
+	SurfaceComposerClient::Transaction t;
+	for(int i=0; i<config->layers; i++) {
+		StressLayer* layer = &layers[i];
+		char name[32];
+		snprintf(name, sizeof(name), "red_layer_stress_%d", i);
+		layer->sc = client->createSurface(String8(name), config->width, config->height, config->format, 0);
+		if(layer->sc == NULL || !layer->sc->isValid()) {
+			printf("cannot create layer %d\n", i);
+			return 1;
+		}
+		layer->surface = layer->sc->getSurface();
+		layer->window = layer->surface.get();
+		native_window_api_connect(layer->window, NATIVE_WINDOW_API_CPU);
+		native_window_set_buffer_count(layer->window, config->buffers);
+		layer->timestamps = native_window_enable_frame_timestamps(layer->window, true) == 0;
+		/* every layer a different gradient so the composer cannot shortcut */
+		producerInit(&layer->producer, pool, "gradient", config->width, config->height);
+		layer->producer.background.color = FILL_RGBA(255 - i*7, i*29, 128, 255);
+		frameStatsInit(&layer->stats, systemTime());
+		layer->stats.period = period;
+
+		float x, y;
+		stressPosition(config, i, &x, &y);
+		t.setLayer(layer->sc, config->z + i)
+			.setPosition(layer->sc, x, y)
+			.setAlpha(layer->sc, config->alpha)
+			.show(layer->sc);
+	}
+	t.apply();
+
+	int late = 0;
+	nsecs_t start = systemTime();
+	nsecs_t vsync = start;
+	for(int frame=0; frame<config->frames; frame++) {
+		stressSleepUntil(vsync);
+		for(int i=0; i<config->layers; i++) {
+			stressFrame(&layers[i]);
+			if(layers[i].timestamps) {
+				frameStatsCollect(&layers[i].stats, presentTime, layers[i].window);
+			}
+		}
+		vsync += period;
+		nsecs_t now = systemTime();
+		if(now > vsync) {
+			/* the producer itself could not keep up: skip the ticks it missed */
+			while(vsync < now) {
+				vsync += period;
+				late++;
+			}
+		}
+	}
+	nsecs_t elapsed = systemTime() - start;
+	/* the last frames need a refresh or two to reach the screen */
+	stressSleepUntil(systemTime() + 4*period);
+
+	printf("%-6s %8s %8s %6s %8s %8s %9s %8s\n", "layer", "frames", "present", "lost", "dropped", "p50 ms", "p99 ms", "fill ms");
+	int frames = 0, presented = 0, lost = 0, dropped = 0;
+	for(int i=0; i<config->layers; i++) {
+		StressLayer* layer = &layers[i];
+		if(layer->timestamps) {
+			frameStatsCollect(&layer->stats, presentTime, layer->window);
+		}
+		FrameStats* s = &layer->stats;
+		lost += s->lost + s->numPending;
+		printf("%-6d %8d %8d %6d %8d %8d %9d %8.3f\n", config->z + i, s->frames, s->presented,
+				s->lost + s->numPending, s->dropped, s->presented ? frameStatsPercentile(s, 0.5) : 0,
+				s->presented ? frameStatsPercentile(s, 0.99) : 0, s->frames ? s->fill/s->frames/1e6 : 0.0);
+		frames += s->frames;
+		presented += s->presented;
+		dropped += s->dropped;
+		native_window_api_disconnect(layer->window, NATIVE_WINDOW_API_CPU);
+		t.hide(layer->sc);
+	}
+	t.apply();
+	printf("total: %d frames in %.2f s (%.1f fps per layer, target %d), %d presented, %d lost, "
+			"%d refreshes dropped, %d ticks missed by the producer\n",
+			frames, elapsed/1e9, config->frames*1e9/elapsed, config->fps, presented, lost, dropped, late);
+	for(int i=0; i<config->layers; i++) {
+		layers[i].surface = NULL;
+		layers[i].sc = NULL;
+	}
+	return 0;
+}
+
+/*
+ * red_layer stress [layers] [width height] [rgba|rgbx|565|yv12] [alpha] [overlap%] [fps] [frames] [z] [buffers]
+ * Defaults: 4 layers of 640x360 RGBA, opaque, 50% overlap, 60 fps for 600
+ * frames from z 31005 with 3 buffers each. Same arguments, same run.
+ */
+static int stressMain(int argc, char** argv)
+{
+	StressConfig config = { 4, 640, 360, HAL_PIXEL_FORMAT_RGBA_8888, 1.0f, 50, 60, 600, 31005, 3 };
+	if(argc > 2) config.layers = atoi(argv[2]);
+	if(argc > 4) {
+		config.width = atoi(argv[3]);
+		config.height = atoi(argv[4]);
+	}
+	if(argc > 5 && !parseFormat(argv[5], &config.format)) {
+		printf("unknown format %s\n", argv[5]);
+		return 1;
+	}
+	if(argc > 6) config.alpha = atof(argv[6]);
+	if(argc > 7) config.overlap = atoi(argv[7]);
+	if(argc > 8) config.fps = atoi(argv[8]);
+	if(argc > 9) config.frames = atoi(argv[9]);
+	if(argc > 10) config.z = atoi(argv[10]);
+	if(argc > 11) config.buffers = atoi(argv[11]);
+	if(config.layers < 1 || config.layers > STRESS_MAX_LAYERS || config.width < 2 || config.height < 2 ||
+			config.overlap < 0 || config.overlap > 100 || config.fps < 1 || config.frames < 1 ||
+			config.buffers < 1) {
+		printf("usage: red_layer stress [layers 1..%d] [width height] [rgba|rgbx|565|yv12] [alpha] [overlap%%] "
+				"[fps] [frames] [z] [buffers]\n", STRESS_MAX_LAYERS);
+		return 1;
+	}
+
+	FillPool pool;
+	fillPoolStart(&pool, 1, false);
+	printf("stress: %d layers %dx%d format %d alpha %.2f overlap %d%% at %d fps, %d frames, z %d, %d buffers, %s kernels\n",
+			config.layers, config.width, config.height, config.format, config.alpha, config.overlap,
+			config.fps, config.frames, config.z, config.buffers, fillGetKernels()->name);
+	sp<ProcessState> proc(ProcessState::self());
+	ProcessState::self()->startThreadPool();
+	int result = runStress(&config, &pool);
+	fillPoolStop(&pool);
+	return result;
+}
+
+/*
+ * usage: red_layer [solid|gradient|checker|box|boxfull] [threads] [width height] [buffers] [frames]
+ * With threads > 1 every buffer is filled in row bands by a pool of threads
+ * pinned to the fastest cores. box moves a small square over a static
+ * background and only rewrites what changed since the dequeued buffer was
+ * last drawn; boxfull draws the same but rewrites every pixel.
+ * buffers 2 or 3 switches to the fenced double / triple buffered loop and
+ * prints a dequeue to present latency histogram; 0 keeps the serial loop.
+ * frames 0, the default, runs until killed.
+ * red_layer usage [threads] [width height] [buffers] [frames] instead times
+ * lock / fill / unlock under each gralloc usage combination and exits.
+ * red_layer stress ... drives many layers at once, see stressMain().
+ */
 int main(int argc, char** argv)
 {
-	(void)argc;
-	(void)argv;
+	const char* mode = argc > 1 ? argv[1] : "solid";
+	if(strcmp(mode, "stress") == 0) {
+		return stressMain(argc, argv);
+	}
+	int threads = argc > 2 ? atoi(argv[2]) : 1;
+	int width = argc > 4 ? atoi(argv[3]) : 1920;
+	int height = argc > 4 ? atoi(argv[4]) : 1080;
+	int buffers = argc > 5 ? atoi(argv[5]) : 0;
+	int maxFrames = argc > 6 ? atoi(argv[6]) : 0;
+
+	FillPool pool;
+	if(!fillPoolStart(&pool, threads, threads > 1)) {
+		printf("threads must be 1..%d\n", FILL_POOL_MAX_THREADS);
+		return 1;
+	}
+	bool usageSweep = strcmp(mode, "usage") == 0;
+	Producer producer;
+	if(!producerInit(&producer, &pool, usageSweep ? "solid" : mode, width, height)) {
+		printf("unknown mode %s\n", mode);
+		return 1;
+	}
+	printf("fill kernels: %s, mode %s, %dx%d, %d threads on cpus", fillGetKernels()->name, mode,
+			width, height, pool.numThreads);
+	for(int i=0; i<pool.numThreads; i++) {
+		printf(" %d", pool.cpus[i]);
+	}
+	printf("\n");
     // set up the thread-pool
     sp<ProcessState> proc(ProcessState::self());
     ProcessState::self()->startThreadPool();
@@ -24,11 +594,13 @@ int main(int argc, char** argv)
     // create a client to surfaceflinger
     sp<SurfaceComposerClient> client = new SurfaceComposerClient();
     
-    sp<SurfaceControl> surfaceControl_p = client->createSurface(String8("red_layer_p"), 1920, 1080, 0x1, 0);
+    sp<SurfaceControl> surfaceControl_p = client->createSurface(String8("red_layer_p"), width, height, 0x1, 0);
     
-    SurfaceComposerClient::Transaction().setLayer(surfaceControl_p, 31005).apply();
-	SurfaceComposerClient::Transaction().setPosition(surfaceControl_p,000.0f, 212.0f).apply();
-	SurfaceComposerClient::Transaction().show(surfaceControl_p).apply();
+    SurfaceComposerClient::Transaction()
+		.setLayer(surfaceControl_p, 31005)
+		.setPosition(surfaceControl_p, 000.0f, 212.0f)
+		.show(surfaceControl_p)
+		.apply();
 
     
     sp<Surface> surface = surfaceControl_p->getSurface();
@@ -51,26 +623,25 @@ int main(int argc, char** argv)
 //		ALOGE("huataol error");
 //	}
 
-    ANativeWindowBuffer * outBuffer;
-
-    while(1)
-    {
-		char* vaddr;
-		int status = window->dequeueBuffer_DEPRECATED(window, &outBuffer);
-		GraphicBufferMapper::get().lock(outBuffer->handle, 0x00000030, Rect(0, 0, 100, 100), (void**)&vaddr);
-			
-		for(int i=0; i< 1080; i++) {
-			for(int j=0; j<1920; j++) {
-				vaddr[i*1920*4 + j*4 + 0] = 255;
-				vaddr[i*1920*4 + j*4 + 1] = 0;
-				vaddr[i*1920*4 + j*4 + 2] = 0;
-				vaddr[i*1920*4 + j*4 + 3] = 255;
-			}
+	if(usageSweep) {
+		if(buffers > 0) {
+			native_window_set_buffer_count(window, buffers);
 		}
-		GraphicBufferMapper::get().unlock(outBuffer->handle);
-		printf("##### After set memory\n");
-		status = window->queueBuffer_DEPRECATED(window, outBuffer);
-  }
+		runUsageSweep(window, maxFrames);
+		native_window_api_disconnect(window, NATIVE_WINDOW_API_CPU);
+		fillPoolStop(&pool);
+		return 0;
+	}
+	if(buffers > 0) {
+		runPipelined(window, &producer, buffers, maxFrames);
+	} else {
+		runSerial(window, &producer, maxFrames);
+	}
+	if(maxFrames > 0) {
+		native_window_api_disconnect(window, NATIVE_WINDOW_API_CPU);
+		fillPoolStop(&pool);
+		return 0;
+	}
 
 /*
      surface->lock(&outBuffer, NULL);
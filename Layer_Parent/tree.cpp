@@ -0,0 +1,171 @@
+/*
+ * tree.cpp
+ * A complete tree of parent / child layers, mutated every frame.
+ */
+
+#include <stdio.h>
+
+#include "fill.h"
+#include "scene.h"
+#include "tree.h"
+
+using namespace android;
+
+/* Pixels an inner layer swings back and forth, and its crop margin. */
+#define TREE_SWING	8
+
+int treeSize(int depth, int fanout)
+{
+	int total = 0;
+	int level = 1;
+	for(int d=0; d<=depth; d++) {
+		total += level;
+		if(total > TREE_MAX_NODES) {
+			return -1;
+		}
+		level *= fanout;
+	}
+	return total;
+}
+
+static int treeLeaves(const LayerTree* tree)
+{
+	return tree->numNodes - tree->firstLeaf;
+}
+
+/* The probe is the last leaf; the mutations leave it alone. */
+static int treeMutableLeaves(const LayerTree* tree)
+{
+	return treeLeaves(tree) - 1;
+}
+
+bool treeCreate(LayerTree* tree, const sp<SurfaceComposerClient>& client, int depth, int fanout, int width, int height)
+{
+	int n = treeSize(depth, fanout);
+	if(n < 1 || fanout < 1) {
+		return false;
+	}
+	tree->nodes = new TreeNode[n];
+	tree->numNodes = 0;
+	tree->depth = depth;
+	tree->fanout = fanout;
+	tree->firstLeaf = treeSize(depth - 1, fanout);
+	tree->frame = 0;
+
+	SurfaceComposerClient::Transaction t;
+	for(int i=0; i<n; i++) {
+		TreeNode* node = &tree->nodes[i];
+		node->parent = i == 0 ? -1 : (i - 1)/fanout;
+		node->relativeTo = -1;
+		if(node->parent < 0) {
+			node->level = 0;
+			node->width = width;
+			node->height = height;
+			node->x = 0;
+			node->y = 0;
+		} else {
+			/* children split their parent's width, inset a little so every level shows */
+			const TreeNode* parent = &tree->nodes[node->parent];
+			int k = (i - 1) % fanout;
+			node->level = parent->level + 1;
+			node->width = parent->width/fanout > 4 ? parent->width/fanout : 4;
+			node->height = parent->height > 4 + 2*TREE_SWING ? parent->height - 2*TREE_SWING : 4;
+			node->x = k*(parent->width/fanout);
+			node->y = TREE_SWING;
+		}
+
+		char name[32];
+		snprintf(name, sizeof(name), "tree_%d", i);
+		SurfaceControl* parent = node->parent >= 0 ? tree->nodes[node->parent].sc.get() : NULL;
+		node->sc = client->createSurface(String8(name), node->width, node->height, HAL_PIXEL_FORMAT_RGBA_8888, 0, parent);
+		if(node->sc == NULL || !node->sc->isValid()) {
+			printf("cannot create layer %d\n", i);
+			treeDestroy(tree);
+			return false;
+		}
+		tree->numNodes++;
+		if(i >= tree->firstLeaf) {
+			node->surface = node->sc->getSurface();
+			sceneQueueSolid(node->surface.get(), FILL_RGBA(40*node->level, 255 - 40*node->level, i*37, 255));
+		}
+		t.setLayer(node->sc, node->parent < 0 ? TREE_BASE_Z : (i - 1) % fanout)
+			.setPosition(node->sc, node->x, node->y)
+			.show(node->sc);
+	}
+	t.apply();
+	return true;
+}
+
+void treeDestroy(LayerTree* tree)
+{
+	if(tree->numNodes > 0) {
+		SurfaceComposerClient::Transaction().hide(tree->nodes[0].sc).apply();
+	}
+	for(int i=0; i<tree->numNodes; i++) {
+		if(tree->nodes[i].surface != NULL) {
+			native_window_api_disconnect(tree->nodes[i].surface.get(), NATIVE_WINDOW_API_CPU);
+		}
+	}
+	delete[] tree->nodes;
+	tree->nodes = NULL;
+	tree->numNodes = 0;
+}
+
+int treeMutate(LayerTree* tree, int mutations, SurfaceComposerClient::Transaction& t)
+{
+	int changes = 0;
+	int swing = tree->frame % (2*TREE_SWING);
+	swing = swing < TREE_SWING ? swing : 2*TREE_SWING - swing;
+
+	for(int i=0; i<tree->firstLeaf; i++) {
+		TreeNode* node = &tree->nodes[i];
+		if(mutations & TREE_MOVE) {
+			t.setPosition(node->sc, node->x + swing, node->y);
+			changes++;
+		}
+		if(mutations & TREE_CROP) {
+			t.setCrop(node->sc, Rect(swing, 0, node->width - swing, node->height));
+			changes++;
+		}
+	}
+
+	/* a rotating eighth of the leaves, probe excluded */
+	int leaves = treeMutableLeaves(tree);
+	int batch = leaves/8 > 0 ? leaves/8 : 1;
+	for(int j=0; leaves > 0 && j<batch; j++) {
+		int leaf = tree->firstLeaf + (tree->frame*batch + j) % leaves;
+		TreeNode* node = &tree->nodes[leaf];
+		if((mutations & TREE_REPARENT) && tree->firstLeaf > 0) {
+			/* to the next parent on the level above, wrapping */
+			int firstParent = treeSize(tree->depth - 2, tree->fanout);
+			int parents = tree->firstLeaf - firstParent;
+			node->parent = firstParent + (node->parent - firstParent + 1) % parents;
+			t.reparent(node->sc, tree->nodes[node->parent].sc->getHandle());
+			changes++;
+		}
+		if(mutations & TREE_RELATIVE) {
+			if(node->relativeTo >= 0) {
+				t.setLayer(node->sc, (leaf - 1) % tree->fanout);
+				node->relativeTo = -1;
+				changes++;
+			} else if(leaves > 1) {
+				/* half way round the leaves, another subtree once there is more than one */
+				int target = tree->firstLeaf + (leaf - tree->firstLeaf + leaves/2) % leaves;
+				if(tree->nodes[target].relativeTo >= 0) {
+					/* would make a loop */
+					continue;
+				}
+				node->relativeTo = target;
+				t.setRelativeLayer(node->sc, tree->nodes[target].sc->getHandle(), 1);
+				changes++;
+			}
+		}
+	}
+	tree->frame++;
+	return changes;
+}
+
+sp<Surface> treeProbe(const LayerTree* tree)
+{
+	return tree->nodes[tree->numNodes - 1].surface;
+}
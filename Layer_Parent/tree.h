@@ -0,0 +1,63 @@
+/*
+ * tree.h
+ * A complete tree of parent / child layers, mutated every frame the ways
+ * that make SurfaceFlinger walk it: moving and cropping inner layers,
+ * reparenting leaves and giving them z relative to other subtrees.
+ */
+
+#ifndef TREE_H
+#define TREE_H
+
+#include <gui/Surface.h>
+#include <gui/SurfaceComposerClient.h>
+
+#define TREE_MAX_NODES		1024
+/* The root's z, above the scene layers. */
+#define TREE_BASE_Z		31200
+
+/* What treeMutate() changes, or'ed together. */
+#define TREE_MOVE		0x1	/* position of every inner layer, children follow */
+#define TREE_CROP		0x2	/* crop of every inner layer, children inherit it */
+#define TREE_REPARENT		0x4	/* an eighth of the leaves move to the next parent */
+#define TREE_RELATIVE		0x8	/* an eighth of the leaves go above a leaf of another subtree */
+#define TREE_ALL		0xf
+
+typedef struct {
+	android::sp<android::SurfaceControl> sc;
+	android::sp<android::Surface> surface;	/* leaves only */
+	int parent;			/* node index, -1 for the root */
+	int level;
+	int width;
+	int height;
+	float x;			/* relative to the parent */
+	float y;
+	int relativeTo;			/* node index while z is relative, else -1 */
+} TreeNode;
+
+typedef struct {
+	TreeNode* nodes;		/* breadth first, the root first */
+	int numNodes;
+	int depth;			/* levels below the root */
+	int fanout;
+	int firstLeaf;
+	int frame;
+} LayerTree;
+
+/* Nodes in a complete tree of the given shape, or -1 when over TREE_MAX_NODES. */
+int treeSize(int depth, int fanout);
+
+/*
+ * Creates the tree under a width x height root at the top left of the
+ * display. Every leaf gets one solid buffer, inner layers have none.
+ */
+bool treeCreate(LayerTree* tree, const android::sp<android::SurfaceComposerClient>& client,
+		int depth, int fanout, int width, int height);
+void treeDestroy(LayerTree* tree);
+
+/* Adds the next frame's mutations to t and returns how many layer changes that is. */
+int treeMutate(LayerTree* tree, int mutations, android::SurfaceComposerClient::Transaction& t);
+
+/* A leaf nothing mutates, for the caller to keep redrawing. */
+android::sp<android::Surface> treeProbe(const LayerTree* tree);
+
+#endif
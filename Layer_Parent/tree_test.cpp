@@ -0,0 +1,195 @@
+/*
+ * tree_test.cpp
+ * Builds parent / child layer trees of growing depth and fan-out, mutates
+ * them every frame in one transaction and reports how apply time and the
+ * probe leaf's dequeue to present latency scale with the tree.
+ *
+ * usage: layer_tree [move,crop,reparent,relz|all] [maxDepth] [maxFanout] [frames] [refreshHz]
+ * Every depth 1..maxDepth is run with fan-out 1, 2, 4 .. maxFanout, as far
+ * as the tree stays within TREE_MAX_NODES layers.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <binder/IPCThreadState.h>
+#include <binder/ProcessState.h>
+#include <ui/GraphicBufferMapper.h>
+#include <utils/Timers.h>
+
+#include "fill.h"
+#include "framestats.h"
+#include "tree.h"
+
+using namespace android;
+
+#define MAX_FRAMES	10000
+
+static int compareTimes(const void* a, const void* b)
+{
+	nsecs_t x = *(const nsecs_t*)a;
+	nsecs_t y = *(const nsecs_t*)b;
+	return x < y ? -1 : x > y;
+}
+
+static void sleepUntil(nsecs_t when)
+{
+	struct timespec ts;
+	ts.tv_sec = when/1000000000;
+	ts.tv_nsec = when % 1000000000;
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+	}
+}
+
+static int parseMutations(const char* spec)
+{
+	if(strcmp(spec, "all") == 0) {
+		return TREE_ALL;
+	}
+	int mutations = 0;
+	if(strstr(spec, "move")) mutations |= TREE_MOVE;
+	if(strstr(spec, "crop")) mutations |= TREE_CROP;
+	if(strstr(spec, "reparent")) mutations |= TREE_REPARENT;
+	if(strstr(spec, "relz")) mutations |= TREE_RELATIVE;
+	return mutations;
+}
+
+static int presentTime(void* user, uint64_t id, int64_t* present)
+{
+	ANativeWindow* window = (ANativeWindow*)user;
+	if(native_window_get_frame_timestamps(window, id, NULL, NULL, NULL, NULL, NULL, NULL, present, NULL, NULL) != 0) {
+		return -1;
+	}
+	if(*present == NATIVE_WINDOW_TIMESTAMP_PENDING) {
+		return 0;
+	}
+	return *present == NATIVE_WINDOW_TIMESTAMP_INVALID ? -1 : 1;
+}
+
+/* Redraws the probe leaf so each frame has a present time to wait for. */
+static void drawProbe(ANativeWindow* window, FrameStats* stats, int frame, bool timestamps)
+{
+	ANativeWindowBuffer* buffer;
+	FrameTimes t;
+	memset(&t, 0, sizeof(t));
+	int fenceFd = -1;
+	t.dequeueStart = systemTime();
+	if(window->dequeueBuffer(window, &buffer, &fenceFd) != 0) {
+		stats->lost++;
+		return;
+	}
+	t.dequeued = systemTime();
+	char* vaddr = NULL;
+	if(GraphicBufferMapper::get().lockAsync(buffer->handle, 0x00000030,
+			Rect(0, 0, buffer->width, buffer->height), (void**)&vaddr, fenceFd) != NO_ERROR || !vaddr) {
+		window->cancelBuffer(window, buffer, -1);
+		stats->lost++;
+		return;
+	}
+	t.locked = systemTime();
+	FillSurface dst = { vaddr, buffer->width, buffer->height, buffer->stride, FILL_RGBA8888 };
+	fillSolid(&dst, frame & 1 ? FILL_RGBA(255, 255, 255, 255) : FILL_RGBA(0, 0, 0, 255));
+	int releaseFd = -1;
+	GraphicBufferMapper::get().unlockAsync(buffer->handle, &releaseFd);
+	t.filled = systemTime();
+	if(timestamps) {
+		native_window_get_next_frame_id(window, &t.id);
+	}
+	window->queueBuffer(window, buffer, releaseFd);
+	t.queued = systemTime();
+	frameStatsAdd(stats, &t);
+}
+
+static void runTree(const sp<SurfaceComposerClient>& client, int depth, int fanout, int mutations,
+		int frames, nsecs_t period, nsecs_t* applies)
+{
+	LayerTree tree;
+	if(!treeCreate(&tree, client, depth, fanout, 1280, 720)) {
+		return;
+	}
+	sp<Surface> probe = treeProbe(&tree);
+	ANativeWindow* window = probe.get();
+	bool timestamps = native_window_enable_frame_timestamps(window, true) == 0;
+	FrameStats stats;
+	frameStatsInit(&stats, systemTime());
+	stats.period = period;
+
+	long changes = 0;
+	int late = 0;
+	nsecs_t vsync = systemTime() + period;
+	for(int f=0; f<frames; f++) {
+		sleepUntil(vsync);
+		nsecs_t start = systemTime();
+		SurfaceComposerClient::Transaction t;
+		changes += treeMutate(&tree, mutations, t);
+		t.apply();
+		applies[f] = systemTime() - start;
+		drawProbe(window, &stats, f, timestamps);
+		if(timestamps) {
+			frameStatsCollect(&stats, presentTime, window);
+		}
+		vsync += period;
+		nsecs_t now = systemTime();
+		if(now > vsync) {
+			late++;
+			while(vsync < now) {
+				vsync += period;
+			}
+		}
+	}
+	/* give the last probe frames time to reach the screen */
+	sleepUntil(systemTime() + 4*period);
+	if(timestamps) {
+		frameStatsCollect(&stats, presentTime, window);
+	}
+
+	nsecs_t total = 0;
+	for(int f=0; f<frames; f++) {
+		total += applies[f];
+	}
+	qsort(applies, frames, sizeof(nsecs_t), compareTimes);
+	printf("%5d %6d %6d %8.1f %8.3f %8.3f %8.3f %7d %7d %7d %5d\n", depth, fanout, tree.numNodes,
+			(double)changes/frames, total/frames/1e6, applies[frames*99/100]/1e6, applies[frames - 1]/1e6,
+			stats.presented ? frameStatsPercentile(&stats, 0.5) : 0,
+			stats.presented ? frameStatsPercentile(&stats, 0.99) : 0, stats.dropped, late);
+	treeDestroy(&tree);
+}
+
+int main(int argc, char** argv)
+{
+	int mutations = parseMutations(argc > 1 ? argv[1] : "all");
+	int maxDepth = argc > 2 ? atoi(argv[2]) : 8;
+	int maxFanout = argc > 3 ? atoi(argv[3]) : 4;
+	int frames = argc > 4 ? atoi(argv[4]) : 120;
+	int refreshHz = argc > 5 ? atoi(argv[5]) : 60;
+	if(mutations == 0 || maxDepth < 1 || maxFanout < 1 || frames < 1 || frames > MAX_FRAMES || refreshHz < 1) {
+		printf("usage: %s [move,crop,reparent,relz|all] [maxDepth] [maxFanout] [frames 1..%d] [refreshHz]\n",
+				argv[0], MAX_FRAMES);
+		return 1;
+	}
+
+	sp<ProcessState> proc(ProcessState::self());
+	ProcessState::self()->startThreadPool();
+	sp<SurfaceComposerClient> client = new SurfaceComposerClient();
+	if(client->initCheck() != NO_ERROR) {
+		printf("cannot connect to SurfaceFlinger\n");
+		return 1;
+	}
+
+	static nsecs_t applies[MAX_FRAMES];
+	printf("%d frames at %d Hz; apply in ms, probe dequeue to present in ms\n", frames, refreshHz);
+	printf("%5s %6s %6s %8s %8s %8s %8s %7s %7s %7s %5s\n", "depth", "fanout", "layers", "chg/f",
+			"apply", "p99", "max", "pres50", "pres99", "dropped", "late");
+	for(int fanout=1; fanout<=maxFanout; fanout*=2) {
+		for(int depth=1; depth<=maxDepth; depth++) {
+			if(treeSize(depth, fanout) < 0) {
+				break;
+			}
+			runTree(client, depth, fanout, mutations, frames, 1000000000LL/refreshHz, applies);
+		}
+	}
+	return 0;
+}
@@ -2,7 +2,10 @@ LOCAL_PATH:= $(call my-dir)
 include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES:= \
-		    test.cpp
+		    test.cpp \
+		    dmabuf.cpp \
+		    dmabufpool.cpp \
+		    dmabufsync.cpp
 		    
 LOCAL_C_INCLUDES := \
 	external/skia/include/core \
@@ -23,9 +26,26 @@ LOCAL_SHARED_LIBRARIES := \
 
             
 
+LOCAL_CFLAGS := -DDMABUF_HAVE_ION=1
+
 LOCAL_MODULE:= secure_mmap_test
 
 LOCAL_MODULE_TAGS := tests
 
 include $(BUILD_EXECUTABLE)
 
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+		    test.cpp \
+		    dmabuf.cpp \
+		    dmabufpool.cpp \
+		    dmabufsync.cpp
+
+LOCAL_LDLIBS := -lpthread
+
+LOCAL_MODULE:= secure_mmap_test_host
+
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,206 @@
+/*
+ * dmabuf.cpp
+ * ION, dma_heap, memfd and mock secure allocation behind one call.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/ioctl.h>
+#include <linux/memfd.h>
+#include <linux/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if DMABUF_HAVE_ION
+#include <ion/ion.h>
+#endif
+
+#include "dmabuf.h"
+
+#ifndef ION_FLAG_CACHED
+#define ION_FLAG_CACHED		1
+#endif
+
+/* <linux/dma-heap.h>, for kernel headers older than 5.6 */
+#ifndef DMA_HEAP_IOCTL_ALLOC
+struct dma_heap_allocation_data {
+	__u64 len;
+	__u32 fd;
+	__u32 fd_flags;
+	__u64 heap_flags;
+};
+#define DMA_HEAP_IOC_MAGIC	'H'
+#define DMA_HEAP_IOCTL_ALLOC	_IOWR(DMA_HEAP_IOC_MAGIC, 0x0, struct dma_heap_allocation_data)
+#endif
+
+static int openHeapDevice(const char* name)
+{
+	char path[128];
+	snprintf(path, sizeof(path), "/dev/dma_heap/%s", name);
+	return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+static int memfdAlloc(size_t len)
+{
+	int fd = syscall(__NR_memfd_create, "dmabuf", MFD_CLOEXEC);
+	if(fd < 0) {
+		return -errno;
+	}
+	if(ftruncate(fd, len) != 0) {
+		int err = -errno;
+		close(fd);
+		return err;
+	}
+	return fd;
+}
+
+/* A memfd reached through an fd that mmap() refuses, as a secure heap's buffers are. */
+static int mockSecureAlloc(size_t len)
+{
+	int fd = memfdAlloc(len);
+	if(fd < 0) {
+		return fd;
+	}
+	char path[64];
+	snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+	int secure = open(path, O_PATH | O_CLOEXEC);
+	int err = secure < 0 ? -errno : 0;
+	close(fd);
+	return secure < 0 ? err : secure;
+}
+
+bool dmabufHeapOpen(DmabufHeap* heap, const char* spec)
+{
+	memset(heap, 0, sizeof(*heap));
+	heap->ionFd = heap->heapFd = heap->uncachedHeapFd = -1;
+	snprintf(heap->name, sizeof(heap->name), "%s", spec);
+
+	if(strncmp(spec, "ion:", 4) == 0) {
+		heap->backend = DMABUF_ION;
+		char* end;
+		heap->ionHeapMask = strtoul(spec + 4, &end, 0);
+		heap->ionFlags = *end == ':' ? strtoul(end + 1, NULL, 0) : 0;
+#if DMABUF_HAVE_ION
+		heap->ionFd = ion_open();
+		if(heap->ionFd < 0) {
+			fprintf(stderr, "%s: cannot open ion\n", spec);
+			return false;
+		}
+		return true;
+#else
+		fprintf(stderr, "%s: built without ION\n", spec);
+		return false;
+#endif
+	}
+	if(strncmp(spec, "dma_heap:", 9) == 0) {
+		char uncached[80];
+		heap->backend = DMABUF_DMA_HEAP;
+		heap->heapFd = openHeapDevice(spec + 9);
+		if(heap->heapFd < 0) {
+			fprintf(stderr, "%s: cannot open /dev/dma_heap/%s: %s\n", spec, spec + 9, strerror(errno));
+			return false;
+		}
+		snprintf(uncached, sizeof(uncached), "%s-uncached", spec + 9);
+		heap->uncachedHeapFd = openHeapDevice(uncached);
+		return true;
+	}
+	if(strcmp(spec, "memfd") == 0) {
+		heap->backend = DMABUF_MEMFD;
+		return true;
+	}
+	if(strcmp(spec, "mock-secure") == 0) {
+		/* goes down the dma_heap path, with a device that is not there */
+		heap->backend = DMABUF_DMA_HEAP;
+		heap->heapFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+		if(heap->heapFd < 0) {
+			fprintf(stderr, "%s: cannot open /dev/null: %s\n", spec, strerror(errno));
+			return false;
+		}
+		heap->mock = true;
+		heap->secure = true;
+		return true;
+	}
+	fprintf(stderr, "%s: not ion:<mask>[:<flags>], dma_heap:<name>, memfd or mock-secure\n", spec);
+	return false;
+}
+
+void dmabufHeapClose(DmabufHeap* heap)
+{
+#if DMABUF_HAVE_ION
+	if(heap->ionFd >= 0) {
+		ion_close(heap->ionFd);
+	}
+#endif
+	if(heap->heapFd >= 0) {
+		close(heap->heapFd);
+	}
+	if(heap->uncachedHeapFd >= 0) {
+		close(heap->uncachedHeapFd);
+	}
+	heap->ionFd = heap->heapFd = heap->uncachedHeapFd = -1;
+}
+
+int dmabufAlloc(DmabufHeap* heap, size_t len, bool cached)
+{
+	switch(heap->backend) {
+	case DMABUF_ION: {
+#if DMABUF_HAVE_ION
+		int fd = -1;
+		int err = ion_alloc_fd(heap->ionFd, len, getpagesize(), heap->ionHeapMask,
+				heap->ionFlags | (cached && !heap->secure ? ION_FLAG_CACHED : 0), &fd);
+		return err < 0 ? err : fd;
+#else
+		return -ENODEV;
+#endif
+	}
+	case DMABUF_DMA_HEAP: {
+		/* protected heaps have no -uncached twin, nor need one */
+		int heapFd = cached || heap->secure ? heap->heapFd : heap->uncachedHeapFd;
+		if(heapFd < 0) {
+			return -EINVAL;
+		}
+		if(heap->mock) {
+			return mockSecureAlloc(len);
+		}
+		struct dma_heap_allocation_data data;
+		memset(&data, 0, sizeof(data));
+		data.len = len;
+		data.fd_flags = O_RDWR | O_CLOEXEC;
+		if(ioctl(heapFd, DMA_HEAP_IOCTL_ALLOC, &data) < 0) {
+			return -errno;
+		}
+		return (int)data.fd;
+	}
+	case DMABUF_MEMFD:
+		return memfdAlloc(len);
+	}
+	return -EINVAL;
+}
+
+int dmabufImport(int fd, size_t* size)
+{
+	int own = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+	if(own < 0) {
+		return -errno;
+	}
+	/* dma-bufs tell their size through lseek, st_size is 0 on older kernels */
+	off_t end = lseek(own, 0, SEEK_END);
+	if(end > 0) {
+		lseek(own, 0, SEEK_SET);
+		*size = end;
+		return own;
+	}
+	struct stat st;
+	if(fstat(own, &st) != 0) {
+		int err = -errno;
+		close(own);
+		return err;
+	}
+	*size = st.st_size;
+	return own;
+}
@@ -0,0 +1,60 @@
+/*
+ * dmabuf.h
+ * One way to get dma-buf fds from any of the allocators a device may have:
+ * legacy ION (ion_alloc_fd on a heap mask), a /dev/dma_heap heap by name,
+ * or, for running on a host, a memfd standing in for the dma-buf. Every
+ * buffer comes back as an fd that is mmap()ed and close()d the same way.
+ * "mock-secure" stands in for a secure dma_heap with no -uncached twin:
+ * its buffers are O_PATH fds to a memfd, which can be passed around and
+ * sized but not mapped.
+ *
+ * ION needs libion and is built only with DMABUF_HAVE_ION.
+ */
+
+#ifndef DMABUF_H
+#define DMABUF_H
+
+#include <stddef.h>
+
+typedef enum {
+	DMABUF_ION,
+	DMABUF_DMA_HEAP,
+	DMABUF_MEMFD,
+} DmabufBackend;
+
+typedef struct {
+	DmabufBackend backend;
+	char name[64];			/* as given to dmabufHeapOpen() */
+	int ionFd;
+	unsigned ionHeapMask;
+	unsigned ionFlags;		/* added to every allocation, e.g. a vendor secure flag */
+	int heapFd;			/* /dev/dma_heap/<name> */
+	int uncachedHeapFd;		/* /dev/dma_heap/<name>-uncached, -1 when there is none */
+	bool mock;			/* heapFd is a placeholder, allocations are mock secure memfds */
+	bool secure;			/* protected memory: no cache choice, the heap as named */
+} DmabufHeap;
+
+/*
+ * spec is "ion:<heap mask>[:<flags>]", "dma_heap:<name>", "memfd" or
+ * "mock-secure". False, with a message on stderr, when the allocator is
+ * not there or not built in. A heap holding protected memory should have
+ * secure set before allocating; mock-secure sets it itself.
+ */
+bool dmabufHeapOpen(DmabufHeap* heap, const char* spec);
+void dmabufHeapClose(DmabufHeap* heap);
+
+/*
+ * A new buffer of len bytes, as an fd the caller closes; -errno on
+ * failure. ION takes cached as ION_FLAG_CACHED; a dma_heap uses its
+ * -uncached twin for !cached when it has one and fails otherwise; a
+ * memfd is always cached. A secure heap ignores cached.
+ */
+int dmabufAlloc(DmabufHeap* heap, size_t len, bool cached);
+
+/*
+ * What a consumer does with a buffer fd it was handed: its own reference
+ * and the size. Returns the new fd or -errno.
+ */
+int dmabufImport(int fd, size_t* size);
+
+#endif
@@ -0,0 +1,148 @@
+/*
+ * dmabufpool.cpp
+ * Same size dma-buf recycling with an LRU byte budget.
+ */
+
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "dmabufpool.h"
+
+bool dmabufBufferAlloc(DmabufHeap* heap, size_t size, bool cached, bool map, DmabufBuffer* buffer)
+{
+	int fd = dmabufAlloc(heap, size, cached);
+	if(fd < 0) {
+		return false;
+	}
+	buffer->fd = fd;
+	buffer->size = size;
+	buffer->cached = cached;
+	buffer->addr = NULL;
+	if(map) {
+		void* addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if(addr == MAP_FAILED) {
+			close(fd);
+			return false;
+		}
+		buffer->addr = addr;
+	}
+	return true;
+}
+
+void dmabufBufferFree(DmabufBuffer* buffer)
+{
+	if(buffer->addr) {
+		munmap(buffer->addr, buffer->size);
+	}
+	close(buffer->fd);
+	buffer->fd = -1;
+	buffer->addr = NULL;
+}
+
+void dmabufPoolInit(DmabufPool* pool, DmabufHeap* heap, size_t maxBytes, bool map)
+{
+	memset(pool, 0, sizeof(*pool));
+	pool->heap = heap;
+	pool->maxBytes = maxBytes;
+	pool->map = map;
+	pthread_mutex_init(&pool->lock, NULL);
+}
+
+void dmabufPoolDestroy(DmabufPool* pool)
+{
+	dmabufPoolTrim(pool, 0);
+	pthread_mutex_destroy(&pool->lock);
+}
+
+static void removeFree(DmabufPool* pool, int i)
+{
+	pool->stats.bytesFree -= pool->free[i].size;
+	pool->numFree--;
+	pool->free[i] = pool->free[pool->numFree];
+	pool->freeStamp[i] = pool->freeStamp[pool->numFree];
+}
+
+/* The oldest free buffer goes; called with the lock held, returns false when empty. */
+static bool evictOldest(DmabufPool* pool)
+{
+	if(pool->numFree == 0) {
+		return false;
+	}
+	int oldest = 0;
+	for(int i=1; i<pool->numFree; i++) {
+		if(pool->freeStamp[i] < pool->freeStamp[oldest]) {
+			oldest = i;
+		}
+	}
+	DmabufBuffer victim = pool->free[oldest];
+	removeFree(pool, oldest);
+	pool->stats.evictions++;
+	dmabufBufferFree(&victim);
+	return true;
+}
+
+bool dmabufPoolGet(DmabufPool* pool, size_t size, bool cached, DmabufBuffer* buffer)
+{
+	pthread_mutex_lock(&pool->lock);
+	/* the most recently returned match, its pages are the likeliest still in cache */
+	int best = -1;
+	for(int i=0; i<pool->numFree; i++) {
+		if(pool->free[i].size == size && pool->free[i].cached == cached &&
+				(best < 0 || pool->freeStamp[i] > pool->freeStamp[best])) {
+			best = i;
+		}
+	}
+	if(best >= 0) {
+		*buffer = pool->free[best];
+		removeFree(pool, best);
+		pool->stats.hits++;
+		pthread_mutex_unlock(&pool->lock);
+		return true;
+	}
+	pool->stats.misses++;
+	pthread_mutex_unlock(&pool->lock);
+
+	/* allocation can take milliseconds, other threads keep using the pool meanwhile */
+	if(!dmabufBufferAlloc(pool->heap, size, cached, pool->map, buffer)) {
+		pthread_mutex_lock(&pool->lock);
+		pool->stats.failures++;
+		pthread_mutex_unlock(&pool->lock);
+		return false;
+	}
+	return true;
+}
+
+void dmabufPoolPut(DmabufPool* pool, DmabufBuffer* buffer)
+{
+	if(buffer->size > pool->maxBytes) {
+		dmabufBufferFree(buffer);
+		return;
+	}
+	pthread_mutex_lock(&pool->lock);
+	while(pool->numFree == DMABUF_POOL_MAX_FREE || pool->stats.bytesFree + buffer->size > pool->maxBytes) {
+		evictOldest(pool);
+	}
+	pool->free[pool->numFree] = *buffer;
+	pool->freeStamp[pool->numFree] = ++pool->clock;
+	pool->numFree++;
+	pool->stats.bytesFree += buffer->size;
+	pthread_mutex_unlock(&pool->lock);
+	buffer->fd = -1;
+	buffer->addr = NULL;
+}
+
+void dmabufPoolTrim(DmabufPool* pool, size_t maxBytes)
+{
+	pthread_mutex_lock(&pool->lock);
+	while(pool->stats.bytesFree > maxBytes && evictOldest(pool)) {
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+void dmabufPoolGetStats(DmabufPool* pool, DmabufPoolStats* stats)
+{
+	pthread_mutex_lock(&pool->lock);
+	*stats = pool->stats;
+	pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,63 @@
+/*
+ * dmabufpool.h
+ * Recycles dma-bufs of the sizes a pipeline keeps asking for. A buffer put
+ * back is kept, mapped if it was, and the next get of the same size and
+ * cache flag takes it again, so a steady stream of frames pays for
+ * allocation, mmap and the first touch of every page only once. Past
+ * maxBytes the least recently returned buffers are freed.
+ */
+
+#ifndef DMABUFPOOL_H
+#define DMABUFPOOL_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "dmabuf.h"
+
+#define DMABUF_POOL_MAX_FREE	64
+
+typedef struct {
+	int fd;
+	void* addr;			/* NULL when not mapped */
+	size_t size;
+	bool cached;
+} DmabufBuffer;
+
+typedef struct {
+	uint64_t hits;
+	uint64_t misses;		/* allocated from the heap */
+	uint64_t evictions;		/* freed to stay under maxBytes or the slot count */
+	uint64_t failures;
+	size_t bytesFree;		/* held in the pool right now */
+} DmabufPoolStats;
+
+typedef struct {
+	DmabufHeap* heap;
+	size_t maxBytes;
+	bool map;			/* hand buffers out mapped read/write */
+
+	pthread_mutex_t lock;
+	DmabufBuffer free[DMABUF_POOL_MAX_FREE];
+	uint64_t freeStamp[DMABUF_POOL_MAX_FREE];	/* when put back, for LRU */
+	int numFree;
+	uint64_t clock;
+	DmabufPoolStats stats;
+} DmabufPool;
+
+void dmabufPoolInit(DmabufPool* pool, DmabufHeap* heap, size_t maxBytes, bool map);
+/* frees everything still in the pool; buffers handed out stay the caller's */
+void dmabufPoolDestroy(DmabufPool* pool);
+
+/* a buffer of exactly size bytes, reused when one is free; false on failure */
+bool dmabufPoolGet(DmabufPool* pool, size_t size, bool cached, DmabufBuffer* buffer);
+void dmabufPoolPut(DmabufPool* pool, DmabufBuffer* buffer);
+/* frees least recently used buffers until at most maxBytes are held */
+void dmabufPoolTrim(DmabufPool* pool, size_t maxBytes);
+void dmabufPoolGetStats(DmabufPool* pool, DmabufPoolStats* stats);
+
+/* an unpooled buffer, mapped when map is set */
+bool dmabufBufferAlloc(DmabufHeap* heap, size_t size, bool cached, bool map, DmabufBuffer* buffer);
+void dmabufBufferFree(DmabufBuffer* buffer);
+
+#endif
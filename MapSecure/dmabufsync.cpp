@@ -0,0 +1,184 @@
+/*
+ * dmabufsync.cpp
+ * Batched DMA_BUF_IOCTL_SYNC brackets for CPU access.
+ */
+
+#include <errno.h>
+#include <linux/dma-buf.h>
+#include <string.h>
+#include <sys/ioctl.h>
+
+#include "dmabufsync.h"
+
+static int syncFlags(int access)
+{
+	int flags = 0;
+	if(access & DMABUF_ACCESS_READ) flags |= DMA_BUF_SYNC_READ;
+	if(access & DMABUF_ACCESS_WRITE) flags |= DMA_BUF_SYNC_WRITE;
+	return flags;
+}
+
+bool dmabufPartialSync()
+{
+#ifdef DMA_BUF_IOCTL_SYNC_PARTIAL
+	return true;
+#else
+	return false;
+#endif
+}
+
+void dmabufAccessInit(DmabufCpuAccess* a, DmabufBuffer* buffer)
+{
+	memset(a, 0, sizeof(*a));
+	a->buffer = buffer;
+}
+
+/* Merges ranges[i] and ranges[i + 1] into ranges[i]. */
+static void mergeWithNext(DmabufCpuAccess* a, int i)
+{
+	DmabufRange* r = &a->ranges[i];
+	DmabufRange* next = &a->ranges[i + 1];
+	size_t end = r->offset + r->len;
+	size_t nextEnd = next->offset + next->len;
+	r->len = (end > nextEnd ? end : nextEnd) - r->offset;
+	r->access |= next->access;
+	memmove(next, next + 1, sizeof(DmabufRange)*(a->numRanges - i - 2));
+	a->numRanges--;
+}
+
+bool dmabufAccessAdd(DmabufCpuAccess* a, size_t offset, size_t len, int access)
+{
+	if(a->begun || len == 0 || offset > a->buffer->size || len > a->buffer->size - offset) {
+		return false;
+	}
+	int i = 0;
+	while(i < a->numRanges && a->ranges[i].offset < offset) {
+		i++;
+	}
+	if(a->numRanges == DMABUF_ACCESS_MAX_RANGES) {
+		/* no room: fold the two closest ranges together first */
+		int best = 0;
+		size_t bestGap = (size_t)-1;
+		for(int j=0; j+1<a->numRanges; j++) {
+			size_t end = a->ranges[j].offset + a->ranges[j].len;
+			size_t gap = a->ranges[j + 1].offset > end ? a->ranges[j + 1].offset - end : 0;
+			if(gap < bestGap) {
+				bestGap = gap;
+				best = j;
+			}
+		}
+		mergeWithNext(a, best);
+		i = 0;
+		while(i < a->numRanges && a->ranges[i].offset < offset) {
+			i++;
+		}
+	}
+	memmove(&a->ranges[i + 1], &a->ranges[i], sizeof(DmabufRange)*(a->numRanges - i));
+	a->ranges[i].offset = offset;
+	a->ranges[i].len = len;
+	a->ranges[i].access = access;
+	a->numRanges++;
+
+	/* touching or overlapping neighbours become one range */
+	if(i > 0 && a->ranges[i - 1].offset + a->ranges[i - 1].len >= offset) {
+		i--;
+		mergeWithNext(a, i);
+	}
+	while(i + 1 < a->numRanges && a->ranges[i].offset + a->ranges[i].len >= a->ranges[i + 1].offset) {
+		mergeWithNext(a, i);
+	}
+	return true;
+}
+
+static int syncOne(DmabufCpuAccess* a, int flags, size_t offset, size_t len)
+{
+	a->syncs++;
+	a->bytesSynced += len;
+	if(a->noSync) {
+		return 0;
+	}
+	int ret;
+	/* exporters wait for fences interruptibly in begin_cpu_access */
+	do {
+#ifdef DMA_BUF_IOCTL_SYNC_PARTIAL
+		struct dma_buf_sync_partial partial;
+		partial.flags = flags;
+		partial.offset = offset;
+		partial.len = len;
+		ret = ioctl(a->buffer->fd, DMA_BUF_IOCTL_SYNC_PARTIAL, &partial);
+#else
+		(void)offset;
+		struct dma_buf_sync sync;
+		sync.flags = flags;
+		ret = ioctl(a->buffer->fd, DMA_BUF_IOCTL_SYNC, &sync);
+#endif
+	} while(ret < 0 && (errno == EINTR || errno == EAGAIN));
+	if(ret < 0) {
+		if(errno == ENOTTY || errno == EINVAL) {
+			/* not a dma-buf, or one without CPU access ops: nothing to keep coherent */
+			a->noSync = true;
+			return 0;
+		}
+		return -errno;
+	}
+	return 0;
+}
+
+static int syncBatch(DmabufCpuAccess* a, int phase)
+{
+	if(dmabufPartialSync()) {
+		for(int i=0; i<a->numRanges; i++) {
+			int ret = syncOne(a, phase | syncFlags(a->ranges[i].access), a->ranges[i].offset, a->ranges[i].len);
+			if(ret < 0) {
+				/* a failed start leaves no range begun */
+				for(int j=0; phase == DMA_BUF_SYNC_START && j<i; j++) {
+					syncOne(a, DMA_BUF_SYNC_END | syncFlags(a->ranges[j].access), a->ranges[j].offset,
+							a->ranges[j].len);
+				}
+				return ret;
+			}
+		}
+		return 0;
+	}
+	/* whole buffer syncs: one for the batch, with every access asked for */
+	int access = 0;
+	for(int i=0; i<a->numRanges; i++) {
+		access |= a->ranges[i].access;
+	}
+	return a->numRanges ? syncOne(a, phase | syncFlags(access), 0, a->buffer->size) : 0;
+}
+
+int dmabufAccessBegin(DmabufCpuAccess* a)
+{
+	if(a->begun) {
+		return -EBUSY;
+	}
+	int ret = syncBatch(a, DMA_BUF_SYNC_START);
+	a->begun = ret == 0;
+	if(ret < 0) {
+		a->numRanges = 0;
+	}
+	return ret;
+}
+
+int dmabufAccessEnd(DmabufCpuAccess* a)
+{
+	if(!a->begun) {
+		return -EINVAL;
+	}
+	int ret = syncBatch(a, DMA_BUF_SYNC_END);
+	a->begun = false;
+	a->numRanges = 0;
+	return ret;
+}
+
+void* dmabufAccessRange(DmabufCpuAccess* a, size_t offset, size_t len, int access)
+{
+	if(!a->buffer->addr || !dmabufAccessAdd(a, offset, len, access)) {
+		return NULL;
+	}
+	if(dmabufAccessBegin(a) != 0) {
+		return NULL;
+	}
+	return (uint8_t*)a->buffer->addr + offset;
+}
@@ -0,0 +1,74 @@
+/*
+ * dmabufsync.h
+ * CPU access to a mapped dma-buf, bracketed by DMA_BUF_IOCTL_SYNC as the
+ * kernel wants for cached buffers: start before touching, so the CPU
+ * caches see what a device wrote, and end after, so a device sees what
+ * the CPU wrote.
+ *
+ * Ranges are collected first and synced as a batch: overlapping and
+ * adjacent ones are merged, and where the kernel only syncs whole buffers,
+ * as upstream does, the whole batch costs a single start and a single end.
+ * With a kernel header that has DMA_BUF_IOCTL_SYNC_PARTIAL, each merged
+ * range is synced on its own and nothing outside them is.
+ *
+ * A buffer whose fd does not take the ioctl (a memfd stand-in) is
+ * noticed once and its syncs are skipped, still counted.
+ */
+
+#ifndef DMABUFSYNC_H
+#define DMABUFSYNC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dmabufpool.h"
+
+#define DMABUF_ACCESS_READ	(1 << 0)
+#define DMABUF_ACCESS_WRITE	(1 << 1)
+#define DMABUF_ACCESS_RW	(DMABUF_ACCESS_READ | DMABUF_ACCESS_WRITE)
+
+#define DMABUF_ACCESS_MAX_RANGES	32
+
+typedef struct {
+	size_t offset;
+	size_t len;
+	int access;
+} DmabufRange;
+
+typedef struct {
+	DmabufBuffer* buffer;
+	DmabufRange ranges[DMABUF_ACCESS_MAX_RANGES];	/* sorted, merged */
+	int numRanges;
+	bool begun;
+	bool noSync;			/* the fd is not a dma-buf that syncs */
+
+	/* since init */
+	uint64_t syncs;			/* ioctls issued, or skipped under noSync */
+	uint64_t bytesSynced;
+} DmabufCpuAccess;
+
+void dmabufAccessInit(DmabufCpuAccess* a, DmabufBuffer* buffer);
+
+/*
+ * Adds [offset, offset + len) to the next batch. A batch that is full
+ * gets the new range merged into its closest neighbour, syncing a little
+ * more than asked. False when the range is outside the buffer or the
+ * batch has already begun.
+ */
+bool dmabufAccessAdd(DmabufCpuAccess* a, size_t offset, size_t len, int access);
+/*
+ * Starts CPU access to every range added; returns 0 or -errno. Syncs
+ * interrupted by a signal are retried. On failure nothing is left begun,
+ * the batch is emptied, and the CPU must not touch the ranges.
+ */
+int dmabufAccessBegin(DmabufCpuAccess* a);
+/* Ends it and empties the batch for the next one. */
+int dmabufAccessEnd(DmabufCpuAccess* a);
+
+/* One range on its own: add and begin, the pointer to it, or NULL. */
+void* dmabufAccessRange(DmabufCpuAccess* a, size_t offset, size_t len, int access);
+
+/* True when the kernel header offers ranged syncs, false for whole buffer ones. */
+bool dmabufPartialSync();
+
+#endif
@@ -1,40 +1,541 @@
-#include <cutils/memory.h>
-#include <utils/Log.h>
+/*
+ * test.cpp
+ * dma-buf allocator benchmark: what allocating, mapping, first touching
+ * and freeing a buffer costs on a heap, by size and cache flag, and what
+ * a pool of recycled buffers saves a pipeline that wants one per frame,
+ * and what protected playback pays to move buffers it cannot map.
+ *
+ * usage: secure_mmap_test bench [heap] [cached|uncached|both] [minSize] [maxSize]
+ *        secure_mmap_test pool [heap] [frames] [size] [inFlight]
+ *        secure_mmap_test sync [heap] [size] [reps]
+ *        secure_mmap_test secure [heap] [frames] [fps] [size]
+ *        secure_mmap_test hold [heap]
+ * heap is "ion:<mask>[:<flags>]", "dma_heap:<name>", "memfd" or
+ * "mock-secure"; the default is ion:4 where ION is built in and memfd
+ * elsewhere. Sizes take K and M.
+ * bench, pool and sync print CSV. sync compares CPU access to a cached
+ * buffer inside DMA_BUF_IOCTL_SYNC brackets with access to an uncached,
+ * write-combined one, for a full fill, sparse small updates and a full
+ * readback. secure wants a secure heap (a vendor dma_heap, ion with its
+ * secure flag, or mock-secure on a host): it checks that the CPU cannot
+ * map a buffer, then times the allocate, import and free each protected
+ * frame goes through against the frame period, and fails when a frame
+ * misses it, so it can gate playback changes. A second, "reuse" row
+ * takes the buffers from an in-process pool instead: it shows what
+ * recycling saves, never reaches the heap, and does not gate. hold
+ * allocates 10000 pages, maps them and sleeps, for looking
+ * at the buffer from outside.
+ */
 
 #include <sys/mman.h>
-#include <sys/mman.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <memory.h>
 #include <string.h>
-#include <ion_4.12.h>
-#define ION_FLAG_CACHED 1 
-#include <ion/ion.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dmabuf.h"
+#include "dmabufpool.h"
+#include "dmabufsync.h"
+
+#if DMABUF_HAVE_ION
+#define DEFAULT_HEAP	"ion:4"
+#else
+#define DEFAULT_HEAP	"memfd"
+#endif
+
+#define MAX_REPS	256
+#define MAX_FRAMES	100000
+#define MAX_IN_FLIGHT	32
+#define SPARSE_REGIONS	64
+#define SPARSE_BYTES	256
+#define SECURE_STAGES	4
+
+static long pageSize;
+
+static int64_t nowNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+static int compareTimes(const void* a, const void* b)
+{
+	int64_t x = *(const int64_t*)a;
+	int64_t y = *(const int64_t*)b;
+	return x < y ? -1 : x > y;
+}
+
+static size_t parseSize(const char* s)
+{
+	char* end;
+	double v = strtod(s, &end);
+	switch(*end) {
+	case 'k': case 'K': v *= 1024; break;
+	case 'm': case 'M': v *= 1024*1024; break;
+	}
+	return (size_t)v;
+}
+
+static void touchPages(void* p, size_t size)
+{
+	volatile char* c = (volatile char*)p;
+	for(size_t off=0; off<size; off+=pageSize) {
+		c[off] = 1;
+	}
+}
+
+/*
+ * One row: reps buffers of size allocated, mapped, touched, unmapped and
+ * freed one at a time, each step timed on its own.
+ */
+static bool benchSize(DmabufHeap* heap, size_t size, bool cached)
+{
+	static int64_t allocs[MAX_REPS];
+	int64_t mapTotal = 0, touchTotal = 0, unmapTotal = 0, freeTotal = 0;
+	long reps = (long)((size_t)64*1024*1024/size);
+	reps = reps < 8 ? 8 : (reps > MAX_REPS ? MAX_REPS : reps);
+
+	for(long r=0; r<reps; r++) {
+		int64_t t0 = nowNs();
+		int fd = dmabufAlloc(heap, size, cached);
+		int64_t t1 = nowNs();
+		if(fd < 0) {
+			printf("%s,%d,%zu,%ld,-1,,,,,\n", heap->name, cached, size, reps);
+			return false;
+		}
+		void* addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		int64_t t2 = nowNs();
+		if(addr == MAP_FAILED) {
+			close(fd);
+			printf("%s,%d,%zu,%ld,-1,,,,,\n", heap->name, cached, size, reps);
+			return false;
+		}
+		touchPages(addr, size);
+		int64_t t3 = nowNs();
+		munmap(addr, size);
+		int64_t t4 = nowNs();
+		close(fd);
+		int64_t t5 = nowNs();
+		allocs[r] = t1 - t0;
+		mapTotal += t2 - t1;
+		touchTotal += t3 - t2;
+		unmapTotal += t4 - t3;
+		freeTotal += t5 - t4;
+	}
+	qsort(allocs, reps, sizeof(int64_t), compareTimes);
+	printf("%s,%d,%zu,%ld,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n", heap->name, cached, size, reps,
+			allocs[reps/2]/1e3, allocs[reps*99/100]/1e3, mapTotal/1e3/reps, touchTotal/1e3/reps,
+			unmapTotal/1e3/reps, freeTotal/1e3/reps);
+	fflush(stdout);
+	return true;
+}
+
+static int runBench(DmabufHeap* heap, const char* cache, size_t minSize, size_t maxSize)
+{
+	printf("heap,cached,size,reps,alloc_p50_us,alloc_p99_us,mmap_us,touch_us,munmap_us,free_us\n");
+	for(int cached=1; cached>=0; cached--) {
+		if((cached && strcmp(cache, "uncached") == 0) || (!cached && strcmp(cache, "cached") == 0)) {
+			continue;
+		}
+		for(size_t size=minSize; size<=maxSize; size*=4) {
+			if(!benchSize(heap, size, cached)) {
+				break;	/* bigger ones will not do better */
+			}
+		}
+	}
+	return 0;
+}
+
+/*
+ * A decoder's view: every frame takes a buffer, writes all of it and
+ * hands it on; it comes back inFlight frames later. Once with a fresh
+ * buffer per frame, once through the pool.
+ */
+static void runPipeline(DmabufHeap* heap, DmabufPool* pool, int frames, size_t size, int inFlight)
+{
+	static int64_t times[MAX_FRAMES];
+	DmabufBuffer ring[MAX_IN_FLIGHT];
+	int failed = 0;
+	memset(ring, 0, sizeof(ring));
+	for(int i=0; i<inFlight; i++) {
+		ring[i].fd = -1;
+	}
+
+	for(int f=0; f<frames; f++) {
+		DmabufBuffer* slot = &ring[f % inFlight];
+		if(slot->fd >= 0) {
+			if(pool) {
+				dmabufPoolPut(pool, slot);
+			} else {
+				dmabufBufferFree(slot);
+			}
+		}
+		int64_t start = nowNs();
+		bool ok = pool ? dmabufPoolGet(pool, size, true, slot) : dmabufBufferAlloc(heap, size, true, true, slot);
+		if(!ok) {
+			slot->fd = -1;
+			times[f] = 0;
+			failed++;
+			continue;
+		}
+		memset(slot->addr, f & 0xff, size);
+		times[f] = nowNs() - start;
+	}
+	for(int i=0; i<inFlight; i++) {
+		if(ring[i].fd >= 0) {
+			if(pool) {
+				dmabufPoolPut(pool, &ring[i]);
+			} else {
+				dmabufBufferFree(&ring[i]);
+			}
+		}
+	}
+
+	int64_t total = 0;
+	for(int f=0; f<frames; f++) {
+		total += times[f];
+	}
+	qsort(times, frames, sizeof(int64_t), compareTimes);
+	DmabufPoolStats stats;
+	memset(&stats, 0, sizeof(stats));
+	if(pool) {
+		dmabufPoolGetStats(pool, &stats);
+	}
+	printf("%s,%s,%d,%zu,%d,%.2f,%.2f,%.2f,%.2f,%llu,%llu,%d\n", heap->name, pool ? "pool" : "alloc",
+			frames, size, inFlight, total/1e3/frames, times[frames/2]/1e3, times[frames*99/100]/1e3,
+			times[frames - 1]/1e3, (unsigned long long)stats.hits, (unsigned long long)stats.misses, failed);
+	fflush(stdout);
+}
+
+static int runPool(DmabufHeap* heap, int frames, size_t size, int inFlight)
+{
+	printf("heap,mode,frames,size,in_flight,mean_us,p50_us,p99_us,max_us,hits,misses,failures\n");
+	runPipeline(heap, NULL, frames, size, inFlight);
+	DmabufPool pool;
+	/* room for a full set in flight and one more */
+	dmabufPoolInit(&pool, heap, size*(inFlight + 1), true);
+	runPipeline(heap, &pool, frames, size, inFlight);
+	dmabufPoolDestroy(&pool);
+	return 0;
+}
+
+enum {
+	SYNC_NONE,			/* cached without brackets: wrong, for the cost of them */
+	SYNC_EACH,			/* a start and end around every region */
+	SYNC_BATCH,			/* all regions in one batch */
+	NUM_SYNC_MODES,
+};
+
+static const char* syncModeNames[NUM_SYNC_MODES] = { "nosync", "sync-each", "sync-batch" };
+
+static void syncRow(const char* heapName, const char* pattern, const char* variant, size_t size, int reps,
+		int64_t ns, uint64_t syncs, size_t bytesPerIter)
+{
+	if(ns < 0) {
+		printf("%s,%s,%s,%zu,%d,-1,,\n", heapName, pattern, variant, size, reps);
+		return;
+	}
+	printf("%s,%s,%s,%zu,%d,%.2f,%.1f,%.1f\n", heapName, pattern, variant, size, reps, ns/1e3/reps,
+			(double)syncs/reps, (double)bytesPerIter*reps*1e9/ns/(1024*1024));
+	fflush(stdout);
+}
+
+/*
+ * One pattern on one buffer. Region offsets for sparse updates come from
+ * the same seed for every variant, so each does the same work.
+ */
+static int64_t runPattern(DmabufBuffer* buffer, const char* pattern, int mode, int reps, uint64_t* syncs)
+{
+	static volatile uint64_t sink;
+	DmabufCpuAccess a;
+	dmabufAccessInit(&a, buffer);
+	uint8_t* base = (uint8_t*)buffer->addr;
+	size_t size = buffer->size;
+	bool uncached = !buffer->cached;
+	/* accesses skipped because their sync failed */
+	int skipped = 0;
+	srand(1);
+
+	int64_t start = nowNs();
+	for(int r=0; r<reps; r++) {
+		if(strcmp(pattern, "fill") == 0) {
+			if(!uncached && mode != SYNC_NONE && !dmabufAccessRange(&a, 0, size, DMABUF_ACCESS_WRITE)) {
+				skipped++;
+				continue;
+			}
+			memset(base, r & 0xff, size);
+			if(a.begun) {
+				dmabufAccessEnd(&a);
+			}
+		} else if(strcmp(pattern, "sparse") == 0) {
+			size_t offsets[SPARSE_REGIONS];
+			for(int i=0; i<SPARSE_REGIONS; i++) {
+				offsets[i] = (size_t)rand() % (size/SPARSE_BYTES)*SPARSE_BYTES;
+			}
+			if(!uncached && mode == SYNC_BATCH) {
+				for(int i=0; i<SPARSE_REGIONS; i++) {
+					dmabufAccessAdd(&a, offsets[i], SPARSE_BYTES, DMABUF_ACCESS_WRITE);
+				}
+				if(dmabufAccessBegin(&a) != 0) {
+					skipped++;
+					continue;
+				}
+			}
+			for(int i=0; i<SPARSE_REGIONS; i++) {
+				if(!uncached && mode == SYNC_EACH && !dmabufAccessRange(&a, offsets[i], SPARSE_BYTES,
+						DMABUF_ACCESS_WRITE)) {
+					skipped++;
+					continue;
+				}
+				memset(base + offsets[i], r & 0xff, SPARSE_BYTES);
+				if(!uncached && mode == SYNC_EACH) {
+					dmabufAccessEnd(&a);
+				}
+			}
+			if(a.begun) {
+				dmabufAccessEnd(&a);
+			}
+		} else {
+			if(!uncached && mode != SYNC_NONE && !dmabufAccessRange(&a, 0, size, DMABUF_ACCESS_READ)) {
+				skipped++;
+				continue;
+			}
+			const uint64_t* w = (const uint64_t*)base;
+			uint64_t sum = 0;
+			for(size_t i=0; i<size/sizeof(uint64_t); i++) {
+				sum += w[i];
+			}
+			sink += sum;
+			if(a.begun) {
+				dmabufAccessEnd(&a);
+			}
+		}
+	}
+	int64_t ns = nowNs() - start;
+	*syncs = a.syncs;
+	if(skipped) {
+		/* the time is for less work than the row claims */
+		printf("# %s %s: %d accesses skipped, DMA_BUF_IOCTL_SYNC failed\n", buffer->cached ? "cached" : "uncached",
+				pattern, skipped);
+		return -1;
+	}
+	return ns;
+}
+
+static int runSync(DmabufHeap* heap, size_t size, int reps)
+{
+	static const char* patterns[] = { "fill", "sparse", "readback" };
+	printf("# %s syncs, %s\n", dmabufPartialSync() ? "ranged" : "whole buffer", heap->name);
+	printf("heap,pattern,variant,size,reps,us_per_iter,syncs_per_iter,mb_per_s\n");
+	DmabufBuffer cached, uncached;
+	bool haveCached = dmabufBufferAlloc(heap, size, true, true, &cached);
+	bool haveUncached = dmabufBufferAlloc(heap, size, false, true, &uncached);
+	if(haveCached) {
+		memset(cached.addr, 0, size);
+	}
+	if(haveUncached) {
+		memset(uncached.addr, 0, size);
+	}
+
+	for(int p=0; p<3; p++) {
+		bool sparse = p == 1;
+		size_t bytes = sparse ? SPARSE_REGIONS*SPARSE_BYTES : size;
+		for(int mode=0; mode<NUM_SYNC_MODES; mode++) {
+			if(mode == SYNC_BATCH && !sparse) {
+				continue;	/* one range, nothing to batch */
+			}
+			char variant[32];
+			snprintf(variant, sizeof(variant), "cached-%s", sparse ? syncModeNames[mode] :
+					(mode == SYNC_NONE ? "nosync" : "sync"));
+			uint64_t syncs = 0;
+			int64_t ns = haveCached ? runPattern(&cached, patterns[p], mode, reps, &syncs) : -1;
+			syncRow(heap->name, patterns[p], variant, size, reps, ns, syncs, bytes);
+		}
+		uint64_t syncs = 0;
+		int64_t ns = haveUncached ? runPattern(&uncached, patterns[p], SYNC_NONE, reps, &syncs) : -1;
+		syncRow(heap->name, patterns[p], "uncached", size, reps, ns, syncs, bytes);
+	}
+	if(haveCached) {
+		dmabufBufferFree(&cached);
+	}
+	if(haveUncached) {
+		dmabufBufferFree(&uncached);
+	}
+	return 0;
+}
+
+/* True when the CPU can map fd either way, which a secure heap must refuse. */
+static bool cpuCanMap(int fd, size_t size)
+{
+	static const int prots[] = { PROT_READ, PROT_READ | PROT_WRITE };
+	bool mapped = false;
+	for(int i=0; i<2; i++) {
+		void* addr = mmap(NULL, size, prots[i], MAP_SHARED, fd, 0);
+		if(addr != MAP_FAILED) {
+			munmap(addr, size);
+			mapped = true;
+		}
+	}
+	return mapped;
+}
+
+/*
+ * Protected frames as they go from decoder to display: the decoder
+ * allocates, the consumer imports its own reference and learns the size,
+ * then both let go. Nothing is mapped, there is nothing the CPU could
+ * touch. Each stage is timed per frame; the row fails when the p99 frame
+ * does not fit the frame period. With a pool the buffers are recycled
+ * once it holds them, so the alloc and free columns are reuse costs.
+ */
+static bool runSecurePipeline(DmabufHeap* heap, DmabufPool* pool, int frames, int fps, size_t size)
+{
+	static int64_t times[SECURE_STAGES][MAX_FRAMES];
+	int64_t budget = 1000000000LL/fps;
+	int failed = 0;
+	int overBudget = 0;
+
+	for(int f=0; f<frames; f++) {
+		DmabufBuffer buffer;
+		int64_t t0 = nowNs();
+		bool ok = pool ? dmabufPoolGet(pool, size, false, &buffer) : dmabufBufferAlloc(heap, size, false, false, &buffer);
+		int64_t t1 = nowNs();
+		size_t imported = 0;
+		int fd = ok ? dmabufImport(buffer.fd, &imported) : -1;
+		int64_t t2 = nowNs();
+		if(fd >= 0) {
+			close(fd);
+		}
+		if(ok) {
+			if(pool) {
+				dmabufPoolPut(pool, &buffer);
+			} else {
+				dmabufBufferFree(&buffer);
+			}
+		}
+		int64_t t3 = nowNs();
+		if(fd < 0 || imported < size) {
+			failed++;
+		}
+		times[0][f] = t1 - t0;
+		times[1][f] = t2 - t1;
+		times[2][f] = t3 - t2;
+		times[3][f] = t3 - t0;
+		overBudget += t3 - t0 > budget ? 1 : 0;
+	}
+
+	for(int s=0; s<SECURE_STAGES; s++) {
+		qsort(times[s], frames, sizeof(int64_t), compareTimes);
+	}
+	int64_t p99 = times[3][frames*99/100];
+	printf("%s,%s,%d,%zu,%d,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.0f,%d,%d\n", heap->name,
+			pool ? "reuse" : "alloc", frames, size, fps,
+			times[0][frames/2]/1e3, times[0][frames*99/100]/1e3, times[1][frames/2]/1e3,
+			times[1][frames*99/100]/1e3, times[2][frames/2]/1e3, times[2][frames*99/100]/1e3,
+			times[3][frames/2]/1e3, p99/1e3, p99 > 0 ? 1e9/p99 : 0, overBudget, failed);
+	fflush(stdout);
+	return failed == 0 && p99 <= budget;
+}
+
+static int runSecure(DmabufHeap* heap, int frames, int fps, size_t size)
+{
+	/* buffers come from the heap as named, whatever the cached flag says */
+	heap->secure = true;
+	int fd = dmabufAlloc(heap, size, false);
+	if(fd < 0) {
+		printf("# %s: cannot allocate a %zu byte protected buffer: %s\n", heap->name, size, strerror(-fd));
+		return 1;
+	}
+	bool mappable = cpuCanMap(fd, size);
+	close(fd);
+	printf("# %s: cpu mmap %s\n", heap->name, mappable ? "allowed, not a secure heap" : "refused");
+
+	printf("heap,mode,frames,size,fps,alloc_p50_us,alloc_p99_us,import_p50_us,import_p99_us,"
+			"free_p50_us,free_p99_us,frame_p50_us,frame_p99_us,max_fps,over_budget,failures\n");
+	bool ok = runSecurePipeline(heap, NULL, frames, fps, size);
+	DmabufPool pool;
+	/* decoders keep a handful of protected buffers, the pool keeps as many */
+	dmabufPoolInit(&pool, heap, size*8, false);
+	printf("# reuse: buffers recycled in process, not the heap's cost, not gated\n");
+	runSecurePipeline(heap, &pool, frames, fps, size);
+	dmabufPoolDestroy(&pool);
+	return ok && !mappable ? 0 : 1;
+}
+
+/* What this tool used to do, without leaking the fd or mapping one page of many. */
+static int hold(DmabufHeap* heap)
+{
+	size_t size = (size_t)pageSize*10000;
+	int fd = dmabufAlloc(heap, size, true);
+	printf("heap %s, page size %ld, fd %d\n", heap->name, pageSize, fd);
+	if(fd < 0) {
+		return 1;
+	}
+	void* addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	printf("addr %p, %zu bytes\n", addr, size);
+	sleep(100);
+	if(addr != MAP_FAILED) {
+		munmap(addr, size);
+	}
+	close(fd);
+	return 0;
+}
 
 int main(int argc, char** argv)
 {
-	(void)argc;
-	(void)argv;
-	int ionMemFD;
-  
-  	int ionDeviceFD = ion_open();
-  	
-  	printf("The ionDeviceFD =%d\n", ionDeviceFD);
-  	
-  	const int iPageSize = sysconf(_SC_PAGESIZE);
-  	  	
-  	printf("The page size =%d\n", iPageSize);
-  	
-  	int err = ion_alloc_fd(ionDeviceFD, iPageSize*10000, iPageSize, 4, ION_FLAG_CACHED, &ionMemFD);
-  	
-  	printf("The ionMemFD =%d err=%d\n", ionMemFD, err);
-  	
-  	void * addr = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, ionMemFD, 0);
-  	
-  	printf("The addr =%p\n", addr);
-    
-    
-    sleep(100);
-    
-    return 0;
+	pageSize = sysconf(_SC_PAGESIZE);
+	const char* mode = argc > 1 ? argv[1] : "bench";
+	DmabufHeap heap;
+	if(!dmabufHeapOpen(&heap, argc > 2 ? argv[2] : DEFAULT_HEAP)) {
+		return 1;
+	}
+
+	int ret = 1;
+	if(strcmp(mode, "bench") == 0) {
+		const char* cache = argc > 3 ? argv[3] : "both";
+		size_t minSize = argc > 4 ? parseSize(argv[4]) : 4096;
+		size_t maxSize = argc > 5 ? parseSize(argv[5]) : 16*1024*1024;
+		if(minSize >= (size_t)pageSize && maxSize >= minSize) {
+			ret = runBench(&heap, cache, minSize, maxSize);
+		} else {
+			printf("usage: %s bench [heap] [cached|uncached|both] [minSize] [maxSize]\n", argv[0]);
+		}
+	} else if(strcmp(mode, "pool") == 0) {
+		int frames = argc > 3 ? atoi(argv[3]) : 1000;
+		/* a 1080p NV12 frame */
+		size_t size = argc > 4 ? parseSize(argv[4]) : 1920*1080*3/2;
+		int inFlight = argc > 5 ? atoi(argv[5]) : 4;
+		if(frames > 0 && frames <= MAX_FRAMES && size > 0 && inFlight > 0 && inFlight <= MAX_IN_FLIGHT) {
+			ret = runPool(&heap, frames, size, inFlight);
+		} else {
+			printf("usage: %s pool [heap] [frames 1..%d] [size] [inFlight 1..%d]\n", argv[0],
+					MAX_FRAMES, MAX_IN_FLIGHT);
+		}
+	} else if(strcmp(mode, "sync") == 0) {
+		size_t size = argc > 3 ? parseSize(argv[3]) : 1920*1080*4;
+		int reps = argc > 4 ? atoi(argv[4]) : 100;
+		if(size >= SPARSE_BYTES && reps > 0) {
+			ret = runSync(&heap, size, reps);
+		} else {
+			printf("usage: %s sync [heap] [size >= %d] [reps]\n", argv[0], SPARSE_BYTES);
+		}
+	} else if(strcmp(mode, "secure") == 0) {
+		int frames = argc > 3 ? atoi(argv[3]) : 1000;
+		int fps = argc > 4 ? atoi(argv[4]) : 60;
+		/* a 4K NV12 frame */
+		size_t size = argc > 5 ? parseSize(argv[5]) : 3840*2160*3/2;
+		if(frames > 0 && frames <= MAX_FRAMES && fps > 0 && size > 0) {
+			ret = runSecure(&heap, frames, fps, size);
+		} else {
+			printf("usage: %s secure [heap] [frames 1..%d] [fps] [size]\n", argv[0], MAX_FRAMES);
+		}
+	} else if(strcmp(mode, "hold") == 0) {
+		ret = hold(&heap);
+	} else {
+		printf("usage: %s bench|pool|sync|secure|hold [heap] ...\n", argv[0]);
+	}
+	dmabufHeapClose(&heap);
+	return ret;
 }
@@ -21,3 +21,19 @@ LOCAL_MODULE_TAGS := tests
 
 include $(BUILD_EXECUTABLE)
 
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+		    test.cpp
+
+LOCAL_STATIC_LIBRARIES := \
+		    libhostwindow
+
+LOCAL_LDLIBS := -lpthread
+
+LOCAL_MODULE:= sf_cmd_host
+
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_HOST_EXECUTABLE)
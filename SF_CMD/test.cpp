@@ -1,3 +1,28 @@
+/*
+ * test.cpp
+ * Sends SurfaceFlinger debug transactions (the codes onTransact() takes
+ * past the ISurfaceComposer interface) and times the binder round trip
+ * of each, so toggles flipped during A/B perf runs can be scripted and
+ * their cost seen.
+ *
+ * usage: sf_cmd [-n calls] [-i intervalUs] [-q] <code|name> [args...]
+ *        sf_cmd [-n calls] [-i intervalUs] [-q] -f <script|->
+ *        sf_cmd list
+ *        sf_cmd 0|1
+ * A named code takes the arguments its table entry lists, int32 (i),
+ * int64 (l) or float (f). Any other number is sent as a raw code, its
+ * arguments int32 unless written l:<n> or f:<n>. -n sends each command
+ * that many times, -i waits between calls. A script has one command per
+ * line, each with its own -n and -i if wanted, "sleep <ms>" lines and
+ * '#' comments. The last form is what this tool used to be, the HDR
+ * patch toggle.
+ *
+ * Replies are printed for the first call of each command unless -q. At
+ * the end one CSV row per code:
+ *   code,name,calls,errors,mean_us,p50_us,p90_us,p99_us,max_us
+ * The exit status is 1 when a command is malformed or any call failed.
+ */
+
 #include <cutils/memory.h>
 #include <utils/Log.h>
 
@@ -5,41 +30,367 @@
 #include <binder/ProcessState.h>
 #include <binder/IServiceManager.h>
 
-#include <gui/Surface.h>
-#include <gui/SurfaceComposerClient.h>
-#include <ui/GraphicBufferMapper.h>
-#include <sys/mman.h>
 #include <gui/ISurfaceComposer.h>
-#include <gui/ISurfaceComposerClient.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 using namespace android;
-sp<IBinder> composer = NULL;
+
+#define MAX_ARGS	16
+#define MAX_CODES	64
+#define MAX_LINE	512
+
+typedef struct {
+	uint32_t code;
+	const char* name;
+	const char* args;		/* one of i, l, f per argument */
+	const char* reply;		/* what comes back, the same way */
+	const char* help;
+} DebugCode;
+
+/* As SurfaceFlinger::onTransact() reads them; not every build has all. */
+static const DebugCode debugCodes[] = {
+	{ 1002, "show-updates", "i", "", "flash updated regions, 0 off" },
+	{ 1004, "repaint", "", "", "repaint everything" },
+	{ 1005, "force-transaction", "", "", "force a display transaction" },
+	{ 1006, "refresh", "", "", "send an empty update" },
+	{ 1008, "disable-hwc", "i", "", "compose everything with GLES" },
+	{ 1009, "disable-transform-hint", "i", "", "" },
+	{ 1013, "page-flips", "", "i", "page flip count of the primary display" },
+	{ 1014, "daltonizer", "i", "", "color blindness simulation type, 0 off" },
+	{ 1016, "refresh-skip", "i", "", "vsyncs to skip between refreshes" },
+	{ 1017, "force-full-damage", "i", "", "" },
+	{ 1018, "app-phase", "i", "", "app vsync phase offset, ns" },
+	{ 1019, "sf-phase", "i", "", "sf vsync phase offset, ns" },
+	{ 1020, "interceptor", "i", "", "layer update interceptor, 0 off" },
+	{ 1022, "saturation", "f", "", "global saturation" },
+	{ 1023, "color-setting", "i", "", "display color setting" },
+	{ 1025, "layer-trace", "i", "", "winscope layer tracing, 0 off" },
+	{ 1026, "layer-trace-status", "", "i", "" },
+	{ 2001, "hdr-patch", "i", "", "vendor HDR patch, 0 off" },
+};
+
+#define NUM_DEBUG_CODES	(sizeof(debugCodes)/sizeof(debugCodes[0]))
+
+typedef struct {
+	uint32_t code;
+	const char* name;
+	long calls;
+	long errors;
+	int64_t* samples;
+	long capacity;
+} CodeStats;
+
+typedef struct {
+	long calls;
+	int64_t intervalUs;
+	bool quiet;
+} CallOptions;
+
+static sp<IBinder> composer;
+static CodeStats codeStats[MAX_CODES];
+static int numCodeStats;
+
+static int64_t nowNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+static int compareTimes(const void* a, const void* b)
+{
+	int64_t x = *(const int64_t*)a;
+	int64_t y = *(const int64_t*)b;
+	return x < y ? -1 : x > y;
+}
+
+static const DebugCode* findCode(const char* s)
+{
+	char* end;
+	unsigned long code = strtoul(s, &end, 0);
+	for(size_t i=0; i<NUM_DEBUG_CODES; i++) {
+		if(*end ? strcmp(s, debugCodes[i].name) == 0 : debugCodes[i].code == code) {
+			return &debugCodes[i];
+		}
+	}
+	return NULL;
+}
+
+static CodeStats* statsFor(uint32_t code, const char* name)
+{
+	for(int i=0; i<numCodeStats; i++) {
+		if(codeStats[i].code == code) {
+			return &codeStats[i];
+		}
+	}
+	if(numCodeStats == MAX_CODES) {
+		return NULL;
+	}
+	CodeStats* stats = &codeStats[numCodeStats++];
+	memset(stats, 0, sizeof(*stats));
+	stats->code = code;
+	stats->name = name;
+	return stats;
+}
+
+static void addSample(CodeStats* stats, int64_t ns)
+{
+	if(stats->calls == stats->capacity) {
+		long capacity = stats->capacity ? stats->capacity*2 : 256;
+		int64_t* samples = (int64_t*)realloc(stats->samples, capacity*sizeof(int64_t));
+		if(!samples) {
+			return;
+		}
+		stats->samples = samples;
+		stats->capacity = capacity;
+	}
+	stats->samples[stats->calls++] = ns;
+}
+
+/* Arguments into data, typed by the table entry or by their l:/f: prefix; false if one is bad. */
+static bool writeArgs(Parcel* data, const DebugCode* dc, int argc, char** argv)
+{
+	if(dc && (size_t)argc != strlen(dc->args)) {
+		fprintf(stderr, "%s takes %zu argument%s\n", dc->name, strlen(dc->args), strlen(dc->args) == 1 ? "" : "s");
+		return false;
+	}
+	for(int i=0; i<argc; i++) {
+		const char* arg = argv[i];
+		char type = 'i';
+		if(dc) {
+			type = dc->args[i];
+		} else if((arg[0] == 'l' || arg[0] == 'f') && arg[1] == ':') {
+			type = arg[0];
+			arg += 2;
+		}
+		char* end;
+		switch(type) {
+		case 'i':
+			data->writeInt32((int32_t)strtol(arg, &end, 0));
+			break;
+		case 'l':
+			data->writeInt64((int64_t)strtoll(arg, &end, 0));
+			break;
+		default:
+			data->writeFloat(strtof(arg, &end));
+			break;
+		}
+		if(end == arg || *end) {
+			fprintf(stderr, "bad argument %s\n", argv[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
+static void printReply(const DebugCode* dc, const Parcel& reply)
+{
+	printf("%s:", dc->name);
+	for(const char* r=dc->reply; *r; r++) {
+		switch(*r) {
+		case 'i': printf(" %d", reply.readInt32()); break;
+		case 'l': printf(" %lld", (long long)reply.readInt64()); break;
+		default: printf(" %g", reply.readFloat()); break;
+		}
+	}
+	printf("\n");
+}
+
+/*
+ * One command: [-n calls] [-i intervalUs] <code|name> [args...], the
+ * options overriding defaults for this command only. The parcel is
+ * built once and sent calls times; false when the command is bad.
+ */
+static bool runCommand(int argc, char** argv, CallOptions options)
+{
+	int a = 0;
+	while(a + 1 < argc && argv[a][0] == '-') {
+		if(strcmp(argv[a], "-n") == 0) {
+			options.calls = atol(argv[a + 1]);
+		} else if(strcmp(argv[a], "-i") == 0) {
+			options.intervalUs = atoll(argv[a + 1]);
+		} else {
+			break;
+		}
+		a += 2;
+	}
+	if(a >= argc || options.calls < 1 || options.intervalUs < 0) {
+		fprintf(stderr, "expected [-n calls >= 1] [-i intervalUs] <code|name> [args...]\n");
+		return false;
+	}
+	const DebugCode* dc = findCode(argv[a]);
+	char* end;
+	uint32_t code = dc ? dc->code : (uint32_t)strtoul(argv[a], &end, 0);
+	if(!dc && (end == argv[a] || *end)) {
+		fprintf(stderr, "unknown code %s, see \"sf_cmd list\"\n", argv[a]);
+		return false;
+	}
+	Parcel data;
+	data.writeInterfaceToken(String16("android.ui.ISurfaceComposer"));
+	if(!writeArgs(&data, dc, argc - a - 1, argv + a + 1)) {
+		return false;
+	}
+	CodeStats* stats = statsFor(code, dc ? dc->name : "raw");
+	if(!stats) {
+		fprintf(stderr, "more than %d codes\n", MAX_CODES);
+		return false;
+	}
+
+	for(long c=0; c<options.calls; c++) {
+		if(c > 0 && options.intervalUs > 0) {
+			usleep(options.intervalUs);
+		}
+		Parcel reply;
+		int64_t start = nowNs();
+		status_t err = composer->transact(code, data, &reply, 0);
+		int64_t ns = nowNs() - start;
+		addSample(stats, ns);
+		if(err != NO_ERROR) {
+			stats->errors++;
+			if(!options.quiet && stats->errors == 1) {
+				fprintf(stderr, "%s (%u): error %d\n", stats->name, code, err);
+			}
+		} else if(c == 0 && !options.quiet && dc && *dc->reply) {
+			printReply(dc, reply);
+		}
+	}
+	return true;
+}
+
+/* Splits line in place on blanks; returns the word count. */
+static int splitWords(char* line, char** words, int maxWords)
+{
+	int n = 0;
+	for(char* w=strtok(line, " \t\r\n"); w && n<maxWords; w=strtok(NULL, " \t\r\n")) {
+		words[n++] = w;
+	}
+	return n;
+}
+
+static bool runScript(const char* path, CallOptions options)
+{
+	FILE* f = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+	if(!f) {
+		fprintf(stderr, "cannot open %s\n", path);
+		return false;
+	}
+	char line[MAX_LINE];
+	char* words[MAX_ARGS + 6];
+	int lineNo = 0;
+	bool ok = true;
+	while(ok && fgets(line, sizeof(line), f)) {
+		lineNo++;
+		line[strcspn(line, "#")] = 0;
+		int n = splitWords(line, words, MAX_ARGS + 6);
+		if(n == 0) {
+			continue;
+		}
+		if(strcmp(words[0], "sleep") == 0 && n == 2) {
+			usleep(atoll(words[1])*1000);
+			continue;
+		}
+		ok = runCommand(n, words, options);
+		if(!ok) {
+			fprintf(stderr, "%s:%d: stopped\n", path, lineNo);
+		}
+	}
+	if(f != stdin) {
+		fclose(f);
+	}
+	return ok;
+}
+
+/* Returns the failed calls of every code. */
+static long printStats()
+{
+	long errors = 0;
+	printf("code,name,calls,errors,mean_us,p50_us,p90_us,p99_us,max_us\n");
+	for(int i=0; i<numCodeStats; i++) {
+		CodeStats* stats = &codeStats[i];
+		long n = stats->calls;
+		errors += stats->errors;
+		if(n == 0) {
+			continue;
+		}
+		int64_t total = 0;
+		for(long s=0; s<n; s++) {
+			total += stats->samples[s];
+		}
+		qsort(stats->samples, n, sizeof(int64_t), compareTimes);
+		printf("%u,%s,%ld,%ld,%.2f,%.2f,%.2f,%.2f,%.2f\n", stats->code, stats->name, n, stats->errors,
+				total/1e3/n, stats->samples[n/2]/1e3, stats->samples[n*9/10]/1e3,
+				stats->samples[n*99/100]/1e3, stats->samples[n - 1]/1e3);
+		free(stats->samples);
+	}
+	return errors;
+}
+
+static void usage(const char* argv0)
+{
+	printf("usage: %s [-n calls] [-i intervalUs] [-q] <code|name> [args...]\n", argv0);
+	printf("       %s [-n calls] [-i intervalUs] [-q] -f <script|->\n", argv0);
+	printf("       %s list\n", argv0);
+	printf("       %s 0|1\n", argv0);
+}
 
 int main(int argc, char** argv)
 {
-	(void)argc;
-	(void)argv;
-	if(argc != 2) {
-		printf("Please run as \"sf_cmd 1\" or \"sf_cmd 0\"\n");
+	if(argc == 2 && strcmp(argv[1], "list") == 0) {
+		for(size_t i=0; i<NUM_DEBUG_CODES; i++) {
+			const DebugCode* dc = &debugCodes[i];
+			printf("%u %-24s args %-4s reply %-4s %s\n", dc->code, dc->name, *dc->args ? dc->args : "-",
+					*dc->reply ? dc->reply : "-", dc->help);
+		}
 		return 0;
 	}
-	int enable = !strcmp(argv[1], "1");
-	
-	const String16 name("SurfaceFlinger");
-	composer = defaultServiceManager()->getService(name);
-
-    assert(composer != NULL);    
-    
-    Parcel data;
-    data.writeInterfaceToken(String16("android.ui.ISurfaceComposer"));
-    if(enable) {
-    	data.writeInt32(1);
-    	printf("Enable HDR patch\n");
-    } else {
-    	data.writeInt32(0);
-    	printf("Disable HDR patch\n");
-    }
-    composer->transact(2001, data, NULL, 0);
-    
-    return 0;
+
+	CallOptions options = { 1, 0, false };
+	const char* script = NULL;
+	int a = 1;
+	while(a < argc && argv[a][0] == '-') {
+		if(strcmp(argv[a], "-q") == 0) {
+			options.quiet = true;
+			a++;
+		} else if(a + 1 < argc && strcmp(argv[a], "-n") == 0) {
+			options.calls = atol(argv[a + 1]);
+			a += 2;
+		} else if(a + 1 < argc && strcmp(argv[a], "-i") == 0) {
+			options.intervalUs = atoll(argv[a + 1]);
+			a += 2;
+		} else if(a + 1 < argc && strcmp(argv[a], "-f") == 0) {
+			script = argv[a + 1];
+			a += 2;
+		} else {
+			break;
+		}
+	}
+	if((!script && a >= argc) || (script && a < argc) || options.calls < 1 || options.intervalUs < 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	composer = defaultServiceManager()->getService(String16("SurfaceFlinger"));
+	if(composer == NULL) {
+		fprintf(stderr, "SurfaceFlinger is not running\n");
+		return 1;
+	}
+
+	bool ok;
+	if(script) {
+		ok = runScript(script, options);
+	} else if(argc - a == 1 && (strcmp(argv[a], "0") == 0 || strcmp(argv[a], "1") == 0)) {
+		printf("%s HDR patch\n", argv[a][0] == '1' ? "Enable" : "Disable");
+		char* words[] = { (char*)"hdr-patch", argv[a] };
+		ok = runCommand(2, words, options);
+	} else {
+		ok = runCommand(argc - a, argv + a, options);
+	}
+	long errors = printStats();
+	return ok && errors == 0 ? 0 : 1;
 }
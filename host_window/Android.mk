@@ -0,0 +1,25 @@
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+# Host stand-ins for the Surface, GraphicBufferMapper, SurfaceComposerClient,
+# DisplayEventReceiver and binder pieces the test tools use, so they build
+# and run on a Linux box.
+
+LOCAL_SRC_FILES:= \
+		    hostsurface.cpp \
+		    hostcomposer.cpp \
+		    hostbinder.cpp \
+		    hostcutils.cpp \
+		    hostdisplayevent.cpp
+
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/include
+
+LOCAL_EXPORT_C_INCLUDE_DIRS := \
+	$(LOCAL_PATH)/include
+
+LOCAL_MODULE:= libhostwindow
+
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_HOST_STATIC_LIBRARY)
@@ -0,0 +1,70 @@
+/*
+ * hostbinder.cpp
+ * Host ProcessState, IPCThreadState and a service manager whose only
+ * service is a SurfaceFlinger that logs debug transactions.
+ */
+
+#define LOG_TAG "HostBinder"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <binder/IPCThreadState.h>
+#include <binder/IServiceManager.h>
+#include <binder/ProcessState.h>
+#include <utils/Log.h>
+
+namespace android {
+
+sp<ProcessState> ProcessState::self()
+{
+	static sp<ProcessState> process = new ProcessState();
+	return process;
+}
+
+IPCThreadState* IPCThreadState::self()
+{
+	static IPCThreadState state;
+	return &state;
+}
+
+void IPCThreadState::joinThreadPool()
+{
+	for(;;) {
+		pause();
+	}
+}
+
+class HostSurfaceFlinger : public IBinder {
+public:
+	virtual status_t transact(uint32_t code, const Parcel& data, Parcel* reply, uint32_t /*flags*/)
+	{
+		const char* env = getenv("HOST_BINDER_LATENCY_US");
+		if(env && atoi(env) > 0) {
+			usleep(atoi(env));
+		}
+		if(!data.checkInterface(String16("android.ui.ISurfaceComposer"))) {
+			ALOGW("transaction %u with interface %s", code, data.interfaceToken().host());
+			return PERMISSION_DENIED;
+		}
+		ALOGV("transaction %u, %zu bytes", code, data.dataSize());
+		if(reply) {
+			reply->freeData();
+		}
+		return NO_ERROR;
+	}
+};
+
+sp<IBinder> IServiceManager::getService(const String16& name) const
+{
+	static sp<IBinder> surfaceFlinger = new HostSurfaceFlinger();
+	return name == String16("SurfaceFlinger") ? surfaceFlinger : NULL;
+}
+
+sp<IServiceManager> defaultServiceManager()
+{
+	static sp<IServiceManager> manager = new IServiceManager();
+	return manager;
+}
+
+};
@@ -0,0 +1,339 @@
+/*
+ * hostcomposer.cpp
+ * Host SurfaceComposerClient: layer state lives in this process.
+ */
+
+#define LOG_TAG "HostComposer"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <gui/SurfaceComposerClient.h>
+#include <utils/Log.h>
+
+namespace android {
+
+/*
+ * SurfaceFlinger's state lock; recursive because dropping the last
+ * reference to a layer while applying takes it again to unregister it.
+ */
+static pthread_mutex_t gStateLock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static int gTransactions;
+static int gChanges;
+/* every live layer, for the traversal */
+static std::vector<SurfaceControl*> gLayers;
+static long gVisited;
+
+/* Stops a relative z loop from recursing for ever. */
+#define MAX_TREE_DEPTH	256
+
+/* The handle a SurfaceControl is referred to by in reparent / setRelativeLayer. */
+class LayerHandle : public IBinder {
+public:
+	LayerHandle(SurfaceControl* sc) : layer(sc) {}
+	status_t transact(uint32_t, const Parcel&, Parcel*, uint32_t) { return INVALID_OPERATION; }
+	SurfaceControl* layer;		/* cleared when the layer goes away */
+};
+
+static sp<SurfaceControl> fromHandle(const sp<IBinder>& handle)
+{
+	if(handle == NULL) {
+		return NULL;
+	}
+	return static_cast<LayerHandle*>(handle.get())->layer;
+}
+
+enum {
+	CHANGE_LAYER,
+	CHANGE_POSITION,
+	CHANGE_SIZE,
+	CHANGE_MATRIX,
+	CHANGE_ALPHA,
+	CHANGE_SHOW,
+	CHANGE_HIDE,
+	CHANGE_REPARENT,
+	CHANGE_RELATIVE_LAYER,
+	CHANGE_CROP,
+};
+
+/* Stands in for the binder round trip of a transaction or a query. */
+static void binderLatency()
+{
+	static int latencyUs = -1;
+	if(latencyUs < 0) {
+		const char* env = getenv("HOST_BINDER_LATENCY_US");
+		latencyUs = env ? atoi(env) : 0;
+	}
+	if(latencyUs > 0) {
+		usleep(latencyUs);
+	}
+}
+
+SurfaceControl::SurfaceControl(const String8& name, uint32_t w, uint32_t h, PixelFormat format)
+	: z(0), x(0), y(0), width(w), height(h), alpha(1.0f), shown(false), order(0), depth(0), mName(name), mFormat(format)
+{
+	matrix[0] = 1.0f;
+	matrix[1] = 0.0f;
+	matrix[2] = 0.0f;
+	matrix[3] = 1.0f;
+	mHandle = new LayerHandle(this);
+	pthread_mutex_lock(&gStateLock);
+	gLayers.push_back(this);
+	pthread_mutex_unlock(&gStateLock);
+}
+
+SurfaceControl::~SurfaceControl()
+{
+	pthread_mutex_lock(&gStateLock);
+	gLayers.erase(std::find(gLayers.begin(), gLayers.end(), this));
+	static_cast<LayerHandle*>(mHandle.get())->layer = NULL;
+	pthread_mutex_unlock(&gStateLock);
+}
+
+sp<Surface> SurfaceControl::getSurface()
+{
+	pthread_mutex_lock(&gStateLock);
+	if(mSurface == NULL) {
+		mSurface = new Surface(mName, width, height, mFormat);
+	}
+	sp<Surface> surface = mSurface;
+	pthread_mutex_unlock(&gStateLock);
+	return surface;
+}
+
+sp<SurfaceControl> SurfaceComposerClient::createSurface(const String8& name, uint32_t w, uint32_t h,
+		PixelFormat format, uint32_t /*flags*/, SurfaceControl* parent, int32_t /*windowType*/, int32_t /*ownerUid*/)
+{
+	binderLatency();
+	sp<SurfaceControl> sc = new SurfaceControl(name, w, h, format);
+	sc->parent = parent;
+	return sc;
+}
+
+SurfaceComposerClient::Transaction::Change& SurfaceComposerClient::Transaction::add(const sp<SurfaceControl>& sc, int what)
+{
+	Change c;
+	c.sc = sc;
+	c.what = what;
+	c.f[0] = c.f[1] = c.f[2] = c.f[3] = 0.0f;
+	c.i = 0;
+	mChanges.push_back(c);
+	return mChanges.back();
+}
+
+SurfaceComposerClient::Transaction& SurfaceComposerClient::Transaction::setLayer(const sp<SurfaceControl>& sc, int32_t z)
+{
+	add(sc, CHANGE_LAYER).i = z;
+	return *this;
+}
+
+SurfaceComposerClient::Transaction& SurfaceComposerClient::Transaction::setRelativeLayer(const sp<SurfaceControl>& sc,
+		const sp<IBinder>& relativeTo, int32_t z)
+{
+	Change& c = add(sc, CHANGE_RELATIVE_LAYER);
+	c.i = z;
+	c.other = fromHandle(relativeTo);
+	return *this;
+}
+
+SurfaceComposerClient::Transaction& SurfaceComposerClient::Transaction::setPosition(const sp<SurfaceControl>& sc, float x, float y)
+{
+	Change& c = add(sc, CHANGE_POSITION);
+	c.f[0] = x;
+	c.f[1] = y;
+	return *this;
+}
+
+SurfaceComposerClient::Transaction& SurfaceComposerClient::Transaction::setSize(const sp<SurfaceControl>& sc, uint32_t w, uint32_t h)
+{
+	Change& c = add(sc, CHANGE_SIZE);
+	c.f[0] = w;
+	c.f[1] = h;
+	return *this;
+}
+
+SurfaceComposerClient::Transaction& SurfaceComposerClient::Transaction::setMatrix(const sp<SurfaceControl>& sc,
+		float dsdx, float dtdx, float dtdy, float dsdy)
+{
+	Change& c = add(sc, CHANGE_MATRIX);
+	c.f[0] = dsdx;
+	c.f[1] = dtdx;
+	c.f[2] = dtdy;
+	c.f[3] = dsdy;
+	return *this;
+}
+
+SurfaceComposerClient::Transaction& SurfaceComposerClient::Transaction::setAlpha(const sp<SurfaceControl>& sc, float alpha)
+{
+	add(sc, CHANGE_ALPHA).f[0] = alpha;
+	return *this;
+}
+
+SurfaceComposerClient::Transaction& SurfaceComposerClient::Transaction::setCrop(const sp<SurfaceControl>& sc, const Rect& crop)
+{
+	Change& c = add(sc, CHANGE_CROP);
+	c.f[0] = crop.left;
+	c.f[1] = crop.top;
+	c.f[2] = crop.right;
+	c.f[3] = crop.bottom;
+	return *this;
+}
+
+SurfaceComposerClient::Transaction& SurfaceComposerClient::Transaction::show(const sp<SurfaceControl>& sc)
+{
+	add(sc, CHANGE_SHOW);
+	return *this;
+}
+
+SurfaceComposerClient::Transaction& SurfaceComposerClient::Transaction::hide(const sp<SurfaceControl>& sc)
+{
+	add(sc, CHANGE_HIDE);
+	return *this;
+}
+
+SurfaceComposerClient::Transaction& SurfaceComposerClient::Transaction::reparent(const sp<SurfaceControl>& sc,
+		const sp<IBinder>& newParentHandle)
+{
+	add(sc, CHANGE_REPARENT).other = fromHandle(newParentHandle);
+	return *this;
+}
+
+SurfaceComposerClient::Transaction& SurfaceComposerClient::Transaction::merge(Transaction&& other)
+{
+	mChanges.insert(mChanges.end(), other.mChanges.begin(), other.mChanges.end());
+	other.mChanges.clear();
+	return *this;
+}
+
+static Rect intersect(const Rect& a, const Rect& b)
+{
+	return Rect(std::max(a.left, b.left), std::max(a.top, b.top), std::min(a.right, b.right), std::min(a.bottom, b.bottom));
+}
+
+/* Screen position and visible rect: position is relative to the parent, crops of all ancestors apply. */
+static void geometry(SurfaceControl* sc, float* x, float* y, Rect* visible, int* depth)
+{
+	gVisited++;
+	if(sc->parent == NULL || *depth >= MAX_TREE_DEPTH) {
+		*x = sc->x;
+		*y = sc->y;
+		*visible = Rect(-0x10000, -0x10000, 0x10000, 0x10000);
+	} else {
+		(*depth)++;
+		geometry(sc->parent.get(), x, y, visible, depth);
+		*x += sc->x;
+		*y += sc->y;
+	}
+	Rect bounds((int)*x, (int)*y, (int)*x + sc->width, (int)*y + sc->height);
+	if(!sc->crop.isEmpty()) {
+		bounds = intersect(bounds, Rect((int)*x + sc->crop.left, (int)*y + sc->crop.top,
+				(int)*x + sc->crop.right, (int)*y + sc->crop.bottom));
+	}
+	*visible = intersect(*visible, bounds);
+}
+
+static bool byZ(const SurfaceControl* a, const SurfaceControl* b)
+{
+	return a->z < b->z;
+}
+
+/* Children below the layer, the layer, then the ones above, as SurfaceFlinger draws them. */
+static void visit(SurfaceControl* sc, const std::vector<std::vector<SurfaceControl*> >& children, int* order, int depth)
+{
+	std::vector<SurfaceControl*> kids;
+	if(depth < MAX_TREE_DEPTH) {
+		kids = children[sc->order];
+	}
+	std::stable_sort(kids.begin(), kids.end(), byZ);
+	size_t i = 0;
+	for(; i<kids.size() && kids[i]->z < 0; i++) {
+		visit(kids[i], children, order, depth + 1);
+	}
+	float x, y;
+	sc->depth = 0;
+	geometry(sc, &x, &y, &sc->visible, &sc->depth);
+	sc->order = (*order)++;
+	for(; i<kids.size(); i++) {
+		visit(kids[i], children, order, depth + 1);
+	}
+}
+
+/*
+ * What SurfaceFlinger does with the tree on every transaction: rebuild the
+ * drawing order, relative layers under the layer they are relative to,
+ * and every layer's inherited position and crop. Called with the lock held.
+ */
+static void traverseLayers()
+{
+	size_t n = gLayers.size();
+	/* until the walk below sets it, order is the layer's slot in gLayers and children */
+	for(size_t i=0; i<n; i++) {
+		gLayers[i]->order = (int)i;
+	}
+	std::vector<std::vector<SurfaceControl*> > children(n + 1);
+	std::vector<SurfaceControl*>& roots = children[n];
+	for(size_t i=0; i<n; i++) {
+		SurfaceControl* sc = gLayers[i];
+		SurfaceControl* under = sc->relativeTo != NULL ? sc->relativeTo.get() : sc->parent.get();
+		if(under == NULL) {
+			roots.push_back(sc);
+		} else {
+			children[under->order].push_back(sc);
+		}
+	}
+	std::vector<SurfaceControl*> top = roots;
+	std::stable_sort(top.begin(), top.end(), byZ);
+	int order = 0;
+	for(size_t i=0; i<top.size(); i++) {
+		visit(top[i], children, &order, 0);
+	}
+}
+
+status_t SurfaceComposerClient::Transaction::apply(bool /*synchronous*/)
+{
+	binderLatency();
+	pthread_mutex_lock(&gStateLock);
+	for(size_t i=0; i<mChanges.size(); i++) {
+		Change& c = mChanges[i];
+		SurfaceControl* sc = c.sc.get();
+		switch(c.what) {
+		case CHANGE_LAYER:	sc->z = c.i; break;
+		case CHANGE_POSITION:	sc->x = c.f[0]; sc->y = c.f[1]; break;
+		case CHANGE_SIZE:	sc->width = (uint32_t)c.f[0]; sc->height = (uint32_t)c.f[1]; break;
+		case CHANGE_MATRIX:	for(int m=0; m<4; m++) sc->matrix[m] = c.f[m]; break;
+		case CHANGE_ALPHA:	sc->alpha = c.f[0]; break;
+		case CHANGE_SHOW:	sc->shown = true; break;
+		case CHANGE_HIDE:	sc->shown = false; break;
+		case CHANGE_REPARENT:	sc->parent = c.other; break;
+		case CHANGE_RELATIVE_LAYER:	sc->z = c.i; sc->relativeTo = c.other; break;
+		case CHANGE_CROP:	sc->crop = Rect((int)c.f[0], (int)c.f[1], (int)c.f[2], (int)c.f[3]); break;
+		}
+	}
+	traverseLayers();
+	gTransactions++;
+	gChanges += mChanges.size();
+	pthread_mutex_unlock(&gStateLock);
+	mChanges.clear();
+	return NO_ERROR;
+}
+
+void SurfaceComposerClient::getHostTreeStats(int* layers, long* visited)
+{
+	pthread_mutex_lock(&gStateLock);
+	*layers = (int)gLayers.size();
+	*visited = gVisited;
+	pthread_mutex_unlock(&gStateLock);
+}
+
+void SurfaceComposerClient::getHostStats(int* transactions, int* changes)
+{
+	pthread_mutex_lock(&gStateLock);
+	*transactions = gTransactions;
+	*changes = gChanges;
+	pthread_mutex_unlock(&gStateLock);
+}
+
+};
@@ -0,0 +1,84 @@
+/*
+ * hostcutils.cpp
+ * The libcutils pieces the tools use: native handles, memset and ashmem.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cutils/ashmem.h>
+#include <cutils/memory.h>
+#include <cutils/native_handle.h>
+
+native_handle_t* native_handle_create(int numFds, int numInts)
+{
+	native_handle_t* h = (native_handle_t*)malloc(sizeof(native_handle_t) + sizeof(int)*(numFds + numInts));
+	if(h) {
+		h->version = sizeof(native_handle_t);
+		h->numFds = numFds;
+		h->numInts = numInts;
+	}
+	return h;
+}
+
+int native_handle_close(const native_handle_t* h)
+{
+	for(int i=0; i<h->numFds; i++) {
+		close(h->data[i]);
+	}
+	return 0;
+}
+
+int native_handle_delete(native_handle_t* h)
+{
+	free(h);
+	return 0;
+}
+
+void android_memset16(uint16_t* dst, uint16_t value, size_t size)
+{
+	for(size_t i=0; i<size/2; i++) {
+		dst[i] = value;
+	}
+}
+
+void android_memset32(uint32_t* dst, uint32_t value, size_t size)
+{
+	for(size_t i=0; i<size/4; i++) {
+		dst[i] = value;
+	}
+}
+
+int ashmem_create_region(const char* name, size_t size)
+{
+	int fd = syscall(__NR_memfd_create, name ? name : "ashmem", 0);
+	if(fd < 0) {
+		return -1;
+	}
+	if(ftruncate(fd, size) != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+int ashmem_set_prot_region(int /*fd*/, int /*prot*/)
+{
+	return 0;
+}
+
+int ashmem_get_size_region(int fd)
+{
+	struct stat st;
+	return fstat(fd, &st) == 0 ? (int)st.st_size : -1;
+}
+
+int ashmem_valid(int fd)
+{
+	struct stat st;
+	return fstat(fd, &st) == 0;
+}
@@ -0,0 +1,129 @@
+/*
+ * hostdisplayevent.cpp
+ * Host DisplayEventReceiver: a vsync thread and a pipe of Events.
+ */
+
+#define LOG_TAG "HostDisplayEvent"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <gui/DisplayEventReceiver.h>
+#include <utils/Log.h>
+
+namespace android {
+
+DisplayEventReceiver::DisplayEventReceiver()
+	: mReadFd(-1), mWriteFd(-1), mRate(0), mRequested(false), mQuit(false)
+{
+	const char* hz = getenv("HOST_WINDOW_REFRESH_HZ");
+	mPeriod = 1000000000LL/(hz && atoi(hz) > 0 ? atoi(hz) : 60);
+	pthread_mutex_init(&mLock, NULL);
+
+	int fds[2];
+	if(pipe2(fds, O_CLOEXEC | O_NONBLOCK) != 0) {
+		ALOGE("%s: pipe failed, errno %d", __FUNCTION__, errno);
+		return;
+	}
+	mReadFd = fds[0];
+	mWriteFd = fds[1];
+	if(pthread_create(&mThread, NULL, threadLoop, this) != 0) {
+		close(mReadFd);
+		close(mWriteFd);
+		mReadFd = mWriteFd = -1;
+	}
+}
+
+DisplayEventReceiver::~DisplayEventReceiver()
+{
+	if(mReadFd >= 0) {
+		pthread_mutex_lock(&mLock);
+		mQuit = true;
+		pthread_mutex_unlock(&mLock);
+		pthread_join(mThread, NULL);
+		close(mReadFd);
+		close(mWriteFd);
+	}
+	pthread_mutex_destroy(&mLock);
+}
+
+void* DisplayEventReceiver::threadLoop(void* data)
+{
+	DisplayEventReceiver* r = (DisplayEventReceiver*)data;
+	struct timespec next;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	uint32_t count = 0;
+
+	for(;;) {
+		next.tv_nsec += r->mPeriod;
+		while(next.tv_nsec >= 1000000000) {
+			next.tv_nsec -= 1000000000;
+			next.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		count++;
+
+		pthread_mutex_lock(&r->mLock);
+		if(r->mQuit) {
+			pthread_mutex_unlock(&r->mLock);
+			break;
+		}
+		bool send = r->mRequested || (r->mRate > 0 && count % r->mRate == 0);
+		r->mRequested = false;
+		pthread_mutex_unlock(&r->mLock);
+
+		if(send) {
+			Event e;
+			memset(&e, 0, sizeof(e));
+			e.header.type = DISPLAY_EVENT_VSYNC;
+			e.header.timestamp = (nsecs_t)next.tv_sec*1000000000LL + next.tv_nsec;
+			e.vsync.count = count;
+			/* smaller than PIPE_BUF, so all or nothing; a full pipe drops it */
+			if(write(r->mWriteFd, &e, sizeof(e)) < 0) {
+				continue;
+			}
+		}
+	}
+	return NULL;
+}
+
+status_t DisplayEventReceiver::initCheck() const
+{
+	return mReadFd >= 0 ? NO_ERROR : NO_INIT;
+}
+
+int DisplayEventReceiver::getFd() const
+{
+	return mReadFd;
+}
+
+ssize_t DisplayEventReceiver::getEvents(Event* events, size_t count)
+{
+	ssize_t n = read(mReadFd, events, sizeof(Event)*count);
+	if(n < 0) {
+		return -errno;
+	}
+	return n/sizeof(Event);
+}
+
+status_t DisplayEventReceiver::setVsyncRate(uint32_t count)
+{
+	pthread_mutex_lock(&mLock);
+	mRate = count;
+	pthread_mutex_unlock(&mLock);
+	return NO_ERROR;
+}
+
+status_t DisplayEventReceiver::requestNextVsync()
+{
+	pthread_mutex_lock(&mLock);
+	mRequested = true;
+	pthread_mutex_unlock(&mLock);
+	return NO_ERROR;
+}
+
+}; // namespace android
@@ -0,0 +1,617 @@
+/*
+ * hostsurface.cpp
+ * Host Surface: memfd buffers, a small buffer queue and a consumer thread
+ * that latches one buffer per refresh like SurfaceFlinger.
+ */
+
+#define LOG_TAG "HostSurface"
+
+#include <map>
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <gui/Surface.h>
+#include <ui/GraphicBufferMapper.h>
+#include <utils/Log.h>
+
+#define ALIGN(x, a)		(((x) + (a) - 1) & ~((a) - 1))
+
+#define HOST_MAX_BUFFERS	8
+#define HOST_DEFAULT_BUFFERS	3
+/* frames whose timestamps can still be queried */
+#define HOST_FRAME_HISTORY	64
+
+namespace android {
+
+enum {
+	SLOT_FREE,
+	SLOT_DEQUEUED,
+	SLOT_QUEUED,
+	SLOT_ACQUIRED,			/* on screen */
+};
+
+struct HostBuffer {
+	ANativeWindowBuffer buffer;
+	native_handle_t* handle;	/* one fd: the memfd */
+	void* base;
+	size_t size;
+	int state;
+	uint64_t frameNumber;		/* of the last queue, 0 when never queued since allocation */
+};
+
+struct FrameRecord {
+	uint64_t id;
+	nsecs_t requested;
+	nsecs_t queued;
+	nsecs_t latched;		/* 0 while still queued */
+	nsecs_t present;
+	nsecs_t released;
+};
+
+struct HostQueue {
+	String8 name;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_t consumer;
+	bool quit;
+
+	int defaultWidth;
+	int defaultHeight;
+	int defaultFormat;
+	int width;			/* 0: default */
+	int height;
+	int format;
+	uint64_t usage;
+	nsecs_t timestamp;		/* requested present time of the next queue */
+
+	HostBuffer slots[HOST_MAX_BUFFERS];
+	int numSlots;
+	int fifo[HOST_MAX_BUFFERS];
+	int numQueued;
+	int onScreen;
+	uint64_t frameCounter;
+
+	nsecs_t period;
+	bool scanout;			/* consumer reads every latched buffer */
+	FrameRecord frames[HOST_FRAME_HISTORY];
+	int presented;
+	sp<NativeHandle> sideband;
+};
+
+/* GraphicBufferMapper finds buffers by handle. */
+static pthread_mutex_t gHandleLock = PTHREAD_MUTEX_INITIALIZER;
+static std::map<buffer_handle_t, HostBuffer*> gHandles;
+
+static int bytesPerPixel(int format)
+{
+	switch(format) {
+	case HAL_PIXEL_FORMAT_RGB_888:	return 3;
+	case HAL_PIXEL_FORMAT_RGB_565:	return 2;
+	default:			return 4;
+	}
+}
+
+static void freeBuffer(HostBuffer* b)
+{
+	if(!b->handle) {
+		return;
+	}
+	pthread_mutex_lock(&gHandleLock);
+	gHandles.erase(b->handle);
+	pthread_mutex_unlock(&gHandleLock);
+	munmap(b->base, b->size);
+	native_handle_close(b->handle);
+	native_handle_delete(b->handle);
+	b->handle = NULL;
+	b->base = NULL;
+	b->frameNumber = 0;
+}
+
+static bool allocBuffer(HostQueue* q, HostBuffer* b, int width, int height, int format)
+{
+	freeBuffer(b);
+	/* 64 byte rows, as most gralloc implementations align to */
+	int stride = format == HAL_PIXEL_FORMAT_YV12 ? ALIGN(width, 32) : ALIGN(width, 16);
+	size_t size;
+	if(format == HAL_PIXEL_FORMAT_YV12) {
+		size = (size_t)stride*height + (size_t)ALIGN(stride/2, 16)*((height + 1)/2)*2;
+	} else {
+		size = (size_t)stride*height*bytesPerPixel(format);
+	}
+
+	int fd = syscall(__NR_memfd_create, q->name.string(), 0);
+	if(fd < 0 || ftruncate(fd, size) != 0) {
+		ALOGE("cannot allocate %zu bytes: %s", size, strerror(errno));
+		if(fd >= 0) {
+			close(fd);
+		}
+		return false;
+	}
+	void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(base == MAP_FAILED) {
+		ALOGE("cannot map %zu bytes: %s", size, strerror(errno));
+		close(fd);
+		return false;
+	}
+
+	b->handle = native_handle_create(1, 0);
+	b->handle->data[0] = fd;
+	b->base = base;
+	b->size = size;
+	b->frameNumber = 0;
+	b->buffer.width = width;
+	b->buffer.height = height;
+	b->buffer.stride = stride;
+	b->buffer.format = format;
+	b->buffer.usage = q->usage;
+	b->buffer.usage_deprecated = (int)q->usage;
+	b->buffer.handle = b->handle;
+
+	pthread_mutex_lock(&gHandleLock);
+	gHandles[b->handle] = b;
+	pthread_mutex_unlock(&gHandleLock);
+	return true;
+}
+
+static FrameRecord* findFrame(HostQueue* q, uint64_t id)
+{
+	FrameRecord* f = &q->frames[id % HOST_FRAME_HISTORY];
+	return id != 0 && f->id == id ? f : NULL;
+}
+
+static void releaseSlot(HostQueue* q, int slot, nsecs_t now)
+{
+	HostBuffer* b = &q->slots[slot];
+	FrameRecord* f = findFrame(q, b->frameNumber);
+	if(f) {
+		f->released = now;
+	}
+	b->state = SLOT_FREE;
+	if(slot >= q->numSlots) {
+		/* the buffer count shrank while it was on screen */
+		freeBuffer(b);
+	}
+}
+
+static void* consumerThread(void* data)
+{
+	HostQueue* q = (HostQueue*)data;
+	struct timespec next;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+
+	for(;;) {
+		next.tv_nsec += q->period;
+		while(next.tv_nsec >= 1000000000) {
+			next.tv_nsec -= 1000000000;
+			next.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		nsecs_t vsync = (nsecs_t)next.tv_sec*1000000000LL + next.tv_nsec;
+
+		pthread_mutex_lock(&q->lock);
+		if(q->quit) {
+			pthread_mutex_unlock(&q->lock);
+			break;
+		}
+		if(q->numQueued > 0) {
+			int slot = q->fifo[0];
+			memmove(&q->fifo[0], &q->fifo[1], sizeof(int)*(q->numQueued - 1));
+			q->numQueued--;
+			if(q->onScreen >= 0) {
+				releaseSlot(q, q->onScreen, vsync);
+			}
+			q->onScreen = slot;
+			q->slots[slot].state = SLOT_ACQUIRED;
+			FrameRecord* f = findFrame(q, q->slots[slot].frameNumber);
+			if(f) {
+				f->latched = vsync;
+				f->present = vsync + q->period;
+			}
+			q->presented++;
+			pthread_cond_broadcast(&q->cond);
+
+			if(q->scanout) {
+				/* what a display controller would read, outside the lock */
+				const uint64_t* p = (const uint64_t*)q->slots[slot].base;
+				size_t n = q->slots[slot].size/sizeof(uint64_t);
+				pthread_mutex_unlock(&q->lock);
+				volatile uint64_t sum = 0;
+				for(size_t i=0; i<n; i++) {
+					sum += p[i];
+				}
+				continue;
+			}
+		}
+		pthread_mutex_unlock(&q->lock);
+	}
+	return NULL;
+}
+
+Surface::Surface(const String8& name, uint32_t width, uint32_t height, PixelFormat format)
+{
+	ANativeWindow::setSwapInterval = hook_setSwapInterval;
+	ANativeWindow::dequeueBuffer_DEPRECATED = hook_dequeueBuffer_DEPRECATED;
+	ANativeWindow::lockBuffer_DEPRECATED = hook_lockBuffer_DEPRECATED;
+	ANativeWindow::queueBuffer_DEPRECATED = hook_queueBuffer_DEPRECATED;
+	ANativeWindow::cancelBuffer_DEPRECATED = hook_cancelBuffer_DEPRECATED;
+	ANativeWindow::query = hook_query;
+	ANativeWindow::perform = hook_perform;
+	ANativeWindow::dequeueBuffer = hook_dequeueBuffer;
+	ANativeWindow::queueBuffer = hook_queueBuffer;
+	ANativeWindow::cancelBuffer = hook_cancelBuffer;
+
+	HostQueue* q = new HostQueue();
+	q->name = name;
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->cond, NULL);
+	q->defaultWidth = width;
+	q->defaultHeight = height;
+	q->defaultFormat = format;
+	q->usage = GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_SW_WRITE_OFTEN;
+	q->numSlots = HOST_DEFAULT_BUFFERS;
+	q->onScreen = -1;
+
+	const char* hz = getenv("HOST_WINDOW_REFRESH_HZ");
+	q->period = 1000000000LL/(hz && atoi(hz) > 0 ? atoi(hz) : 60);
+	q->scanout = getenv("HOST_WINDOW_SCANOUT") != NULL;
+	mQueue = q;
+	pthread_create(&q->consumer, NULL, consumerThread, q);
+}
+
+Surface::~Surface()
+{
+	HostQueue* q = mQueue;
+	pthread_mutex_lock(&q->lock);
+	q->quit = true;
+	pthread_mutex_unlock(&q->lock);
+	pthread_join(q->consumer, NULL);
+	for(int i=0; i<HOST_MAX_BUFFERS; i++) {
+		freeBuffer(&q->slots[i]);
+	}
+	pthread_cond_destroy(&q->cond);
+	pthread_mutex_destroy(&q->lock);
+	delete q;
+}
+
+/* Like BufferQueueProducer: one binder call, the consumer keeps the stream until replaced. */
+status_t Surface::setSidebandStream(const sp<NativeHandle>& stream)
+{
+	const char* env = getenv("HOST_BINDER_LATENCY_US");
+	if(env && atoi(env) > 0) {
+		usleep(atoi(env));
+	}
+	ALOGV("%s: sideband stream %p", mQueue->name.string(), stream.get() ? stream->handle() : NULL);
+	pthread_mutex_lock(&mQueue->lock);
+	mQueue->sideband = stream;
+	pthread_mutex_unlock(&mQueue->lock);
+	return NO_ERROR;
+}
+
+void Surface::getHostStats(int* queued, int* presented)
+{
+	pthread_mutex_lock(&mQueue->lock);
+	*queued = (int)mQueue->frameCounter;
+	*presented = mQueue->presented;
+	pthread_mutex_unlock(&mQueue->lock);
+}
+
+int Surface::hook_setSwapInterval(ANativeWindow* /*window*/, int /*interval*/)
+{
+	return NO_ERROR;
+}
+
+int Surface::hook_dequeueBuffer(ANativeWindow* window, ANativeWindowBuffer** buffer, int* fenceFd)
+{
+	HostQueue* q = static_cast<Surface*>(window)->mQueue;
+	pthread_mutex_lock(&q->lock);
+	int width = q->width ? q->width : q->defaultWidth;
+	int height = q->height ? q->height : q->defaultHeight;
+	int format = q->format ? q->format : q->defaultFormat;
+
+	int slot = -1;
+	for(;;) {
+		/* least recently queued free slot, like BufferQueue */
+		for(int i=0; i<q->numSlots; i++) {
+			if(q->slots[i].state == SLOT_FREE && (slot < 0 || q->slots[i].frameNumber < q->slots[slot].frameNumber)) {
+				slot = i;
+			}
+		}
+		if(slot >= 0) {
+			break;
+		}
+		pthread_cond_wait(&q->cond, &q->lock);
+	}
+
+	HostBuffer* b = &q->slots[slot];
+	if(!b->handle || b->buffer.width != width || b->buffer.height != height ||
+			b->buffer.format != format || b->buffer.usage != q->usage) {
+		if(!allocBuffer(q, b, width, height, format)) {
+			pthread_mutex_unlock(&q->lock);
+			return NO_MEMORY;
+		}
+	}
+	b->state = SLOT_DEQUEUED;
+	*buffer = &b->buffer;
+	*fenceFd = -1;
+	pthread_mutex_unlock(&q->lock);
+	return NO_ERROR;
+}
+
+int Surface::hook_queueBuffer(ANativeWindow* window, ANativeWindowBuffer* buffer, int fenceFd)
+{
+	HostQueue* q = static_cast<Surface*>(window)->mQueue;
+	if(fenceFd >= 0) {
+		/* the consumer must not read before the producer is done */
+		struct pollfd p = { fenceFd, POLLIN, 0 };
+		poll(&p, 1, -1);
+		close(fenceFd);
+	}
+
+	pthread_mutex_lock(&q->lock);
+	int slot = (int)((HostBuffer*)buffer - q->slots);
+	if(slot < 0 || slot >= HOST_MAX_BUFFERS || q->slots[slot].state != SLOT_DEQUEUED) {
+		pthread_mutex_unlock(&q->lock);
+		return BAD_VALUE;
+	}
+	HostBuffer* b = &q->slots[slot];
+	b->state = SLOT_QUEUED;
+	b->frameNumber = ++q->frameCounter;
+
+	FrameRecord* f = &q->frames[b->frameNumber % HOST_FRAME_HISTORY];
+	memset(f, 0, sizeof(*f));
+	f->id = b->frameNumber;
+	f->queued = systemTime();
+	f->requested = q->timestamp ? q->timestamp : f->queued;
+	q->timestamp = 0;
+
+	q->fifo[q->numQueued++] = slot;
+	pthread_mutex_unlock(&q->lock);
+	return NO_ERROR;
+}
+
+int Surface::hook_cancelBuffer(ANativeWindow* window, ANativeWindowBuffer* buffer, int fenceFd)
+{
+	HostQueue* q = static_cast<Surface*>(window)->mQueue;
+	if(fenceFd >= 0) {
+		close(fenceFd);
+	}
+	pthread_mutex_lock(&q->lock);
+	int slot = (int)((HostBuffer*)buffer - q->slots);
+	if(slot >= 0 && slot < HOST_MAX_BUFFERS && q->slots[slot].state == SLOT_DEQUEUED) {
+		releaseSlot(q, slot, systemTime());
+		pthread_cond_broadcast(&q->cond);
+	}
+	pthread_mutex_unlock(&q->lock);
+	return NO_ERROR;
+}
+
+int Surface::hook_dequeueBuffer_DEPRECATED(ANativeWindow* window, ANativeWindowBuffer** buffer)
+{
+	int fenceFd = -1;
+	return hook_dequeueBuffer(window, buffer, &fenceFd);
+}
+
+int Surface::hook_lockBuffer_DEPRECATED(ANativeWindow* /*window*/, ANativeWindowBuffer* /*buffer*/)
+{
+	return NO_ERROR;
+}
+
+int Surface::hook_queueBuffer_DEPRECATED(ANativeWindow* window, ANativeWindowBuffer* buffer)
+{
+	return hook_queueBuffer(window, buffer, -1);
+}
+
+int Surface::hook_cancelBuffer_DEPRECATED(ANativeWindow* window, ANativeWindowBuffer* buffer)
+{
+	return hook_cancelBuffer(window, buffer, -1);
+}
+
+int Surface::hook_query(const ANativeWindow* window, int what, int* value)
+{
+	HostQueue* q = static_cast<const Surface*>(window)->mQueue;
+	pthread_mutex_lock(&q->lock);
+	status_t err = NO_ERROR;
+	switch(what) {
+	case NATIVE_WINDOW_WIDTH:
+	case NATIVE_WINDOW_DEFAULT_WIDTH:
+		*value = q->width ? q->width : q->defaultWidth;
+		break;
+	case NATIVE_WINDOW_HEIGHT:
+	case NATIVE_WINDOW_DEFAULT_HEIGHT:
+		*value = q->height ? q->height : q->defaultHeight;
+		break;
+	case NATIVE_WINDOW_FORMAT:
+		*value = q->format ? q->format : q->defaultFormat;
+		break;
+	case NATIVE_WINDOW_MIN_UNDEQUEUED_BUFFERS:
+		*value = 1;
+		break;
+	case NATIVE_WINDOW_QUEUES_TO_WINDOW_COMPOSER:
+		*value = 1;
+		break;
+	case NATIVE_WINDOW_CONSUMER_USAGE_BITS:
+		*value = GRALLOC_USAGE_HW_COMPOSER;
+		break;
+	case NATIVE_WINDOW_BUFFER_AGE: {
+		/* of the buffer dequeued last, as BufferQueue reports it */
+		*value = 0;
+		for(int i=0; i<q->numSlots; i++) {
+			HostBuffer* b = &q->slots[i];
+			if(b->state == SLOT_DEQUEUED) {
+				*value = b->frameNumber ? (int)(q->frameCounter + 1 - b->frameNumber) : 0;
+			}
+		}
+		break;
+	}
+	default:
+		err = BAD_VALUE;
+		break;
+	}
+	pthread_mutex_unlock(&q->lock);
+	return err;
+}
+
+static int getFrameTimestamps(HostQueue* q, uint64_t id, va_list args)
+{
+	int64_t* out[9];
+	for(int i=0; i<9; i++) {
+		out[i] = va_arg(args, int64_t*);
+	}
+	FrameRecord* f = findFrame(q, id);
+	if(!f) {
+		return BAD_VALUE;
+	}
+	nsecs_t now = systemTime();
+	nsecs_t pending = NATIVE_WINDOW_TIMESTAMP_PENDING;
+	/* requested, acquire, latch, first / last refresh start, GPU done, present, dequeue ready, release */
+	nsecs_t values[9] = {
+		f->requested,
+		f->queued,
+		f->latched ? f->latched : pending,
+		f->latched ? f->latched : pending,
+		f->latched ? f->latched : pending,
+		NATIVE_WINDOW_TIMESTAMP_INVALID,
+		f->latched && now >= f->present ? f->present : pending,
+		f->released ? f->released : pending,
+		f->released ? f->released : pending,
+	};
+	for(int i=0; i<9; i++) {
+		if(out[i]) {
+			*out[i] = values[i];
+		}
+	}
+	return NO_ERROR;
+}
+
+int Surface::hook_perform(ANativeWindow* window, int operation, ...)
+{
+	HostQueue* q = static_cast<Surface*>(window)->mQueue;
+	va_list args;
+	va_start(args, operation);
+	pthread_mutex_lock(&q->lock);
+	int err = NO_ERROR;
+
+	switch(operation) {
+	case NATIVE_WINDOW_SET_USAGE:
+		q->usage = (uint32_t)va_arg(args, int);
+		break;
+	case NATIVE_WINDOW_SET_USAGE64:
+		q->usage = va_arg(args, uint64_t);
+		break;
+	case NATIVE_WINDOW_SET_BUFFER_COUNT: {
+		int count = (int)va_arg(args, size_t);
+		bool dequeued = false;
+		for(int i=0; i<HOST_MAX_BUFFERS; i++) {
+			dequeued = dequeued || q->slots[i].state == SLOT_DEQUEUED;
+		}
+		/* one buffer is always held by the consumer */
+		if(count < 2 || count > HOST_MAX_BUFFERS || dequeued) {
+			err = BAD_VALUE;
+			break;
+		}
+		q->numSlots = count;
+		for(int i=count; i<HOST_MAX_BUFFERS; i++) {
+			if(q->slots[i].state == SLOT_FREE) {
+				freeBuffer(&q->slots[i]);
+			}
+		}
+		break;
+	}
+	case NATIVE_WINDOW_SET_BUFFERS_DIMENSIONS:
+	case NATIVE_WINDOW_SET_BUFFERS_USER_DIMENSIONS:
+		q->width = va_arg(args, int);
+		q->height = va_arg(args, int);
+		break;
+	case NATIVE_WINDOW_SET_BUFFERS_FORMAT:
+		q->format = va_arg(args, int);
+		break;
+	case NATIVE_WINDOW_SET_BUFFERS_TIMESTAMP:
+		q->timestamp = va_arg(args, int64_t);
+		break;
+	case NATIVE_WINDOW_GET_REFRESH_CYCLE_DURATION:
+		*va_arg(args, int64_t*) = q->period;
+		break;
+	case NATIVE_WINDOW_GET_NEXT_FRAME_ID:
+		*va_arg(args, uint64_t*) = q->frameCounter + 1;
+		break;
+	case NATIVE_WINDOW_GET_FRAME_TIMESTAMPS: {
+		uint64_t id = va_arg(args, uint64_t);
+		err = getFrameTimestamps(q, id, args);
+		break;
+	}
+	case NATIVE_WINDOW_CONNECT:
+	case NATIVE_WINDOW_DISCONNECT:
+	case NATIVE_WINDOW_API_CONNECT:
+	case NATIVE_WINDOW_API_DISCONNECT:
+	case NATIVE_WINDOW_SET_CROP:
+	case NATIVE_WINDOW_SET_BUFFERS_TRANSFORM:
+	case NATIVE_WINDOW_SET_BUFFERS_STICKY_TRANSFORM:
+	case NATIVE_WINDOW_SET_SCALING_MODE:
+	case NATIVE_WINDOW_SET_SIDEBAND_STREAM:
+	case NATIVE_WINDOW_SET_SURFACE_DAMAGE:
+	case NATIVE_WINDOW_ENABLE_FRAME_TIMESTAMPS:
+		/* accepted, nothing to composite */
+		break;
+	default:
+		err = INVALID_OPERATION;
+		break;
+	}
+
+	pthread_mutex_unlock(&q->lock);
+	va_end(args);
+	return err;
+}
+
+/* ---- GraphicBufferMapper ---- */
+
+GraphicBufferMapper& GraphicBufferMapper::get()
+{
+	static GraphicBufferMapper mapper;
+	return mapper;
+}
+
+static void* mappingOf(buffer_handle_t handle)
+{
+	pthread_mutex_lock(&gHandleLock);
+	std::map<buffer_handle_t, HostBuffer*>::iterator it = gHandles.find(handle);
+	void* base = it == gHandles.end() ? NULL : it->second->base;
+	pthread_mutex_unlock(&gHandleLock);
+	return base;
+}
+
+status_t GraphicBufferMapper::lock(buffer_handle_t handle, uint32_t usage, const Rect& bounds, void** vaddr)
+{
+	return lockAsync(handle, usage, bounds, vaddr, -1);
+}
+
+status_t GraphicBufferMapper::lockAsync(buffer_handle_t handle, uint32_t /*usage*/, const Rect& /*bounds*/,
+		void** vaddr, int fenceFd)
+{
+	if(fenceFd >= 0) {
+		struct pollfd p = { fenceFd, POLLIN, 0 };
+		poll(&p, 1, -1);
+		close(fenceFd);
+	}
+	*vaddr = mappingOf(handle);
+	return *vaddr ? NO_ERROR : BAD_VALUE;
+}
+
+status_t GraphicBufferMapper::unlock(buffer_handle_t handle)
+{
+	return mappingOf(handle) ? NO_ERROR : BAD_VALUE;
+}
+
+status_t GraphicBufferMapper::unlockAsync(buffer_handle_t handle, int* fenceFd)
+{
+	*fenceFd = -1;
+	return unlock(handle);
+}
+
+};
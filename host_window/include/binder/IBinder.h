@@ -0,0 +1,24 @@
+/*
+ * Host stand-in for <binder/IBinder.h>.
+ */
+
+#ifndef HOST_BINDER_IBINDER_H
+#define HOST_BINDER_IBINDER_H
+
+#include <binder/Parcel.h>
+#include <utils/RefBase.h>
+
+namespace android {
+
+class IBinder : public RefBase {
+public:
+	enum {
+		FIRST_CALL_TRANSACTION = 0x00000001,
+		FLAG_ONEWAY = 0x00000001,
+	};
+	virtual status_t transact(uint32_t code, const Parcel& data, Parcel* reply, uint32_t flags = 0) = 0;
+};
+
+};
+
+#endif
@@ -0,0 +1,10 @@
+/*
+ * Host stand-in for <binder/IMemory.h>: nothing the host tools use.
+ */
+
+#ifndef HOST_BINDER_IMEMORY_H
+#define HOST_BINDER_IMEMORY_H
+
+#include <utils/RefBase.h>
+
+#endif
@@ -0,0 +1,19 @@
+/*
+ * Host stand-in for <binder/IPCThreadState.h>.
+ */
+
+#ifndef HOST_BINDER_IPCTHREADSTATE_H
+#define HOST_BINDER_IPCTHREADSTATE_H
+
+namespace android {
+
+class IPCThreadState {
+public:
+	static IPCThreadState* self();
+	/* nothing to serve on the host, blocks forever like the device */
+	void joinThreadPool();
+};
+
+};
+
+#endif
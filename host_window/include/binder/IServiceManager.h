@@ -0,0 +1,26 @@
+/*
+ * Host stand-in for <binder/IServiceManager.h>. The only service is
+ * "SurfaceFlinger", which checks the interface token, logs the
+ * transaction code and replies with an empty parcel after
+ * HOST_BINDER_LATENCY_US, if set.
+ */
+
+#ifndef HOST_BINDER_ISERVICEMANAGER_H
+#define HOST_BINDER_ISERVICEMANAGER_H
+
+#include <binder/IBinder.h>
+#include <utils/String16.h>
+
+namespace android {
+
+class IServiceManager : public RefBase {
+public:
+	sp<IBinder> getService(const String16& name) const;
+	sp<IBinder> checkService(const String16& name) const { return getService(name); }
+};
+
+sp<IServiceManager> defaultServiceManager();
+
+};
+
+#endif
@@ -0,0 +1,61 @@
+/*
+ * Host stand-in for <binder/Parcel.h>: a flat byte buffer.
+ */
+
+#ifndef HOST_BINDER_PARCEL_H
+#define HOST_BINDER_PARCEL_H
+
+#include <assert.h>
+#include <string.h>
+
+#include <vector>
+
+#include <utils/Errors.h>
+#include <utils/String16.h>
+
+namespace android {
+
+class Parcel {
+public:
+	Parcel() : mPos(0) {}
+
+	status_t writeInterfaceToken(const String16& interface) { mInterface = interface; return NO_ERROR; }
+	bool checkInterface(const String16& interface) const { return mInterface == interface; }
+	const String16& interfaceToken() const { return mInterface; }
+
+	status_t writeInt32(int32_t v) { return write(&v, sizeof(v)); }
+	status_t writeInt64(int64_t v) { return write(&v, sizeof(v)); }
+	status_t writeFloat(float v) { return write(&v, sizeof(v)); }
+	int32_t readInt32() const { int32_t v = 0; read(&v, sizeof(v)); return v; }
+	int64_t readInt64() const { int64_t v = 0; read(&v, sizeof(v)); return v; }
+	float readFloat() const { float v = 0; read(&v, sizeof(v)); return v; }
+
+	size_t dataSize() const { return mData.size(); }
+	size_t dataPosition() const { return mPos; }
+	void setDataPosition(size_t pos) const { mPos = pos; }
+	void freeData() { mData.clear(); mPos = 0; }
+
+private:
+	status_t write(const void* p, size_t n)
+	{
+		mData.insert(mData.end(), (const uint8_t*)p, (const uint8_t*)p + n);
+		return NO_ERROR;
+	}
+	status_t read(void* p, size_t n) const
+	{
+		if(mPos + n > mData.size()) {
+			return NOT_ENOUGH_DATA;
+		}
+		memcpy(p, &mData[mPos], n);
+		mPos += n;
+		return NO_ERROR;
+	}
+
+	String16 mInterface;
+	std::vector<uint8_t> mData;
+	mutable size_t mPos;
+};
+
+};
+
+#endif
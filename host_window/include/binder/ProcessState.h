@@ -0,0 +1,21 @@
+/*
+ * Host stand-in for <binder/ProcessState.h>: there is no binder, the host
+ * window lives in this process.
+ */
+
+#ifndef HOST_BINDER_PROCESSSTATE_H
+#define HOST_BINDER_PROCESSSTATE_H
+
+#include <utils/RefBase.h>
+
+namespace android {
+
+class ProcessState : public RefBase {
+public:
+	static sp<ProcessState> self();
+	void startThreadPool() {}
+};
+
+};
+
+#endif
@@ -0,0 +1,15 @@
+/*
+ * Host stand-in for <cutils/ashmem.h>, backed by memfd.
+ */
+
+#ifndef HOST_CUTILS_ASHMEM_H
+#define HOST_CUTILS_ASHMEM_H
+
+#include <stddef.h>
+
+int ashmem_create_region(const char* name, size_t size);
+int ashmem_set_prot_region(int fd, int prot);
+int ashmem_get_size_region(int fd);
+int ashmem_valid(int fd);
+
+#endif
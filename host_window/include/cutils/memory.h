@@ -0,0 +1,15 @@
+/*
+ * Host stand-in for <cutils/memory.h>.
+ */
+
+#ifndef HOST_CUTILS_MEMORY_H
+#define HOST_CUTILS_MEMORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* size is in bytes, as on the device */
+void android_memset16(uint16_t* dst, uint16_t value, size_t size);
+void android_memset32(uint32_t* dst, uint32_t value, size_t size);
+
+#endif
@@ -0,0 +1,21 @@
+/*
+ * Host stand-in for <cutils/native_handle.h>.
+ */
+
+#ifndef HOST_CUTILS_NATIVE_HANDLE_H
+#define HOST_CUTILS_NATIVE_HANDLE_H
+
+typedef struct native_handle {
+	int version;		/* sizeof(native_handle_t) */
+	int numFds;
+	int numInts;
+	int data[0];		/* numFds fds, then numInts ints */
+} native_handle_t;
+
+typedef const native_handle_t* buffer_handle_t;
+
+native_handle_t* native_handle_create(int numFds, int numInts);
+int native_handle_close(const native_handle_t* h);
+int native_handle_delete(native_handle_t* h);
+
+#endif
@@ -0,0 +1,20 @@
+/*
+ * Host stand-in for <cutils/threads.h>: gettid(), which bionic declares in
+ * <unistd.h> but glibc only has from 2.30.
+ */
+
+#ifndef HOST_CUTILS_THREADS_H
+#define HOST_CUTILS_THREADS_H
+
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#if defined(__GLIBC__) && (__GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 30))
+static inline pid_t gettid()
+{
+	return (pid_t)syscall(SYS_gettid);
+}
+#endif
+
+#endif
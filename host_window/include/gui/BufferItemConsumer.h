@@ -0,0 +1,10 @@
+/*
+ * Host stand-in for <gui/BufferItemConsumer.h>: nothing the host tools use.
+ */
+
+#ifndef HOST_GUI_BUFFERITEMCONSUMER_H
+#define HOST_GUI_BUFFERITEMCONSUMER_H
+
+#include <gui/SurfaceComposerClient.h>
+
+#endif
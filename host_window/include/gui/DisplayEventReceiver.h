@@ -0,0 +1,80 @@
+/*
+ * Host stand-in for <gui/DisplayEventReceiver.h>.
+ *
+ * A thread ticks at the refresh rate (HOST_WINDOW_REFRESH_HZ, 60 Hz by
+ * default) and counts every vsync; the ones the receiver asked for are
+ * written to a pipe as Events, so getFd() can be polled like the real
+ * BitTube. Events that find the pipe full are dropped, as they are there.
+ */
+
+#ifndef HOST_GUI_DISPLAYEVENTRECEIVER_H
+#define HOST_GUI_DISPLAYEVENTRECEIVER_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <utils/Errors.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+static inline constexpr uint32_t fourcc(char c1, char c2, char c3, char c4) {
+	return static_cast<uint32_t>(c1) << 24 | static_cast<uint32_t>(c2) << 16 |
+		static_cast<uint32_t>(c3) << 8 | static_cast<uint32_t>(c4);
+}
+
+class DisplayEventReceiver {
+public:
+	enum {
+		DISPLAY_EVENT_VSYNC = fourcc('v', 's', 'y', 'n'),
+		DISPLAY_EVENT_HOTPLUG = fourcc('p', 'l', 'u', 'g'),
+	};
+
+	struct Event {
+		struct Header {
+			uint32_t type;
+			uint32_t id;
+			nsecs_t timestamp __attribute__((aligned(8)));
+		};
+		struct VSync {
+			uint32_t count;
+		};
+		struct Hotplug {
+			bool connected;
+		};
+
+		Header header;
+		union {
+			VSync vsync;
+			Hotplug hotplug;
+		};
+	};
+
+	DisplayEventReceiver();
+	~DisplayEventReceiver();
+
+	status_t initCheck() const;
+	int getFd() const;
+	/* whole events read without blocking, -EAGAIN when there are none */
+	ssize_t getEvents(Event* events, size_t count);
+	/* every count-th vsync, 0 for only those asked for by requestNextVsync() */
+	status_t setVsyncRate(uint32_t count);
+	status_t requestNextVsync();
+
+private:
+	static void* threadLoop(void* data);
+
+	int mReadFd;
+	int mWriteFd;
+	pthread_t mThread;
+	pthread_mutex_t mLock;
+	nsecs_t mPeriod;
+	uint32_t mRate;
+	bool mRequested;
+	bool mQuit;
+};
+
+}; // namespace android
+
+#endif
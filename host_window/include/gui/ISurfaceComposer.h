@@ -0,0 +1,10 @@
+/*
+ * Host stand-in for <gui/ISurfaceComposer.h>: nothing the host tools use.
+ */
+
+#ifndef HOST_GUI_ISURFACECOMPOSER_H
+#define HOST_GUI_ISURFACECOMPOSER_H
+
+#include <gui/SurfaceComposerClient.h>
+
+#endif
@@ -0,0 +1,10 @@
+/*
+ * Host stand-in for <gui/ISurfaceComposerClient.h>: nothing the host tools use.
+ */
+
+#ifndef HOST_GUI_ISURFACECOMPOSERCLIENT_H
+#define HOST_GUI_ISURFACECOMPOSERCLIENT_H
+
+#include <gui/SurfaceComposerClient.h>
+
+#endif
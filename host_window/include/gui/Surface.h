@@ -0,0 +1,57 @@
+/*
+ * Host stand-in for <gui/Surface.h>.
+ *
+ * A Surface owns a small buffer queue of memfd backed buffers and a
+ * consumer thread that plays SurfaceFlinger: once per refresh it latches
+ * the oldest queued buffer, releases the one it showed before and records
+ * latch and present times for native_window_get_frame_timestamps().
+ *
+ * The refresh rate is 60 Hz unless HOST_WINDOW_REFRESH_HZ says otherwise.
+ * Fences are always -1: a dequeued buffer is already released.
+ */
+
+#ifndef HOST_GUI_SURFACE_H
+#define HOST_GUI_SURFACE_H
+
+#include <system/window.h>
+#include <ui/PixelFormat.h>
+#include <utils/Errors.h>
+#include <utils/NativeHandle.h>
+#include <utils/RefBase.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+struct HostQueue;
+
+class Surface : public ANativeWindow, public RefBase {
+public:
+	Surface(const String8& name, uint32_t width, uint32_t height, PixelFormat format);
+
+	status_t setSidebandStream(const sp<NativeHandle>& stream);
+
+	/* Frames latched by the consumer and frames queued over others, since creation. */
+	void getHostStats(int* presented, int* dropped);
+
+protected:
+	virtual ~Surface();
+
+private:
+	static int hook_setSwapInterval(ANativeWindow* window, int interval);
+	static int hook_dequeueBuffer_DEPRECATED(ANativeWindow* window, ANativeWindowBuffer** buffer);
+	static int hook_lockBuffer_DEPRECATED(ANativeWindow* window, ANativeWindowBuffer* buffer);
+	static int hook_queueBuffer_DEPRECATED(ANativeWindow* window, ANativeWindowBuffer* buffer);
+	static int hook_cancelBuffer_DEPRECATED(ANativeWindow* window, ANativeWindowBuffer* buffer);
+	static int hook_query(const ANativeWindow* window, int what, int* value);
+	static int hook_perform(ANativeWindow* window, int operation, ...);
+	static int hook_dequeueBuffer(ANativeWindow* window, ANativeWindowBuffer** buffer, int* fenceFd);
+	static int hook_queueBuffer(ANativeWindow* window, ANativeWindowBuffer* buffer, int fenceFd);
+	static int hook_cancelBuffer(ANativeWindow* window, ANativeWindowBuffer* buffer, int fenceFd);
+
+	HostQueue* mQueue;
+};
+
+};
+
+#endif
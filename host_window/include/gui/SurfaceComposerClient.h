@@ -0,0 +1,99 @@
+/*
+ * Host stand-in for <gui/SurfaceComposerClient.h>. Layer state is kept in
+ * this process; Transaction::apply() takes one lock and, when
+ * HOST_BINDER_LATENCY_US is set, sleeps that long to stand in for the
+ * binder round trip. Like SurfaceFlinger it then walks the whole layer
+ * tree to work out every layer's z order and inherited crop, so its cost
+ * grows with the tree.
+ */
+
+#ifndef HOST_GUI_SURFACECOMPOSERCLIENT_H
+#define HOST_GUI_SURFACECOMPOSERCLIENT_H
+
+#include <vector>
+
+#include <binder/IBinder.h>
+#include <gui/Surface.h>
+#include <ui/Rect.h>
+
+namespace android {
+
+class SurfaceControl : public RefBase {
+public:
+	~SurfaceControl();
+	sp<Surface> getSurface();
+	bool isValid() const { return true; }
+	/* what reparent() and setRelativeLayer() refer to the layer by */
+	sp<IBinder> getHandle() const { return mHandle; }
+
+	/* the state as of the last applied transaction */
+	int32_t z;
+	float x;
+	float y;
+	uint32_t width;
+	uint32_t height;
+	float matrix[4];		/* dsdx, dtdx, dtdy, dsdy */
+	float alpha;
+	bool shown;
+	Rect crop;			/* in layer space, empty for none */
+	sp<SurfaceControl> parent;
+	sp<SurfaceControl> relativeTo;	/* z is relative to this layer's when set */
+	/* from the last traversal */
+	Rect visible;			/* screen space, crops of all ancestors applied */
+	int order;			/* position in the composition order, bottom first */
+	int depth;
+
+private:
+	friend class SurfaceComposerClient;
+	SurfaceControl(const String8& name, uint32_t w, uint32_t h, PixelFormat format);
+
+	String8 mName;
+	PixelFormat mFormat;
+	sp<Surface> mSurface;
+	sp<IBinder> mHandle;
+};
+
+class SurfaceComposerClient : public RefBase {
+public:
+	SurfaceComposerClient() {}
+	status_t initCheck() const { return NO_ERROR; }
+
+	sp<SurfaceControl> createSurface(const String8& name, uint32_t w, uint32_t h, PixelFormat format,
+			uint32_t flags = 0, SurfaceControl* parent = NULL, int32_t windowType = -1, int32_t ownerUid = -1);
+
+	class Transaction {
+	public:
+		Transaction& setLayer(const sp<SurfaceControl>& sc, int32_t z);
+		Transaction& setRelativeLayer(const sp<SurfaceControl>& sc, const sp<IBinder>& relativeTo, int32_t z);
+		Transaction& setPosition(const sp<SurfaceControl>& sc, float x, float y);
+		Transaction& setSize(const sp<SurfaceControl>& sc, uint32_t w, uint32_t h);
+		Transaction& setMatrix(const sp<SurfaceControl>& sc, float dsdx, float dtdx, float dtdy, float dsdy);
+		Transaction& setAlpha(const sp<SurfaceControl>& sc, float alpha);
+		Transaction& setCrop(const sp<SurfaceControl>& sc, const Rect& crop);
+		Transaction& show(const sp<SurfaceControl>& sc);
+		Transaction& hide(const sp<SurfaceControl>& sc);
+		Transaction& reparent(const sp<SurfaceControl>& sc, const sp<IBinder>& newParentHandle);
+		Transaction& merge(Transaction&& other);
+		status_t apply(bool synchronous = false);
+
+	private:
+		struct Change {
+			sp<SurfaceControl> sc;
+			int what;
+			float f[4];
+			int32_t i;
+			sp<SurfaceControl> other;
+		};
+		Change& add(const sp<SurfaceControl>& sc, int what);
+		std::vector<Change> mChanges;
+	};
+
+	/* Applied transactions and layer changes in them, since start. */
+	static void getHostStats(int* transactions, int* changes);
+	/* Layers alive and layers visited by the traversals, since start. */
+	static void getHostTreeStats(int* layers, long* visited);
+};
+
+};
+
+#endif
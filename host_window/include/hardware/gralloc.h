@@ -0,0 +1,23 @@
+/*
+ * Host stand-in for <hardware/gralloc.h>: usage bits only.
+ */
+
+#ifndef HOST_HARDWARE_GRALLOC_H
+#define HOST_HARDWARE_GRALLOC_H
+
+enum {
+	GRALLOC_USAGE_SW_READ_NEVER	= 0x00000000,
+	GRALLOC_USAGE_SW_READ_RARELY	= 0x00000002,
+	GRALLOC_USAGE_SW_READ_OFTEN	= 0x00000003,
+	GRALLOC_USAGE_SW_READ_MASK	= 0x0000000F,
+	GRALLOC_USAGE_SW_WRITE_NEVER	= 0x00000000,
+	GRALLOC_USAGE_SW_WRITE_RARELY	= 0x00000020,
+	GRALLOC_USAGE_SW_WRITE_OFTEN	= 0x00000030,
+	GRALLOC_USAGE_SW_WRITE_MASK	= 0x000000F0,
+	GRALLOC_USAGE_HW_TEXTURE	= 0x00000100,
+	GRALLOC_USAGE_HW_RENDER		= 0x00000200,
+	GRALLOC_USAGE_HW_COMPOSER	= 0x00000800,
+	GRALLOC_USAGE_PROTECTED		= 0x00004000,
+};
+
+#endif
@@ -0,0 +1,17 @@
+/*
+ * Host stand-in for <system/graphics.h>: the formats the tools use.
+ */
+
+#ifndef HOST_SYSTEM_GRAPHICS_H
+#define HOST_SYSTEM_GRAPHICS_H
+
+typedef enum {
+	HAL_PIXEL_FORMAT_RGBA_8888 = 1,
+	HAL_PIXEL_FORMAT_RGBX_8888 = 2,
+	HAL_PIXEL_FORMAT_RGB_888 = 3,
+	HAL_PIXEL_FORMAT_RGB_565 = 4,
+	HAL_PIXEL_FORMAT_BGRA_8888 = 5,
+	HAL_PIXEL_FORMAT_YV12 = 0x32315659,
+} android_pixel_format_t;
+
+#endif
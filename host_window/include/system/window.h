@@ -0,0 +1,219 @@
+/*
+ * Host stand-in for <system/window.h>: the ANativeWindow interface and the
+ * native_window_*() helpers the tools call, routed through perform() as on
+ * the device.
+ */
+
+#ifndef HOST_SYSTEM_WINDOW_H
+#define HOST_SYSTEM_WINDOW_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cutils/native_handle.h>
+#include <hardware/gralloc.h>
+#include <system/graphics.h>
+
+typedef struct android_native_rect_t {
+	int32_t left;
+	int32_t top;
+	int32_t right;
+	int32_t bottom;
+} android_native_rect_t;
+
+typedef struct ANativeWindowBuffer {
+	int width;
+	int height;
+	int stride;
+	int format;
+	int usage_deprecated;
+	uint64_t usage;
+	buffer_handle_t handle;
+} ANativeWindowBuffer_t;
+
+/* query() */
+enum {
+	NATIVE_WINDOW_WIDTH = 0,
+	NATIVE_WINDOW_HEIGHT = 1,
+	NATIVE_WINDOW_FORMAT = 2,
+	NATIVE_WINDOW_MIN_UNDEQUEUED_BUFFERS = 3,
+	NATIVE_WINDOW_QUEUES_TO_WINDOW_COMPOSER = 4,
+	NATIVE_WINDOW_CONCRETE_TYPE = 5,
+	NATIVE_WINDOW_DEFAULT_WIDTH = 6,
+	NATIVE_WINDOW_DEFAULT_HEIGHT = 7,
+	NATIVE_WINDOW_CONSUMER_USAGE_BITS = 10,
+	NATIVE_WINDOW_BUFFER_AGE = 13,
+};
+
+/* perform() */
+enum {
+	NATIVE_WINDOW_SET_USAGE = 0,
+	NATIVE_WINDOW_CONNECT = 1,
+	NATIVE_WINDOW_DISCONNECT = 2,
+	NATIVE_WINDOW_SET_CROP = 3,
+	NATIVE_WINDOW_SET_BUFFER_COUNT = 4,
+	NATIVE_WINDOW_SET_BUFFERS_TRANSFORM = 6,
+	NATIVE_WINDOW_SET_BUFFERS_TIMESTAMP = 7,
+	NATIVE_WINDOW_SET_BUFFERS_DIMENSIONS = 8,
+	NATIVE_WINDOW_SET_BUFFERS_FORMAT = 9,
+	NATIVE_WINDOW_SET_SCALING_MODE = 10,
+	NATIVE_WINDOW_API_CONNECT = 13,
+	NATIVE_WINDOW_API_DISCONNECT = 14,
+	NATIVE_WINDOW_SET_BUFFERS_USER_DIMENSIONS = 15,
+	NATIVE_WINDOW_SET_BUFFERS_STICKY_TRANSFORM = 17,
+	NATIVE_WINDOW_SET_SIDEBAND_STREAM = 18,
+	NATIVE_WINDOW_SET_SURFACE_DAMAGE = 20,
+	NATIVE_WINDOW_GET_REFRESH_CYCLE_DURATION = 23,
+	NATIVE_WINDOW_GET_NEXT_FRAME_ID = 24,
+	NATIVE_WINDOW_ENABLE_FRAME_TIMESTAMPS = 25,
+	NATIVE_WINDOW_GET_FRAME_TIMESTAMPS = 27,
+	NATIVE_WINDOW_SET_USAGE64 = 30,
+};
+
+enum {
+	NATIVE_WINDOW_API_EGL = 1,
+	NATIVE_WINDOW_API_CPU = 2,
+	NATIVE_WINDOW_API_MEDIA = 3,
+	NATIVE_WINDOW_API_CAMERA = 4,
+};
+
+enum {
+	NATIVE_WINDOW_TRANSFORM_FLIP_H = 1,
+	NATIVE_WINDOW_TRANSFORM_FLIP_V = 2,
+	NATIVE_WINDOW_TRANSFORM_ROT_90 = 4,
+};
+
+enum {
+	NATIVE_WINDOW_SCALING_MODE_FREEZE = 0,
+	NATIVE_WINDOW_SCALING_MODE_SCALE_TO_WINDOW = 1,
+	NATIVE_WINDOW_SCALING_MODE_SCALE_CROP = 2,
+};
+
+static const int64_t NATIVE_WINDOW_TIMESTAMP_AUTO = (-9223372036854775807LL-1);
+static const int64_t NATIVE_WINDOW_TIMESTAMP_PENDING = -2;
+static const int64_t NATIVE_WINDOW_TIMESTAMP_INVALID = -1;
+
+typedef struct ANativeWindow {
+	const uint32_t flags;
+	const int minSwapInterval;
+	const int maxSwapInterval;
+	const float xdpi;
+	const float ydpi;
+
+	int (*setSwapInterval)(struct ANativeWindow* window, int interval);
+	int (*dequeueBuffer_DEPRECATED)(struct ANativeWindow* window, struct ANativeWindowBuffer** buffer);
+	int (*lockBuffer_DEPRECATED)(struct ANativeWindow* window, struct ANativeWindowBuffer* buffer);
+	int (*queueBuffer_DEPRECATED)(struct ANativeWindow* window, struct ANativeWindowBuffer* buffer);
+	int (*query)(const struct ANativeWindow* window, int what, int* value);
+	int (*perform)(struct ANativeWindow* window, int operation, ...);
+	int (*cancelBuffer_DEPRECATED)(struct ANativeWindow* window, struct ANativeWindowBuffer* buffer);
+	int (*dequeueBuffer)(struct ANativeWindow* window, struct ANativeWindowBuffer** buffer, int* fenceFd);
+	int (*queueBuffer)(struct ANativeWindow* window, struct ANativeWindowBuffer* buffer, int fenceFd);
+	int (*cancelBuffer)(struct ANativeWindow* window, struct ANativeWindowBuffer* buffer, int fenceFd);
+
+#ifdef __cplusplus
+	ANativeWindow() : flags(0), minSwapInterval(0), maxSwapInterval(1), xdpi(0), ydpi(0) {}
+#endif
+} ANativeWindow;
+
+static inline int native_window_set_usage(ANativeWindow* window, uint64_t usage)
+{
+	return window->perform(window, NATIVE_WINDOW_SET_USAGE64, usage);
+}
+
+static inline int native_window_api_connect(ANativeWindow* window, int api)
+{
+	return window->perform(window, NATIVE_WINDOW_API_CONNECT, api);
+}
+
+static inline int native_window_api_disconnect(ANativeWindow* window, int api)
+{
+	return window->perform(window, NATIVE_WINDOW_API_DISCONNECT, api);
+}
+
+static inline int native_window_set_crop(ANativeWindow* window, const android_native_rect_t* crop)
+{
+	return window->perform(window, NATIVE_WINDOW_SET_CROP, crop);
+}
+
+static inline int native_window_set_buffer_count(ANativeWindow* window, size_t bufferCount)
+{
+	return window->perform(window, NATIVE_WINDOW_SET_BUFFER_COUNT, bufferCount);
+}
+
+static inline int native_window_set_buffers_dimensions(ANativeWindow* window, int w, int h)
+{
+	return window->perform(window, NATIVE_WINDOW_SET_BUFFERS_DIMENSIONS, w, h);
+}
+
+static inline int native_window_set_buffers_user_dimensions(ANativeWindow* window, int w, int h)
+{
+	return window->perform(window, NATIVE_WINDOW_SET_BUFFERS_USER_DIMENSIONS, w, h);
+}
+
+static inline int native_window_set_buffers_format(ANativeWindow* window, int format)
+{
+	return window->perform(window, NATIVE_WINDOW_SET_BUFFERS_FORMAT, format);
+}
+
+static inline int native_window_set_buffers_transform(ANativeWindow* window, int transform)
+{
+	return window->perform(window, NATIVE_WINDOW_SET_BUFFERS_TRANSFORM, transform);
+}
+
+static inline int native_window_set_buffers_sticky_transform(ANativeWindow* window, int transform)
+{
+	return window->perform(window, NATIVE_WINDOW_SET_BUFFERS_STICKY_TRANSFORM, transform);
+}
+
+static inline int native_window_set_buffers_timestamp(ANativeWindow* window, int64_t timestamp)
+{
+	return window->perform(window, NATIVE_WINDOW_SET_BUFFERS_TIMESTAMP, timestamp);
+}
+
+static inline int native_window_set_scaling_mode(ANativeWindow* window, int mode)
+{
+	return window->perform(window, NATIVE_WINDOW_SET_SCALING_MODE, mode);
+}
+
+static inline int native_window_set_sideband_stream(ANativeWindow* window, native_handle_t* sidebandHandle)
+{
+	return window->perform(window, NATIVE_WINDOW_SET_SIDEBAND_STREAM, sidebandHandle);
+}
+
+static inline int native_window_set_surface_damage(ANativeWindow* window,
+		const android_native_rect_t* rects, size_t numRects)
+{
+	return window->perform(window, NATIVE_WINDOW_SET_SURFACE_DAMAGE, rects, numRects);
+}
+
+static inline int native_window_get_refresh_cycle_duration(ANativeWindow* window, int64_t* outDuration)
+{
+	return window->perform(window, NATIVE_WINDOW_GET_REFRESH_CYCLE_DURATION, outDuration);
+}
+
+static inline int native_window_get_next_frame_id(ANativeWindow* window, uint64_t* frameId)
+{
+	return window->perform(window, NATIVE_WINDOW_GET_NEXT_FRAME_ID, frameId);
+}
+
+static inline int native_window_enable_frame_timestamps(ANativeWindow* window, bool enable)
+{
+	return window->perform(window, NATIVE_WINDOW_ENABLE_FRAME_TIMESTAMPS, enable);
+}
+
+static inline int native_window_get_frame_timestamps(ANativeWindow* window, uint64_t frameId,
+		int64_t* outRequestedPresentTime, int64_t* outAcquireTime, int64_t* outLatchTime,
+		int64_t* outFirstRefreshStartTime, int64_t* outLastRefreshStartTime,
+		int64_t* outGpuCompositionDoneTime, int64_t* outDisplayPresentTime,
+		int64_t* outDequeueReadyTime, int64_t* outReleaseTime)
+{
+	return window->perform(window, NATIVE_WINDOW_GET_FRAME_TIMESTAMPS, frameId,
+			outRequestedPresentTime, outAcquireTime, outLatchTime, outFirstRefreshStartTime,
+			outLastRefreshStartTime, outGpuCompositionDoneTime, outDisplayPresentTime,
+			outDequeueReadyTime, outReleaseTime);
+}
+
+#endif
@@ -0,0 +1,27 @@
+/*
+ * Host stand-in for <ui/GraphicBufferMapper.h>. Buffers come from the host
+ * window and are always mapped, so lock only checks the handle and waits
+ * for the fence.
+ */
+
+#ifndef HOST_UI_GRAPHICBUFFERMAPPER_H
+#define HOST_UI_GRAPHICBUFFERMAPPER_H
+
+#include <utils/Errors.h>
+#include <ui/Rect.h>
+
+namespace android {
+
+class GraphicBufferMapper {
+public:
+	static GraphicBufferMapper& get();
+
+	status_t lock(buffer_handle_t handle, uint32_t usage, const Rect& bounds, void** vaddr);
+	status_t lockAsync(buffer_handle_t handle, uint32_t usage, const Rect& bounds, void** vaddr, int fenceFd);
+	status_t unlock(buffer_handle_t handle);
+	status_t unlockAsync(buffer_handle_t handle, int* fenceFd);
+};
+
+};
+
+#endif
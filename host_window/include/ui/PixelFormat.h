@@ -0,0 +1,22 @@
+/*
+ * Host stand-in for <ui/PixelFormat.h>.
+ */
+
+#ifndef HOST_UI_PIXELFORMAT_H
+#define HOST_UI_PIXELFORMAT_H
+
+#include <system/graphics.h>
+
+namespace android {
+
+typedef int32_t PixelFormat;
+
+enum {
+	PIXEL_FORMAT_RGBA_8888 = HAL_PIXEL_FORMAT_RGBA_8888,
+	PIXEL_FORMAT_RGBX_8888 = HAL_PIXEL_FORMAT_RGBX_8888,
+	PIXEL_FORMAT_RGB_565 = HAL_PIXEL_FORMAT_RGB_565,
+};
+
+};
+
+#endif
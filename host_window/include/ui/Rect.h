@@ -0,0 +1,29 @@
+/*
+ * Host stand-in for <ui/Rect.h>.
+ */
+
+#ifndef HOST_UI_RECT_H
+#define HOST_UI_RECT_H
+
+#include <stdint.h>
+
+#include <system/window.h>
+
+namespace android {
+
+class Rect : public android_native_rect_t {
+public:
+	Rect() { left = top = right = bottom = 0; }
+	Rect(int32_t w, int32_t h) { left = top = 0; right = w; bottom = h; }
+	Rect(int32_t l, int32_t t, int32_t r, int32_t b) { left = l; top = t; right = r; bottom = b; }
+
+	int32_t getWidth() const { return right - left; }
+	int32_t getHeight() const { return bottom - top; }
+	int32_t width() const { return getWidth(); }
+	int32_t height() const { return getHeight(); }
+	bool isEmpty() const { return right <= left || bottom <= top; }
+};
+
+};
+
+#endif
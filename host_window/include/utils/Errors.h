@@ -0,0 +1,32 @@
+/*
+ * Host stand-in for <utils/Errors.h>.
+ */
+
+#ifndef HOST_UTILS_ERRORS_H
+#define HOST_UTILS_ERRORS_H
+
+#include <errno.h>
+#include <stdint.h>
+
+namespace android {
+
+typedef int32_t status_t;
+
+enum {
+	OK			= 0,
+	NO_ERROR		= 0,
+	UNKNOWN_ERROR		= (-2147483647-1),
+	NO_MEMORY		= -ENOMEM,
+	INVALID_OPERATION	= -ENOSYS,
+	BAD_VALUE		= -EINVAL,
+	NAME_NOT_FOUND		= -ENOENT,
+	NO_INIT			= -ENODEV,
+	TIMED_OUT		= -ETIMEDOUT,
+	WOULD_BLOCK		= -EWOULDBLOCK,
+	NOT_ENOUGH_DATA		= -ENODATA,
+	PERMISSION_DENIED	= -EPERM,
+};
+
+};
+
+#endif
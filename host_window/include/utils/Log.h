@@ -0,0 +1,26 @@
+/*
+ * Host stand-in for <utils/Log.h>: everything goes to stderr.
+ */
+
+#ifndef HOST_UTILS_LOG_H
+#define HOST_UTILS_LOG_H
+
+#include <stdio.h>
+
+/* device code calls gettid() next to its log lines without including anything for it */
+#include <cutils/threads.h>
+
+#ifndef LOG_TAG
+#define LOG_TAG NULL
+#endif
+
+#define HOST_LOG(level, ...)	do { fprintf(stderr, "%s %s: ", level, LOG_TAG ? LOG_TAG : "-"); \
+					fprintf(stderr, __VA_ARGS__); fprintf(stderr, "\n"); } while(0)
+
+#define ALOGV(...)	do { if(0) HOST_LOG("V", __VA_ARGS__); } while(0)
+#define ALOGD(...)	HOST_LOG("D", __VA_ARGS__)
+#define ALOGI(...)	HOST_LOG("I", __VA_ARGS__)
+#define ALOGW(...)	HOST_LOG("W", __VA_ARGS__)
+#define ALOGE(...)	HOST_LOG("E", __VA_ARGS__)
+
+#endif
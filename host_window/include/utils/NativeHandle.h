@@ -0,0 +1,37 @@
+/*
+ * Host stand-in for <utils/NativeHandle.h>.
+ */
+
+#ifndef HOST_UTILS_NATIVEHANDLE_H
+#define HOST_UTILS_NATIVEHANDLE_H
+
+#include <cutils/native_handle.h>
+#include <utils/RefBase.h>
+
+namespace android {
+
+class NativeHandle : public RefBase {
+public:
+	static sp<NativeHandle> create(native_handle_t* handle, bool ownsHandle)
+	{
+		return handle ? new NativeHandle(handle, ownsHandle) : NULL;
+	}
+	const native_handle_t* handle() { return mHandle; }
+
+private:
+	NativeHandle(native_handle_t* handle, bool ownsHandle) : mHandle(handle), mOwnsHandle(ownsHandle) {}
+	~NativeHandle()
+	{
+		if(mOwnsHandle) {
+			native_handle_close(mHandle);
+			native_handle_delete(mHandle);
+		}
+	}
+
+	native_handle_t* mHandle;
+	bool mOwnsHandle;
+};
+
+};
+
+#endif
@@ -0,0 +1,35 @@
+/*
+ * Host stand-in for <utils/RefBase.h>: strong references only.
+ */
+
+#ifndef HOST_UTILS_REFBASE_H
+#define HOST_UTILS_REFBASE_H
+
+#include <utils/StrongPointer.h>
+
+namespace android {
+
+class RefBase {
+public:
+	void incStrong(const void* /*id*/) const { __atomic_add_fetch(&mStrong, 1, __ATOMIC_RELAXED); }
+	void decStrong(const void* /*id*/) const
+	{
+		if(__atomic_sub_fetch(&mStrong, 1, __ATOMIC_ACQ_REL) == 0) {
+			delete this;
+		}
+	}
+	int32_t getStrongCount() const { return __atomic_load_n(&mStrong, __ATOMIC_RELAXED); }
+
+protected:
+	RefBase() : mStrong(0) {}
+	virtual ~RefBase() {}
+
+private:
+	RefBase(const RefBase&);
+	RefBase& operator=(const RefBase&);
+	mutable int32_t mStrong;
+};
+
+};
+
+#endif
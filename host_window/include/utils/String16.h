@@ -0,0 +1,26 @@
+/*
+ * Host stand-in for <utils/String16.h>; kept as UTF-8, which is all the
+ * tools compare.
+ */
+
+#ifndef HOST_UTILS_STRING16_H
+#define HOST_UTILS_STRING16_H
+
+#include <string>
+
+namespace android {
+
+class String16 {
+public:
+	String16() {}
+	String16(const char* s) : mString(s ? s : "") {}
+	const char* host() const { return mString.c_str(); }
+	bool operator==(const String16& o) const { return mString == o.mString; }
+
+private:
+	std::string mString;
+};
+
+};
+
+#endif
@@ -0,0 +1,25 @@
+/*
+ * Host stand-in for <utils/String8.h>.
+ */
+
+#ifndef HOST_UTILS_STRING8_H
+#define HOST_UTILS_STRING8_H
+
+#include <string>
+
+namespace android {
+
+class String8 {
+public:
+	String8() {}
+	String8(const char* s) : mString(s ? s : "") {}
+	const char* string() const { return mString.c_str(); }
+	size_t length() const { return mString.size(); }
+
+private:
+	std::string mString;
+};
+
+};
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * Host stand-in for <utils/StrongPointer.h>.
+ */
+
+#ifndef HOST_UTILS_STRONGPOINTER_H
+#define HOST_UTILS_STRONGPOINTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+template<typename T>
+class sp {
+public:
+	sp() : m_ptr(NULL) {}
+	sp(T* other) : m_ptr(other) { if(m_ptr) m_ptr->incStrong(this); }
+	sp(const sp<T>& other) : m_ptr(other.m_ptr) { if(m_ptr) m_ptr->incStrong(this); }
+	template<typename U> sp(U* other) : m_ptr(other) { if(m_ptr) m_ptr->incStrong(this); }
+	template<typename U> sp(const sp<U>& other) : m_ptr(other.get()) { if(m_ptr) m_ptr->incStrong(this); }
+	~sp() { if(m_ptr) m_ptr->decStrong(this); }
+
+	sp& operator=(const sp<T>& other) { return *this = other.m_ptr; }
+	sp& operator=(T* other)
+	{
+		if(other) other->incStrong(this);
+		if(m_ptr) m_ptr->decStrong(this);
+		m_ptr = other;
+		return *this;
+	}
+	void clear() { *this = (T*)NULL; }
+
+	T& operator*() const { return *m_ptr; }
+	T* operator->() const { return m_ptr; }
+	T* get() const { return m_ptr; }
+	explicit operator bool() const { return m_ptr != NULL; }
+
+	bool operator==(const T* o) const { return m_ptr == o; }
+	bool operator!=(const T* o) const { return m_ptr != o; }
+	template<typename U> bool operator==(const sp<U>& o) const { return m_ptr == o.get(); }
+	template<typename U> bool operator!=(const sp<U>& o) const { return m_ptr != o.get(); }
+
+private:
+	T* m_ptr;
+};
+
+};
+
+#endif
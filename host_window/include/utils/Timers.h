@@ -0,0 +1,30 @@
+/*
+ * Host stand-in for <utils/Timers.h>.
+ */
+
+#ifndef HOST_UTILS_TIMERS_H
+#define HOST_UTILS_TIMERS_H
+
+#include <stdint.h>
+#include <time.h>
+
+typedef int64_t nsecs_t;
+
+enum {
+	SYSTEM_TIME_REALTIME = 0,
+	SYSTEM_TIME_MONOTONIC = 1,
+};
+
+static inline nsecs_t systemTime(int clock = SYSTEM_TIME_MONOTONIC)
+{
+	struct timespec t;
+	clock_gettime(clock == SYSTEM_TIME_REALTIME ? CLOCK_REALTIME : CLOCK_MONOTONIC, &t);
+	return (nsecs_t)t.tv_sec*1000000000LL + t.tv_nsec;
+}
+
+static inline nsecs_t ns2us(nsecs_t v) { return v/1000; }
+static inline nsecs_t ns2ms(nsecs_t v) { return v/1000000; }
+static inline nsecs_t us2ns(nsecs_t v) { return v*1000; }
+static inline nsecs_t ms2ns(nsecs_t v) { return v*1000000; }
+
+#endif
@@ -21,3 +21,37 @@ LOCAL_MODULE_TAGS := tests
 
 include $(BUILD_EXECUTABLE)
 
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+		    test.cpp
+
+LOCAL_MODULE:= mapp_test_host
+
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+		    ring_bench.cpp \
+		    shmring.cpp
+
+LOCAL_MODULE:= ring_bench
+
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+		    ring_bench.cpp \
+		    shmring.cpp
+
+LOCAL_MODULE:= ring_bench_host
+
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,277 @@
+/*
+ * ring_bench.cpp
+ * Forks one consumer and 1..N producer processes around a shmring and
+ * reports messages per second and send to receive latency for payloads
+ * from 64 bytes to 8 MiB. Producers write each payload in place, the
+ * consumer checks it in place, as frame metadata would travel between a
+ * media and a display process.
+ *
+ * usage: ring_bench [producers] [messages] [capacity] [rateHz]
+ * messages is per payload size, capped so no size moves more than 1 GiB;
+ * capacity takes K and M suffixes and must hold two of the largest
+ * payload. Unpaced, the ring runs full and latency is mostly queueing;
+ * rateHz paces each producer to that many messages a second, so latency
+ * is the handoff and wakeup alone. After those, small payloads of mixed
+ * lengths, up to the size shown, go through a 4 KiB ring, so records wrap
+ * with every length of tail left before the end. Their payloads carry, at
+ * every place a later record's header may start, the commit word that
+ * record will have, so a consumer that takes stale bytes for a commit
+ * reads a record before it is written. Output is CSV:
+ *   producers,size,messages,ns,msgs_per_s,mb_per_s,p50_us,p99_us,max_us,errors
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "shmring.h"
+
+#define MAX_PRODUCERS	16
+#define MAX_SAMPLES	(1 << 20)
+#define BYTE_BUDGET	((size_t)1 << 30)
+#define WRAP_CAPACITY	4096
+#define WRAP_MESSAGES	200000
+/* shmring starts records on 32 byte boundaries, the size of their header */
+#define RING_HEADER_STRIDE	32
+
+static const size_t payloadSizes[] = {
+	64, 256, 1024, 4096, 16384, 65536, 262144, 1048576, 8388608,
+};
+
+/* Largest of the mixed lengths; none a power of two past the stamp. */
+static const size_t wrapSizes[] = {
+	17, 40, 100, 1000,
+};
+
+/* At the front of every payload; the rest is filled with seq's low byte. */
+typedef struct {
+	int64_t sent;
+	uint32_t producer;
+	uint32_t seq;
+} MessageStamp;
+
+/* Filled in by the consumer, read by the parent once everyone has exited. */
+typedef struct {
+	int64_t start;
+	int64_t end;
+	long received;
+	long long bytes;
+	long errors;
+	long numSamples;
+	int64_t samples[MAX_SAMPLES];
+} BenchResults;
+
+static int64_t nowNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+static int compareTimes(const void* a, const void* b)
+{
+	int64_t x = *(const int64_t*)a;
+	int64_t y = *(const int64_t*)b;
+	return x < y ? -1 : x > y;
+}
+
+/* Blocks until the parent closes the write end of the start pipe. */
+static void waitForStart(int fd)
+{
+	char c;
+	while(read(fd, &c, 1) > 0) {
+	}
+}
+
+static void sleepUntil(int64_t when)
+{
+	struct timespec ts;
+	ts.tv_sec = when/1000000000;
+	ts.tv_nsec = when % 1000000000;
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+	}
+}
+
+/*
+ * Where a record header may start, stores the commit word a record there
+ * will have one lap later: its position plus one. The ring holds no more
+ * than capacity bytes past the oldest unreleased record, so msg's position
+ * is the last one below the reservation counter with msg's offset.
+ */
+static void poison(ShmRing* ring, uint8_t* msg, size_t size)
+{
+	uint64_t capacity = ring->header->capacity;
+	uint64_t reserved = __atomic_load_n(&ring->header->reserved, __ATOMIC_RELAXED);
+	uint64_t behind = (reserved - (uint64_t)(msg - ring->data)) & (capacity - 1);
+	uint64_t pos = reserved - (behind ? behind : capacity);
+	/* the payload starts on a header boundary; keep the stamp and the last byte */
+	for(size_t at=RING_HEADER_STRIDE; at + sizeof(uint64_t) < size; at+=RING_HEADER_STRIDE) {
+		uint64_t word = pos + at + capacity + 1;
+		memcpy(msg + at, &word, sizeof(word));
+	}
+}
+
+/* With mixed, message i is between one byte past the stamp and maxSize long. */
+static void produce(ShmRing* ring, int producer, long count, size_t maxSize, bool mixed, int64_t interval)
+{
+	int64_t start = nowNs();
+	for(long i=0; i<count; i++) {
+		if(interval > 0) {
+			sleepUntil(start + i*interval);
+		}
+		size_t size = mixed ? sizeof(MessageStamp) + 1 + (size_t)(i*37 + producer) % (maxSize - sizeof(MessageStamp)) :
+				maxSize;
+		uint8_t* msg = (uint8_t*)shmRingReserve(ring, size, -1);
+		memset(msg + sizeof(MessageStamp), (int)(i & 0xff), size - sizeof(MessageStamp));
+		if(mixed) {
+			poison(ring, msg, size);
+		}
+		MessageStamp* stamp = (MessageStamp*)msg;
+		stamp->producer = producer;
+		stamp->seq = (uint32_t)i;
+		stamp->sent = nowNs();
+		shmRingCommit(ring, msg);
+	}
+}
+
+static void consume(ShmRing* ring, BenchResults* results, long count, int numProducers)
+{
+	uint32_t next[MAX_PRODUCERS] = { 0 };
+	long every = count/MAX_SAMPLES + 1;
+	for(long i=0; i<count; i++) {
+		size_t len;
+		const uint8_t* msg = (const uint8_t*)shmRingPeek(ring, &len, 10000000000LL);
+		if(!msg) {
+			results->errors += count - i;
+			break;
+		}
+		int64_t now = nowNs();
+		MessageStamp stamp;
+		memcpy(&stamp, msg, sizeof(stamp));
+		/* per producer order holds, and the payload is all there */
+		if(stamp.producer >= (uint32_t)numProducers || stamp.seq != next[stamp.producer] ||
+				msg[len - 1] != (uint8_t)(stamp.seq & 0xff)) {
+			results->errors++;
+		}
+		if(stamp.producer < (uint32_t)numProducers) {
+			next[stamp.producer] = stamp.seq + 1;
+		}
+		if(i % every == 0 && results->numSamples < MAX_SAMPLES) {
+			results->samples[results->numSamples++] = now - stamp.sent;
+		}
+		shmRingRelease(ring);
+		results->received++;
+		results->bytes += len;
+	}
+	results->end = nowNs();
+}
+
+static bool runSize(int numProducers, size_t size, bool mixed, long messages, size_t capacity, int64_t interval,
+		BenchResults* results)
+{
+	ShmRing ring;
+	if(!shmRingCreate(&ring, capacity)) {
+		printf("# cannot create a %zu byte ring\n", capacity);
+		return false;
+	}
+	memset(results, 0, offsetof(BenchResults, samples));
+
+	int start[2];
+	if(pipe(start) != 0) {
+		shmRingDestroy(&ring);
+		return false;
+	}
+	pid_t pids[MAX_PRODUCERS + 1];
+	int numChildren = 0;
+	for(int c=0; c<=numProducers; c++) {
+		pid_t pid = fork();
+		if(pid == 0) {
+			close(start[1]);
+			waitForStart(start[0]);
+			if(c == numProducers) {
+				consume(&ring, results, messages, numProducers);
+			} else {
+				long share = messages/numProducers + (c < messages % numProducers ? 1 : 0);
+				produce(&ring, c, share, size, mixed, interval);
+			}
+			_exit(0);
+		}
+		if(pid > 0) {
+			pids[numChildren++] = pid;
+		}
+	}
+	close(start[0]);
+	results->start = nowNs();
+	close(start[1]);
+	for(int c=0; c<numChildren; c++) {
+		waitpid(pids[c], NULL, 0);
+	}
+	shmRingDestroy(&ring);
+	if(numChildren != numProducers + 1) {
+		printf("# fork failed\n");
+		return false;
+	}
+
+	int64_t ns = results->end - results->start;
+	qsort(results->samples, results->numSamples, sizeof(int64_t), compareTimes);
+	long n = results->numSamples;
+	printf("%d,%zu,%ld,%lld,%.0f,%.1f,%.2f,%.2f,%.2f,%ld\n", numProducers, size, results->received,
+			(long long)ns, results->received*1e9/ns, (double)results->bytes*1e9/ns/(1024*1024),
+			n ? results->samples[n/2]/1e3 : 0, n ? results->samples[n*99/100]/1e3 : 0,
+			n ? results->samples[n - 1]/1e3 : 0, results->errors);
+	fflush(stdout);
+	return results->errors == 0;
+}
+
+static size_t parseSize(const char* s)
+{
+	char* end;
+	double v = strtod(s, &end);
+	switch(*end) {
+	case 'k': case 'K': v *= 1024; break;
+	case 'm': case 'M': v *= 1024*1024; break;
+	}
+	return (size_t)v;
+}
+
+int main(int argc, char** argv)
+{
+	int numProducers = argc > 1 ? atoi(argv[1]) : 1;
+	long messages = argc > 2 ? atol(argv[2]) : 200000;
+	size_t capacity = argc > 3 ? parseSize(argv[3]) : 32*1024*1024;
+	int rateHz = argc > 4 ? atoi(argv[4]) : 0;
+	size_t largest = payloadSizes[sizeof(payloadSizes)/sizeof(payloadSizes[0]) - 1];
+	if(numProducers < 1 || numProducers > MAX_PRODUCERS || messages < 1 || capacity < 2*largest + 64 ||
+			rateHz < 0) {
+		printf("usage: %s [producers 1..%d] [messages] [capacity >= %zu] [rateHz]\n", argv[0], MAX_PRODUCERS,
+				2*largest + 64);
+		return 1;
+	}
+
+	BenchResults* results = (BenchResults*)mmap(NULL, sizeof(BenchResults), PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if(results == MAP_FAILED) {
+		return 1;
+	}
+	printf("producers,size,messages,ns,msgs_per_s,mb_per_s,p50_us,p99_us,max_us,errors\n");
+	int failed = 0;
+	for(size_t i=0; i<sizeof(payloadSizes)/sizeof(payloadSizes[0]); i++) {
+		size_t size = payloadSizes[i];
+		long n = (long)(BYTE_BUDGET/size);
+		n = n < messages ? n : messages;
+		n = n > numProducers ? n : numProducers;
+		failed += runSize(numProducers, size, false, n, capacity, rateHz ? 1000000000LL/rateHz : 0, results) ? 0 : 1;
+	}
+	for(size_t i=0; i<sizeof(wrapSizes)/sizeof(wrapSizes[0]); i++) {
+		long n = messages < WRAP_MESSAGES ? messages : WRAP_MESSAGES;
+		n = n > numProducers ? n : numProducers;
+		failed += runSize(numProducers, wrapSizes[i], true, n, WRAP_CAPACITY, 0, results) ? 0 : 1;
+	}
+	munmap(results, sizeof(BenchResults));
+	return failed ? 1 : 0;
+}
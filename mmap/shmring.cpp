@@ -0,0 +1,301 @@
+/*
+ * shmring.cpp
+ * Multi producer, single consumer message ring in a memfd, futex wakeups.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "shmring.h"
+
+#define RECORD_PAD	1		/* filler to the end of the ring */
+
+/* Precedes every message. */
+typedef struct {
+	uint64_t pos;
+	uint32_t len;
+	uint32_t flags;
+	uint8_t pad[16];
+} RecordHeader;
+
+/*
+ * Records start on a header sized boundary, so whatever is left before
+ * the end of the ring always has room for the header of a pad record.
+ */
+#define RECORD_ALIGN	sizeof(RecordHeader)
+
+static_assert((sizeof(RecordHeader) & (sizeof(RecordHeader) - 1)) == 0, "RecordHeader must be a power of two");
+
+static size_t recordSize(size_t len)
+{
+	return sizeof(RecordHeader) + ((len + RECORD_ALIGN - 1) & ~(size_t)(RECORD_ALIGN - 1));
+}
+
+static int64_t nowNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+/* Shared, not FUTEX_PRIVATE: the waiter and the waker are different processes. */
+static void futexWait(uint32_t* addr, uint32_t val, int64_t deadline)
+{
+	struct timespec ts;
+	struct timespec* timeout = NULL;
+	if(deadline >= 0) {
+		int64_t left = deadline - nowNs();
+		if(left <= 0) {
+			return;
+		}
+		ts.tv_sec = left/1000000000;
+		ts.tv_nsec = left % 1000000000;
+		timeout = &ts;
+	}
+	syscall(SYS_futex, addr, FUTEX_WAIT, val, timeout, NULL, 0);
+}
+
+static void futexWake(uint32_t* addr, int count)
+{
+	syscall(SYS_futex, addr, FUTEX_WAKE, count, NULL, NULL, 0);
+}
+
+static RecordHeader* recordAt(ShmRing* ring, uint64_t pos)
+{
+	return (RecordHeader*)(ring->data + (pos & (ring->header->capacity - 1)));
+}
+
+/*
+ * The commit word of the record at pos. Commit words live apart from the
+ * data, one for every place a record may start, so no payload left over
+ * from an earlier lap can be read as one: a word is pos + 1, never 0 as
+ * pos is aligned, once the record is complete, and 0 again once it is
+ * released.
+ */
+static uint32_t* commitAt(ShmRing* ring, uint64_t pos)
+{
+	return &ring->commits[(pos & (ring->header->capacity - 1))/RECORD_ALIGN];
+}
+
+static size_t pageAlign(size_t size)
+{
+	return (size + getpagesize() - 1)/getpagesize()*getpagesize();
+}
+
+/* Header, commit words, data, each starting on a page. */
+static size_t ringSize(size_t capacity, size_t* commitsOffset, size_t* dataOffset)
+{
+	*commitsOffset = pageAlign(sizeof(ShmRingHeader));
+	*dataOffset = *commitsOffset + pageAlign(capacity/RECORD_ALIGN*sizeof(uint32_t));
+	return *dataOffset + capacity;
+}
+
+static bool mapRing(ShmRing* ring, int fd, size_t capacity)
+{
+	size_t commitsOffset, dataOffset;
+	ring->mapSize = ringSize(capacity, &commitsOffset, &dataOffset);
+	void* base = mmap(NULL, ring->mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(base == MAP_FAILED) {
+		return false;
+	}
+	ring->fd = fd;
+	ring->header = (ShmRingHeader*)base;
+	ring->commits = (uint32_t*)((uint8_t*)base + commitsOffset);
+	ring->data = (uint8_t*)base + dataOffset;
+	return true;
+}
+
+bool shmRingCreate(ShmRing* ring, size_t capacity)
+{
+	size_t size = 4096;
+	while(size < capacity) {
+		size *= 2;
+	}
+	if(size > 0x80000000u) {
+		return false;
+	}
+	int fd = syscall(__NR_memfd_create, "shmring", 0);
+	if(fd < 0) {
+		return false;
+	}
+	size_t commitsOffset, dataOffset;
+	if(ftruncate(fd, ringSize(size, &commitsOffset, &dataOffset)) != 0 || !mapRing(ring, fd, size)) {
+		close(fd);
+		return false;
+	}
+	/* a fresh memfd reads as zeros, so every commit word starts out unset */
+	ring->header->capacity = size;
+	__atomic_store_n(&ring->header->magic, SHM_RING_MAGIC, __ATOMIC_RELEASE);
+	return true;
+}
+
+bool shmRingMap(ShmRing* ring, int fd)
+{
+	ShmRingHeader* h = (ShmRingHeader*)mmap(NULL, sizeof(ShmRingHeader), PROT_READ, MAP_SHARED, fd, 0);
+	if(h == MAP_FAILED) {
+		return false;
+	}
+	uint32_t magic = __atomic_load_n(&h->magic, __ATOMIC_ACQUIRE);
+	uint32_t capacity = h->capacity;
+	munmap(h, sizeof(ShmRingHeader));
+	if(magic != SHM_RING_MAGIC || capacity == 0 || (capacity & (capacity - 1)) != 0) {
+		return false;
+	}
+	int own = dup(fd);
+	if(own < 0) {
+		return false;
+	}
+	if(!mapRing(ring, own, capacity)) {
+		close(own);
+		return false;
+	}
+	return true;
+}
+
+void shmRingDestroy(ShmRing* ring)
+{
+	munmap(ring->header, ring->mapSize);
+	close(ring->fd);
+	ring->header = NULL;
+	ring->commits = NULL;
+	ring->data = NULL;
+	ring->fd = -1;
+}
+
+size_t shmRingMaxMessage(const ShmRing* ring)
+{
+	/* a record never needs more padding than its own size, so half always fits */
+	return ring->header->capacity/2 - sizeof(RecordHeader);
+}
+
+void* shmRingReserve(ShmRing* ring, size_t len, int64_t timeoutNs)
+{
+	ShmRingHeader* h = ring->header;
+	if(len > shmRingMaxMessage(ring)) {
+		return NULL;
+	}
+	int64_t deadline = timeoutNs < 0 ? -1 : nowNs() + timeoutNs;
+	size_t need = recordSize(len);
+	uint64_t pos = __atomic_load_n(&h->reserved, __ATOMIC_RELAXED);
+	size_t total;
+	for(;;) {
+		size_t contiguous = h->capacity - (pos & (h->capacity - 1));
+		total = need <= contiguous ? need : contiguous + need;
+		uint64_t released = __atomic_load_n(&h->released, __ATOMIC_ACQUIRE);
+		if(pos + total - released > h->capacity) {
+			uint32_t seq = __atomic_load_n(&h->spaceSeq, __ATOMIC_ACQUIRE);
+			__atomic_add_fetch(&h->producersWaiting, 1, __ATOMIC_SEQ_CST);
+			/* the consumer may have released between the check and the flag */
+			if(__atomic_load_n(&h->released, __ATOMIC_SEQ_CST) == released) {
+				if(deadline >= 0 && nowNs() >= deadline) {
+					__atomic_sub_fetch(&h->producersWaiting, 1, __ATOMIC_SEQ_CST);
+					return NULL;
+				}
+				futexWait(&h->spaceSeq, seq, deadline);
+			}
+			__atomic_sub_fetch(&h->producersWaiting, 1, __ATOMIC_SEQ_CST);
+			pos = __atomic_load_n(&h->reserved, __ATOMIC_RELAXED);
+			continue;
+		}
+		if(__atomic_compare_exchange_n(&h->reserved, &pos, pos + total, true,
+				__ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			break;
+		}
+	}
+
+	if(total != need) {
+		/* not enough room before the end: pad to it and start over at 0 */
+		RecordHeader* pad = recordAt(ring, pos);
+		size_t contiguous = total - need;
+		pad->pos = pos;
+		pad->len = contiguous - sizeof(RecordHeader);
+		pad->flags = RECORD_PAD;
+		__atomic_store_n(commitAt(ring, pos), (uint32_t)(pos + 1), __ATOMIC_RELEASE);
+		pos += contiguous;
+	}
+	RecordHeader* r = recordAt(ring, pos);
+	r->pos = pos;
+	r->len = len;
+	r->flags = 0;
+	return r + 1;
+}
+
+void shmRingCommit(ShmRing* ring, void* msg)
+{
+	ShmRingHeader* h = ring->header;
+	RecordHeader* r = (RecordHeader*)msg - 1;
+	__atomic_store_n(commitAt(ring, r->pos), (uint32_t)(r->pos + 1), __ATOMIC_RELEASE);
+	__atomic_add_fetch(&h->dataSeq, 1, __ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&h->consumerWaiting, __ATOMIC_SEQ_CST)) {
+		futexWake(&h->dataSeq, 1);
+	}
+}
+
+bool shmRingWrite(ShmRing* ring, const void* msg, size_t len, int64_t timeoutNs)
+{
+	void* dst = shmRingReserve(ring, len, timeoutNs);
+	if(!dst) {
+		return false;
+	}
+	memcpy(dst, msg, len);
+	shmRingCommit(ring, dst);
+	return true;
+}
+
+/* Releases the record at from, which ends at to. */
+static void advance(ShmRing* ring, uint64_t from, uint64_t to)
+{
+	ShmRingHeader* h = ring->header;
+	/* a commit word left set would pass for a record 4 GiB later */
+	__atomic_store_n(commitAt(ring, from), 0, __ATOMIC_RELAXED);
+	/* the record's bytes are done with before producers may reuse them */
+	__atomic_store_n(&h->released, to, __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&h->spaceSeq, 1, __ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&h->producersWaiting, __ATOMIC_SEQ_CST)) {
+		futexWake(&h->spaceSeq, INT_MAX);
+	}
+}
+
+const void* shmRingPeek(ShmRing* ring, size_t* len, int64_t timeoutNs)
+{
+	ShmRingHeader* h = ring->header;
+	int64_t deadline = timeoutNs < 0 ? -1 : nowNs() + timeoutNs;
+	for(;;) {
+		uint64_t pos = h->released;
+		RecordHeader* r = recordAt(ring, pos);
+		uint32_t* commit = commitAt(ring, pos);
+		if(__atomic_load_n(commit, __ATOMIC_ACQUIRE) == (uint32_t)(pos + 1)) {
+			if(r->flags & RECORD_PAD) {
+				advance(ring, pos, pos + sizeof(RecordHeader) + r->len);
+				continue;
+			}
+			*len = r->len;
+			return r + 1;
+		}
+
+		uint32_t seq = __atomic_load_n(&h->dataSeq, __ATOMIC_ACQUIRE);
+		__atomic_store_n(&h->consumerWaiting, 1, __ATOMIC_SEQ_CST);
+		/* a commit between the check and the flag would not have woken us */
+		if(__atomic_load_n(commit, __ATOMIC_SEQ_CST) != (uint32_t)(pos + 1)) {
+			if(deadline >= 0 && nowNs() >= deadline) {
+				__atomic_store_n(&h->consumerWaiting, 0, __ATOMIC_RELAXED);
+				return NULL;
+			}
+			futexWait(&h->dataSeq, seq, deadline);
+		}
+		__atomic_store_n(&h->consumerWaiting, 0, __ATOMIC_RELAXED);
+	}
+}
+
+void shmRingRelease(ShmRing* ring)
+{
+	uint64_t pos = ring->header->released;
+	RecordHeader* r = recordAt(ring, pos);
+	advance(ring, pos, pos + recordSize(r->len));
+}
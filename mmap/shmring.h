@@ -0,0 +1,75 @@
+/*
+ * shmring.h
+ * A byte ring in shared memory for passing messages between processes,
+ * any number of producers to one consumer. Producers reserve space and
+ * write their message in place, the consumer reads it in place, so a
+ * payload is written once and never copied. Waits for data or space
+ * sleep on futexes in the shared header, so no extra fds are needed.
+ *
+ * The ring lives in a memfd; shmRingMap() takes any fd holding one, so
+ * it can be handed to an unrelated process over binder or a socket. A
+ * forked child can use the parent's ShmRing as it is.
+ */
+
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHM_RING_MAGIC		0x53524e32	/* SRN2, commit words apart from the data */
+
+/* Counters are byte positions that only grow; offset = pos & (capacity - 1). */
+typedef struct {
+	uint32_t magic;
+	uint32_t capacity;		/* bytes of data, power of two */
+	uint8_t pad0[56];
+
+	uint64_t reserved;		/* producers: end of the last reservation */
+	uint32_t dataSeq;		/* futex, bumped on every commit */
+	uint32_t consumerWaiting;
+	uint8_t pad1[48];
+
+	uint64_t released;		/* consumer: start of the oldest unread record */
+	uint32_t spaceSeq;		/* futex, bumped on every release */
+	uint32_t producersWaiting;
+	uint8_t pad2[48];
+} ShmRingHeader;
+
+typedef struct {
+	int fd;
+	ShmRingHeader* header;
+	uint32_t* commits;		/* one per place a record may start */
+	uint8_t* data;
+	size_t mapSize;
+} ShmRing;
+
+/* A ring of capacity bytes, rounded up to a power of two; false on failure. */
+bool shmRingCreate(ShmRing* ring, size_t capacity);
+/* Maps the ring in fd, which stays the caller's. */
+bool shmRingMap(ShmRing* ring, int fd);
+void shmRingDestroy(ShmRing* ring);
+
+/* Largest message the ring takes, half its capacity less a header. */
+size_t shmRingMaxMessage(const ShmRing* ring);
+
+/*
+ * Producer: room for len bytes, to be filled and passed to
+ * shmRingCommit(). Waits up to timeoutNs for space, -1 for ever; NULL on
+ * timeout or when len is over shmRingMaxMessage(). Commits may come in
+ * any order between producers, the consumer sees them in reservation
+ * order.
+ */
+void* shmRingReserve(ShmRing* ring, size_t len, int64_t timeoutNs);
+void shmRingCommit(ShmRing* ring, void* msg);
+/* Reserve, copy and commit, for small messages. */
+bool shmRingWrite(ShmRing* ring, const void* msg, size_t len, int64_t timeoutNs);
+
+/*
+ * Consumer: the oldest message, valid until shmRingRelease(). Waits up to
+ * timeoutNs, -1 for ever; NULL on timeout. One consumer only.
+ */
+const void* shmRingPeek(ShmRing* ring, size_t* len, int64_t timeoutNs);
+void shmRingRelease(ShmRing* ring);
+
+#endif
@@ -1,29 +1,334 @@
-#include <cutils/memory.h>
-#include <utils/Log.h>
+/*
+ * test.cpp
+ * Memory behaviour benchmark: what a mapping costs to create and to fault
+ * in, how flags and advice change that, and how fast malloc and mmap
+ * memory reads, writes and copies, over sizes from a page to gigabytes.
+ *
+ * usage: mapp_test [fault,bw,alloc|all] [minSize] [maxSize] [minBytes]
+ *        mapp_test hold
+ * Sizes take K, M and G suffixes; minBytes is how much each bandwidth and
+ * alloc row moves at least, repeating the buffer as needed. The second
+ * form maps and mallocs a page and sleeps, for looking at /proc/pid/maps.
+ *
+ * Output is CSV, one row per measurement, after '#' lines describing the
+ * kernel and machine, so runs on different kernels and devices can be
+ * diffed or loaded as they are:
+ *   test,variant,size,reps,ns,ns_per_page,mb_per_s
+ * A variant that cannot be set up (no THP, mlock over RLIMIT_MEMLOCK, out
+ * of memory) gives a row with ns -1 rather than stopping the run.
+ */
 
 #include <sys/mman.h>
-#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/utsname.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <memory.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TEST_FAULT	(1 << 0)
+#define TEST_BW		(1 << 1)
+#define TEST_ALLOC	(1 << 2)
+#define TEST_ALL	(TEST_FAULT | TEST_BW | TEST_ALLOC)
+
+enum {
+	KIND_MALLOC,
+	KIND_PRIVATE,
+	KIND_SHARED,
+	KIND_PRIVATE_POPULATE,
+	KIND_SHARED_POPULATE,
+	KIND_HUGEPAGE,
+	KIND_MLOCK,
+	NUM_KINDS,
+};
+
+static const char* kindNames[NUM_KINDS] = {
+	"malloc", "private", "shared", "private-populate", "shared-populate", "hugepage", "mlock",
+};
+
+static long pageSize;
+
+static int64_t nowNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+static size_t parseSize(const char* s)
+{
+	char* end;
+	double v = strtod(s, &end);
+	switch(*end) {
+	case 'k': case 'K': v *= 1024; break;
+	case 'm': case 'M': v *= 1024*1024; break;
+	case 'g': case 'G': v *= 1024.0*1024*1024; break;
+	}
+	return (size_t)v;
+}
+
+static int parseTests(const char* spec)
+{
+	if(strcmp(spec, "all") == 0) {
+		return TEST_ALL;
+	}
+	int tests = 0;
+	if(strstr(spec, "fault")) tests |= TEST_FAULT;
+	if(strstr(spec, "bw")) tests |= TEST_BW;
+	if(strstr(spec, "alloc")) tests |= TEST_ALLOC;
+	return tests;
+}
+
+static void row(const char* test, const char* variant, size_t size, long reps, int64_t ns)
+{
+	if(ns < 0) {
+		printf("%s,%s,%zu,%ld,-1,,\n", test, variant, size, reps);
+		return;
+	}
+	double pages = (double)size/pageSize*reps;
+	double mb = (double)size*reps/(1024*1024);
+	printf("%s,%s,%zu,%ld,%lld,%.1f,%.1f\n", test, variant, size, reps, (long long)ns,
+			ns/pages, ns > 0 ? mb*1e9/ns : 0);
+	fflush(stdout);
+}
+
+/*
+ * A buffer of the given kind, not yet touched unless the kind populates.
+ * NULL when the kind cannot be had here.
+ */
+static void* allocKind(int kind, size_t size)
+{
+	void* p;
+	if(kind == KIND_MALLOC) {
+		return malloc(size);
+	}
+	int flags = MAP_ANONYMOUS;
+	flags |= (kind == KIND_SHARED || kind == KIND_SHARED_POPULATE) ? MAP_SHARED : MAP_PRIVATE;
+	if(kind == KIND_PRIVATE_POPULATE || kind == KIND_SHARED_POPULATE) {
+		flags |= MAP_POPULATE;
+	}
+	p = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+	if(p == MAP_FAILED) {
+		return NULL;
+	}
+	if(kind == KIND_HUGEPAGE && madvise(p, size, MADV_HUGEPAGE) != 0) {
+		munmap(p, size);
+		return NULL;
+	}
+	if(kind == KIND_MLOCK && mlock(p, size) != 0) {
+		munmap(p, size);
+		return NULL;
+	}
+	return p;
+}
+
+static void freeKind(int kind, void* p, size_t size)
+{
+	if(kind == KIND_MALLOC) {
+		free(p);
+	} else {
+		munmap(p, size);
+	}
+}
+
+/* One write per page, what a first touch after the mapping costs. */
+static void touchPages(void* p, size_t size)
+{
+	volatile char* c = (volatile char*)p;
+	for(size_t off=0; off<size; off+=pageSize) {
+		c[off] = 1;
+	}
+}
+
+static uint64_t readAll(const void* p, size_t size)
+{
+	const uint64_t* w = (const uint64_t*)p;
+	size_t n = size/sizeof(uint64_t);
+	uint64_t a = 0, b = 0, c = 0, d = 0;
+	size_t i;
+	for(i=0; i+4<=n; i+=4) {
+		a += w[i];
+		b += w[i + 1];
+		c += w[i + 2];
+		d += w[i + 3];
+	}
+	for(; i<n; i++) {
+		a += w[i];
+	}
+	return a + b + c + d;
+}
+
+static int64_t faultRow(int kind, size_t size, long reps)
+{
+	int64_t map = 0;
+	int64_t touch = 0;
+	for(long r=0; r<reps; r++) {
+		int64_t start = nowNs();
+		void* p = allocKind(kind, size);
+		int64_t mapped = nowNs();
+		if(!p) {
+			row("map", kindNames[kind], size, reps, -1);
+			row("fault", kindNames[kind], size, reps, -1);
+			row("ready", kindNames[kind], size, reps, -1);
+			return -1;
+		}
+		touchPages(p, size);
+		touch += nowNs() - mapped;
+		map += mapped - start;
+		freeKind(kind, p, size);
+	}
+	row("map", kindNames[kind], size, reps, map);
+	row("fault", kindNames[kind], size, reps, touch);
+	/* map plus touch, the cost of getting memory ready to use */
+	row("ready", kindNames[kind], size, reps, map + touch);
+	return map + touch;
+}
+
+/*
+ * Read, write and copy bandwidth of warm memory of one kind. Each is
+ * repeated until minBytes have gone by, and the best pass is reported
+ * so a stray interruption does not count.
+ */
+static void bandwidthRows(int kind, size_t size, size_t minBytes)
+{
+	static volatile uint64_t sink;
+	void* a = allocKind(kind, size);
+	void* b = a ? allocKind(kind, size) : NULL;
+	long reps = (long)((minBytes + size - 1)/size);
+	if(!b) {
+		if(a) {
+			freeKind(kind, a, size);
+		}
+		row("read", kindNames[kind], size, reps, -1);
+		row("write", kindNames[kind], size, reps, -1);
+		row("copy", kindNames[kind], size, reps, -1);
+		return;
+	}
+	memset(a, 1, size);
+	memset(b, 2, size);
+
+	int64_t best[3] = { INT64_MAX, INT64_MAX, INT64_MAX };
+	for(long r=0; r<reps; r++) {
+		int64_t t0 = nowNs();
+		sink += readAll(a, size);
+		int64_t t1 = nowNs();
+		memset(a, (int)r, size);
+		int64_t t2 = nowNs();
+		memcpy(b, a, size);
+		int64_t t3 = nowNs();
+		best[0] = t1 - t0 < best[0] ? t1 - t0 : best[0];
+		best[1] = t2 - t1 < best[1] ? t2 - t1 : best[1];
+		best[2] = t3 - t2 < best[2] ? t3 - t2 : best[2];
+	}
+	row("read", kindNames[kind], size, 1, best[0]);
+	row("write", kindNames[kind], size, 1, best[1]);
+	/* bytes copied, not read plus written */
+	row("copy", kindNames[kind], size, 1, best[2]);
+	freeKind(kind, a, size);
+	freeKind(kind, b, size);
+}
+
+/*
+ * Allocate, write every page, free: malloc against mmap for the whole
+ * cycle a short lived buffer goes through.
+ */
+static void allocRow(int kind, size_t size, size_t minBytes)
+{
+	long reps = (long)((minBytes + size - 1)/size);
+	int64_t start = nowNs();
+	for(long r=0; r<reps; r++) {
+		void* p = allocKind(kind, size);
+		if(!p) {
+			row("alloc", kindNames[kind], size, reps, -1);
+			return;
+		}
+		touchPages(p, size);
+		freeKind(kind, p, size);
+	}
+	row("alloc", kindNames[kind], size, reps, nowNs() - start);
+}
+
+static void printHeader()
+{
+	struct utsname u;
+	if(uname(&u) == 0) {
+		printf("# kernel %s %s %s\n", u.sysname, u.release, u.machine);
+	}
+	printf("# page %ld cpus %ld memory %lld MiB\n", pageSize, sysconf(_SC_NPROCESSORS_ONLN),
+			(long long)sysconf(_SC_PHYS_PAGES)*pageSize/(1024*1024));
+	char thp[128] = "unknown";
+	FILE* f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+	if(f) {
+		if(fgets(thp, sizeof(thp), f)) {
+			thp[strcspn(thp, "\n")] = 0;
+		}
+		fclose(f);
+	}
+	struct rlimit lim;
+	getrlimit(RLIMIT_MEMLOCK, &lim);
+	printf("# thp %s memlock %lld\n", thp, lim.rlim_cur == RLIM_INFINITY ? -1LL : (long long)lim.rlim_cur);
+	printf("test,variant,size,reps,ns,ns_per_page,mb_per_s\n");
+}
+
+/* What this tool used to be: one page each way, left around to inspect. */
+static int hold()
+{
+	void* ret;
+	printf("pid=%d\n", getpid());
+	ret = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_ANON | MAP_SHARED, -1, 0);
+	memset(ret, 127, 4096);
+	printf("mmap addr=%p\n", ret);
+	ret = malloc(4096);
+	printf("malloc addr=%p\n", ret);
+	sleep(100);
+	return 0;
+}
 
 int main(int argc, char** argv)
 {
-	(void)argc;
-	(void)argv;
-	void *ret;
-  
-    printf("pid=%d\n", getpid());
-    ret = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_ANON | MAP_SHARED, -1, 0);
-    memset(ret, 127, 4096);
-    
-    printf("mmap addr=%p\n", ret);
-    ret = malloc(4096);
-    printf("malloc addr=%p\n", ret);
-    
-    
-    sleep(100);
-    
-    return 0;
+	if(argc > 1 && strcmp(argv[1], "hold") == 0) {
+		return hold();
+	}
+	pageSize = sysconf(_SC_PAGESIZE);
+	int tests = parseTests(argc > 1 ? argv[1] : "all");
+	size_t minSize = argc > 2 ? parseSize(argv[2]) : 4096;
+	size_t maxSize = argc > 3 ? parseSize(argv[3]) : (size_t)1024*1024*1024;
+	size_t minBytes = argc > 4 ? parseSize(argv[4]) : (size_t)256*1024*1024;
+	if(tests == 0 || minSize < (size_t)pageSize || maxSize < minSize || minBytes == 0) {
+		printf("usage: %s [fault,bw,alloc|all] [minSize >= %ld] [maxSize] [minBytes]\n", argv[0], pageSize);
+		printf("       %s hold\n", argv[0]);
+		return 1;
+	}
+
+	printHeader();
+	for(size_t size=minSize; size<=maxSize; size*=4) {
+		size = (size + pageSize - 1)/pageSize*pageSize;
+		if(tests & TEST_FAULT) {
+			/* small mappings are timed in bulk, a single one is below the clock's noise */
+			long reps = (long)((size_t)64*1024*1024/size);
+			reps = reps > 1 ? (reps < 4096 ? reps : 4096) : 1;
+			for(int kind=KIND_PRIVATE; kind<NUM_KINDS; kind++) {
+				faultRow(kind, size, reps);
+			}
+		}
+		if(tests & TEST_BW) {
+			for(int kind=0; kind<NUM_KINDS; kind++) {
+				if(kind == KIND_PRIVATE_POPULATE || kind == KIND_SHARED_POPULATE) {
+					continue;	/* warm memory, the same as without */
+				}
+				bandwidthRows(kind, size, minBytes);
+			}
+		}
+		if(tests & TEST_ALLOC) {
+			allocRow(KIND_MALLOC, size, minBytes);
+			allocRow(KIND_PRIVATE, size, minBytes);
+			allocRow(KIND_PRIVATE_POPULATE, size, minBytes);
+		}
+		if(size > maxSize/4) {
+			break;
+		}
+	}
+	return 0;
 }
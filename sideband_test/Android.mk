@@ -3,6 +3,11 @@ include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES:= \
 		    SidebandNativeHandle.cpp \
+		    SidebandPlaneManager.cpp \
+		    SidebandControl.cpp \
+		    SidebandHandleRegistry.cpp \
+		    SidebandHandleIds.cpp \
+		    SidebandAnimator.cpp \
 		    SidebandNativehandle_test.cpp
 		    
 
@@ -20,3 +25,25 @@ LOCAL_MODULE_TAGS := tests
 
 include $(BUILD_EXECUTABLE)
 
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+		    SidebandNativeHandle.cpp \
+		    SidebandPlaneManager.cpp \
+		    SidebandControl.cpp \
+		    SidebandHandleRegistry.cpp \
+		    SidebandHandleIds.cpp \
+		    SidebandAnimator.cpp \
+		    SidebandNativehandle_test.cpp
+
+LOCAL_STATIC_LIBRARIES := \
+		    libhostwindow
+
+LOCAL_LDLIBS := -lpthread
+
+LOCAL_MODULE:= red123_layer_host
+
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,202 @@
+/*
+ * SidebandAnimator.cpp
+ * Vsync paced, one transaction per frame animation of sideband layers.
+ */
+
+#define LOG_TAG "SidebandAnimator"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <utils/Log.h>
+
+#include "SidebandAnimator.h"
+
+namespace android {
+
+static int compareTimes(const void *a, const void *b)
+{
+    nsecs_t x = *(const nsecs_t *)a;
+    nsecs_t y = *(const nsecs_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* slow in, slow out, so a PIP window does not jump at either end */
+static float ease(float p)
+{
+    return p*p*(3.0f - 2.0f*p);
+}
+
+SidebandAnimator::SidebandAnimator()
+    : mNumTracks(0)
+{
+    mPeriod = 1000000000LL/60;
+    /* every vsync, so the counts show the ones we did not draw for */
+    mReceiver.setVsyncRate(1);
+}
+
+SidebandAnimator::~SidebandAnimator()
+{
+    mReceiver.setVsyncRate(0);
+}
+
+status_t SidebandAnimator::initCheck() const
+{
+    return mReceiver.initCheck();
+}
+
+int SidebandAnimator::addLayer(const sp<SurfaceControl>& control, uint32_t width, uint32_t height)
+{
+    if (mNumTracks == MAX_LAYERS || width == 0 || height == 0) {
+        return -1;
+    }
+    Track& track = mTracks[mNumTracks];
+    track.control = control;
+    track.baseWidth = width;
+    track.baseHeight = height;
+    track.active = false;
+    return mNumTracks++;
+}
+
+status_t SidebandAnimator::animate(int layer, const Geometry& from, const Geometry& to, nsecs_t duration)
+{
+    if (layer < 0 || layer >= mNumTracks || duration <= 0) {
+        return BAD_VALUE;
+    }
+    Track& track = mTracks[layer];
+    track.from = from;
+    track.to = to;
+    track.duration = duration;
+    track.active = true;
+    return NO_ERROR;
+}
+
+bool SidebandAnimator::drainVsync(bool block, nsecs_t* timestamp, uint32_t* count)
+{
+    bool got = false;
+    for (;;) {
+        if (block && !got) {
+            struct pollfd pfd = { mReceiver.getFd(), POLLIN, 0 };
+            if (poll(&pfd, 1, 1000) <= 0) {
+                ALOGE("%s:%i, no vsync for a second", __FUNCTION__, __LINE__);
+                return false;
+            }
+        }
+        DisplayEventReceiver::Event events[8];
+        ssize_t n = mReceiver.getEvents(events, 8);
+        if (n <= 0) {
+            return got;
+        }
+        for (ssize_t i = 0; i < n; i++) {
+            if (events[i].header.type == DisplayEventReceiver::DISPLAY_EVENT_VSYNC) {
+                /* learn the refresh rate from the events themselves */
+                uint32_t vsyncs = events[i].vsync.count - *count;
+                if (*count != 0 && vsyncs > 0 && events[i].header.timestamp > *timestamp) {
+                    mPeriod = (events[i].header.timestamp - *timestamp)/vsyncs;
+                }
+                *timestamp = events[i].header.timestamp;
+                *count = events[i].vsync.count;
+                got = true;
+            }
+        }
+    }
+}
+
+void SidebandAnimator::setGeometry(SurfaceComposerClient::Transaction& t, const Track& track, float progress)
+{
+    float p = ease(progress);
+    float x = track.from.x + (track.to.x - track.from.x)*p;
+    float y = track.from.y + (track.to.y - track.from.y)*p;
+    float w = track.from.width + (track.to.width - track.from.width)*p;
+    float h = track.from.height + (track.to.height - track.from.height)*p;
+    t.setPosition(track.control, x, y)
+     .setMatrix(track.control, w/track.baseWidth, 0.0f, 0.0f, h/track.baseHeight);
+}
+
+status_t SidebandAnimator::run(Stats* stats, int sleepUs)
+{
+    memset(stats, 0, sizeof(*stats));
+    nsecs_t vsyncTime = 0;
+    uint32_t vsyncCount = 0;
+    /* two vsyncs, for the period and a start time */
+    for (int i = 0; i < 2; i++) {
+        if (!drainVsync(true, &vsyncTime, &vsyncCount)) {
+            return TIMED_OUT;
+        }
+    }
+
+    /* how many vsyncs each update should be apart */
+    int step = 1;
+    if (sleepUs > 0) {
+        step = (int)(((nsecs_t)sleepUs*1000 + mPeriod/2)/mPeriod);
+        step = step > 0 ? step : 1;
+    }
+    nsecs_t start = vsyncTime;
+    uint32_t lastCount = vsyncCount;
+    int numApplies = 0;
+
+    for (;;) {
+        if (sleepUs > 0) {
+            usleep(sleepUs);
+            drainVsync(false, &vsyncTime, &vsyncCount);
+        } else if (!drainVsync(true, &vsyncTime, &vsyncCount)) {
+            return TIMED_OUT;
+        }
+
+        /* vsync paced frames are drawn for when they show, a period on */
+        nsecs_t elapsed = sleepUs > 0 ? (nsecs_t)(stats->frames + 1)*sleepUs*1000
+                                      : vsyncTime + mPeriod - start;
+        bool running = false;
+        nsecs_t applyStart = systemTime();
+        SurfaceComposerClient::Transaction t;
+        for (int i = 0; i < mNumTracks; i++) {
+            Track& track = mTracks[i];
+            if (!track.active) {
+                continue;
+            }
+            float progress = elapsed >= track.duration ? 1.0f : (float)elapsed/track.duration;
+            if (sleepUs > 0) {
+                /* the old loop: a transaction for each layer */
+                SurfaceComposerClient::Transaction one;
+                setGeometry(one, track, progress);
+                one.apply();
+            } else {
+                setGeometry(t, track, progress);
+            }
+            track.active = progress < 1.0f;
+            running |= track.active;
+        }
+        if (sleepUs == 0) {
+            t.apply();
+        }
+        nsecs_t applyEnd = systemTime();
+        mApplies[numApplies % MAX_FRAMES] = applyEnd - applyStart;
+        numApplies++;
+        stats->frames++;
+
+        int gap = (int)(vsyncCount - lastCount);
+        if (gap > step) {
+            stats->missedVsyncs += gap - step;
+        } else if (gap < step) {
+            stats->doubledFrames++;
+        }
+        lastCount = vsyncCount;
+        if (applyEnd > vsyncTime + mPeriod) {
+            stats->lateApplies++;
+        }
+        if (!running) {
+            break;
+        }
+    }
+
+    int n = numApplies < MAX_FRAMES ? numApplies : MAX_FRAMES;
+    qsort(mApplies, n, sizeof(nsecs_t), compareTimes);
+    stats->applyP50 = mApplies[n/2];
+    stats->applyP99 = mApplies[n*99/100];
+    stats->applyMax = mApplies[n - 1];
+    return NO_ERROR;
+}
+
+}; // namespace android
@@ -0,0 +1,85 @@
+/*
+ * SidebandAnimator.h
+ * Moves and scales sideband layers, PIP transitions and the like, paced
+ * by DisplayEventReceiver: every vsync the position and scale of all
+ * animating layers go out in one transaction, computed for the time the
+ * frame will be on screen, so a late frame catches up instead of
+ * stretching the animation. Counts the vsyncs that went by without an
+ * update, the pattern that shows up as jank.
+ */
+
+#ifndef ANDROID_SIDEBAND_ANIMATOR_H
+#define ANDROID_SIDEBAND_ANIMATOR_H
+
+#include <gui/DisplayEventReceiver.h>
+#include <gui/SurfaceComposerClient.h>
+#include <utils/Timers.h>
+
+// ----------------------------------------------------------------------------
+namespace android {
+// ----------------------------------------------------------------------------
+class SidebandAnimator {
+public:
+    enum {
+        MAX_LAYERS = 8,
+        MAX_FRAMES = 4096,      /* apply times kept for the percentiles */
+    };
+
+    struct Geometry {
+        float x;
+        float y;
+        float width;
+        float height;
+    };
+
+    struct Stats {
+        int frames;             /* transactions applied, per layer ones counted once */
+        int missedVsyncs;       /* vsyncs without the update they were due */
+        int doubledFrames;      /* updates that landed on the same vsync as the last */
+        int lateApplies;        /* apply returned after the vsync it was meant for */
+        nsecs_t applyP50;
+        nsecs_t applyP99;
+        nsecs_t applyMax;
+    };
+
+    SidebandAnimator();
+    ~SidebandAnimator();
+
+    status_t initCheck() const;
+    /* the layer's unscaled size, what a scale of 1 shows; returns its index or -1 */
+    int addLayer(const sp<SurfaceControl>& control, uint32_t width, uint32_t height);
+    /* starts on the first frame run() draws */
+    status_t animate(int layer, const Geometry& from, const Geometry& to, nsecs_t duration);
+
+    /*
+     * runs until every animation is done. sleepUs 0 paces by vsync; any
+     * other value is the old way, a fixed sleep between fixed steps and a
+     * transaction per layer, kept to compare against.
+     */
+    status_t run(Stats* stats, int sleepUs = 0);
+
+private:
+    struct Track {
+        sp<SurfaceControl> control;
+        float baseWidth;
+        float baseHeight;
+        Geometry from;
+        Geometry to;
+        nsecs_t duration;
+        bool active;
+    };
+
+    /* reads what is in the pipe; with block, waits for at least one vsync */
+    bool drainVsync(bool block, nsecs_t* timestamp, uint32_t* count);
+    void setGeometry(SurfaceComposerClient::Transaction& t, const Track& track, float progress);
+
+    DisplayEventReceiver mReceiver;
+    nsecs_t mPeriod;
+    Track mTracks[MAX_LAYERS];
+    int mNumTracks;
+    nsecs_t mApplies[MAX_FRAMES];
+};
+
+// ----------------------------------------------------------------------------
+}; // namespace android
+#endif // ANDROID_SIDEBAND_ANIMATOR_H
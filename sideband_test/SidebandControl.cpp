@@ -0,0 +1,115 @@
+/*
+ * SidebandControl.cpp
+ * The seqlock protected control block shared through a sideband handle.
+ */
+
+#define LOG_TAG "SidebandControl"
+
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cutils/ashmem.h>
+#include <utils/Log.h>
+
+#include "SidebandControl.h"
+
+namespace android {
+
+SidebandControl::SidebandControl(int fd, SidebandControlBlock* block, size_t size, bool writable)
+    : mFd(fd), mSize(size), mBlock(block), mWritable(writable)
+{
+}
+
+SidebandControl* SidebandControl::create()
+{
+    size_t size = getpagesize();
+    int fd = ashmem_create_region("sideband-control", size);
+    if (fd < 0) {
+        ALOGE("%s:%i, fail to create ashmem region", __FUNCTION__, __LINE__);
+        return NULL;
+    }
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        ALOGE("%s:%i, fail to map control block", __FUNCTION__, __LINE__);
+        close(fd);
+        return NULL;
+    }
+    SidebandControlBlock *block = (SidebandControlBlock *)base;
+    memset(block, 0, sizeof(*block));
+    block->magic = sMagic;
+    block->version = sVersion;
+    block->state.planeId = -1;
+    return new SidebandControl(fd, block, size, true);
+}
+
+SidebandControl* SidebandControl::map(int fd, bool writable)
+{
+    int size = ashmem_get_size_region(fd);
+    if (size < (int)sizeof(SidebandControlBlock)) {
+        ALOGE("%s:%i, fd %d is not a control block (%d bytes)", __FUNCTION__, __LINE__, fd, size);
+        return NULL;
+    }
+    void *base = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        ALOGE("%s:%i, fail to map control block", __FUNCTION__, __LINE__);
+        return NULL;
+    }
+    SidebandControlBlock *block = (SidebandControlBlock *)base;
+    if (block->magic != sMagic || block->version != sVersion) {
+        ALOGE("%s:%i, bad control block magic %x version %u", __FUNCTION__, __LINE__,
+                block->magic, block->version);
+        munmap(base, size);
+        return NULL;
+    }
+    int own = dup(fd);
+    if (own < 0) {
+        munmap(base, size);
+        return NULL;
+    }
+    return new SidebandControl(own, block, size, writable);
+}
+
+SidebandControl::~SidebandControl()
+{
+    munmap(mBlock, mSize);
+    close(mFd);
+}
+
+void SidebandControl::publish(const SidebandFrameState& state)
+{
+    if (!mWritable) {
+        ALOGW("%s:%i, control block mapped read only", __FUNCTION__, __LINE__);
+        return;
+    }
+    uint32_t seq = __atomic_load_n(&mBlock->seq, __ATOMIC_RELAXED);
+    __atomic_store_n(&mBlock->seq, seq + 1, __ATOMIC_RELAXED);
+    /* the odd count must be visible before any of the new state */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&mBlock->state, &state, sizeof(state));
+    __atomic_store_n(&mBlock->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+status_t SidebandControl::read(SidebandFrameState* state, int maxRetries) const
+{
+    for (int i = 0; i < maxRetries; i++) {
+        uint32_t before = __atomic_load_n(&mBlock->seq, __ATOMIC_ACQUIRE);
+        if (before & 1) {
+            continue;
+        }
+        memcpy(state, &mBlock->state, sizeof(*state));
+        /* the copy must be done before seq is looked at again */
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&mBlock->seq, __ATOMIC_RELAXED) == before) {
+            return NO_ERROR;
+        }
+    }
+    return WOULD_BLOCK;
+}
+
+uint32_t SidebandControl::sequence() const
+{
+    return __atomic_load_n(&mBlock->seq, __ATOMIC_ACQUIRE);
+}
+
+}; // namespace android
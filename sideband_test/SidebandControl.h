@@ -0,0 +1,89 @@
+/*
+ * SidebandControl.h
+ * A page of ashmem shared by a sideband producer and the compositor,
+ * carried as the one fd of a SidebandNativeHandle. The producer publishes
+ * each frame's plane, geometry and HDR metadata under a seqlock, so the
+ * compositor picks them up on its next read without a binder call.
+ */
+
+#ifndef ANDROID_SIDEBAND_CONTROL_H
+#define ANDROID_SIDEBAND_CONTROL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utils/Errors.h>
+
+// ----------------------------------------------------------------------------
+namespace android {
+// ----------------------------------------------------------------------------
+
+enum {
+    SIDEBAND_HDR_NONE = 0,
+    SIDEBAND_HDR_HDR10 = 1,
+    SIDEBAND_HDR_HLG = 2,
+};
+
+/* SMPTE ST 2086 mastering display plus content light level, as in HDR10 */
+struct SidebandHdrMetadata {
+    int32_t     type;                   /* SIDEBAND_HDR_* */
+    float       primaries[3][2];        /* r, g, b chromaticity x, y */
+    float       whitePoint[2];
+    float       maxLuminance;           /* cd/m2 */
+    float       minLuminance;
+    float       maxContentLightLevel;
+    float       maxFrameAverageLightLevel;
+};
+
+struct SidebandFrameState {
+    int32_t     planeId;
+    int32_t     x;                      /* hole on screen */
+    int32_t     y;
+    int32_t     width;
+    int32_t     height;
+    SidebandHdrMetadata hdr;
+    uint64_t    frameNumber;
+    int64_t     timestamp;              /* systemTime() when published */
+    uint32_t    droppedFrames;
+};
+
+struct SidebandControlBlock {
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    seq;                    /* odd while the producer writes */
+    uint32_t    reserved;
+    SidebandFrameState state;
+};
+
+class SidebandControl {
+public:
+    static const uint32_t sMagic = 0x53424342; /*SBCB*/
+    static const uint32_t sVersion = 1;
+
+    /* a new zeroed block in a fresh ashmem region, for the producer */
+    static SidebandControl* create();
+    /* maps the block behind fd, which stays the caller's; NULL when it is not one */
+    static SidebandControl* map(int fd, bool writable);
+    ~SidebandControl();
+
+    int fd() const { return mFd; }
+
+    /* single writer: readers never block it and see the whole state or none of it */
+    void publish(const SidebandFrameState& state);
+    /* NO_ERROR with a consistent copy, WOULD_BLOCK if the writer kept getting in the way */
+    status_t read(SidebandFrameState* state, int maxRetries = 64) const;
+    /* changes on every publish, cheap to poll */
+    uint32_t sequence() const;
+
+private:
+    SidebandControl(int fd, SidebandControlBlock* block, size_t size, bool writable);
+
+    int mFd;
+    size_t mSize;
+    SidebandControlBlock *mBlock;
+    bool mWritable;
+};
+
+// ----------------------------------------------------------------------------
+}; // namespace android
+#endif // ANDROID_SIDEBAND_CONTROL_H
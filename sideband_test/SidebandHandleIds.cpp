@@ -0,0 +1,147 @@
+/*
+ * SidebandHandleIds.cpp
+ * Lock free generation tagged ids for client side sideband handles.
+ */
+
+#define LOG_TAG "SidebandHandleIds"
+
+#include <string.h>
+#include <utils/Log.h>
+
+#include "SidebandHandleIds.h"
+
+namespace android {
+
+struct Slot {
+    uint32_t next;      /* slot + 1 below it on the free stack, 0 at the bottom */
+    uint32_t state;     /* generation << 1 | live */
+};
+
+static Slot sSlots[SidebandHandleIds::MAX_SLOTS];
+/* ABA tag << 32 | top slot + 1; a pop racing a pop and push sees the tag move */
+static uint64_t sFreeHead;
+/* slots never handed out yet sit above this, so the table needs no init */
+static uint32_t sFresh;
+
+static uint64_t sCreated;
+static uint64_t sDestroyed;
+static uint64_t sExhausted;
+static uint64_t sBadReleases;
+static int sLive;
+static int sLivePerPlane[SidebandNativeHandle::SIDEBAND_VIDEO_PLANE_NUM];
+
+int SidebandHandleIds::pop()
+{
+    uint64_t head = __atomic_load_n(&sFreeHead, __ATOMIC_ACQUIRE);
+    for (;;) {
+        uint32_t top = (uint32_t)head;
+        if (top == 0) {
+            return -1;
+        }
+        /* may be stale if top was taken meanwhile, the CAS then fails on the tag */
+        uint32_t next = __atomic_load_n(&sSlots[top - 1].next, __ATOMIC_RELAXED);
+        uint64_t desired = (((head >> 32) + 1) << 32) | next;
+        if (__atomic_compare_exchange_n(&sFreeHead, &head, desired, true,
+                __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+            return top - 1;
+        }
+    }
+}
+
+void SidebandHandleIds::push(int slot)
+{
+    uint64_t head = __atomic_load_n(&sFreeHead, __ATOMIC_RELAXED);
+    for (;;) {
+        __atomic_store_n(&sSlots[slot].next, (uint32_t)head, __ATOMIC_RELAXED);
+        uint64_t desired = (((head >> 32) + 1) << 32) | (uint32_t)(slot + 1);
+        if (__atomic_compare_exchange_n(&sFreeHead, &head, desired, true,
+                __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            return;
+        }
+    }
+}
+
+void SidebandHandleIds::countPlane(int planeId, int delta)
+{
+    __atomic_add_fetch(&sLive, delta, __ATOMIC_RELAXED);
+    if (SidebandNativeHandle::isValidPlaneId(planeId)) {
+        __atomic_add_fetch(&sLivePerPlane[planeId], delta, __ATOMIC_RELAXED);
+    }
+}
+
+int SidebandHandleIds::allocate(int planeId)
+{
+    int slot = pop();
+    if (slot < 0) {
+        uint32_t fresh = __atomic_fetch_add(&sFresh, 1, __ATOMIC_RELAXED);
+        if (fresh >= MAX_SLOTS) {
+            /* keep sFresh from wrapping back into the table */
+            __atomic_store_n(&sFresh, (uint32_t)MAX_SLOTS, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&sExhausted, 1, __ATOMIC_RELAXED);
+            ALOGW("%s:%i, all %d handle ids live", __FUNCTION__, __LINE__, MAX_SLOTS);
+            return -1;
+        }
+        slot = fresh;
+    }
+    /* the slot is ours alone until released */
+    uint32_t generation = __atomic_load_n(&sSlots[slot].state, __ATOMIC_RELAXED) >> 1;
+    __atomic_store_n(&sSlots[slot].state, generation << 1 | 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&sCreated, 1, __ATOMIC_RELAXED);
+    countPlane(planeId, 1);
+    return (int)(generation << SLOT_BITS) | slot;
+}
+
+status_t SidebandHandleIds::release(int id, int planeId)
+{
+    if (id < 0) {
+        __atomic_add_fetch(&sBadReleases, 1, __ATOMIC_RELAXED);
+        return BAD_VALUE;
+    }
+    int slot = slotOf(id);
+    uint32_t generation = generationOf(id);
+    uint32_t expected = generation << 1 | 1;
+    uint32_t desired = ((generation + 1) & GENERATION_MASK) << 1;
+    /* only one of two racing releases of the same id gets past this */
+    if (!__atomic_compare_exchange_n(&sSlots[slot].state, &expected, desired, false,
+            __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+        __atomic_add_fetch(&sBadReleases, 1, __ATOMIC_RELAXED);
+        ALOGW("%s:%i, id %d:%d is not live", __FUNCTION__, __LINE__, slot, generation);
+        return BAD_VALUE;
+    }
+    push(slot);
+    __atomic_add_fetch(&sDestroyed, 1, __ATOMIC_RELAXED);
+    countPlane(planeId, -1);
+    return NO_ERROR;
+}
+
+bool SidebandHandleIds::isLive(int id)
+{
+    if (id < 0) {
+        return false;
+    }
+    uint32_t state = __atomic_load_n(&sSlots[slotOf(id)].state, __ATOMIC_ACQUIRE);
+    return state == ((uint32_t)generationOf(id) << 1 | 1);
+}
+
+void SidebandHandleIds::planeChanged(int fromPlane, int toPlane)
+{
+    if (fromPlane == toPlane) {
+        return;
+    }
+    countPlane(toPlane, 1);
+    countPlane(fromPlane, -1);
+}
+
+void SidebandHandleIds::getStats(Stats* stats)
+{
+    stats->created = __atomic_load_n(&sCreated, __ATOMIC_RELAXED);
+    stats->destroyed = __atomic_load_n(&sDestroyed, __ATOMIC_RELAXED);
+    stats->exhausted = __atomic_load_n(&sExhausted, __ATOMIC_RELAXED);
+    stats->badReleases = __atomic_load_n(&sBadReleases, __ATOMIC_RELAXED);
+    stats->live = __atomic_load_n(&sLive, __ATOMIC_RELAXED);
+    for (int p = 0; p < SidebandNativeHandle::SIDEBAND_VIDEO_PLANE_NUM; p++) {
+        stats->livePerPlane[p] = __atomic_load_n(&sLivePerPlane[p], __ATOMIC_RELAXED);
+    }
+}
+
+}; // namespace android
@@ -0,0 +1,61 @@
+/*
+ * SidebandHandleIds.h
+ * Process wide ids for client side sideband handles, and the counts that
+ * track their lifetime. An id is a slot in a fixed table tagged with the
+ * slot's generation, so an id that was released stays dead when its slot
+ * is handed out again. Allocation and release are lock free: a Treiber
+ * stack of free slots whose head carries an ABA tag.
+ */
+
+#ifndef ANDROID_SIDEBAND_HANDLE_IDS_H
+#define ANDROID_SIDEBAND_HANDLE_IDS_H
+
+#include <stdint.h>
+
+#include <utils/Errors.h>
+
+#include "SidebandNativeHandle.h"
+
+// ----------------------------------------------------------------------------
+namespace android {
+// ----------------------------------------------------------------------------
+class SidebandHandleIds {
+public:
+    enum {
+        SLOT_BITS = 12,
+        MAX_SLOTS = 1 << SLOT_BITS,
+        /* what is left of a positive int after the slot */
+        GENERATION_MASK = (1 << (31 - SLOT_BITS)) - 1,
+    };
+
+    struct Stats {
+        uint64_t created;
+        uint64_t destroyed;
+        uint64_t exhausted;     /* allocate() found no free slot */
+        uint64_t badReleases;   /* release() of an id that was not live */
+        int live;
+        int livePerPlane[SidebandNativeHandle::SIDEBAND_VIDEO_PLANE_NUM];
+    };
+
+    /* a new id on planeId, -1 when all MAX_SLOTS are live */
+    static int allocate(int planeId);
+    /* BAD_VALUE, and nothing released, when id is not live */
+    static status_t release(int id, int planeId);
+    static bool isLive(int id);
+    /* keeps the per plane counts of a live id right */
+    static void planeChanged(int fromPlane, int toPlane);
+    /* each count is exact, together they are a snapshot only when nothing runs */
+    static void getStats(Stats* stats);
+
+    static int slotOf(int id) { return id & (MAX_SLOTS - 1); }
+    static int generationOf(int id) { return (id >> SLOT_BITS) & GENERATION_MASK; }
+
+private:
+    static int pop();
+    static void push(int slot);
+    static void countPlane(int planeId, int delta);
+};
+
+// ----------------------------------------------------------------------------
+}; // namespace android
+#endif // ANDROID_SIDEBAND_HANDLE_IDS_H
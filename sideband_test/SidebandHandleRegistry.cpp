@@ -0,0 +1,188 @@
+/*
+ * SidebandHandleRegistry.cpp
+ * Server side cache of imported sideband handles.
+ */
+
+#define LOG_TAG "SidebandHandleRegistry"
+
+#include <string.h>
+#include <sys/stat.h>
+#include <utils/Log.h>
+
+#include "SidebandHandleRegistry.h"
+
+namespace android {
+
+SidebandHandleRegistry::SidebandHandleRegistry()
+{
+    pthread_mutex_init(&mLock, NULL);
+    for (int i = 0; i < CAPACITY; i++) {
+        mEntries[i].used = false;
+    }
+    memset(&mStats, 0, sizeof(mStats));
+}
+
+SidebandHandleRegistry::~SidebandHandleRegistry()
+{
+    clear();
+    pthread_mutex_destroy(&mLock);
+}
+
+bool SidebandHandleRegistry::keyOf(const native_handle* h, Key* key)
+{
+    /* the shape isValid() wants, enough to know where the ints are */
+    if (!h || h->version != sizeof(native_handle) ||
+            (h->numFds != SidebandNativeHandle::sNumFds && h->numFds != SidebandNativeHandle::sNumControlFds) ||
+            (h->numInts != SidebandNativeHandle::sNumInts && h->numInts != SidebandNativeHandle::sNumIntsV1)) {
+        return false;
+    }
+    memset(key, 0, sizeof(*key));
+    /* the ints are magic, clientTid, index, ... */
+    key->clientTid = h->data[h->numFds + 1];
+    key->index = h->data[h->numFds + 2];
+    struct stat st;
+    if (h->numFds == SidebandNativeHandle::sNumControlFds && fstat(h->data[0], &st) == 0) {
+        key->dev = st.st_dev;
+        key->ino = st.st_ino;
+    }
+    return true;
+}
+
+bool SidebandHandleRegistry::sameKey(const Key& a, const Key& b)
+{
+    return a.index == b.index && a.clientTid == b.clientTid && a.ino == b.ino && a.dev == b.dev;
+}
+
+unsigned SidebandHandleRegistry::slotOf(const Key& key)
+{
+    uint32_t x = (uint32_t)key.index * 0x9e3779b1u;
+    x ^= (uint32_t)key.clientTid * 0x85ebca6bu;
+    x ^= (uint32_t)(key.ino ^ (key.ino >> 32)) * 0xc2b2ae35u;
+    return (x >> 16) & (CAPACITY - 1);
+}
+
+/* fd numbers differ from one delivery to the next, only the ints count */
+bool SidebandHandleRegistry::sameContents(const Entry& e, const native_handle* h)
+{
+    return e.version == h->version && e.numFds == h->numFds && e.numInts == h->numInts &&
+            memcmp(e.ints, h->data + h->numFds, sizeof(int)*e.numInts) == 0;
+}
+
+void SidebandHandleRegistry::fill(Entry& e, const Key& key, const native_handle* h,
+        const sp<Imported>& imported)
+{
+    e.used = true;
+    e.key = key;
+    e.version = h->version;
+    e.numFds = h->numFds;
+    e.numInts = h->numInts;
+    memcpy(e.ints, h->data + h->numFds, sizeof(int)*h->numInts);
+    e.imported = imported;
+}
+
+void SidebandHandleRegistry::drop(Entry& e)
+{
+    /* the last reference, if nobody else holds one, deletes the handle */
+    e.imported.clear();
+    e.used = false;
+}
+
+sp<SidebandHandleRegistry::Imported> SidebandHandleRegistry::import(const native_handle* h)
+{
+    if (h && h->numFds == 0) {
+        /* nothing to map, building it costs less than the lock and the lookup */
+        if (!SidebandNativeHandle::isValid(h)) {
+            pthread_mutex_lock(&mLock);
+            mStats.rejected++;
+            pthread_mutex_unlock(&mLock);
+            return NULL;
+        }
+        __atomic_fetch_add(&mStats.direct, 1, __ATOMIC_RELAXED);
+        return new Imported(h);
+    }
+
+    Key key;
+    if (!keyOf(h, &key)) {
+        pthread_mutex_lock(&mLock);
+        mStats.rejected++;
+        pthread_mutex_unlock(&mLock);
+        return NULL;
+    }
+    pthread_mutex_lock(&mLock);
+    unsigned slot = slotOf(key);
+    int free = -1;
+    for (int i = 0; i < PROBES; i++) {
+        Entry& e = mEntries[(slot + i) & (CAPACITY - 1)];
+        if (e.used && sameKey(e.key, key)) {
+            if (sameContents(e, h)) {
+                mStats.hits++;
+                sp<Imported> imported = e.imported;
+                pthread_mutex_unlock(&mLock);
+                return imported;
+            }
+            /* same stream, new generation or plane: import it again */
+            drop(e);
+            free = (slot + i) & (CAPACITY - 1);
+            break;
+        }
+        if (!e.used && free < 0) {
+            free = (slot + i) & (CAPACITY - 1);
+        }
+    }
+
+    if (!SidebandNativeHandle::isValid(h)) {
+        mStats.rejected++;
+        pthread_mutex_unlock(&mLock);
+        return NULL;
+    }
+    if (free < 0) {
+        /* every probed slot is taken by another stream */
+        free = slot;
+        drop(mEntries[free]);
+        mStats.evictions++;
+    }
+    sp<Imported> imported = new Imported(h);
+    fill(mEntries[free], key, h, imported);
+    mStats.misses++;
+    pthread_mutex_unlock(&mLock);
+    return imported;
+}
+
+void SidebandHandleRegistry::forget(const native_handle* h)
+{
+    Key key;
+    if (!keyOf(h, &key)) {
+        return;
+    }
+    pthread_mutex_lock(&mLock);
+    unsigned slot = slotOf(key);
+    for (int i = 0; i < PROBES; i++) {
+        Entry& e = mEntries[(slot + i) & (CAPACITY - 1)];
+        if (e.used && sameKey(e.key, key)) {
+            drop(e);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mLock);
+}
+
+void SidebandHandleRegistry::clear()
+{
+    pthread_mutex_lock(&mLock);
+    for (int i = 0; i < CAPACITY; i++) {
+        if (mEntries[i].used) {
+            drop(mEntries[i]);
+        }
+    }
+    pthread_mutex_unlock(&mLock);
+}
+
+void SidebandHandleRegistry::getStats(Stats* stats)
+{
+    pthread_mutex_lock(&mLock);
+    *stats = mStats;
+    stats->direct = __atomic_load_n(&mStats.direct, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&mLock);
+}
+
+}; // namespace android
@@ -0,0 +1,97 @@
+/*
+ * SidebandHandleRegistry.h
+ * Server side cache of imported sideband handles with a control block.
+ * Importing one maps the block, so the first import of a stream validates
+ * its handle and builds its SidebandNativeHandle, and later imports with
+ * the same ints, generation included, are a hash lookup, an fstat and a
+ * compare of a few ints. An fd-less handle is cheaper to build than to
+ * look up: import() builds those every time without the lock, and a hot
+ * path should construct their SidebandNativeHandle itself and skip the
+ * counted copy too.
+ *
+ * A stream is known by what names it, not by where its native_handle
+ * happens to live or which fd numbers it arrived with, both of which are
+ * reused: the client's tid and its SidebandHandleIds id, and the control
+ * block's file when it has one. Entries are handed out counted, so one in
+ * use outlives its eviction.
+ */
+
+#ifndef ANDROID_SIDEBAND_HANDLE_REGISTRY_H
+#define ANDROID_SIDEBAND_HANDLE_REGISTRY_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <utils/RefBase.h>
+
+#include "SidebandNativeHandle.h"
+
+// ----------------------------------------------------------------------------
+namespace android {
+// ----------------------------------------------------------------------------
+class SidebandHandleRegistry {
+public:
+    enum {
+        CAPACITY = 64,          /* power of two */
+        PROBES = 4,             /* slots looked at before evicting */
+    };
+
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;        /* built, first sight or changed */
+        uint64_t direct;        /* fd-less, built without the cache */
+        uint64_t rejected;      /* failed validation, not cached */
+        uint64_t evictions;
+    };
+
+    /* the server side handle of one import, alive while anyone holds it */
+    class Imported : public RefBase {
+    public:
+        explicit Imported(const native_handle* h) : handle(h, false) {}
+        const SidebandNativeHandle handle;
+    };
+
+    SidebandHandleRegistry();
+    ~SidebandHandleRegistry();
+
+    /* the server side handle for h, or NULL if h is not a valid sideband handle */
+    sp<Imported> import(const native_handle* h);
+    /* drops h's stream, for when the consumer lets go of it */
+    void forget(const native_handle* h);
+    void clear();
+    void getStats(Stats* stats);
+
+private:
+    struct Key {
+        uint64_t dev;           /* the control block's file, 0 without one */
+        uint64_t ino;
+        int clientTid;
+        int index;
+    };
+
+    struct Entry {
+        bool used;
+        Key key;
+        int version;
+        int numFds;
+        int numInts;
+        int ints[SidebandNativeHandle::sNumInts];  /* as validated */
+        sp<Imported> imported;
+    };
+
+    /* false when h is not shaped like a sideband handle, so has no key */
+    static bool keyOf(const native_handle* h, Key* key);
+    static bool sameKey(const Key& a, const Key& b);
+    static unsigned slotOf(const Key& key);
+    static bool sameContents(const Entry& e, const native_handle* h);
+    void fill(Entry& e, const Key& key, const native_handle* h, const sp<Imported>& imported);
+    void drop(Entry& e);
+
+    pthread_mutex_t mLock;
+    Entry mEntries[CAPACITY];
+    Stats mStats;
+};
+
+// ----------------------------------------------------------------------------
+}; // namespace android
+#endif // ANDROID_SIDEBAND_HANDLE_REGISTRY_H
@@ -21,17 +21,29 @@
 #include <cutils/ashmem.h>
 #include <utils/Log.h>
 #include <string.h>
+#include <unistd.h>
+#include "SidebandHandleIds.h"
 #include "SidebandNativeHandle.h"
 
-static int global_index = 0;
-
 namespace android {
 
-SidebandNativeHandle::SidebandNativeHandle(bool inOwnsFd)
+const SidebandNativeHandle::PlaneInfo SidebandNativeHandle::sPlanes[SIDEBAND_VIDEO_PLANE_NUM] = {
+    { SIDEBAND_VIDEO_PLANE_MAIN,    "main" },
+    { SIDEBAND_VIDEO_PLANE_PIP,     "pip" },
+};
+
+SidebandNativeHandle::SidebandNativeHandle(bool inOwnsFd, bool withControl)
 {
     ALOGV("%s:%i, create SidebandNativeHandle %p at client side,  inOwnsFd=%d",
             __FUNCTION__, __LINE__, this, inOwnsFd);
 
+    /* the object itself never carries the fd, createWireHandle() adds it */
+    control = withControl ? SidebandControl::create() : NULL;
+    if (withControl && !control) {
+        ALOGE("%s:%i, this=%p, no control block, falling back to binder only",
+              __FUNCTION__, __LINE__, this);
+    }
+
     // Set planeid with default value, use setVideoPlaneId() to update it.
     planeId = SIDEBAND_VIDEO_PLANE_MAIN;
     /* follow the native_handle's version */
@@ -45,7 +57,9 @@ SidebandNativeHandle::SidebandNativeHandle(bool inOwnsFd)
 
     nativeHandle = NULL;
     clientTid = gettid();
-    global_index++;
+    index = SidebandHandleIds::allocate(planeId);
+    ownsId = index >= 0;
+    generation = 0;
 
     ALOGV("%s:%i finish, this=%p, ID=(%d:%d), planeId:%d", __FUNCTION__,
           __LINE__, this,  clientTid, index, planeId);
@@ -59,14 +73,20 @@ SidebandNativeHandle::SidebandNativeHandle(const native_handle *handle, bool inO
     /* follow the native_handle's version */
     version = sizeof(native_handle);
 
+    control = NULL;
+    ownsId = false;
     if ((handle) && !validate(handle)) {
-        /*set numInts and numFds*/
-        numInts = handle->numInts;
-        numFds = handle->numFds;
+        /*set numInts; the fd, if any, goes to the control block*/
+        numInts = sNumInts;
+        numFds = sNumFds;
 
         nativeHandle = handle;
 
-        memcpy(&magic, handle->data+numFds, sizeof(int)*numInts);
+        generation = 0;
+        memcpy(&magic, handle->data+handle->numFds, sizeof(int)*handle->numInts);
+        if (handle->numFds == sNumControlFds) {
+            control = SidebandControl::map(handle->data[0], false);
+        }
     }
     else {
         ALOGE("%s:%i, this=%p, invalid native_handle %p to create sideband native handle",
@@ -75,6 +95,8 @@ SidebandNativeHandle::SidebandNativeHandle(const native_handle *handle, bool inO
         numFds = sNumFds;
         magic = sMagic;
         clientTid = index = -1;
+        planeId = SIDEBAND_VIDEO_PLANE_MAIN;
+        generation = 0;
         nativeHandle = NULL;
     }
 
@@ -83,12 +105,57 @@ SidebandNativeHandle::SidebandNativeHandle(const native_handle *handle, bool inO
 
 SidebandNativeHandle::~SidebandNativeHandle()
 {
+    if (ownsId) {
+        SidebandHandleIds::release(index, planeId);
+    }
+    delete control;
+}
+
+native_handle_t* SidebandNativeHandle::createWireHandle() const
+{
+    int fds = control ? sNumControlFds : sNumFds;
+    native_handle_t *h = native_handle_create(fds, sNumInts);
+    if (!h) {
+        return NULL;
+    }
+    if (control) {
+        h->data[0] = dup(control->fd());
+    }
+    memcpy(h->data+fds, &magic, sizeof(int)*sNumInts);
+    return h;
 }
 
 status_t SidebandNativeHandle::setVideoPlaneId(int id)
 {
+    if (!isValidPlaneId(id)) {
+        ALOGE("%s:%i, this=%p, invalid video plane id %d", __FUNCTION__, __LINE__, this, id);
+        return BAD_VALUE;
+    }
+    if (ownsId) {
+        SidebandHandleIds::planeChanged(planeId, id);
+    }
     planeId = id;
+    generation++;
+    if (control) {
+        SidebandFrameState state;
+        if (control->read(&state) == NO_ERROR) {
+            state.planeId = id;
+            control->publish(state);
+        }
+    }
+
+    return NO_ERROR;
+}
 
+status_t SidebandNativeHandle::publishFrame(const SidebandFrameState& state)
+{
+    if (!control) {
+        return INVALID_OPERATION;
+    }
+    if (!isValidPlaneId(state.planeId)) {
+        return BAD_VALUE;
+    }
+    control->publish(state);
     return NO_ERROR;
 }
 };  //namespace android
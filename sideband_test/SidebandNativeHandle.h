@@ -23,6 +23,8 @@
 #include <utils/Errors.h>
 #include <cutils/native_handle.h>
 
+#include "SidebandControl.h"
+
 
 // ----------------------------------------------------------------------------
 namespace android {
@@ -33,41 +35,83 @@ public:
     /* ints */
     int     magic;          /* for handle validation */
     int     clientTid;      /* for debug usage */
-    int     index;          /* for debug usage */
+    int     index;          /* SidebandHandleIds id of the client side handle */
     int     planeId;        /* video plane id will be used by this sideband stream */
+    int     generation;     /* bumped on every change of the ints, for caches */
 
     const native_handle *nativeHandle;
+    /* optional shared state, travels as the handle's one fd; NULL without */
+    SidebandControl *control;
+    /* client side: index came from SidebandHandleIds and goes back on delete */
+    bool ownsId;
 
     static const int sNumFds = 0;
-    static const int sNumInts = 4;
+    static const int sNumControlFds = 1;
+    static const int sNumInts = 5;
+    static const int sNumIntsV1 = 4;    /* before generation, still accepted */
     static const int sMagic = 0x53424e48; /*SBNH*/
 
     enum {
         SIDEBAND_VIDEO_PLANE_MAIN = 0x0,
         SIDEBAND_VIDEO_PLANE_PIP = 0x1,
+        SIDEBAND_VIDEO_PLANE_NUM,       /* planes the display controller has */
+    };
+
+    struct PlaneInfo {
+        int         id;
+        const char *name;
     };
 
-    SidebandNativeHandle(bool ownsFd = true);
+    /* every plane a stream may be put on, indexed by plane id */
+    static const PlaneInfo sPlanes[SIDEBAND_VIDEO_PLANE_NUM];
+
+    static bool isValidPlaneId(int id)
+    {
+        return id >= 0 && id < SIDEBAND_VIDEO_PLANE_NUM && sPlanes[id].id == id;
+    }
+
+    SidebandNativeHandle(bool ownsFd = true, bool withControl = false);
 
     SidebandNativeHandle(const native_handle *handle, bool ownsFd = false);
 
     ~SidebandNativeHandle();
 
+    /* the ints follow the fds, so they are looked up through numFds */
+    static bool isValid(const native_handle* h)
+    {
+        return h && h->version == sizeof(native_handle) &&
+                (h->numInts == sNumInts || h->numInts == sNumIntsV1) &&
+                (h->numFds == sNumFds || h->numFds == sNumControlFds) &&
+                h->data[h->numFds] == sMagic && isValidPlaneId(h->data[h->numFds + 3]);
+    }
+
     static int validate(const native_handle* h)
     {
-        const SidebandNativeHandle* hnd = (const SidebandNativeHandle*)h;
-        if (!hnd || hnd->version != sizeof(native_handle) ||
-                hnd->numInts != sNumInts || hnd->numFds != sNumFds ||
-                hnd->magic != sMagic)
+        if (!isValid(h))
         {
-            ALOGW("invalid sideband handle (at %p)", hnd);
+            ALOGW("invalid sideband handle (at %p)", h);
             return -EINVAL;
         }
         return 0;
     }
 
-    /*server use, set the video plane id to shared memory region */
+    static int generationOf(const native_handle* h)
+    {
+        return h->numInts > sNumIntsV1 ? h->data[h->numFds + 4] : 0;
+    }
+
+    /*
+     * what to give NativeHandle::create(h, true): the ints, plus a dup of
+     * the control block fd in front of them when there is one
+     */
+    native_handle_t* createWireHandle() const;
+
+    /*server use, set the video plane id to shared memory region,
+      BAD_VALUE for an id not in sPlanes */
     status_t setVideoPlaneId(int id);
+
+    /* producer, with a control block: publishes a frame's state, no binder call */
+    status_t publishFrame(const SidebandFrameState& state);
 };
 
 // ----------------------------------------------------------------------------
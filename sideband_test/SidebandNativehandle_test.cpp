@@ -24,9 +24,17 @@
 #include <gui/SurfaceComposerClient.h>
 #include <gui/BufferItemConsumer.h>
 
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <utils/Timers.h>
 
+#include "SidebandAnimator.h"
+#include "SidebandHandleIds.h"
+#include "SidebandHandleRegistry.h"
 #include "SidebandNativeHandle.h"
+#include "SidebandPlaneManager.h"
 
 using namespace android;
 
@@ -58,10 +66,722 @@ static void punchHole(
     return;
 }
 
+enum {
+    OP_ATTACH,
+    OP_DETACH,
+    OP_MOVE,
+    OP_TOGGLE,
+    NUM_OPS,
+};
+
+static const char *opNames[NUM_OPS] = { "attach", "detach", "move", "toggle" };
+
+static int compareTimes(const void *a, const void *b)
+{
+    nsecs_t x = *(const nsecs_t *)a;
+    nsecs_t y = *(const nsecs_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* hole positions: a grid of X_WINDOW_SIZE x Y_WINDOW_SIZE cells */
+static void cellPosition(int cell, int *x, int *y)
+{
+    int columns = 2*HALF_RES_X/X_WINDOW_SIZE;
+    *x = (cell % columns)*X_WINDOW_SIZE;
+    *y = (cell/columns % (2*HALF_RES_Y/Y_WINDOW_SIZE))*Y_WINDOW_SIZE;
+}
+
+/*
+ * Random attach / detach / move / toggle on nStreams streams as fast as
+ * they go, each op timed around the calls that reach SurfaceFlinger.
+ * toggle is setSidebandStream(NULL) then back on the same plane.
+ */
+static int runBench(int nStreams, int nOps, unsigned seed)
+{
+    sp<SurfaceComposerClient> client = new SurfaceComposerClient;
+    if (client->initCheck()) {
+        printf("%s:%i, fail to create SurfaceComposerClient\n", __FUNCTION__, __LINE__);
+        return 1;
+    }
+    SidebandPlaneManager manager(client);
+    for (int i = 0; i < nStreams; i++) {
+        int x, y;
+        cellPosition(i, &x, &y);
+        if (manager.allocate(x, y, X_WINDOW_SIZE, Y_WINDOW_SIZE, 21000 + 1 + i) < 0) {
+            printf("%s:%i, fail to allocate stream %d\n", __FUNCTION__, __LINE__, i);
+            return 1;
+        }
+    }
+
+    nsecs_t *times[NUM_OPS];
+    int counts[NUM_OPS] = { 0 };
+    for (int op = 0; op < NUM_OPS; op++) {
+        times[op] = new nsecs_t[nOps];
+    }
+    int busy = 0;
+    int errors = 0;
+    srand(seed);
+    for (int i = 0; i < nOps; i++) {
+        int stream = rand() % nStreams;
+        int plane = manager.planeOf(stream);
+        int op;
+        if (plane < 0) {
+            op = OP_ATTACH;
+        } else {
+            op = OP_DETACH + rand() % 3;
+        }
+
+        status_t err = NO_ERROR;
+        nsecs_t start = systemTime();
+        switch (op) {
+        case OP_ATTACH:
+            err = manager.attach(stream);
+            break;
+        case OP_DETACH:
+            err = manager.detach(stream);
+            break;
+        case OP_MOVE: {
+            /* to the other plane when it is free, else just to another cell */
+            int target = (plane + 1) % SidebandNativeHandle::SIDEBAND_VIDEO_PLANE_NUM;
+            if (manager.streamOn(target) >= 0) {
+                target = plane;
+            }
+            int x, y;
+            cellPosition(rand(), &x, &y);
+            err = manager.move(stream, target, x, y);
+            break;
+        }
+        case OP_TOGGLE:
+            err = manager.detach(stream);
+            if (err == NO_ERROR) {
+                err = manager.attach(stream, plane);
+            }
+            break;
+        }
+        nsecs_t elapsed = systemTime() - start;
+        if (err == INVALID_OPERATION) {
+            /* every plane taken, not a measurement */
+            busy++;
+        } else if (err != NO_ERROR) {
+            errors++;
+        } else {
+            times[op][counts[op]++] = elapsed;
+        }
+    }
+
+    printf("%d streams on %d planes, %d ops, seed %u: %d found no free plane, %d failed\n",
+            nStreams, SidebandNativeHandle::SIDEBAND_VIDEO_PLANE_NUM, nOps, seed, busy, errors);
+    printf("%-8s %7s %9s %9s %9s %9s\n", "op", "count", "avg us", "p50 us", "p99 us", "max us");
+    for (int op = 0; op < NUM_OPS; op++) {
+        int n = counts[op];
+        if (n == 0) {
+            continue;
+        }
+        nsecs_t total = 0;
+        for (int i = 0; i < n; i++) {
+            total += times[op][i];
+        }
+        qsort(times[op], n, sizeof(nsecs_t), compareTimes);
+        printf("%-8s %7d %9.1f %9.1f %9.1f %9.1f\n", opNames[op], n, total/n/1e3,
+                times[op][n/2]/1e3, times[op][n*99/100]/1e3, times[op][n - 1]/1e3);
+    }
+    for (int op = 0; op < NUM_OPS; op++) {
+        delete[] times[op];
+    }
+    manager.dump();
+    return errors ? 1 : 0;
+}
+
+static void printTimes(const char *name, nsecs_t *times, int n)
+{
+    if (n == 0) {
+        printf("%-22s no samples\n", name);
+        return;
+    }
+    nsecs_t total = 0;
+    for (int i = 0; i < n; i++) {
+        total += times[i];
+    }
+    qsort(times, n, sizeof(nsecs_t), compareTimes);
+    printf("%-22s %7d %9.2f %9.2f %9.2f %9.2f\n", name, n, total/n/1e3,
+            times[n/2]/1e3, times[n*99/100]/1e3, times[n - 1]/1e3);
+}
+
+/* The compositor's side: a handle rebuilt from the wire form, read on every change. */
+struct ControlReader {
+    SidebandNativeHandle *server;
+    nsecs_t *latency;
+    int frames;
+    uint32_t last;              /* sequence of the last state read */
+    volatile int seen;
+};
+
+static void *controlReaderLoop(void *arg)
+{
+    ControlReader *r = (ControlReader *)arg;
+    uint32_t last = r->last;
+    while (r->seen < r->frames) {
+        uint32_t seq = r->server->control->sequence();
+        if (seq == last) {
+            sched_yield();
+            continue;
+        }
+        SidebandFrameState state;
+        if (r->server->control->read(&state) == NO_ERROR) {
+            r->latency[r->seen] = systemTime() - state.timestamp;
+            last = seq;
+            __atomic_store_n(&r->seen, r->seen + 1, __ATOMIC_RELEASE);
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Per-frame geometry and plane changes two ways: published into the
+ * control block and picked up by a reader thread, against a transaction
+ * plus a setSidebandStream() call carrying the new plane id.
+ */
+static int runControlBench(int frames)
+{
+    sp<SurfaceComposerClient> client = new SurfaceComposerClient;
+    if (client->initCheck()) {
+        printf("%s:%i, fail to create SurfaceComposerClient\n", __FUNCTION__, __LINE__);
+        return 1;
+    }
+    sp<SurfaceControl> control = client->createSurface(String8("sideband_control"),
+            X_WINDOW_SIZE, Y_WINDOW_SIZE, PIXEL_FORMAT_RGBX_8888, 0);
+    sp<Surface> surface = control->getSurface();
+    SurfaceComposerClient::Transaction().setLayer(control, 21000 + 1).show(control).apply();
+
+    SidebandNativeHandle *client_handle = new SidebandNativeHandle(true, true);
+    if (!client_handle->control) {
+        printf("%s:%i, no control block\n", __FUNCTION__, __LINE__);
+        return 1;
+    }
+    native_handle_t *wire = client_handle->createWireHandle();
+    sp<NativeHandle> stream = NativeHandle::create(wire, true);
+    surface->setSidebandStream(stream);
+
+    ControlReader reader;
+    reader.server = new SidebandNativeHandle(wire, false);
+    if (!reader.server->control) {
+        printf("%s:%i, compositor side cannot map the control block\n", __FUNCTION__, __LINE__);
+        return 1;
+    }
+    reader.latency = new nsecs_t[frames];
+    reader.frames = frames;
+    reader.seen = 0;
+    reader.last = reader.server->control->sequence();
+    pthread_t readerThread;
+    pthread_create(&readerThread, NULL, controlReaderLoop, &reader);
+
+    nsecs_t *publish = new nsecs_t[frames];
+    SidebandFrameState state;
+    memset(&state, 0, sizeof(state));
+    state.width = X_WINDOW_SIZE;
+    state.height = Y_WINDOW_SIZE;
+    state.hdr.type = SIDEBAND_HDR_HDR10;
+    state.hdr.maxLuminance = 1000.0f;
+    state.hdr.minLuminance = 0.005f;
+    for (int i = 0; i < frames; i++) {
+        state.planeId = i & 1;
+        state.x = (i % ANIMATION_COUNT)*X_OFFSET;
+        state.y = (i % ANIMATION_COUNT)*Y_OFFSET;
+        state.frameNumber = i + 1;
+        nsecs_t start = systemTime();
+        state.timestamp = start;
+        client_handle->publishFrame(state);
+        publish[i] = systemTime() - start;
+        /* one frame in flight, like a compositor reading once per refresh */
+        while (__atomic_load_n(&reader.seen, __ATOMIC_ACQUIRE) <= i) {
+            sched_yield();
+        }
+    }
+    pthread_join(readerThread, NULL);
+
+    nsecs_t *transaction = new nsecs_t[frames];
+    for (int i = 0; i < frames; i++) {
+        nsecs_t start = systemTime();
+        SurfaceComposerClient::Transaction()
+            .setPosition(control, (i % ANIMATION_COUNT)*X_OFFSET, (i % ANIMATION_COUNT)*Y_OFFSET)
+            .setSize(control, X_WINDOW_SIZE, Y_WINDOW_SIZE)
+            .apply();
+        client_handle->setVideoPlaneId(i & 1);
+        surface->setSidebandStream(NativeHandle::create(client_handle->createWireHandle(), true));
+        transaction[i] = systemTime() - start;
+    }
+
+    printf("%d frames\n", frames);
+    printf("%-22s %7s %9s %9s %9s %9s\n", "path", "count", "avg us", "p50 us", "p99 us", "max us");
+    printTimes("control publish", publish, frames);
+    printTimes("control to reader", reader.latency, frames);
+    printTimes("transaction+sideband", transaction, frames);
+
+    surface->setSidebandStream(NULL);
+    delete reader.server;
+    delete client_handle;
+    delete[] reader.latency;
+    delete[] publish;
+    delete[] transaction;
+    return 0;
+}
+
+static void printRate(const char *name, int calls, nsecs_t elapsed)
+{
+    printf("%-24s %10d calls %8.1f ns/call %8.2f M/s\n", name, calls,
+            (double)elapsed/calls, calls*1e3/(elapsed > 0 ? elapsed : 1));
+}
+
+/*
+ * What the compositor pays per frame to turn a received handle into a
+ * SidebandNativeHandle: validation alone, a full import, and for the
+ * control form a registry lookup of a handle it has seen before. A plain
+ * handle has nothing to map, so the compositor builds it directly.
+ */
+static int runImportBench(int calls)
+{
+    static volatile int sink;
+    SidebandNativeHandle plain(true, false);
+    SidebandNativeHandle withControl(true, true);
+    native_handle_t *wires[2] = { plain.createWireHandle(), withControl.createWireHandle() };
+    const char *names[2] = { "plain", "control" };
+
+    for (int w = 0; w < 2; w++) {
+        native_handle_t *wire = wires[w];
+        char name[32];
+
+        nsecs_t start = systemTime();
+        for (int i = 0; i < calls; i++) {
+            sink += SidebandNativeHandle::isValid(wire);
+        }
+        snprintf(name, sizeof(name), "%s validate", names[w]);
+        printRate(name, calls, systemTime() - start);
+
+        /* a full import maps the control block, so far fewer of those */
+        int imports = w == 0 ? calls/10 : calls/1000;
+        imports = imports > 0 ? imports : 1;
+        start = systemTime();
+        for (int i = 0; i < imports; i++) {
+            SidebandNativeHandle *server = new SidebandNativeHandle(wire, false);
+            sink += server->planeId;
+            delete server;
+        }
+        snprintf(name, sizeof(name), "%s import", names[w]);
+        printRate(name, imports, systemTime() - start);
+
+        if (w == 0) {
+            continue;
+        }
+        SidebandHandleRegistry registry;
+        start = systemTime();
+        for (int i = 0; i < calls; i++) {
+            sink += registry.import(wire)->handle.planeId;
+        }
+        snprintf(name, sizeof(name), "%s registry", names[w]);
+        printRate(name, calls, systemTime() - start);
+        SidebandHandleRegistry::Stats stats;
+        registry.getStats(&stats);
+        if (stats.misses != 1 || stats.hits != (uint64_t)calls - 1) {
+            printf("registry: expected 1 miss, got %llu misses %llu hits\n",
+                    (unsigned long long)stats.misses, (unsigned long long)stats.hits);
+            return 1;
+        }
+    }
+    native_handle_close(wires[0]);
+    native_handle_delete(wires[0]);
+    native_handle_close(wires[1]);
+    native_handle_delete(wires[1]);
+    return 0;
+}
+
+/* What validation is meant to accept, written out independently of it. */
+static bool fuzzExpected(const native_handle *h)
+{
+    if (h->version != (int)sizeof(native_handle) || (h->numFds != 0 && h->numFds != 1) ||
+            (h->numInts != 4 && h->numInts != 5)) {
+        return false;
+    }
+    int plane = h->data[h->numFds + 3];
+    return h->data[h->numFds] == SidebandNativeHandle::sMagic &&
+            (plane == SidebandNativeHandle::SIDEBAND_VIDEO_PLANE_MAIN ||
+             plane == SidebandNativeHandle::SIDEBAND_VIDEO_PLANE_PIP);
+}
+
+/*
+ * Mutated copies of valid handles, some reusing the same few buffers so a
+ * cached entry is hit with changed contents. Every handle must be judged
+ * as fuzzExpected() does, and every accepted import must reflect the
+ * handle's current ints.
+ */
+static int runFuzz(int iterations, unsigned seed)
+{
+    enum { BUFFERS = 8, MAX_FDS = 2, MAX_INTS = 8 };
+    SidebandNativeHandle source(true, true);
+    native_handle_t *wire = source.createWireHandle();
+    native_handle_t *buffers[BUFFERS];
+    for (int b = 0; b < BUFFERS; b++) {
+        /* room for the largest header the mutations produce, so no read leaves the buffer */
+        buffers[b] = native_handle_create(MAX_FDS, MAX_INTS);
+    }
+
+    SidebandHandleRegistry registry;
+    int accepted = 0;
+    int failures = 0;
+    srand(seed);
+    for (int i = 0; i < iterations; i++) {
+        native_handle_t *h = buffers[rand() % BUFFERS];
+        h->version = wire->version;
+        h->numFds = wire->numFds;
+        h->numInts = wire->numInts;
+        memset(h->data, 0, sizeof(int)*(MAX_FDS + MAX_INTS));
+        memcpy(h->data, wire->data, sizeof(int)*(wire->numFds + wire->numInts));
+        if (rand() % 2) {
+            /* the fd-less form */
+            h->numFds = 0;
+            memmove(h->data, h->data + 1, sizeof(int)*wire->numInts);
+        }
+
+        int mutations = rand() % 4;
+        for (int m = 0; m < mutations; m++) {
+            int word = rand() % (MAX_FDS + MAX_INTS);
+            switch (rand() % 7) {
+            case 0: h->version = rand() % 2 ? (int)sizeof(native_handle) + 4 : rand(); break;
+            case 1: h->numFds = rand() % (MAX_FDS + 1); break;
+            case 2: h->numInts = rand() % (MAX_INTS + 1); break;
+            case 3: h->data[word] ^= 1 << (rand() % 32); break;
+            case 4: h->data[h->numFds + 3] = rand() % 5 - 1; break;
+            case 5: h->data[h->numFds + 4] = rand(); break;          /* new generation */
+            case 6: h->data[h->numFds] = rand() % 2 ? 0 : SidebandNativeHandle::sMagic; break;
+            }
+        }
+        /* whatever fd slot there is holds a real control block fd */
+        if (h->numFds > 0) {
+            h->data[0] = wire->data[0];
+        }
+        if (h->numFds > 1 || h->numInts > MAX_INTS) {
+            h->numFds = 1;
+        }
+
+        bool expected = fuzzExpected(h);
+        bool valid = SidebandNativeHandle::isValid(h);
+        sp<SidebandHandleRegistry::Imported> imported = registry.import(h);
+        if (valid != expected || (imported != NULL) != expected) {
+            printf("iteration %d: expected %d, isValid %d, import %p (fds %d ints %d version %d)\n",
+                    i, expected, valid, imported.get(), h->numFds, h->numInts, h->version);
+            failures++;
+        } else if (imported != NULL && (imported->handle.planeId != h->data[h->numFds + 3] ||
+                imported->handle.generation != SidebandNativeHandle::generationOf(h))) {
+            printf("iteration %d: stale import, plane %d/%d generation %d/%d\n", i, imported->handle.planeId,
+                    h->data[h->numFds + 3], imported->handle.generation, SidebandNativeHandle::generationOf(h));
+            failures++;
+        }
+        accepted += expected ? 1 : 0;
+        if (failures > 10) {
+            break;
+        }
+    }
+
+    SidebandHandleRegistry::Stats stats;
+    registry.getStats(&stats);
+    printf("%d iterations, seed %u: %d valid, %llu hits, %llu misses, %llu direct, %llu rejected, %d failures\n",
+            iterations, seed, accepted, (unsigned long long)stats.hits, (unsigned long long)stats.misses,
+            (unsigned long long)stats.direct, (unsigned long long)stats.rejected, failures);
+    registry.clear();
+    for (int b = 0; b < BUFFERS; b++) {
+        native_handle_delete(buffers[b]);
+    }
+    native_handle_close(wire);
+    native_handle_delete(wire);
+    return failures ? 1 : 0;
+}
+
+struct IdWorker {
+    pthread_t thread;
+    int id;
+    int iterations;
+    int held;
+    unsigned seed;
+    int *owners;            /* worker + 1 holding each slot, shared by all */
+    int failures;
+    int staleChecks;
+};
+
+static void *idWorkerLoop(void *arg)
+{
+    enum { MAX_HELD = 64 };
+    IdWorker *w = (IdWorker *)arg;
+    SidebandNativeHandle *held[MAX_HELD] = { NULL };
+    int me = w->id + 1;
+
+    for (int i = 0; i < w->iterations; i++) {
+        int k = rand_r(&w->seed) % w->held;
+        SidebandNativeHandle *h = held[k];
+        if (!h) {
+            h = new SidebandNativeHandle(true);
+            int slot = SidebandHandleIds::slotOf(h->index);
+            int none = 0;
+            if (h->index < 0 || !SidebandHandleIds::isLive(h->index) ||
+                    !__atomic_compare_exchange_n(&w->owners[slot], &none, me, false,
+                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                printf("worker %d: id %d handed out twice (slot held by %d)\n", w->id, h->index, none - 1);
+                w->failures++;
+            }
+            held[k] = h;
+            continue;
+        }
+        if (rand_r(&w->seed) % 4 == 0) {
+            h->setVideoPlaneId(rand_r(&w->seed) % SidebandNativeHandle::SIDEBAND_VIDEO_PLANE_NUM);
+            continue;
+        }
+        int id = h->index;
+        __atomic_store_n(&w->owners[SidebandHandleIds::slotOf(id)], 0, __ATOMIC_RELEASE);
+        delete h;
+        held[k] = NULL;
+        if (SidebandHandleIds::isLive(id)) {
+            printf("worker %d: id %d still live after delete\n", w->id, id);
+            w->failures++;
+        }
+        /* now and then, a second release must bounce off the generation */
+        if ((i & 1023) == 0) {
+            w->staleChecks++;
+            if (SidebandHandleIds::release(id, SidebandNativeHandle::SIDEBAND_VIDEO_PLANE_MAIN) != BAD_VALUE) {
+                printf("worker %d: stale id %d released twice\n", w->id, id);
+                w->failures++;
+            }
+        }
+    }
+    for (int k = 0; k < w->held; k++) {
+        if (held[k]) {
+            __atomic_store_n(&w->owners[SidebandHandleIds::slotOf(held[k]->index)], 0, __ATOMIC_RELEASE);
+            delete held[k];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Many threads creating, re-planing and deleting client handles at once.
+ * Every id must be unique among the live ones, dead once deleted, and the
+ * lifetime counts must come back to where they started.
+ */
+static int runIdStress(int nThreads, int iterations, int held)
+{
+    static int owners[SidebandHandleIds::MAX_SLOTS];
+    IdWorker *workers = new IdWorker[nThreads];
+    SidebandHandleIds::Stats before, after;
+    SidebandHandleIds::getStats(&before);
+
+    nsecs_t start = systemTime();
+    for (int t = 0; t < nThreads; t++) {
+        IdWorker& w = workers[t];
+        w.id = t;
+        w.iterations = iterations;
+        w.held = held;
+        w.seed = t*7919 + 1;
+        w.owners = owners;
+        w.failures = 0;
+        w.staleChecks = 0;
+        pthread_create(&w.thread, NULL, idWorkerLoop, &w);
+    }
+    int failures = 0;
+    int staleChecks = 0;
+    for (int t = 0; t < nThreads; t++) {
+        pthread_join(workers[t].thread, NULL);
+        failures += workers[t].failures;
+        staleChecks += workers[t].staleChecks;
+    }
+    nsecs_t elapsed = systemTime() - start;
+    SidebandHandleIds::getStats(&after);
+
+    uint64_t created = after.created - before.created;
+    uint64_t destroyed = after.destroyed - before.destroyed;
+    printf("%d threads x %d ops, up to %d held each: %.2f Mops/s\n", nThreads, iterations, held,
+            (double)nThreads*iterations*1e3/elapsed);
+    printf("created %llu destroyed %llu exhausted %llu bad releases %llu (%d expected)\n",
+            (unsigned long long)created, (unsigned long long)destroyed,
+            (unsigned long long)(after.exhausted - before.exhausted),
+            (unsigned long long)(after.badReleases - before.badReleases), staleChecks);
+    if (created != destroyed || after.live != before.live ||
+            after.badReleases - before.badReleases != (uint64_t)staleChecks) {
+        printf("lifetime counts do not balance, live %d -> %d\n", before.live, after.live);
+        failures++;
+    }
+    for (int p = 0; p < SidebandNativeHandle::SIDEBAND_VIDEO_PLANE_NUM; p++) {
+        if (after.livePerPlane[p] != before.livePerPlane[p]) {
+            printf("plane %s: live %d -> %d\n", SidebandNativeHandle::sPlanes[p].name,
+                    before.livePerPlane[p], after.livePerPlane[p]);
+            failures++;
+        }
+    }
+    delete[] workers;
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
+
+static void printAnimStats(const char *name, const SidebandAnimator::Stats& s)
+{
+    printf("%-12s %6d %6d %7d %5d %8.3f %8.3f %8.3f\n", name, s.frames, s.missedVsyncs,
+            s.doubledFrames, s.lateApplies, s.applyP50/1e6, s.applyP99/1e6, s.applyMax/1e6);
+}
+
+/*
+ * PIP transitions of several sideband streams at once: each window grows
+ * from its corner slot to a quarter of the screen and shrinks back,
+ * vsync paced, or with the old fixed sleep when sleepUs is given.
+ */
+static int runAnimation(int nStreams, int transitions, int durationMs, int sleepUs)
+{
+    sp<SurfaceComposerClient> client = new SurfaceComposerClient;
+    if (client->initCheck() != NO_ERROR) {
+        printf("cannot connect to SurfaceFlinger\n");
+        return 1;
+    }
+    SidebandAnimator animator;
+    if (animator.initCheck() != NO_ERROR) {
+        printf("no display events\n");
+        return 1;
+    }
+
+    sp<SurfaceControl> controls[SidebandAnimator::MAX_LAYERS];
+    sp<Surface> surfaces[SidebandAnimator::MAX_LAYERS];
+    SidebandNativeHandle *handles[SidebandAnimator::MAX_LAYERS];
+    SidebandAnimator::Geometry small[SidebandAnimator::MAX_LAYERS];
+    SidebandAnimator::Geometry large[SidebandAnimator::MAX_LAYERS];
+    SurfaceComposerClient::Transaction setup;
+    for (int k = 0; k < nStreams; k++) {
+        char name[32];
+        snprintf(name, sizeof(name), "sideband_anim_%d", k);
+        controls[k] = client->createSurface(String8(name), X_WINDOW_SIZE, Y_WINDOW_SIZE,
+                PIXEL_FORMAT_RGBX_8888, 0);
+        if ((controls[k] == NULL) || (!controls[k]->isValid())) {
+            printf("%s:%i, fail to create SurfaceControl\n", __FUNCTION__, __LINE__);
+            return 1;
+        }
+        surfaces[k] = controls[k]->getSurface();
+        handles[k] = new SidebandNativeHandle(true);
+        handles[k]->setVideoPlaneId(k % SidebandNativeHandle::SIDEBAND_VIDEO_PLANE_NUM);
+        sp<NativeHandle> stream = NativeHandle::create(handles[k], false);
+        punchHole(surfaces[k], stream);
+
+        small[k].x = 2*HALF_RES_X - (k % 4 + 1)*(X_WINDOW_SIZE/2 + 16);
+        small[k].y = 2*HALF_RES_Y - (k/4 + 1)*(Y_WINDOW_SIZE/2 + 16);
+        small[k].width = X_WINDOW_SIZE/2;
+        small[k].height = Y_WINDOW_SIZE/2;
+        large[k].x = (k % 2)*HALF_RES_X;
+        large[k].y = (k/2 % 2)*HALF_RES_Y;
+        large[k].width = HALF_RES_X;
+        large[k].height = HALF_RES_Y;
+        setup.setLayer(controls[k], 21000 + k).show(controls[k])
+             .setPosition(controls[k], small[k].x, small[k].y)
+             .setMatrix(controls[k], 0.5f, 0.0f, 0.0f, 0.5f);
+        animator.addLayer(controls[k], X_WINDOW_SIZE, Y_WINDOW_SIZE);
+    }
+    setup.apply();
+
+    printf("%d streams, %d ms transitions, %s\n", nStreams, durationMs,
+            sleepUs ? "fixed sleep, a transaction per layer" : "vsync paced, one transaction");
+    printf("%-12s %6s %6s %7s %5s %8s %8s %8s\n", "transition", "frames", "missed", "doubled",
+            "late", "apply50", "apply99", "max");
+    SidebandAnimator::Stats total;
+    memset(&total, 0, sizeof(total));
+    for (int i = 0; i < transitions; i++) {
+        bool grow = (i % 2) == 0;
+        for (int k = 0; k < nStreams; k++) {
+            animator.animate(k, grow ? small[k] : large[k], grow ? large[k] : small[k],
+                    (nsecs_t)durationMs*1000000);
+        }
+        SidebandAnimator::Stats stats;
+        if (animator.run(&stats, sleepUs) != NO_ERROR) {
+            printf("no vsync\n");
+            break;
+        }
+        char name[24];
+        snprintf(name, sizeof(name), "%d %s", i, grow ? "grow" : "shrink");
+        printAnimStats(name, stats);
+        total.frames += stats.frames;
+        total.missedVsyncs += stats.missedVsyncs;
+        total.doubledFrames += stats.doubledFrames;
+        total.lateApplies += stats.lateApplies;
+        total.applyP50 = stats.applyP50 > total.applyP50 ? stats.applyP50 : total.applyP50;
+        total.applyP99 = stats.applyP99 > total.applyP99 ? stats.applyP99 : total.applyP99;
+        total.applyMax = stats.applyMax > total.applyMax ? stats.applyMax : total.applyMax;
+    }
+    printAnimStats("all (worst)", total);
+
+    for (int k = 0; k < nStreams; k++) {
+        surfaces[k]->setSidebandStream(NULL);
+        delete handles[k];
+    }
+    return 0;
+}
+
+/*
+ * usage: red123_layer                          one hole on the PIP plane, held
+ *        red123_layer bench [streams] [ops] [seed]
+ *        red123_layer control [frames]
+ *        red123_layer import [calls]
+ *        red123_layer fuzz [iterations] [seed]
+ *        red123_layer ids [threads] [iterations] [held]
+ *        red123_layer animate [streams] [transitions] [durationMs] [sleepUs]
+ */
 int main(int argc, char** argv)
 {
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        int nStreams = argc > 2 ? atoi(argv[2]) : 4;
+        int nOps = argc > 3 ? atoi(argv[3]) : 2000;
+        unsigned seed = argc > 4 ? (unsigned)atoi(argv[4]) : 1;
+        if (nStreams < 1 || nStreams > SidebandPlaneManager::MAX_STREAMS || nOps < 1) {
+            printf("usage: %s bench [streams 1..%d] [ops] [seed]\n", argv[0], SidebandPlaneManager::MAX_STREAMS);
+            return 1;
+        }
+        return runBench(nStreams, nOps, seed);
+    }
+    if (argc > 1 && strcmp(argv[1], "control") == 0) {
+        int frames = argc > 2 ? atoi(argv[2]) : 1000;
+        if (frames < 1) {
+            printf("usage: %s control [frames]\n", argv[0]);
+            return 1;
+        }
+        return runControlBench(frames);
+    }
+    if (argc > 1 && strcmp(argv[1], "import") == 0) {
+        int calls = argc > 2 ? atoi(argv[2]) : 10000000;
+        return runImportBench(calls > 0 ? calls : 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "fuzz") == 0) {
+        int iterations = argc > 2 ? atoi(argv[2]) : 100000;
+        unsigned seed = argc > 3 ? (unsigned)atoi(argv[3]) : 1;
+        return runFuzz(iterations, seed);
+    }
+    if (argc > 1 && strcmp(argv[1], "ids") == 0) {
+        int nThreads = argc > 2 ? atoi(argv[2]) : 48;
+        int iterations = argc > 3 ? atoi(argv[3]) : 20000;
+        int held = argc > 4 ? atoi(argv[4]) : 8;
+        if (nThreads < 1 || iterations < 1 || held < 1 || held > 64 ||
+                nThreads*held > SidebandHandleIds::MAX_SLOTS) {
+            printf("usage: %s ids [threads] [iterations] [held 1..64], threads*held <= %d\n",
+                    argv[0], SidebandHandleIds::MAX_SLOTS);
+            return 1;
+        }
+        return runIdStress(nThreads, iterations, held);
+    }
+    if (argc > 1 && strcmp(argv[1], "animate") == 0) {
+        int nStreams = argc > 2 ? atoi(argv[2]) : 4;
+        int transitions = argc > 3 ? atoi(argv[3]) : 4;
+        int durationMs = argc > 4 ? atoi(argv[4]) : 300;
+        int sleepUs = argc > 5 ? atoi(argv[5]) : 0;
+        if (nStreams < 1 || nStreams > SidebandAnimator::MAX_LAYERS || transitions < 1 ||
+                durationMs < 1 || sleepUs < 0) {
+            printf("usage: %s animate [streams 1..%d] [transitions] [durationMs] [sleepUs, 0 for vsync]\n",
+                    argv[0], SidebandAnimator::MAX_LAYERS);
+            return 1;
+        }
+        return runAnimation(nStreams, transitions, durationMs, sleepUs);
+    }
     if (argc != 1) {
-        printf("usage: %s\n", argv[0]);
+        printf("usage: %s [bench [streams] [ops] [seed] | control [frames] | import [calls] | fuzz [iterations] [seed] |"
+                " ids [threads] [iterations] [held] | animate [streams] [transitions] [durationMs] [sleepUs]]\n",
+                argv[0]);
         exit(0);
     }
 
@@ -82,8 +802,8 @@ int main(int argc, char** argv)
      printf("%s:%i, Qunidaye !!!!! n", __FUNCTION__, __LINE__);
 
 	SurfaceComposerClient::Transaction t;
-	t.setLayer(mSurfaceControl, 21000+1).show(mSurfaceControl).apply();	
-	t.setPosition(mSurfaceControl, 1000, 200).setSize(mSurfaceControl, 500, 500).apply();
+	t.setLayer(mSurfaceControl, 21000+1).show(mSurfaceControl)
+	 .setPosition(mSurfaceControl, 1000, 200).setSize(mSurfaceControl, 500, 500).apply();
 
     mSurface = mSurfaceControl->getSurface();
     if (mSurface == NULL) {
@@ -99,7 +819,7 @@ int main(int argc, char** argv)
         goto error_exit;
     }
     
-    sb_nativeHandle->planeId = 1;
+    sb_nativeHandle->setVideoPlaneId(SidebandNativeHandle::SIDEBAND_VIDEO_PLANE_PIP);
         
     nativeHandle = NativeHandle::create(sb_nativeHandle, false);
 
@@ -107,31 +827,20 @@ int main(int argc, char** argv)
         punch a hole and wait the position changes */
     punchHole(mSurface, nativeHandle);
 
-    //for (i = 0; i < ANIMATION_COUNT; i++)
+    /* second step: slide the hole to the middle, doubling it, one update per vsync */
+    sleep(3);
     {
-	
-		
-
+        SidebandAnimator animator;
+        SidebandAnimator::Stats stats;
+        SidebandAnimator::Geometry from = { 1000, 200, 500, 500 };
+        SidebandAnimator::Geometry to = { X_OFFSET*ANIMATION_COUNT, Y_OFFSET*ANIMATION_COUNT, 1000, 1000 };
+        animator.addLayer(mSurfaceControl, 500, 500);
+        animator.animate(0, from, to, ms2ns(33*ANIMATION_COUNT));
+        if (animator.initCheck() == NO_ERROR && animator.run(&stats) == NO_ERROR) {
+            printf("animation: %d frames, %d missed vsyncs\n", stats.frames, stats.missedVsyncs);
+        }
     }
 
-    /*sleep(3);
-
-    x_off = y_off = 0;
-    x_ratio = y_ratio = 1.0;
-    for (i = 0; i < ANIMATION_COUNT; i++)
-    {
-        usleep(33000);
-        x_off += X_OFFSET;
-        y_off += Y_OFFSET;
-        x_ratio += X_RATIO;
-        y_ratio += Y_RATIO;
-        SurfaceComposerClient::openGlobalTransaction();
-        mSurfaceControl->setPosition(x_off, y_off);
-        //mSurfaceControl->setSize(x_ratio*X_WINDOW_SIZE, y_ratio*Y_WINDOW_SIZE);
-        mSurfaceControl->setMatrix(x_ratio, 0.0, 0.0, y_ratio);
-        SurfaceComposerClient::closeGlobalTransaction();
-    }*/
-
     sleep(300000);
     mSurface->setSidebandStream(NULL);
 
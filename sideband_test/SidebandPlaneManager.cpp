@@ -0,0 +1,253 @@
+/*
+ * SidebandPlaneManager.cpp
+ * Hands the video planes out between sideband streams.
+ */
+
+#define LOG_TAG "SidebandPlaneManager"
+
+#include <stdio.h>
+#include <utils/Log.h>
+
+#include "SidebandPlaneManager.h"
+
+namespace android {
+
+SidebandPlaneManager::SidebandPlaneManager(const sp<SurfaceComposerClient>& client)
+    : mClient(client)
+{
+    pthread_mutex_init(&mLock, NULL);
+    for (int i = 0; i < MAX_STREAMS; i++) {
+        mStreams[i].used = false;
+        mStreams[i].plane = -1;
+        mStreams[i].handle = NULL;
+    }
+    for (int p = 0; p < SidebandNativeHandle::SIDEBAND_VIDEO_PLANE_NUM; p++) {
+        mPlaneOwner[p] = -1;
+    }
+}
+
+SidebandPlaneManager::~SidebandPlaneManager()
+{
+    for (int i = 0; i < MAX_STREAMS; i++) {
+        if (mStreams[i].used) {
+            release(i);
+        }
+    }
+    pthread_mutex_destroy(&mLock);
+}
+
+bool SidebandPlaneManager::validStream(int stream) const
+{
+    return stream >= 0 && stream < MAX_STREAMS && mStreams[stream].used;
+}
+
+int SidebandPlaneManager::allocate(int x, int y, int width, int height, int z)
+{
+    pthread_mutex_lock(&mLock);
+    int stream = -1;
+    for (int i = 0; i < MAX_STREAMS; i++) {
+        if (!mStreams[i].used) {
+            stream = i;
+            break;
+        }
+    }
+    if (stream < 0) {
+        pthread_mutex_unlock(&mLock);
+        ALOGW("%s:%i, all %d streams in use", __FUNCTION__, __LINE__, MAX_STREAMS);
+        return -1;
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "sideband_%d", stream);
+    Stream& s = mStreams[stream];
+    s.control = mClient->createSurface(String8(name), width, height, PIXEL_FORMAT_RGBX_8888, 0);
+    if ((s.control == NULL) || (!s.control->isValid())) {
+        pthread_mutex_unlock(&mLock);
+        ALOGE("%s:%i, fail to create SurfaceControl", __FUNCTION__, __LINE__);
+        return -1;
+    }
+    s.surface = s.control->getSurface();
+    s.handle = new SidebandNativeHandle(true);
+    s.nativeHandle = NativeHandle::create(s.handle, false);
+    s.plane = -1;
+    s.x = x;
+    s.y = y;
+    s.used = true;
+
+    SurfaceComposerClient::Transaction()
+        .setLayer(s.control, z)
+        .setPosition(s.control, x, y)
+        .setSize(s.control, width, height)
+        .show(s.control)
+        .apply();
+    pthread_mutex_unlock(&mLock);
+    return stream;
+}
+
+status_t SidebandPlaneManager::release(int stream)
+{
+    pthread_mutex_lock(&mLock);
+    if (!validStream(stream)) {
+        pthread_mutex_unlock(&mLock);
+        return BAD_VALUE;
+    }
+    Stream& s = mStreams[stream];
+    if (s.plane >= 0) {
+        detachLocked(stream);
+    }
+    SurfaceComposerClient::Transaction().hide(s.control).apply();
+    s.nativeHandle = NULL;
+    delete s.handle;
+    s.handle = NULL;
+    s.surface = NULL;
+    s.control = NULL;
+    s.used = false;
+    pthread_mutex_unlock(&mLock);
+    return NO_ERROR;
+}
+
+status_t SidebandPlaneManager::attachLocked(int stream, int planeId)
+{
+    Stream& s = mStreams[stream];
+    if (planeId == ANY_PLANE) {
+        for (int p = 0; p < SidebandNativeHandle::SIDEBAND_VIDEO_PLANE_NUM; p++) {
+            if (mPlaneOwner[p] < 0) {
+                planeId = p;
+                break;
+            }
+        }
+        if (planeId == ANY_PLANE) {
+            return INVALID_OPERATION;
+        }
+    }
+    if (!SidebandNativeHandle::isValidPlaneId(planeId)) {
+        return BAD_VALUE;
+    }
+    if (mPlaneOwner[planeId] >= 0 && mPlaneOwner[planeId] != stream) {
+        return INVALID_OPERATION;
+    }
+    if (s.plane >= 0 && s.plane != planeId) {
+        return INVALID_OPERATION;
+    }
+
+    s.handle->setVideoPlaneId(planeId);
+    /* the consumer copies the handle, so a new plane id needs a new call */
+    status_t err = s.surface->setSidebandStream(s.nativeHandle);
+    if (err != NO_ERROR) {
+        ALOGE("%s:%i, setSidebandStream failed %d", __FUNCTION__, __LINE__, err);
+        return err;
+    }
+    s.plane = planeId;
+    mPlaneOwner[planeId] = stream;
+    return NO_ERROR;
+}
+
+status_t SidebandPlaneManager::detachLocked(int stream)
+{
+    Stream& s = mStreams[stream];
+    if (s.plane < 0) {
+        return NO_ERROR;
+    }
+    status_t err = s.surface->setSidebandStream(NULL);
+    mPlaneOwner[s.plane] = -1;
+    s.plane = -1;
+    return err;
+}
+
+status_t SidebandPlaneManager::attach(int stream, int planeId)
+{
+    pthread_mutex_lock(&mLock);
+    status_t err = validStream(stream) ? attachLocked(stream, planeId) : BAD_VALUE;
+    pthread_mutex_unlock(&mLock);
+    return err;
+}
+
+status_t SidebandPlaneManager::detach(int stream)
+{
+    pthread_mutex_lock(&mLock);
+    status_t err = validStream(stream) ? detachLocked(stream) : BAD_VALUE;
+    pthread_mutex_unlock(&mLock);
+    return err;
+}
+
+status_t SidebandPlaneManager::move(int stream, int planeId, int x, int y)
+{
+    pthread_mutex_lock(&mLock);
+    if (!validStream(stream) || !SidebandNativeHandle::isValidPlaneId(planeId)) {
+        pthread_mutex_unlock(&mLock);
+        return BAD_VALUE;
+    }
+    if (mPlaneOwner[planeId] >= 0 && mPlaneOwner[planeId] != stream) {
+        pthread_mutex_unlock(&mLock);
+        return INVALID_OPERATION;
+    }
+    Stream& s = mStreams[stream];
+    int oldPlane = s.plane;
+    if (s.plane >= 0 && s.plane != planeId) {
+        /* the old plane is released before the new one is programmed */
+        mPlaneOwner[s.plane] = -1;
+        s.plane = -1;
+    }
+    SurfaceComposerClient::Transaction().setPosition(s.control, x, y).apply();
+    status_t err = attachLocked(stream, planeId);
+    if (err != NO_ERROR) {
+        /* nothing took the old plane, the lock is held */
+        SurfaceComposerClient::Transaction().setPosition(s.control, s.x, s.y).apply();
+        if (oldPlane >= 0 && s.plane < 0 && attachLocked(stream, oldPlane) != NO_ERROR) {
+            ALOGE("%s:%i, stream %d lost plane %d", __FUNCTION__, __LINE__, stream, oldPlane);
+        }
+        pthread_mutex_unlock(&mLock);
+        return err;
+    }
+    s.x = x;
+    s.y = y;
+    pthread_mutex_unlock(&mLock);
+    return err;
+}
+
+int SidebandPlaneManager::planeOf(int stream)
+{
+    pthread_mutex_lock(&mLock);
+    int plane = validStream(stream) ? mStreams[stream].plane : -1;
+    pthread_mutex_unlock(&mLock);
+    return plane;
+}
+
+int SidebandPlaneManager::streamOn(int planeId)
+{
+    if (!SidebandNativeHandle::isValidPlaneId(planeId)) {
+        return -1;
+    }
+    pthread_mutex_lock(&mLock);
+    int stream = mPlaneOwner[planeId];
+    pthread_mutex_unlock(&mLock);
+    return stream;
+}
+
+int SidebandPlaneManager::numStreams()
+{
+    pthread_mutex_lock(&mLock);
+    int n = 0;
+    for (int i = 0; i < MAX_STREAMS; i++) {
+        n += mStreams[i].used ? 1 : 0;
+    }
+    pthread_mutex_unlock(&mLock);
+    return n;
+}
+
+void SidebandPlaneManager::dump()
+{
+    pthread_mutex_lock(&mLock);
+    for (int p = 0; p < SidebandNativeHandle::SIDEBAND_VIDEO_PLANE_NUM; p++) {
+        printf("plane %d (%s): stream %d\n", p, SidebandNativeHandle::sPlanes[p].name, mPlaneOwner[p]);
+    }
+    for (int i = 0; i < MAX_STREAMS; i++) {
+        if (mStreams[i].used) {
+            printf("stream %d: handle %d:%d, plane %d\n", i, mStreams[i].handle->clientTid,
+                    mStreams[i].handle->index, mStreams[i].plane);
+        }
+    }
+    pthread_mutex_unlock(&mLock);
+}
+
+}; // namespace android
@@ -0,0 +1,82 @@
+/*
+ * SidebandPlaneManager.h
+ * Owns up to MAX_STREAMS sideband streams, each a layer with its own
+ * SidebandNativeHandle, and hands the video planes out between them: a
+ * stream is attached to at most one plane, a plane carries at most one
+ * stream.
+ */
+
+#ifndef ANDROID_SIDEBAND_PLANE_MANAGER_H
+#define ANDROID_SIDEBAND_PLANE_MANAGER_H
+
+#include <pthread.h>
+
+#include <gui/Surface.h>
+#include <gui/SurfaceComposerClient.h>
+#include <utils/NativeHandle.h>
+
+#include "SidebandNativeHandle.h"
+
+// ----------------------------------------------------------------------------
+namespace android {
+// ----------------------------------------------------------------------------
+class SidebandPlaneManager {
+public:
+    enum {
+        MAX_STREAMS = 16,
+        ANY_PLANE = -1,
+    };
+
+    SidebandPlaneManager(const sp<SurfaceComposerClient>& client);
+    ~SidebandPlaneManager();
+
+    /* creates a detached stream with its hole at (x, y), returns its id or -1 */
+    int allocate(int x, int y, int width, int height, int z);
+    /* detaches the stream if needed and destroys its layer */
+    status_t release(int stream);
+
+    /*
+     * puts the stream on planeId, or on the first free plane for ANY_PLANE,
+     * and punches its hole; INVALID_OPERATION when the plane is taken
+     */
+    status_t attach(int stream, int planeId = ANY_PLANE);
+    /* clears the layer's sideband stream and frees the plane */
+    status_t detach(int stream);
+    /*
+     * to another plane, taking the hole to (x, y) first; the stream is a
+     * Surface call of its own, so when it cannot go on planeId the stream
+     * is put back on its old plane and the hole back where it was
+     */
+    status_t move(int stream, int planeId, int x, int y);
+
+    /* the plane a stream is on, or -1 */
+    int planeOf(int stream);
+    /* the stream on a plane, or -1 */
+    int streamOn(int planeId);
+    int numStreams();
+    void dump();
+
+private:
+    struct Stream {
+        bool used;
+        int plane;
+        int x, y;               /* where its hole is */
+        sp<SurfaceControl> control;
+        sp<Surface> surface;
+        SidebandNativeHandle *handle;
+        sp<NativeHandle> nativeHandle;
+    };
+
+    bool validStream(int stream) const;
+    status_t attachLocked(int stream, int planeId);
+    status_t detachLocked(int stream);
+
+    sp<SurfaceComposerClient> mClient;
+    pthread_mutex_t mLock;
+    Stream mStreams[MAX_STREAMS];
+    int mPlaneOwner[SidebandNativeHandle::SIDEBAND_VIDEO_PLANE_NUM];
+};
+
+// ----------------------------------------------------------------------------
+}; // namespace android
+#endif // ANDROID_SIDEBAND_PLANE_MANAGER_H